@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/image/depthCodec.h"
+#include "saiga/core/image/png_wrapper.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/directory.h"
+#include "saiga/core/util/file.h"
+#include "saiga/core/util/zlib.h"
+
+#include <filesystem>
+
+using namespace Saiga;
+
+/**
+ * Compression ratio and throughput of the lossless depth codec compared to zlib and PNG.
+ *
+ * Usage:
+ *    sample_core_benchmark_depth_codec [dir]
+ *
+ * If a directory is given, all 16 bit depth images (.png, .saigai, .saigad) in it are used as a sequence.
+ * Otherwise a synthetic sequence of a moving object in front of a noisy plane is generated.
+ *
+ * Throughput is measured in MB/s of uncompressed depth data. PNG is written to and read from a temporary
+ * file, because libpng is only used with files in Saiga.
+ */
+
+static std::vector<TemplatedImage<uint16_t>> SyntheticSequence(int num_frames, int h, int w)
+{
+    std::vector<TemplatedImage<uint16_t>> frames;
+    for (int i = 0; i < num_frames; ++i)
+    {
+        TemplatedImage<uint16_t> img(h, w);
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                // Depth in mm like the raw output of a Kinect
+                float d = 2000 + 0.8f * x + 0.4f * y;
+                if (std::abs(x - 100 - i * 5) < 60 && std::abs(y - h / 2) < 80) d = 1200 + 0.1f * y;
+                // Invalid border and holes
+                if (x < 8 || (x * 7 + y * 13) % 211 == 0) d = 0;
+                if (d > 0) d += Random::sampleDouble(-2, 2);
+                img(y, x) = uint16_t(d);
+            }
+        }
+        frames.push_back(img);
+    }
+    return frames;
+}
+
+static std::vector<TemplatedImage<uint16_t>> LoadSequence(const std::string& dir_name)
+{
+    Directory dir(dir_name);
+    std::vector<std::string> files;
+    for (auto ending : {".saigad", ".saigai", ".png"})
+    {
+        files = dir.getFilesEnding(ending);
+        if (!files.empty()) break;
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<TemplatedImage<uint16_t>> frames;
+    for (auto& f : files)
+    {
+        TemplatedImage<uint16_t> img;
+        if (img.load(dir() + "/" + f)) frames.push_back(img);
+    }
+    return frames;
+}
+
+struct Result
+{
+    size_t compressed_size = 0;
+    double encode_ms       = 0;
+    double decode_ms       = 0;
+};
+
+int main(int argc, char** argv)
+{
+    catchSegFaults();
+
+    auto frames = argc > 1 ? LoadSequence(argv[1]) : SyntheticSequence(30, 480, 640);
+    SAIGA_ASSERT(!frames.empty(), "No 16 bit depth images found.");
+
+    int samples       = 3;
+    double total_size = 0;
+    for (auto& f : frames) total_size += f.size();
+    double total_mb = total_size / (1000.0 * 1000.0);
+
+    std::cout << "Depth sequence: " << frames.size() << " frames of " << frames.front().w << "x" << frames.front().h
+              << " (" << total_mb << " MB)" << std::endl;
+
+    Table table({25, 12, 18, 18});
+    table << "Method"
+          << "Ratio"
+          << "Encode (MB/s)"
+          << "Decode (MB/s)";
+
+    auto print = [&](const std::string& name, const Result& r) {
+        table << name << total_size / r.compressed_size << total_mb / (r.encode_ms / 1000.0)
+              << total_mb / (r.decode_ms / 1000.0);
+    };
+
+    std::vector<std::vector<unsigned char>> compressed(frames.size());
+    TemplatedImage<uint16_t> decoded, previous;
+
+    auto depth_codec = [&](bool temporal) {
+        Result r;
+        r.encode_ms = measureObject(samples, [&]() {
+                          for (int i = 0; i < frames.size(); ++i)
+                          {
+                              compressed[i] = EncodeDepth(frames[i], temporal && i > 0 ? &frames[i - 1] : nullptr);
+                          }
+                      }).median;
+        r.decode_ms = measureObject(samples, [&]() {
+                          for (int i = 0; i < frames.size(); ++i)
+                          {
+                              bool ok = DecodeDepth(compressed[i].data(), compressed[i].size(), decoded,
+                                                    temporal && i > 0 ? &previous : nullptr);
+                              SAIGA_ASSERT(ok && decoded == frames[i]);
+                              std::swap(decoded, previous);
+                          }
+                      }).median;
+        for (auto& c : compressed) r.compressed_size += c.size();
+        return r;
+    };
+
+    for (auto kernel : {DepthCodecKernel::Scalar, DepthCodecKernel::AVX2})
+    {
+        if (!DepthCodecKernelSupported(kernel)) continue;
+        SetDepthCodecKernel(kernel);
+        std::string name = std::string("Depth ") + DepthCodecKernelName(kernel);
+        print(name + " spatial", depth_codec(false));
+        print(name + " temporal", depth_codec(true));
+    }
+
+#ifdef SAIGA_USE_ZLIB
+    {
+        Result r;
+        r.encode_ms = measureObject(samples, [&]() {
+                          for (int i = 0; i < frames.size(); ++i)
+                          {
+                              compressed[i] = compress(frames[i].data(), frames[i].size());
+                          }
+                      }).median;
+        r.decode_ms = measureObject(samples, [&]() {
+                          for (int i = 0; i < frames.size(); ++i)
+                          {
+                              auto data = uncompress(compressed[i].data());
+                              SAIGA_ASSERT(data.size() == frames[i].size());
+                          }
+                      }).median;
+        for (auto& c : compressed) r.compressed_size += c.size();
+        print("zlib", r);
+    }
+#endif
+
+#ifdef SAIGA_USE_PNG
+    {
+        auto file = [](int i) { return "depth_codec_benchmark_" + std::to_string(i) + ".png"; };
+        Result r;
+        r.encode_ms = measureObject(samples, [&]() {
+                          for (int i = 0; i < frames.size(); ++i) LibPNG::save(file(i), frames[i]);
+                      }).median;
+        r.decode_ms = measureObject(samples, [&]() {
+                          for (int i = 0; i < frames.size(); ++i)
+                          {
+                              bool ok = LibPNG::load(file(i), decoded);
+                              SAIGA_ASSERT(ok && decoded == frames[i]);
+                          }
+                      }).median;
+        for (int i = 0; i < frames.size(); ++i)
+        {
+            r.compressed_size += std::filesystem::file_size(file(i));
+            std::filesystem::remove(file(i));
+        }
+        print("PNG", r);
+    }
+#endif
+
+    return 0;
+}
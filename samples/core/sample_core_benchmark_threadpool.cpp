@@ -0,0 +1,199 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/core/util/Thread/threadPool.h"
+
+#include <queue>
+#include <set>
+
+using namespace Saiga;
+
+/**
+ * The previous single-queue thread pool.
+ * One mutex protected std::queue<std::function> and a shared_ptr<packaged_task> per task.
+ * Only used as a reference here.
+ */
+class LegacyThreadPool
+{
+   public:
+    LegacyThreadPool(size_t threads)
+    {
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers.emplace_back([this] {
+                for (;;)
+                {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queue_mutex);
+                        condition.wait(lock, [this] { return stop || !tasks.empty(); });
+                        if (stop && tasks.empty()) return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~LegacyThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    template <class F>
+    std::future<void> enqueue(F&& f)
+    {
+        auto task                = std::make_shared<std::packaged_task<void()>>(std::forward<F>(f));
+        std::future<void> result = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            tasks.emplace([task]() { (*task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+   private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable condition;
+    bool stop = false;
+};
+
+std::atomic<long> sink = 0;
+
+// A tiny task, comparable to per-keypoint work
+inline void smallWork(int i)
+{
+    long s = 0;
+    for (int j = 0; j < 50; ++j) s += (i * j) ^ j;
+    sink += s & 1;
+}
+
+template <typename F>
+void printResult(Table& table, const std::string& name, int n, F f)
+{
+    auto st = measureObject(5, f);
+    // tasks per second in millions
+    double mtps = n / (st.median / 1000.0) / 1e6;
+    table << name << st.median << mtps;
+}
+
+void throughputTest(int threads, int n)
+{
+    std::cout << "Throughput with " << threads << " threads and " << n << " tasks" << std::endl;
+    Table table({30, 15, 15});
+    table << "Method"
+          << "Time (ms)"
+          << "M Tasks/s";
+
+    {
+        LegacyThreadPool pool(threads);
+        printResult(table, "Legacy enqueue", n, [&]() {
+            std::vector<std::future<void>> fs;
+            fs.reserve(n);
+            for (int i = 0; i < n; ++i) fs.push_back(pool.enqueue([i]() { smallWork(i); }));
+            for (auto& f : fs) f.wait();
+        });
+    }
+
+    ThreadPool pool(threads);
+    printResult(table, "ThreadPool enqueue", n, [&]() {
+        std::vector<std::future<void>> fs;
+        fs.reserve(n);
+        for (int i = 0; i < n; ++i) fs.push_back(pool.enqueue([i]() { smallWork(i); }));
+        for (auto& f : fs) f.wait();
+    });
+
+    printResult(table, "ThreadPool TaskGroup", n, [&]() {
+        TaskGroup group(&pool);
+        for (int i = 0; i < n; ++i) group.run([i]() { smallWork(i); });
+        group.wait();
+    });
+
+    // Spawn the tasks from inside the pool, so they are pushed to the local queues and distributed by stealing.
+    printResult(table, "ThreadPool nested TaskGroup", n, [&]() {
+        TaskGroup group(&pool);
+        int blocks = threads * 4;
+        for (int b = 0; b < blocks; ++b)
+        {
+            group.run([&, b]() {
+                TaskGroup inner(&pool, &group);
+                for (int i = b; i < n; i += blocks) inner.run([i]() { smallWork(i); });
+                inner.wait();
+            });
+        }
+        group.wait();
+    });
+    std::cout << std::endl;
+}
+
+// Time from enqueue until the task has finished on an idle pool.
+void latencyTest(int threads, int n)
+{
+    std::cout << "Round trip latency with " << threads << " threads" << std::endl;
+    Table table({30, 15});
+    table << "Method"
+          << "Latency (us)";
+
+    auto measure = [&](auto enqueue_and_wait) {
+        std::vector<float> times;
+        for (int i = 0; i < n; ++i)
+        {
+            float t;
+            {
+                ScopedTimer<float, std::chrono::microseconds> tim(t);
+                enqueue_and_wait();
+            }
+            times.push_back(t);
+        }
+        return Statistics<float>(times).median;
+    };
+
+    {
+        LegacyThreadPool pool(threads);
+        table << "Legacy enqueue" << measure([&]() { pool.enqueue([]() { smallWork(0); }).wait(); });
+    }
+    {
+        ThreadPool pool(threads);
+        table << "ThreadPool enqueue" << measure([&]() { pool.enqueue([]() { smallWork(0); }).wait(); });
+        table << "ThreadPool TaskGroup" << measure([&]() {
+            TaskGroup group(&pool);
+            group.run([]() { smallWork(0); });
+            group.wait();
+        });
+    }
+    std::cout << std::endl;
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+
+    int max_threads = OMP::getMaxThreads();
+    for (int threads : std::set<int>{1, 4, max_threads})
+    {
+        throughputTest(threads, 200000);
+    }
+    for (int threads : std::set<int>{1, max_threads})
+    {
+        latencyTest(threads, 1000);
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
@@ -99,7 +99,7 @@ void test_to_file(const OptimizationOptions& baoptions, const std::string& file,
     strm << "file,images,points,schur density,solver_type,iterations,time_recursive,time_g2o,time_ceres" << std::endl;
 
 
-    Saiga::Table table({20, 20, 15, 15});
+    Saiga::Table table({20, 20, 15, 15, 15});
 
     for (auto file : files)
     {
@@ -129,6 +129,7 @@ void test_to_file(const OptimizationOptions& baoptions, const std::string& file,
         std::cout << "> Initial Error: " << scene.chi2() << " - " << scene.rms() << std::endl;
         table << "Name"
               << "Final Error"
+              << "Time_JtJ"
               << "Time_LS"
               << "Time_Total";
 
@@ -139,6 +140,7 @@ void test_to_file(const OptimizationOptions& baoptions, const std::string& file,
         {
             std::vector<double> times;
             std::vector<double> timesl;
+            std::vector<double> timesj;
             double chi2;
             for (int i = 0; i < its; ++i)
             {
@@ -151,12 +153,14 @@ void test_to_file(const OptimizationOptions& baoptions, const std::string& file,
                 chi2        = result.cost_final;
                 times.push_back(result.total_time);
                 timesl.push_back(result.linear_solver_time);
+                timesj.push_back(result.jtj_time);
             }
 
 
             auto t  = Statistics(times).median / 1000.0 / baoptions.maxIterations;
             auto tl = Statistics(timesl).median / 1000.0 / baoptions.maxIterations;
-            table << s->name << chi2 << tl << t;
+            auto tj = Statistics(timesj).median / 1000.0 / baoptions.maxIterations;
+            table << s->name << chi2 << tj << tl << t;
             strm << "," << t;
         }
         strm << std::endl;
@@ -164,6 +168,53 @@ void test_to_file(const OptimizationOptions& baoptions, const std::string& file,
     }
 }
 
+// Compares the double and the mixed precision (float + iterative refinement) linear solver of BARec.
+void test_mixed_precision(OptimizationOptions baoptions, int its)
+{
+    baoptions.solverType = OptimizationOptions::SolverType::Iterative;
+    std::cout << baoptions << std::endl;
+
+    Saiga::Table table({30, 15, 15, 15, 15, 10});
+    table << "File"
+          << "Precision"
+          << "Final Error"
+          << "Time_LS"
+          << "Time_Total"
+          << "Speedup";
+
+    for (auto file : getBALFiles())
+    {
+        if (hasEnding(file, ".scene")) continue;
+
+        Scene scene;
+        buildSceneBAL(scene, SearchPathes::data(balPrefix + file));
+
+        double time_double = 0;
+        for (bool mixed : {false, true})
+        {
+            std::vector<double> times;
+            std::vector<double> timesl;
+            double chi2 = 0;
+            for (int i = 0; i < its; ++i)
+            {
+                Scene cpy = scene;
+                BARec ba;
+                ba.create(cpy);
+                ba.optimizationOptions                = baoptions;
+                ba.optimizationOptions.mixedPrecision = mixed;
+                auto result                           = ba.initAndSolve();
+                chi2                                  = result.cost_final;
+                times.push_back(result.total_time);
+                timesl.push_back(result.linear_solver_time);
+            }
+
+            auto t  = Statistics(times).median;
+            auto tl = Statistics(timesl).median;
+            if (!mixed) time_double = t;
+            table << file << (mixed ? "mixed" : "double") << chi2 << tl << t << time_double / t;
+        }
+    }
+}
 
 int main(int, char**)
 {
@@ -193,6 +244,12 @@ int main(int, char**)
             baoptions.solverType = OptimizationOptions::SolverType::Direct;
             test_to_file(baoptions, "ba_benchmark_chol.csv", testIts);
         }
+        if (1)
+        {
+            baoptions.maxIterativeIterations = 50;
+            baoptions.iterativeTolerance     = 1e-5;
+            test_mixed_precision(baoptions, testIts);
+        }
         return 0;
     }
 #endif
@@ -292,7 +349,8 @@ int main(int, char**)
         //        auto result = opt->initAndSolve();
 
         std::cout << "Error " << result.cost_initial << " -> " << result.cost_final << std::endl;
-        std::cout << "Time LinearSolver/Total: " << result.linear_solver_time << "/" << result.total_time << std::endl;
+        std::cout << "Time Linearization/LinearSolver/Total: " << result.jtj_time << "/" << result.linear_solver_time
+                  << "/" << result.total_time << std::endl;
         std::cout << std::endl;
     }
 
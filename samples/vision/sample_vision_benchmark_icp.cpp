@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/threadPool.h"
+#include "saiga/vision/icp/ICPDepthMap.h"
+
+using namespace Saiga;
+
+/**
+ * Runtime and accuracy of the depth map ICP on a VGA frame pair.
+ * The frames are ray cast from a synthetic room, so the correct relative pose is known.
+ * Compares alignDepthMaps (full resolution, correspondence list) with the coarse-to-fine alignDepthMapsDense.
+ *
+ * Usage:
+ *    sample_vision_benchmark_icp            // all threads
+ *    sample_vision_benchmark_icp 1          // number of threads
+ */
+
+// Ray casting of a room with two spheres. The camera looks along +z with y pointing down.
+static TemplatedImage<float> RenderRoom(const IntrinsicsPinholed& K, int h, int w, const SE3& pose)
+{
+    // n * x = d
+    std::vector<std::pair<Vec3, double>> planes = {
+        {Vec3(0, 0, 1), 4}, {Vec3(0, 1, 0), 1.2}, {Vec3(1, 0, 0), -2}, {Vec3(1, 0, 0), 2.5}};
+    std::vector<std::pair<Vec3, double>> spheres = {{Vec3(0.3, 0.1, 2.5), 0.5}, {Vec3(-0.8, 0.6, 3.0), 0.4}};
+
+    TemplatedImage<float> depth(h, w);
+    Vec3 o = pose.translation();
+    for (int i = 0; i < h; ++i)
+    {
+        for (int j = 0; j < w; ++j)
+        {
+            Vec3 dir = pose.so3() * K.unproject(Vec2(j, i), 1);
+            double t = std::numeric_limits<double>::infinity();
+            for (auto& [n, d] : planes)
+            {
+                double ti = (d - n.dot(o)) / n.dot(dir);
+                if (ti > 0) t = std::min(t, ti);
+            }
+            for (auto& [c, r] : spheres)
+            {
+                Vec3 oc     = o - c;
+                double a    = dir.squaredNorm();
+                double b    = 2 * dir.dot(oc);
+                double disc = b * b - 4 * a * (oc.squaredNorm() - r * r);
+                if (disc < 0) continue;
+                double ti = (-b - std::sqrt(disc)) / (2 * a);
+                if (ti > 0) t = std::min(t, ti);
+            }
+            // 1mm noise
+            depth(i, j) = std::isfinite(t) ? t + Random::gaussRand(0, 0.001) : 0;
+        }
+    }
+    return depth;
+}
+
+int main(int argc, char** argv)
+{
+    catchSegFaults();
+    createGlobalThreadPool(argc > 1 ? std::atoi(argv[1]) - 1 : -1);
+    std::cout << "Threads: " << globalThreadPool->numThreads() + 1 << std::endl;
+
+    int w = 640, h = 480;
+    IntrinsicsPinholed K(525, 525, 319.5, 239.5, 0);
+    SE3 ref_pose;
+    // About the motion between two frames at 30 Hz of a hand-held camera
+    SE3 src_pose(Sophus::SO3d::exp(Vec3(0.3, 1, 0.2).normalized() * radians(2.0)), Vec3(0.02, -0.01, 0.03));
+
+    auto ref_depth = RenderRoom(K, h, w, ref_pose);
+    auto src_depth = RenderRoom(K, h, w, src_pose);
+
+    int its = 20;
+    Table table({35, 15, 15, 15});
+    table << "Method"
+          << "Time (ms)"
+          << "Error t (mm)"
+          << "Error R (deg)";
+    auto print = [&](const std::string& name, auto f) {
+        SE3 result;
+        auto st = measureObject(its, [&]() { result = f(); });
+        SE3 d   = result.inverse() * src_pose;
+        table << name << st.median << d.translation().norm() * 1000 << degrees(d.so3().log().norm());
+    };
+
+    print("alignDepthMaps (10 its)", [&]() {
+        return ICP::alignDepthMaps(ref_depth.getImageView(), src_depth.getImageView(), ref_pose, SE3(), K, 10);
+    });
+
+    ICP::DenseICPParams params;
+    print("alignDepthMapsDense", [&]() {
+        return ICP::alignDepthMapsDense(ref_depth.getImageView(), src_depth.getImageView(), ref_pose, SE3(), K,
+                                        params);
+    });
+
+    // Odometry: the pyramid of each frame is only built once.
+    ICP::DepthMapPyramid ref_pyramid(ref_depth.getImageView(), K, params.iterations.size());
+    ICP::DepthMapPyramid src_pyramid(src_depth.getImageView(), K, params.iterations.size());
+    print("  DepthMapPyramid", [&]() {
+        ICP::DepthMapPyramid pyramid(src_depth.getImageView(), K, params.iterations.size());
+        return src_pose;
+    });
+    print("  alignDepthMapsDense (pyramids)",
+          [&]() { return ICP::alignDepthMapsDense(ref_pyramid, src_pyramid, ref_pose, SE3(), params); });
+
+    params.huberThres = 0.01;
+    print("  robust (pyramids)",
+          [&]() { return ICP::alignDepthMapsDense(ref_pyramid, src_pyramid, ref_pose, SE3(), params); });
+
+    params.huberThres = 0;
+    params.fineStride = 1;
+    print("  all fine pixels (pyramids)",
+          [&]() { return ICP::alignDepthMapsDense(ref_pyramid, src_pyramid, ref_pose, SE3(), params); });
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
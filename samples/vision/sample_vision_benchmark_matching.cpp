@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/features/Features.h"
+
+#include <set>
+
+using namespace Saiga;
+
+/**
+ * Brute force matching of random ORB descriptors.
+ * Reports the number of descriptor comparisons per second for the scalar reference loop,
+ * every SIMD kernel supported by this CPU and the multithreaded matcher.
+ */
+
+static std::vector<DescriptorORB> RandomDescriptors(int n)
+{
+    std::vector<DescriptorORB> result(n);
+    for (auto& d : result)
+    {
+        for (auto& w : d) w = Random::urand64();
+    }
+    return result;
+}
+
+// The matcher before the batched kernels: one scalar distance call per pair.
+static void ScalarKnn2(const std::vector<DescriptorORB>& d1, const std::vector<DescriptorORB>& d2,
+                       std::vector<std::pair<int, int>>& knn2)
+{
+    knn2.resize(d1.size() * 2);
+    for (int i = 0; i < d1.size(); ++i)
+    {
+        std::pair<int, int> best = {1000, -1}, second = {1000, -1};
+        for (int j = 0; j < d2.size(); ++j)
+        {
+            int dis = distance(d1[i], d2[j]);
+            if (dis < best.first)
+            {
+                second = best;
+                best   = {dis, j};
+            }
+            else if (dis < second.first)
+            {
+                second = {dis, j};
+            }
+        }
+        knn2[i * 2]     = best;
+        knn2[i * 2 + 1] = second;
+    }
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+
+    int n   = 2000;
+    int m   = 2000;
+    auto d1 = RandomDescriptors(n);
+    auto d2 = RandomDescriptors(m);
+
+    double comparisons = double(n) * m;
+    std::cout << "Matching " << n << " x " << m << " ORB descriptors" << std::endl;
+    std::cout << "Default kernel: " << HammingKernelName(ActiveHammingKernel()) << std::endl;
+
+    Table table({35, 15, 20});
+    table << "Method"
+          << "Time (ms)"
+          << "G Comparisons/s";
+    auto print = [&](const std::string& name, auto f) {
+        auto st = measureObject(10, f);
+        table << name << st.median << comparisons / (st.median / 1000.0) / 1e9;
+    };
+
+    std::vector<std::pair<int, int>> ref;
+    print("Scalar loop", [&]() { ScalarKnn2(d1, d2, ref); });
+
+    BruteForceMatcher<DescriptorORB> matcher;
+    auto default_kernel = ActiveHammingKernel();
+    for (auto kernel : {HammingKernel::Scalar, HammingKernel::AVX2, HammingKernel::AVX512BW,
+                        HammingKernel::AVX512VPOPCNT})
+    {
+        if (!HammingKernelSupported(kernel)) continue;
+        SetHammingKernel(kernel);
+        print(std::string("knn2 ") + HammingKernelName(kernel), [&]() { matcher.matchKnn2(d1, d2); });
+    }
+    SetHammingKernel(default_kernel);
+
+    for (int threads : std::set<int>{1, 4, OMP::getMaxThreads()})
+    {
+        print("knn2 " + std::to_string(threads) + " threads", [&]() { matcher.matchKnn2_omp(d1, d2, threads); });
+        print("cross check " + std::to_string(threads) + " threads",
+              [&]() { matcher.matchCrossCheck(d1, d2, 50, threads); });
+    }
+
+    // Sanity check against the reference
+    matcher.matchKnn2(d1, d2);
+    for (int i = 0; i < n; ++i)
+    {
+        SAIGA_ASSERT(matcher.knn2(i, 0) == ref[i * 2] && matcher.knn2(i, 1) == ref[i * 2 + 1]);
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
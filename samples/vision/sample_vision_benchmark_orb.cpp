@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/image/imageTransformations.h"
+#include "saiga/core/time/all.h"
+#include "saiga/vision/features/FastDetector.h"
+#include "saiga/vision/features/ORBExtractor.h"
+#include "saiga/vision/features/OrbDescriptors.h"
+
+#ifdef SAIGA_USE_OPENCV
+#    include "saiga/vision/opencv/opencv.h"
+
+#    include <opencv2/features2d/features2d.hpp>
+#    include <opencv2/imgproc/imgproc.hpp>
+#endif
+
+using namespace Saiga;
+
+/**
+ * Runtime of the ORB extractor stages on a EuRoC-sized (752x480) gray image.
+ * Compares every FAST and ORB descriptor kernel supported by this CPU, the pyramid downsampler and the gaussian blur
+ * against the OpenCV functions which were used by the ORBExtractor before (only if saiga is built with OpenCV).
+ *
+ * Usage:
+ *    sample_vision_benchmark_orb            // synthetic image
+ *    sample_vision_benchmark_orb image.png  // for example a frame of the EuRoC MAV dataset
+ */
+
+// Blurred noise with some uniform rectangles
+static TemplatedImage<unsigned char> SyntheticImage(int h, int w)
+{
+    TemplatedImage<unsigned char> noise(h, w), img(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x) noise(y, x) = Random::uniformInt(0, 255);
+    }
+    ImageTransformation::GaussianBlur(noise.getConstImageView(), img.getImageView(), 3, 1.5);
+
+    for (int i = 0; i < 200; ++i)
+    {
+        int s  = Random::uniformInt(5, 30);
+        int y0 = Random::uniformInt(0, h - s - 1);
+        int x0 = Random::uniformInt(0, w - s - 1);
+        int c  = Random::uniformInt(0, 255);
+        img.getImageView().subImageView(y0, x0, s, s).set(c);
+    }
+    return img;
+}
+
+int main(int argc, char** argv)
+{
+    catchSegFaults();
+
+    TemplatedImage<unsigned char> img = argc > 1 ? TemplatedImage<unsigned char>(argv[1]) : SyntheticImage(480, 752);
+    std::cout << "Image " << img.w << "x" << img.h << std::endl;
+    std::cout << "Default FAST kernel: " << FastKernelName(ActiveFastKernel()) << std::endl;
+
+    int its = 50;
+    Table table({35, 15, 15});
+    table << "Method"
+          << "Time (ms)"
+          << "Result";
+    auto print = [&](const std::string& name, auto f, auto result) {
+        auto st = measureObject(its, f);
+        table << name << st.median << result();
+    };
+
+    // ============== FAST ==============
+    std::vector<KeyPoint<float>> keypoints;
+    FastDetector fast;
+    auto default_kernel = ActiveFastKernel();
+    for (auto kernel : {FastKernel::Scalar, FastKernel::SSE2, FastKernel::AVX2})
+    {
+        if (!FastKernelSupported(kernel)) continue;
+        SetFastKernel(kernel);
+        print(std::string("FAST ") + FastKernelName(kernel),
+              [&]() { fast.Detect(img.getConstImageView(), 20, true, keypoints); },
+              [&]() { return keypoints.size(); });
+    }
+    SetFastKernel(default_kernel);
+
+    // ============== Orientation and descriptors ==============
+    // The FAST corners of the image, which are far enough away from the border.
+    std::vector<KeyPoint<float>> orb_keypoints;
+    for (auto kp : keypoints)
+    {
+        if (kp.point.x() >= 19 && kp.point.y() >= 19 && kp.point.x() < img.w - 19 && kp.point.y() < img.h - 19)
+            orb_keypoints.push_back(kp);
+    }
+    std::vector<DescriptorORB> orb_descriptors(orb_keypoints.size());
+    ORB orb;
+    print("ComputeAngle (single)",
+          [&]() {
+              for (auto& kp : orb_keypoints) kp.angle = orb.ComputeAngle(img.getImageView(), kp.point);
+          },
+          [&]() { return orb_keypoints.size(); });
+    print("ComputeDescriptor (single)",
+          [&]() {
+              for (size_t i = 0; i < orb_keypoints.size(); ++i)
+                  orb_descriptors[i] =
+                      orb.ComputeDescriptor(img.getImageView(), orb_keypoints[i].point, orb_keypoints[i].angle);
+          },
+          [&]() { return orb_keypoints.size(); });
+
+    auto default_orb_kernel = ActiveOrbKernel();
+    for (auto kernel : {OrbKernel::Scalar, OrbKernel::AVX2})
+    {
+        if (!OrbKernelSupported(kernel)) continue;
+        SetOrbKernel(kernel);
+        print(std::string("ComputeAngles ") + OrbKernelName(kernel),
+              [&]() { orb.ComputeAngles(img.getImageView(), orb_keypoints); },
+              [&]() { return orb_keypoints.size(); });
+        print(std::string("ComputeDescriptors ") + OrbKernelName(kernel),
+              [&]() { orb.ComputeDescriptors(img.getImageView(), orb_keypoints, orb_descriptors); },
+              [&]() { return orb_keypoints.size(); });
+    }
+    SetOrbKernel(default_orb_kernel);
+
+    // ============== Pyramid and blur ==============
+    TemplatedImage<unsigned char> small(iRound(img.h / 1.2), iRound(img.w / 1.2));
+    TemplatedImage<unsigned char> blurred(img.h, img.w);
+    print("ResizeBilinear (1/1.2)",
+          [&]() { ImageTransformation::ResizeBilinear(img.getConstImageView(), small.getImageView()); },
+          [&]() { return int(small(small.h / 2, small.w / 2)); });
+    print("GaussianBlur 7x7",
+          [&]() { ImageTransformation::GaussianBlur(img.getConstImageView(), blurred.getImageView(), 3, 2); },
+          [&]() { return int(blurred(img.h / 2, img.w / 2)); });
+
+#ifdef SAIGA_USE_OPENCV
+    cv::setNumThreads(1);
+    cv::Mat cv_img = ImageViewToMat(img.getImageView());
+    std::vector<cv::KeyPoint> cv_keypoints;
+    print("cv::FAST", [&]() { cv::FAST(cv_img, cv_keypoints, 20, true); }, [&]() { return cv_keypoints.size(); });
+
+    cv::Mat cv_small   = ImageViewToMat(small.getImageView());
+    cv::Mat cv_blurred = ImageViewToMat(blurred.getImageView());
+    print("cv::resize (1/1.2)",
+          [&]() { cv::resize(cv_img, cv_small, cv::Size(small.w, small.h), 0, 0, cv::INTER_LINEAR); },
+          [&]() { return int(small(small.h / 2, small.w / 2)); });
+    print("cv::GaussianBlur 7x7",
+          [&]() { cv::GaussianBlur(cv_img, cv_blurred, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101); },
+          [&]() { return int(blurred(img.h / 2, img.w / 2)); });
+#endif
+
+    // ============== Complete extractor ==============
+    // Same settings as the ORB-SLAM2 EuRoC config
+    ORBExtractor extractor(1000, 1.2, 8, 20, 7, 1);
+    std::vector<DescriptorORB> descriptors;
+    for (auto kernel : {FastKernel::Scalar, FastKernel::SSE2, FastKernel::AVX2})
+    {
+        if (!FastKernelSupported(kernel)) continue;
+        SetFastKernel(kernel);
+        print(std::string("ORBExtractor ") + FastKernelName(kernel),
+              [&]() { extractor.Detect(img.getImageView(), keypoints, descriptors); },
+              [&]() { return keypoints.size(); });
+    }
+    SetFastKernel(default_kernel);
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/math/random.h"
+#include "saiga/core/time/all.h"
+#include "saiga/vision/slam/MiniBow2.h"
+
+using namespace Saiga;
+
+/**
+ * Query latency of the MiniBow2 inverted-file database compared to scoring every entry.
+ *
+ * The bow vectors are sampled randomly from a vocabulary with the size of the ORB-SLAM vocabulary (k=10, L=6).
+ * Therefore no trained vocabulary is required.
+ */
+
+const int num_words        = 1000000;
+const int words_per_vector = 150;
+const int num_queries      = 100;
+
+static MiniBow2::BowVector RandomBowVector()
+{
+    std::vector<std::pair<MiniBow2::WordId, MiniBow2::WordValue>> words;
+    for (int i = 0; i < words_per_vector; ++i)
+    {
+        words.push_back({Random::uniformInt(0, num_words - 1), Random::sampleDouble(0.1, 1)});
+    }
+    MiniBow2::BowVector bv;
+    bv.set(words);
+    return bv;
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+
+    Table table({12, 20, 20, 20});
+    table << "Entries"
+          << "Linear (us)"
+          << "Inverted (us)"
+          << "Candidates/query";
+
+    MiniBow2::Database db(num_words, false);
+    std::vector<MiniBow2::BowVector> queries;
+    for (int i = 0; i < num_queries; ++i) queries.push_back(RandomBowVector());
+
+    for (int n : {10000, 100000})
+    {
+        for (int i = db.size(); i < n; ++i) db.add(i, RandomBowVector());
+
+        auto measure = [&](auto f) {
+            std::vector<float> times;
+            for (auto& q : queries)
+            {
+                float t;
+                {
+                    ScopedTimer<float, std::chrono::microseconds> tim(t);
+                    f(q);
+                }
+                times.push_back(t);
+            }
+            return Statistics<float>(times).median;
+        };
+
+        auto linear = measure([&](const MiniBow2::BowVector& q) {
+            std::vector<std::pair<float, int>> scores;
+            for (int i = 0; i < db.size(); ++i)
+            {
+                float s = MiniBow2::FeatureVector::score(q, db.getBowVector(i));
+                if (s > 0) scores.push_back({s, i});
+            }
+            int k = std::min<int>(10, scores.size());
+            std::partial_sort(scores.begin(), scores.begin() + k, scores.end(), std::greater<>());
+        });
+
+        auto inverted = measure([&](const MiniBow2::BowVector& q) { db.query(q, 10); });
+
+        // Number of entries sharing at least one word with the query
+        long candidates = 0;
+        for (auto& q : queries) candidates += db.query(q, -1).size();
+
+        table << n << linear << inverted << candidates / double(num_queries);
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
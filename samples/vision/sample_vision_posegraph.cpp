@@ -12,16 +12,85 @@
 #include "saiga/core/util/tostring.h"
 #include "saiga/vision/ceres/CeresPGO.h"
 #include "saiga/vision/g2o/g2oPoseGraph.h"
+#include "saiga/vision/pgo/PGOIncremental.h"
 #include "saiga/vision/recursive/PGORecursive.h"
 #include "saiga/vision/recursive/PGOSim3Recursive.h"
 #include "saiga/vision/scene/BALDataset.h"
 #include "saiga/vision/scene/PoseGraph.h"
 #include "saiga/vision/scene/SynteticPoseGraph.h"
 #include "saiga/vision/scene/SynteticScene.h"
+#include "saiga/vision/util/Random.h"
 
 #include <fstream>
 using namespace Saiga;
 
+// Simulates a SLAM system: The vertices of a circle graph are added one by one together with all edges to previous
+// vertices. The wrap-around edges at the end are large loop closures. After each step the graph is optimized with
+// the incremental solver and, for comparison, with a full batch solve.
+static void IncrementalBenchmark(int num_vertices, int num_connections)
+{
+    PoseGraph reference = SyntheticPoseGraph::Circle(5, num_vertices, num_connections);
+    for (auto& e : reference.edges)
+    {
+        e.T_i_j = DSim3(Random::JitterPose(e.GetSE3(), 0.01, 0.01), 1.0);
+    }
+
+    OptimizationOptions baoptions;
+    baoptions.maxIterations = 3;
+    baoptions.solverType    = OptimizationOptions::SolverType::Direct;
+
+    PoseGraph graph_incremental, graph_batch;
+    PGOIncremental incremental;
+    incremental.create(graph_incremental);
+
+    double time_incremental = 0, time_batch = 0;
+    int full_solves = 0, refactored = 0;
+
+    for (int i = 0; i < num_vertices; ++i)
+    {
+        for (auto* graph : {&graph_incremental, &graph_batch})
+        {
+            graph->vertices.push_back(reference.vertices[i]);
+            for (auto& e : reference.edges)
+            {
+                if (i > 0 && e.from == i - 1 && e.to == i)
+                {
+                    graph->vertices[i].SetPose(graph->vertices[i - 1].Pose() * e.GetSE3());
+                }
+                if (std::max(e.from, e.to) == i) graph->edges.push_back(e);
+            }
+        }
+
+        double t;
+        {
+            ScopedTimer<double> timer(t);
+            auto result = incremental.Update();
+            full_solves += result.full_solve;
+            refactored += result.refactored_vertices;
+        }
+        time_incremental += t;
+        {
+            ScopedTimer<double> timer(t);
+            PGORec batch;
+            batch.create(graph_batch);
+            batch.optimizationOptions = baoptions;
+            batch.initAndSolve();
+        }
+        time_batch += t;
+    }
+
+    std::cout << "Incremental PGO: " << num_vertices << " vertices, " << reference.edges.size() << " edges"
+              << std::endl;
+    std::cout << "Full solves: " << full_solves
+              << ", refactored vertices per step: " << double(refactored) / num_vertices << std::endl;
+    Table table({20, 15, 15});
+    table << "Solver"
+          << "Time (ms)"
+          << "Chi2";
+    table << "Incremental" << time_incremental << graph_incremental.chi2();
+    table << "Batch" << time_batch << graph_batch.chi2();
+    std::cout << std::endl;
+}
 
 int main(int, char**)
 {
@@ -67,5 +136,7 @@ int main(int, char**)
         std::cout << std::endl;
     }
 
+    IncrementalBenchmark(1000, 6);
+
     return 0;
 }
@@ -432,6 +432,25 @@ class Sparse_LDLT_TEST
     }
 
 
+    auto solveEigenRecursiveSupernodal()
+    {
+        x.setZero();
+        // Uses its own AMD ordering on the block pattern.
+        using LLT = Eigen::RecursiveSupernodalLLT<AType, Eigen::Lower>;
+        LLT llt;
+        float time = 0;
+        {
+            Saiga::ScopedTimer<float> timer(time);
+            llt.analyzePattern(A);
+            llt.factorize(A);
+        }
+        x = llt.solve(b);
+
+        double error = expand((A * x - b).eval()).squaredNorm();
+        return std::make_tuple(time, error, SAIGA_SHORT_FUNCTION);
+    }
+
+
     Eigen::PermutationMatrix<-1> permFull, permBlock;
     std::vector<int> orderingFull;
     std::vector<int> orderingBlock;
@@ -633,6 +652,7 @@ void run()
     //        make_test(test, table, &LDLT::solveEigenRecursiveSparseLDLTRowMajor);
     make_test(test, table, &LDLT::solveEigenRecursiveSparseLDLT);
     make_test(test, table, &LDLT::solveEigenRecursiveSparseLDLT3);
+    if constexpr (block_size > 1) make_test(test, table, &LDLT::solveEigenRecursiveSupernodal);
 
     //    make_test(test, table, &LDLT::solveEigenRecursiveSparseLDLT);
 
@@ -673,6 +693,7 @@ void perf_test()
     strm << "n,nnz,block_size,density,"
             "eigen_recursive,"
             "eigen_recursive2,"
+            "eigen_recursive_supernodal,"
             "cholmod_simp,"
             "cholmod_super"
          << std::endl;
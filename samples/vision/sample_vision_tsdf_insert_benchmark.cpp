@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/reconstruction/SparseTSDF.h"
+
+using namespace Saiga;
+
+/**
+ * Thread scaling of the block allocation of the SparseTSDF.
+ *
+ * Similar to FusionScene::AnalyseSparseStructure, the blocks in the truncation band around random surface points
+ * are inserted. The rays are processed in parallel with InsertBlockConcurrent using 1..N threads. The serial
+ * InsertBlock is the reference. Every configuration must produce the same set of blocks.
+ */
+
+// Block indices along the truncation band of random rays. Neighbouring rays hit mostly the same blocks, which
+// creates a realistic amount of concurrent inserts of the same key.
+static std::vector<std::vector<ivec3>> RandomRays(SparseTSDF& tsdf, int num_rays, float truncation)
+{
+    std::vector<std::vector<ivec3>> rays(num_rays);
+    for (auto& ray : rays)
+    {
+        vec3 dir     = Random::sphericalRand(1).cast<float>();
+        float depth  = Random::sampleDouble(2, 4);
+        float step   = tsdf.voxel_size * tsdf.VOXEL_BLOCK_SIZE * 0.5f;
+        int num_step = int(2 * truncation / step) + 1;
+        for (int s = 0; s <= num_step; ++s)
+        {
+            vec3 position = dir * (depth - truncation + s * step);
+            ray.push_back(tsdf.GetBlockIndex(position));
+        }
+    }
+    return rays;
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+
+    int num_rays     = 100000;
+    float truncation = 0.1;
+    int hash_size    = 1000 * 1000;
+    int samples      = 5;
+
+    SparseTSDF reference(0.01, 1000, hash_size);
+    auto rays = RandomRays(reference, num_rays, truncation);
+
+    size_t num_inserts = 0;
+    for (auto& r : rays) num_inserts += r.size();
+
+    auto st_serial = measureObject(
+        samples,
+        [&]() {
+            for (auto& ray : rays)
+            {
+                for (auto& i : ray) reference.InsertBlock(i);
+            }
+        },
+        [&]() { reference.Clear(); });
+
+    std::cout << "Inserting " << num_inserts << " blocks along " << num_rays << " rays" << std::endl;
+    std::cout << "Unique blocks: " << reference.Size() << std::endl;
+
+    Table table({20, 15, 15, 15});
+    table << "Method"
+          << "Time (ms)"
+          << "M Inserts/s"
+          << "Speedup";
+    table << "Serial" << st_serial.median << num_inserts / (st_serial.median / 1000.0) / 1e6 << 1;
+
+    SparseTSDF tsdf(0.01, 1000, hash_size);
+    int max_threads = OMP::getMaxThreads();
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    for (int threads : thread_counts)
+    {
+        ParallelOptions options;
+        options.max_threads = threads;
+
+        auto st = measureObject(
+            samples,
+            [&]() {
+                ParallelFor(
+                    0, (int)rays.size(),
+                    [&](int r) {
+                        for (auto& i : rays[r]) tsdf.InsertBlockConcurrent(i);
+                    },
+                    options);
+            },
+            [&]() { tsdf.Clear(); });
+
+        SAIGA_ASSERT(tsdf.Size() == reference.Size());
+        for (int b = 0; b < tsdf.Size(); ++b)
+        {
+            SAIGA_ASSERT(reference.GetBlock(tsdf.blocks[b].index));
+        }
+
+        table << ("Concurrent " + std::to_string(threads)) << st.median
+              << num_inserts / (st.median / 1000.0) / 1e6 << st_serial.median / st.median;
+    }
+
+    return 0;
+}
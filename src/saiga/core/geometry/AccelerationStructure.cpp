@@ -5,8 +5,12 @@
  */
 #include "AccelerationStructure.h"
 
+#include "saiga/core/util/assert.h"
+
 #include "algorithm"
 
+#include <cmath>
+
 namespace Saiga
 {
 namespace AccelerationStructure
@@ -45,6 +49,21 @@ std::vector<RayTriangleIntersection> BruteForce::getAll(const Ray& ray) const
     return result;
 }
 
+bool BruteForce::AnyHit(const Ray& ray) const
+{
+    for (auto& tri : triangles)
+    {
+        if (Intersection::RayTriangle(ray, tri, triangle_epsilon)) return true;
+    }
+    return false;
+}
+
+// Fixed size traversal stack. The depth of a BVH over int-indexed triangles is far below this.
+static constexpr int bvh_stack_size = 128;
+
+// Below this depth SAHBVH only uses median splits, which add at most 32 more levels.
+static constexpr int sah_max_depth = 64;
+static_assert(sah_max_depth + 32 < bvh_stack_size, "The SAH depth limit does not fit into the traversal stack.");
 
 BVH::BVH(const std::vector<Saiga::Triangle>& triangles)
 {
@@ -70,6 +89,145 @@ std::vector<Intersection::RayTriangleIntersection> BVH::getAll(const Ray& ray) c
     return result;
 }
 
+bool BVH::AnyHit(const Ray& ray) const
+{
+    if (nodes.empty()) return false;
+
+    uint32_t stack[bvh_stack_size];
+    int stack_size      = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        const BVHNode& n = nodes[stack[--stack_size]];
+
+        float aabbT;
+        if (!Intersection::RayAABB(ray, n.box, aabbT)) continue;
+
+        if (n._inner)
+        {
+            SAIGA_ASSERT(stack_size + 2 <= bvh_stack_size);
+            stack[stack_size++] = n._right;
+            stack[stack_size++] = n._left;
+        }
+        else
+        {
+            for (uint32_t i = n._left; i < n._right; ++i)
+            {
+                if (Intersection::RayTriangle(ray, triangles[i].first, triangle_epsilon)) return true;
+            }
+        }
+    }
+    return false;
+}
+
+void BVH::ComputeWindingNumberData()
+{
+    dipoles.resize(nodes.size());
+
+    // Children are always stored after their parent -> bottom up in reverse order
+    for (int i = (int)nodes.size() - 1; i >= 0; --i)
+    {
+        auto& n = nodes[i];
+        auto& d = dipoles[i];
+        d.area_normal.setZero();
+        d.area = 0;
+
+        if (n._inner)
+        {
+            auto& l = dipoles[n._left];
+            auto& r = dipoles[n._right];
+
+            d.area        = l.area + r.area;
+            d.area_normal = l.area_normal + r.area_normal;
+            d.center      = n.box.getPosition();
+            if (d.area > 0) d.center = (l.center * l.area + r.center * r.area) / d.area;
+
+            // Bounding sphere of the children spheres
+            d.radius = std::max((l.center - d.center).norm() + l.radius, (r.center - d.center).norm() + r.radius);
+        }
+        else
+        {
+            vec3 weighted_center = vec3::Zero();
+            for (uint32_t t = n._left; t < n._right; ++t)
+            {
+                auto& tri = triangles[t].first;
+                vec3 an   = 0.5f * (tri.b - tri.a).cross(tri.c - tri.a);
+                float a   = an.norm();
+                d.area_normal += an;
+                d.area += a;
+                weighted_center += a * tri.center();
+            }
+            d.center = n.box.getPosition();
+            if (d.area > 0) d.center = weighted_center / d.area;
+
+            d.radius = 0;
+            for (uint32_t t = n._left; t < n._right; ++t)
+            {
+                auto& tri = triangles[t].first;
+                for (auto& v : {tri.a, tri.b, tri.c})
+                {
+                    d.radius = std::max(d.radius, (v - d.center).norm());
+                }
+            }
+        }
+    }
+}
+
+float BVH::WindingNumber(const vec3& p, float beta) const
+{
+    SAIGA_ASSERT(dipoles.size() == nodes.size(), "ComputeWindingNumberData() missing.");
+    if (nodes.empty()) return 0;
+
+    // Sum of solid angles
+    double omega = 0;
+
+    uint32_t stack[bvh_stack_size];
+    int stack_size      = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        uint32_t node_id = stack[--stack_size];
+        auto& n          = nodes[node_id];
+        auto& d          = dipoles[node_id];
+
+        vec3 r     = d.center - p;
+        float dist = r.norm();
+        if (dist > beta * d.radius)
+        {
+            // Far field: dipole approximation
+            omega += r.dot(d.area_normal) / (dist * dist * dist);
+            continue;
+        }
+
+        if (n._inner)
+        {
+            SAIGA_ASSERT(stack_size + 2 <= bvh_stack_size);
+            stack[stack_size++] = n._right;
+            stack[stack_size++] = n._left;
+        }
+        else
+        {
+            // Exact solid angle of each triangle
+            // The Solid Angle of a Plane Triangle, Van Oosterom and Strackee 1983
+            for (uint32_t t = n._left; t < n._right; ++t)
+            {
+                auto& tri = triangles[t].first;
+                vec3 a    = tri.a - p;
+                vec3 b    = tri.b - p;
+                vec3 c    = tri.c - p;
+                float la = a.norm(), lb = b.norm(), lc = c.norm();
+
+                float det = a.dot(b.cross(c));
+                float div = la * lb * lc + a.dot(b) * lc + a.dot(c) * lb + b.dot(c) * la;
+                omega += 2 * std::atan2(det, div);
+            }
+        }
+    }
+    return omega / (4 * pi<double>());
+}
+
 std::pair<float, int> BVH::ClosestPoint(const vec3& p) const
 {
     std::pair<float, int> result = {std::numeric_limits<float>::infinity(), -1};
@@ -263,5 +421,133 @@ int ObjectMedianBVH::construct(int start, int end)
 }
 
 
+void SAHBVH::construct()
+{
+    nodes.reserve(triangles.size());
+    construct(0, triangles.size(), 0);
+}
+
+int SAHBVH::construct(int start, int end, int depth)
+{
+    auto surface_area = [](const AABB& box) {
+        vec3 s = box.Size();
+        return 2 * (s.x() * s.y() + s.y() * s.z() + s.z() * s.x());
+    };
+
+    int nodeid = nodes.size();
+    nodes.push_back({});
+    nodes.back().box = computeBox(start, end);
+
+    int n = end - start;
+
+    // Bounds of the triangle centers to select the bins
+    AABB center_box;
+    center_box.makeNegative();
+    for (int i = start; i < end; ++i)
+    {
+        center_box.growBox(triangles[i].first.center());
+    }
+    int axis     = center_box.maxDimension();
+    float extent = center_box.max[axis] - center_box.min[axis];
+
+    int split = -1;
+    if (n > 1 && extent > 0 && depth < sah_max_depth)
+    {
+        struct Bin
+        {
+            AABB box;
+            int count = 0;
+        };
+        std::vector<Bin> bin_data(bins);
+        for (auto& b : bin_data) b.box.makeNegative();
+
+        auto bin_id = [&](const Triangle& t) {
+            int b = int(bins * (t.center()[axis] - center_box.min[axis]) / extent);
+            return std::min(b, bins - 1);
+        };
+
+        for (int i = start; i < end; ++i)
+        {
+            auto& t = triangles[i].first;
+            auto& b = bin_data[bin_id(t)];
+            b.count++;
+            b.box.growBox(t.a);
+            b.box.growBox(t.b);
+            b.box.growBox(t.c);
+        }
+
+        // Sweep from the right to get the cost of all right sides
+        std::vector<float> right_cost(bins, 0);
+        AABB right_box;
+        right_box.makeNegative();
+        int right_count = 0;
+        for (int b = bins - 1; b > 0; --b)
+        {
+            right_count += bin_data[b].count;
+            if (bin_data[b].count > 0) right_box.growBox(bin_data[b].box);
+            right_cost[b] = right_count > 0 ? right_count * surface_area(right_box) : 0;
+        }
+
+        // Split between bin b and b+1
+        AABB left_box;
+        left_box.makeNegative();
+        int left_count  = 0;
+        float best_cost = std::numeric_limits<float>::infinity();
+        int best_bin    = -1;
+        for (int b = 0; b < bins - 1; ++b)
+        {
+            left_count += bin_data[b].count;
+            if (bin_data[b].count > 0) left_box.growBox(bin_data[b].box);
+            if (left_count == 0 || left_count == n) continue;
+
+            float cost = left_count * surface_area(left_box) + right_cost[b + 1];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_bin  = b;
+            }
+        }
+
+        // Traversal cost = 1, intersection cost = 1
+        float parent_area = surface_area(nodes[nodeid].box);
+        float split_cost  = 1 + best_cost / parent_area;
+        bool make_leaf    = n <= leafTriangles && n <= split_cost;
+
+        if (best_bin >= 0 && !make_leaf)
+        {
+            auto in_left = [&](const std::pair<Triangle, int>& t) { return bin_id(t.first) <= best_bin; };
+            split = std::partition(triangles.begin() + start, triangles.begin() + end, in_left) - triangles.begin();
+        }
+    }
+
+    if (split < 0 && n > leafTriangles)
+    {
+        // All centers are in the same bin or the tree is too deep -> object median
+        sortByAxis(start, end, axis);
+        split = (start + end) / 2;
+    }
+
+    if (split < 0)
+    {
+        auto& node  = nodes[nodeid];
+        node._inner = 0;
+        node._left  = start;
+        node._right = end;
+    }
+    else
+    {
+        int l = construct(start, split, depth + 1);
+        int r = construct(split, end, depth + 1);
+
+        // reload node, because the reference from above might be broken
+        auto& node  = nodes[nodeid];
+        node._inner = 1;
+        node._left  = l;
+        node._right = r;
+    }
+
+    return nodeid;
+}
+
 }  // namespace AccelerationStructure
 }  // namespace Saiga
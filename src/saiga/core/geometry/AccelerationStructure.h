@@ -31,6 +31,10 @@ class SAIGA_CORE_API Base
     virtual RayTriangleIntersection getClosest(const Ray& ray) const          = 0;
     virtual std::vector<RayTriangleIntersection> getAll(const Ray& ray) const = 0;
 
+    // True if the ray intersects at least one triangle. Same as !getAll(ray).empty(), but the implementations stop at
+    // the first hit and do not allocate memory.
+    virtual bool AnyHit(const Ray& ray) const { return !getAll(ray).empty(); }
+
     float bvh_epsilon      = 0.0001;
     float triangle_epsilon = 0.00001;
 };
@@ -45,6 +49,7 @@ class SAIGA_CORE_API BruteForce : public Base
 
     virtual RayTriangleIntersection getClosest(const Ray& ray) const override;
     virtual std::vector<RayTriangleIntersection> getAll(const Ray& ray) const override;
+    virtual bool AnyHit(const Ray& ray) const override;
 
    private:
     std::vector<Triangle> triangles;
@@ -87,12 +92,36 @@ class SAIGA_CORE_API BVH : public Base
 
     virtual RayTriangleIntersection getClosest(const Ray& ray) const override;
     virtual std::vector<RayTriangleIntersection> getAll(const Ray& ray) const override;
+    virtual bool AnyHit(const Ray& ray) const override;
     virtual std::pair<float, int> ClosestPoint(const vec3& p) const;
 
+    // Generalized winding number of the triangles at point p.
+    // For a closed mesh it is 1 inside and 0 outside (-1 inside if the triangles are oriented clockwise). For
+    // meshes with holes or self intersections it is a smooth inside/outside measure.
+    //
+    // Fast Winding Numbers for Soups and Clouds, Barill et al. 2018:
+    // Nodes with a distance > beta * radius are approximated by a dipole. Larger beta -> more accurate, but slower.
+    // ComputeWindingNumberData() must be called once before.
+    float WindingNumber(const vec3& p, float beta = 2) const;
+    void ComputeWindingNumberData();
+
    protected:
     std::vector<std::pair<Triangle, int>> triangles;
+
+    // Depth first order. The left child of an inner node is always the next node.
     std::vector<BVHNode> nodes;
 
+    // The dipole of all triangles in a node. Same order as 'nodes'.
+    struct DipoleNode
+    {
+        vec3 center;
+        float radius;
+        // sum(area * normal)
+        vec3 area_normal;
+        float area;
+    };
+    std::vector<DipoleNode> dipoles;
+
     AABB computeBox(int start, int end) const;
     void sortByAxis(int start, int end, int axis);
 
@@ -119,5 +148,33 @@ class SAIGA_CORE_API ObjectMedianBVH : public BVH
     int construct(int start, int end);
 };
 
+/**
+ * BVH built with the binned surface area heuristic.
+ *
+ * On Fast Construction of SAH-based Bounding Volume Hierarchies, Wald 2007
+ *
+ * The construction is slower than ObjectMedianBVH, but the traversal visits much fewer nodes on meshes with varying
+ * triangle sizes (CAD models, scans). Nodes with at most 'leafTriangles' triangles become a leaf if splitting does
+ * not reduce the estimated cost. If the SAH finds no split (coincident centers) or the tree gets too deep, the node
+ * is split at the object median. The depth therefore always fits into the fixed traversal stack.
+ */
+class SAIGA_CORE_API SAHBVH : public BVH
+{
+   public:
+    SAHBVH() {}
+    SAHBVH(const std::vector<Triangle>& triangles, int leafTriangles = 4, int bins = 16)
+        : BVH(triangles), leafTriangles(leafTriangles), bins(bins)
+    {
+        construct();
+    }
+    virtual ~SAHBVH() {}
+
+   protected:
+    int leafTriangles = 4;
+    int bins          = 16;
+    void construct() override;
+    int construct(int start, int end, int depth);
+};
+
 }  // namespace AccelerationStructure
 }  // namespace Saiga
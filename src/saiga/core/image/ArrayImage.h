@@ -25,14 +25,15 @@ class ArrayImage : public ImageBase
 
     ImageView<T> getImageView()
     {
-        ImageView<T> res(*this);
+        // Construct from the base, because *this would select the conversion operator below.
+        ImageView<T> res(static_cast<const ImageBase&>(*this));
         res.data = data();
         return res;
     }
 
     ImageView<const T> getConstImageView() const
     {
-        ImageView<const T> res(*this);
+        ImageView<const T> res(static_cast<const ImageBase&>(*this));
         res.data = data();
         return res;
     }
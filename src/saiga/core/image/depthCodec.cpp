@@ -0,0 +1,654 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "depthCodec.h"
+
+#include "saiga/core/util/assert.h"
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_DEPTH_CODEC_X86
+#    include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+namespace Saiga
+{
+constexpr uint32_t depth_codec_magic    = 0x44474153;
+constexpr uint32_t depth_sequence_magic = 0x51474153;
+
+// Residuals with a quotient >= rice_limit are stored without the Rice code.
+constexpr int rice_limit = 24;
+// Number of residuals which share a 'zero group' flag.
+constexpr int group_size = 8;
+
+struct DepthCodecHeader
+{
+    uint32_t magic;
+    int32_t width;
+    int32_t height;
+    int32_t type;
+    uint32_t temporal;
+    uint32_t reserved;
+};
+
+static inline int CountLeadingZeros(uint64_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - index;
+#else
+    return __builtin_clzll(x);
+#endif
+}
+
+// ============== Bit IO ==============
+// The bits are written MSB first, so that the reader can decode the unary part with a single clz.
+
+class BitWriter
+{
+   public:
+    BitWriter(std::vector<unsigned char>& out) : out(out) {}
+
+    // n <= 56
+    void Put(uint64_t value, int n)
+    {
+        acc = (acc << n) | value;
+        bits += n;
+        while (bits >= 8)
+        {
+            bits -= 8;
+            out.push_back(uint8_t(acc >> bits));
+        }
+    }
+
+    void Flush()
+    {
+        if (bits > 0) Put(0, 8 - bits);
+    }
+
+   private:
+    std::vector<unsigned char>& out;
+    uint64_t acc = 0;
+    int bits     = 0;
+};
+
+class BitReader
+{
+   public:
+    BitReader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    // 0 < n <= 56
+    uint64_t Get(int n)
+    {
+        Refill();
+        uint64_t value = acc >> (64 - n);
+        acc <<= n;
+        bits -= n;
+        return value;
+    }
+
+    // Reads q zero bits followed by a one bit and returns q.
+    int Unary()
+    {
+        Refill();
+        int q = acc == 0 ? 64 : CountLeadingZeros(acc);
+        if (q > rice_limit)
+        {
+            error = true;
+            q     = rice_limit;
+        }
+        acc <<= q + 1;
+        bits -= q + 1;
+        return q;
+    }
+
+    // True if the stream was corrupted or more bits were consumed than available.
+    bool Error() const { return error || pos * 8 - bits > size * 8; }
+
+   private:
+    void Refill()
+    {
+        // Zeros are appended at the end of the stream
+        while (bits <= 56)
+        {
+            uint64_t byte = pos < size ? data[pos] : 0;
+            acc |= byte << (56 - bits);
+            bits += 8;
+            pos++;
+        }
+    }
+
+    const unsigned char* data;
+    size_t size;
+    size_t pos   = 0;
+    uint64_t acc = 0;
+    int bits     = 0;
+    bool error   = false;
+};
+
+// ============== Entropy coding ==============
+
+// Adaptive Golomb-Rice parameter (similar to JPEG-LS).
+// A is the accumulated magnitude of the last N residuals.
+struct RiceState
+{
+    uint64_t A = 16;
+    uint64_t N = 1;
+
+    int K() const
+    {
+        int k = 0;
+        while ((N << k) < A) ++k;
+        return k;
+    }
+
+    // Outliers, for example at depth discontinuities and invalid pixels, are clamped. Otherwise they would
+    // increase k for many of the following residuals.
+    void Update(uint64_t u)
+    {
+        A += std::min(u, 8 * (A / N) + 8);
+        if (++N == 64)
+        {
+            A >>= 1;
+            N >>= 1;
+        }
+    }
+};
+
+template <typename U>
+static void EncodeRow(BitWriter& writer, RiceState& state, const U* u, int n, int raw_bits)
+{
+    for (int g = 0; g < n; g += group_size)
+    {
+        int end = std::min(g + group_size, n);
+        U any   = 0;
+        for (int i = g; i < end; ++i) any |= u[i];
+        writer.Put(any != 0, 1);
+        if (!any) continue;
+
+        for (int i = g; i < end; ++i)
+        {
+            int k      = state.K();
+            uint64_t q = u[i] >> k;
+            if (q < rice_limit)
+            {
+                writer.Put(1, q + 1);
+                if (k > 0) writer.Put(u[i] & ((uint64_t(1) << k) - 1), k);
+            }
+            else
+            {
+                writer.Put(1, rice_limit + 1);
+                writer.Put(u[i], raw_bits);
+            }
+            state.Update(u[i]);
+        }
+    }
+}
+
+template <typename U>
+static void DecodeRow(BitReader& reader, RiceState& state, U* u, int n, int raw_bits)
+{
+    for (int g = 0; g < n; g += group_size)
+    {
+        int end = std::min(g + group_size, n);
+        if (!reader.Get(1))
+        {
+            for (int i = g; i < end; ++i) u[i] = 0;
+            continue;
+        }
+
+        for (int i = g; i < end; ++i)
+        {
+            int k = state.K();
+            int q = reader.Unary();
+            if (q < rice_limit)
+            {
+                u[i] = (U(q) << k) | (k > 0 ? reader.Get(k) : 0);
+            }
+            else
+            {
+                u[i] = reader.Get(raw_bits);
+            }
+            state.Update(u[i]);
+        }
+    }
+}
+
+// ============== Prediction ==============
+// T is the pixel type (uint16_t or the bit pattern of a float). U is the type of the zig-zag encoded residuals.
+
+template <typename T, typename U>
+static inline U ZigZag(T x, int64_t prediction)
+{
+    int64_t r = int64_t(x) - prediction;
+    return U((uint64_t(r) << 1) ^ uint64_t(r >> 63));
+}
+
+template <typename T, typename U>
+static inline T UnZigZag(U u, int64_t prediction)
+{
+    int64_t r = int64_t(u >> 1) ^ -int64_t(u & 1);
+    return T(prediction + r);
+}
+
+// Median edge detector. Equal to median(a, b, a + b - c).
+static inline int64_t MED(int64_t a, int64_t b, int64_t c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), a + b - c));
+}
+
+// Spatial prediction of pixel x. 'up' is nullptr in the first row.
+template <typename T>
+static inline int64_t SpatialPrediction(const T* row, const T* up, int x)
+{
+    if (!up) return x > 0 ? row[x - 1] : 0;
+    if (x == 0) return up[0];
+    return MED(row[x - 1], up[x], up[x - 1]);
+}
+
+template <typename T, typename U>
+static void SpatialResidualsScalar(const T* row, const T* up, int w, U* out)
+{
+    for (int x = 0; x < w; ++x) out[x] = ZigZag<T, U>(row[x], SpatialPrediction(row, up, x));
+}
+
+template <typename T, typename U>
+static void TemporalResidualsScalar(const T* row, const T* prev, int w, U* out)
+{
+    for (int x = 0; x < w; ++x) out[x] = ZigZag<T, U>(row[x], prev[x]);
+}
+
+template <typename T, typename U>
+static void SpatialReconstruct(T* row, const T* up, int w, const U* u)
+{
+    // Serial, because each prediction depends on the left pixel
+    for (int x = 0; x < w; ++x) row[x] = UnZigZag<T, U>(u[x], SpatialPrediction(row, up, x));
+}
+
+template <typename T, typename U>
+static void TemporalReconstructScalar(T* row, const T* prev, int w, const U* u)
+{
+    for (int x = 0; x < w; ++x) row[x] = UnZigZag<T, U>(u[x], prev[x]);
+}
+
+#ifdef SAIGA_DEPTH_CODEC_X86
+
+__attribute__((target("avx2"))) static inline __m256i Load8US(const uint16_t* ptr)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)ptr));
+}
+
+__attribute__((target("avx2"))) static inline __m256i ZigZagAVX2(__m256i r)
+{
+    return _mm256_xor_si256(_mm256_slli_epi32(r, 1), _mm256_srai_epi32(r, 31));
+}
+
+__attribute__((target("avx2"))) static void SpatialResidualsAVX2(const uint16_t* row, const uint16_t* up, int w,
+                                                                 uint32_t* out)
+{
+    if (!up || w <= 8)
+    {
+        SpatialResidualsScalar(row, up, w, out);
+        return;
+    }
+
+    out[0] = ZigZag<uint16_t, uint32_t>(row[0], up[0]);
+    int x  = 1;
+    for (; x + 8 <= w; x += 8)
+    {
+        __m256i a  = Load8US(row + x - 1);
+        __m256i b  = Load8US(up + x);
+        __m256i c  = Load8US(up + x - 1);
+        __m256i mn = _mm256_min_epi32(a, b);
+        __m256i mx = _mm256_max_epi32(a, b);
+        __m256i g  = _mm256_sub_epi32(_mm256_add_epi32(a, b), c);
+        __m256i p  = _mm256_max_epi32(mn, _mm256_min_epi32(mx, g));
+        _mm256_storeu_si256((__m256i*)(out + x), ZigZagAVX2(_mm256_sub_epi32(Load8US(row + x), p)));
+    }
+    for (; x < w; ++x) out[x] = ZigZag<uint16_t, uint32_t>(row[x], SpatialPrediction(row, up, x));
+}
+
+__attribute__((target("avx2"))) static void TemporalResidualsAVX2(const uint16_t* row, const uint16_t* prev, int w,
+                                                                  uint32_t* out)
+{
+    int x = 0;
+    for (; x + 8 <= w; x += 8)
+    {
+        __m256i r = _mm256_sub_epi32(Load8US(row + x), Load8US(prev + x));
+        _mm256_storeu_si256((__m256i*)(out + x), ZigZagAVX2(r));
+    }
+    for (; x < w; ++x) out[x] = ZigZag<uint16_t, uint32_t>(row[x], prev[x]);
+}
+
+__attribute__((target("avx2"))) static void TemporalReconstructAVX2(uint16_t* row, const uint16_t* prev, int w,
+                                                                    const uint32_t* u)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    int x             = 0;
+    for (; x + 8 <= w; x += 8)
+    {
+        __m256i uz = _mm256_loadu_si256((const __m256i*)(u + x));
+        __m256i r  = _mm256_xor_si256(_mm256_srli_epi32(uz, 1),
+                                     _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(uz, one)));
+        __m256i v  = _mm256_add_epi32(Load8US(prev + x), r);
+        // The values are in [0, 65535] for valid streams -> packus doesn't saturate
+        __m256i p = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+        _mm_storeu_si128((__m128i*)(row + x), _mm256_castsi256_si128(p));
+    }
+    for (; x < w; ++x) row[x] = UnZigZag<uint16_t, uint32_t>(u[x], prev[x]);
+}
+#endif
+
+// ============== Runtime dispatch ==============
+
+bool DepthCodecKernelSupported(DepthCodecKernel kernel)
+{
+    switch (kernel)
+    {
+        case DepthCodecKernel::Scalar:
+            return true;
+#ifdef SAIGA_DEPTH_CODEC_X86
+        case DepthCodecKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* DepthCodecKernelName(DepthCodecKernel kernel)
+{
+    switch (kernel)
+    {
+        case DepthCodecKernel::Scalar:
+            return "Scalar";
+        case DepthCodecKernel::AVX2:
+            return "AVX2";
+    }
+    return "Unknown";
+}
+
+static std::atomic<DepthCodecKernel> active_kernel =
+    DepthCodecKernelSupported(DepthCodecKernel::AVX2) ? DepthCodecKernel::AVX2 : DepthCodecKernel::Scalar;
+
+DepthCodecKernel ActiveDepthCodecKernel()
+{
+    return active_kernel;
+}
+
+void SetDepthCodecKernel(DepthCodecKernel kernel)
+{
+    SAIGA_ASSERT(DepthCodecKernelSupported(kernel));
+    active_kernel = kernel;
+}
+
+template <typename T, typename U>
+static void SpatialResiduals(const T* row, const T* up, int w, U* out)
+{
+#ifdef SAIGA_DEPTH_CODEC_X86
+    if constexpr (std::is_same_v<T, uint16_t>)
+    {
+        if (active_kernel == DepthCodecKernel::AVX2) return SpatialResidualsAVX2(row, up, w, out);
+    }
+#endif
+    SpatialResidualsScalar(row, up, w, out);
+}
+
+template <typename T, typename U>
+static void TemporalResiduals(const T* row, const T* prev, int w, U* out)
+{
+#ifdef SAIGA_DEPTH_CODEC_X86
+    if constexpr (std::is_same_v<T, uint16_t>)
+    {
+        if (active_kernel == DepthCodecKernel::AVX2) return TemporalResidualsAVX2(row, prev, w, out);
+    }
+#endif
+    TemporalResidualsScalar(row, prev, w, out);
+}
+
+template <typename T, typename U>
+static void TemporalReconstruct(T* row, const T* prev, int w, const U* u)
+{
+#ifdef SAIGA_DEPTH_CODEC_X86
+    if constexpr (std::is_same_v<T, uint16_t>)
+    {
+        if (active_kernel == DepthCodecKernel::AVX2) return TemporalReconstructAVX2(row, prev, w, u);
+    }
+#endif
+    TemporalReconstructScalar(row, prev, w, u);
+}
+
+// ============== Image coding ==============
+
+template <typename T, typename U>
+static void EncodeImage(const Image& img, const Image* previous, BitWriter& writer)
+{
+    int w         = img.width;
+    int raw_bits  = sizeof(T) * 8 + 1;
+    using RowType = const T*;
+
+    std::vector<U> spatial(w), temporal(w);
+    RiceState state;
+    for (int y = 0; y < img.height; ++y)
+    {
+        RowType row = (RowType)img.rowPtr(y);
+        RowType up  = y > 0 ? (RowType)img.rowPtr(y - 1) : nullptr;
+        SpatialResiduals(row, up, w, spatial.data());
+
+        const U* best = spatial.data();
+        if (previous)
+        {
+            TemporalResiduals(row, (RowType)previous->rowPtr(y), w, temporal.data());
+
+            uint64_t cost_spatial = 0, cost_temporal = 0;
+            for (int x = 0; x < w; ++x)
+            {
+                cost_spatial += spatial[x];
+                cost_temporal += temporal[x];
+            }
+            bool use_temporal = cost_temporal < cost_spatial;
+            writer.Put(use_temporal, 1);
+            if (use_temporal) best = temporal.data();
+        }
+        EncodeRow(writer, state, best, w, raw_bits);
+    }
+}
+
+template <typename T, typename U>
+static bool DecodeImage(BitReader& reader, Image& img, const Image* previous)
+{
+    int w        = img.width;
+    int raw_bits = sizeof(T) * 8 + 1;
+
+    std::vector<U> u(w);
+    RiceState state;
+    for (int y = 0; y < img.height; ++y)
+    {
+        bool temporal = previous ? reader.Get(1) : false;
+        DecodeRow(reader, state, u.data(), w, raw_bits);
+        if (reader.Error()) return false;
+
+        T* row = (T*)img.rowPtr(y);
+        if (temporal)
+        {
+            TemporalReconstruct(row, (const T*)previous->rowPtr(y), w, u.data());
+        }
+        else
+        {
+            SpatialReconstruct(row, y > 0 ? (const T*)img.rowPtr(y - 1) : nullptr, w, u.data());
+        }
+    }
+    return true;
+}
+
+bool DepthCodecSupported(ImageType type)
+{
+    return type == US1 || type == F1;
+}
+
+std::vector<unsigned char> EncodeDepth(const Image& img, const Image* previous)
+{
+    SAIGA_ASSERT(img.valid() && DepthCodecSupported(img.type), "Only US1 and F1 depth images are supported.");
+    if (previous)
+    {
+        SAIGA_ASSERT(previous->type == img.type && previous->dimensions() == img.dimensions());
+    }
+
+    DepthCodecHeader header = {depth_codec_magic, img.width, img.height, img.type, previous != nullptr, 0};
+
+    std::vector<unsigned char> result(sizeof(DepthCodecHeader));
+    memcpy(result.data(), &header, sizeof(header));
+    // Typical depth images compress to less than 1/4
+    result.reserve(sizeof(header) + img.size() / 4);
+
+    BitWriter writer(result);
+    if (img.type == US1)
+    {
+        EncodeImage<uint16_t, uint32_t>(img, previous, writer);
+    }
+    else
+    {
+        EncodeImage<uint32_t, uint64_t>(img, previous, writer);
+    }
+    writer.Flush();
+    return result;
+}
+
+bool DecodeDepth(const void* data, size_t size, Image& img, const Image* previous)
+{
+    DepthCodecHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != depth_codec_magic || !DepthCodecSupported(ImageType(header.type))) return false;
+    if (header.width <= 0 || header.height <= 0) return false;
+
+    if (header.temporal)
+    {
+        if (!previous || previous->type != header.type || previous->width != header.width ||
+            previous->height != header.height)
+        {
+            std::cerr << "DecodeDepth: This frame requires the previous frame." << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        previous = nullptr;
+    }
+
+    // The previous image must not be overwritten
+    SAIGA_ASSERT(previous != &img);
+    img.create(header.height, header.width, ImageType(header.type));
+
+    BitReader reader((const unsigned char*)data + sizeof(header), size - sizeof(header));
+    if (header.type == US1)
+    {
+        return DecodeImage<uint16_t, uint32_t>(reader, img, previous);
+    }
+    return DecodeImage<uint32_t, uint64_t>(reader, img, previous);
+}
+
+bool DepthFrameIsTemporal(const void* data, size_t size)
+{
+    DepthCodecHeader header;
+    SAIGA_ASSERT(size >= sizeof(header));
+    memcpy(&header, data, sizeof(header));
+    return header.temporal;
+}
+
+// ============== Sequence ==============
+
+DepthSequenceWriter::DepthSequenceWriter(const std::string& file, int keyframe_interval)
+    : strm(file, std::ios::binary), keyframe_interval(keyframe_interval)
+{
+    SAIGA_ASSERT(strm.is_open(), "Could not open file " + file);
+    SAIGA_ASSERT(keyframe_interval > 0);
+    uint32_t header[2] = {depth_sequence_magic, uint32_t(keyframe_interval)};
+    strm.write((const char*)header, sizeof(header));
+}
+
+void DepthSequenceWriter::Add(const Image& img)
+{
+    bool keyframe = num_frames % keyframe_interval == 0 || img.type != previous.type ||
+                    !(img.dimensions() == previous.dimensions());
+    auto data = EncodeDepth(img, keyframe ? nullptr : &previous);
+
+    uint64_t size = data.size();
+    strm.write((const char*)&size, sizeof(size));
+    strm.write((const char*)data.data(), data.size());
+    SAIGA_ASSERT(strm.good());
+
+    previous = img;
+    num_frames++;
+}
+
+DepthSequenceReader::DepthSequenceReader(const std::string& file) : strm(file, std::ios::binary)
+{
+    SAIGA_ASSERT(strm.is_open(), "Could not open file " + file);
+    uint32_t header[2];
+    strm.read((char*)header, sizeof(header));
+    SAIGA_ASSERT(strm.good() && header[0] == depth_sequence_magic, "Invalid depth sequence " + file);
+
+    // Build the frame index
+    size_t offset = sizeof(header);
+    for (;;)
+    {
+        uint64_t size;
+        DepthCodecHeader frame_header;
+        strm.seekg(offset);
+        strm.read((char*)&size, sizeof(size));
+        strm.read((char*)&frame_header, sizeof(frame_header));
+        if (!strm.good()) break;
+
+        frame_offsets.push_back(offset);
+        keyframe.push_back(!frame_header.temporal);
+        offset += sizeof(size) + size;
+    }
+    strm.clear();
+    Seek(0);
+}
+
+bool DepthSequenceReader::Read(Image& img)
+{
+    if (next_frame >= NumFrames()) return false;
+
+    uint64_t size;
+    strm.seekg(frame_offsets[next_frame]);
+    strm.read((char*)&size, sizeof(size));
+    buffer.resize(size);
+    strm.read((char*)buffer.data(), size);
+    SAIGA_ASSERT(strm.good());
+
+    bool ok = DecodeDepth(buffer.data(), buffer.size(), img, keyframe[next_frame] ? nullptr : &previous);
+    SAIGA_ASSERT(ok, "Corrupted depth sequence.");
+    previous = img;
+    next_frame++;
+    return true;
+}
+
+void DepthSequenceReader::Seek(int frame)
+{
+    SAIGA_ASSERT(frame >= 0 && frame <= NumFrames());
+    int keyframe_id = std::min(frame, NumFrames() - 1);
+    while (keyframe_id > 0 && !keyframe[keyframe_id]) keyframe_id--;
+
+    // Decode from the keyframe to the frame before 'frame'
+    next_frame = std::max(keyframe_id, 0);
+    Image tmp;
+    while (next_frame < frame) Read(tmp);
+}
+
+}  // namespace Saiga
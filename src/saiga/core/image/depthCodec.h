@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/image/managedImage.h"
+
+#include <fstream>
+#include <vector>
+
+namespace Saiga
+{
+/**
+ * Lossless compression of depth images.
+ *
+ * Supported are 16 bit depth images (US1), for example the raw output of RGB-D sensors, and float depth maps (F1).
+ * Float pixels are compressed by their bit pattern, which preserves the order of positive values.
+ *
+ * For each row, the encoder selects the better of two predictors:
+ *   - Spatial: Median edge detector of LOCO-I/JPEG-LS (median of left, up and left + up - upleft)
+ *   - Temporal: The same pixel of the previous frame (only if a previous frame is given)
+ * The residuals are zig-zag encoded and written with an adaptive Golomb-Rice code. Groups of 8 zero residuals,
+ * which are common in invalid regions and static parts of a sequence, cost a single bit.
+ *
+ * The residual computation of the encoder and the temporal reconstruction of the decoder have SIMD
+ * implementations for 16 bit images. They are selected at runtime (see DepthCodecKernel).
+ *
+ * Single images are stored with the ".saigad" extension by Image::save/load.
+ * Sequences should use DepthSequenceWriter/Reader, which also exploit the temporal correlation.
+ */
+enum class DepthCodecKernel
+{
+    Scalar,
+    AVX2,
+};
+
+SAIGA_CORE_API const char* DepthCodecKernelName(DepthCodecKernel kernel);
+SAIGA_CORE_API bool DepthCodecKernelSupported(DepthCodecKernel kernel);
+SAIGA_CORE_API DepthCodecKernel ActiveDepthCodecKernel();
+// The kernel must be supported by the cpu.
+SAIGA_CORE_API void SetDepthCodecKernel(DepthCodecKernel kernel);
+
+// Returns true if the image type can be compressed by EncodeDepth.
+SAIGA_CORE_API bool DepthCodecSupported(ImageType type);
+
+// Compresses a US1 or F1 image.
+// If 'previous' is given, it must have the same size and type. Decoding then requires the same previous image.
+SAIGA_CORE_API std::vector<unsigned char> EncodeDepth(const Image& img, const Image* previous = nullptr);
+
+// Returns false if the data is not a valid depth stream.
+SAIGA_CORE_API bool DecodeDepth(const void* data, size_t size, Image& img, const Image* previous = nullptr);
+
+// True if the compressed frame was predicted from a previous frame
+SAIGA_CORE_API bool DepthFrameIsTemporal(const void* data, size_t size);
+
+/**
+ * A compressed sequence of depth images in a single file.
+ *
+ * Every 'keyframe_interval' frames a keyframe is stored, which only uses spatial prediction.
+ * All other frames are predicted from the previous frame.
+ *
+ * Layout:
+ *    header : magic, keyframe_interval
+ *    frames : [size, EncodeDepth() output] for every frame
+ */
+class SAIGA_CORE_API DepthSequenceWriter
+{
+   public:
+    DepthSequenceWriter(const std::string& file, int keyframe_interval = 30);
+
+    void Add(const Image& img);
+
+    int NumFrames() const { return num_frames; }
+
+   private:
+    std::ofstream strm;
+    int keyframe_interval;
+    int num_frames = 0;
+    Image previous;
+};
+
+class SAIGA_CORE_API DepthSequenceReader
+{
+   public:
+    DepthSequenceReader(const std::string& file);
+
+    int NumFrames() const { return frame_offsets.size(); }
+
+    // Decodes the next frame. Returns false at the end of the sequence.
+    bool Read(Image& img);
+
+    // The next Read() returns frame 'frame'.
+    // Starts decoding at the previous keyframe.
+    void Seek(int frame);
+
+   private:
+    std::ifstream strm;
+    std::vector<size_t> frame_offsets;
+    std::vector<char> keyframe;
+    int next_frame = 0;
+    Image previous;
+    std::vector<unsigned char> buffer;
+};
+
+}  // namespace Saiga
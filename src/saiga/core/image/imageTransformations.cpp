@@ -233,6 +233,232 @@ void ScaleDown2(ImageView<const ucvec4> src, ImageView<ucvec4> dst)
         }
     }
 }
+// GCC vector types for the inner loops of the filters. They are compiled to the vector instructions of the target
+// architecture (-march=native by default).
+#if defined(__GNUC__)
+#    define SAIGA_IMAGE_VECTOR
+using u8x8  = unsigned char __attribute__((vector_size(8)));
+using i32x8 = int __attribute__((vector_size(32)));
+#endif
+
+// Index of a pixel outside of [0, n) reflected at the border without repeating the edge pixel.
+static inline int Reflect101(int i, int n)
+{
+    if (i < 0) return -i;
+    if (i >= n) return 2 * n - 2 - i;
+    return i;
+}
+
+void ResizeBilinear(ImageView<const unsigned char> src, ImageView<unsigned char> dst)
+{
+    SAIGA_ASSERT(src.w >= 1 && src.h >= 1);
+    // Fixed point weights with 11 fractional bits (same as OpenCV).
+    constexpr int bits = 11;
+    constexpr int one  = 1 << bits;
+
+    // The source index and weights of each destination column and row.
+    auto compute_weights = [](int src_size, int dst_size, std::vector<int>& index, std::vector<int>& weight) {
+        index.resize(dst_size);
+        weight.resize(dst_size);
+        double scale = double(src_size) / dst_size;
+        for (int i = 0; i < dst_size; ++i)
+        {
+            double f = (i + 0.5) * scale - 0.5;
+            int s    = std::floor(f);
+            f -= s;
+            if (s < 0)
+            {
+                s = 0;
+                f = 0;
+            }
+            if (s >= src_size - 1)
+            {
+                s = std::max(src_size - 2, 0);
+                f = src_size == 1 ? 0 : 1;
+            }
+            index[i]  = s;
+            weight[i] = iRound(f * one);
+        }
+    };
+
+    std::vector<int> xs, xw, ys, yw;
+    compute_weights(src.w, dst.w, xs, xw);
+    compute_weights(src.h, dst.h, ys, yw);
+
+    int x_last = src.w - 1;
+    int y_last = src.h - 1;
+
+    // Horizontally interpolated source rows (scaled by 'one'). Reused if consecutive output rows read the same rows.
+    std::vector<int> rows[2] = {std::vector<int>(dst.w), std::vector<int>(dst.w)};
+    int row_index[2]         = {-1, -1};
+
+    auto interpolate_row = [&](int y, std::vector<int>& row) {
+        const unsigned char* ptr = src.rowPtr(y);
+        for (int x = 0; x < dst.w; ++x)
+        {
+            int s  = xs[x];
+            int w  = xw[x];
+            row[x] = ptr[s] * (one - w) + ptr[std::min(s + 1, x_last)] * w;
+        }
+    };
+
+    for (int y = 0; y < dst.h; ++y)
+    {
+        int y0 = ys[y];
+        int y1 = std::min(y0 + 1, y_last);
+
+        if (row_index[0] != y0)
+        {
+            if (row_index[1] == y0)
+            {
+                std::swap(rows[0], rows[1]);
+                std::swap(row_index[0], row_index[1]);
+            }
+            else
+            {
+                interpolate_row(y0, rows[0]);
+                row_index[0] = y0;
+            }
+        }
+        if (row_index[1] != y1)
+        {
+            interpolate_row(y1, rows[1]);
+            row_index[1] = y1;
+        }
+
+        const int* r0      = rows[0].data();
+        const int* r1      = rows[1].data();
+        int w1             = yw[y];
+        int w0             = one - w1;
+        unsigned char* out = dst.rowPtr(y);
+        for (int x = 0; x < dst.w; ++x)
+        {
+            out[x] = (r0[x] * w0 + r1[x] * w1 + (1 << (2 * bits - 1))) >> (2 * bits);
+        }
+    }
+}
+
+void GaussianBlur(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius, float sigma)
+{
+    SAIGA_ASSERT(src.h == dst.h && src.w == dst.w);
+    SAIGA_ASSERT(radius >= 0 && src.w > radius && src.h > radius);
+
+    // Fixed point kernel with 8 fractional bits. The rounding error is added to the center weight so that the
+    // kernel sums up to exactly 256.
+    constexpr int bits = 8;
+    int size           = radius * 2 + 1;
+    std::vector<int> kernel(size);
+    {
+        std::vector<double> kf(size);
+        double sum = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            double d = i - radius;
+            kf[i]    = std::exp(-d * d / (2.0 * sigma * sigma));
+            sum += kf[i];
+        }
+        int isum = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            kernel[i] = iRound(kf[i] / sum * (1 << bits));
+            isum += kernel[i];
+        }
+        kernel[radius] += (1 << bits) - isum;
+    }
+
+    // One vertically filtered row with 'radius' reflected pixels on each side.
+    std::vector<int> row(src.w + 2 * radius);
+    std::vector<const unsigned char*> src_rows(size);
+
+    for (int y = 0; y < dst.h; ++y)
+    {
+        for (int k = 0; k < size; ++k)
+        {
+            src_rows[k] = src.rowPtr(Reflect101(y + k - radius, src.h));
+        }
+
+        int* r = row.data() + radius;
+        int x  = 0;
+#ifdef SAIGA_IMAGE_VECTOR
+        for (; x + 8 <= src.w; x += 8)
+        {
+            i32x8 sum = {};
+            for (int k = 0; k < size; ++k)
+            {
+                u8x8 v;
+                memcpy(&v, src_rows[k] + x, sizeof(v));
+                sum += __builtin_convertvector(v, i32x8) * kernel[k];
+            }
+            memcpy(r + x, &sum, sizeof(sum));
+        }
+#endif
+        for (; x < src.w; ++x)
+        {
+            int sum = 0;
+            for (int k = 0; k < size; ++k) sum += src_rows[k][x] * kernel[k];
+            r[x] = sum;
+        }
+        for (int x = 1; x <= radius; ++x)
+        {
+            r[-x]            = r[x];
+            r[src.w - 1 + x] = r[src.w - 1 - x];
+        }
+
+        unsigned char* out = dst.rowPtr(y);
+        x                  = 0;
+#ifdef SAIGA_IMAGE_VECTOR
+        for (; x + 8 <= dst.w; x += 8)
+        {
+            i32x8 sum = {};
+            sum += 1 << (2 * bits - 1);
+            for (int k = 0; k < size; ++k)
+            {
+                i32x8 v;
+                memcpy(&v, r + x + k - radius, sizeof(v));
+                sum += v * kernel[k];
+            }
+            u8x8 result = __builtin_convertvector(sum >> (2 * bits), u8x8);
+            memcpy(out + x, &result, sizeof(result));
+        }
+#endif
+        for (; x < dst.w; ++x)
+        {
+            int sum = 1 << (2 * bits - 1);
+            for (int k = 0; k < size; ++k) sum += r[x + k - radius] * kernel[k];
+            out[x] = sum >> (2 * bits);
+        }
+    }
+}
+
+void FillBorderReflect101(ImageView<unsigned char> image, int border)
+{
+    int inner_w = image.w - 2 * border;
+    int inner_h = image.h - 2 * border;
+    SAIGA_ASSERT(inner_w > border && inner_h > border);
+
+    // Left and right border of the inner rows
+    for (int y = border; y < image.h - border; ++y)
+    {
+        unsigned char* ptr = image.rowPtr(y) + border;
+        for (int x = 1; x <= border; ++x)
+        {
+            ptr[-x]              = ptr[x];
+            ptr[inner_w - 1 + x] = ptr[inner_w - 1 - x];
+        }
+    }
+
+    // Top and bottom rows are copied completely (including the left and right border)
+    for (int y = 0; y < border; ++y)
+    {
+        int src_y = border + Reflect101(y - border, inner_h);
+        memcpy(image.rowPtr(y), image.rowPtr(src_y), image.w);
+
+        int dst_y = image.h - 1 - y;
+        src_y     = border + Reflect101(dst_y - border, inner_h);
+        memcpy(image.rowPtr(dst_y), image.rowPtr(src_y), image.w);
+    }
+}
+
 TemplatedImage<unsigned char> AbsolutePixelError(ImageView<const ucvec3> img1, ImageView<const ucvec3> img2)
 {
     TemplatedImage<unsigned char> result(img1.dimensions());
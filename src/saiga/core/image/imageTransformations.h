@@ -35,6 +35,19 @@ SAIGA_CORE_API void Gray8ToRGB(ImageView<unsigned char> src, ImageView<ucvec3> d
 
 SAIGA_CORE_API void ScaleDown2(ImageView<const ucvec4> src, ImageView<ucvec4> dst);
 
+// Bilinear resize to the size of dst. The sampling positions are the same as in cv::resize with INTER_LINEAR.
+SAIGA_CORE_API void ResizeBilinear(ImageView<const unsigned char> src, ImageView<unsigned char> dst);
+
+// Separable gaussian blur with a (2*radius+1)x(2*radius+1) kernel.
+// The image border is reflected without repeating the edge pixel (BORDER_REFLECT_101).
+// src and dst must not overlap.
+SAIGA_CORE_API void GaussianBlur(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius,
+                                 float sigma);
+
+// Fills the outer 'border' rows and columns of the image by reflecting the inner region (BORDER_REFLECT_101).
+// The inner region must be larger than the border.
+SAIGA_CORE_API void FillBorderReflect101(ImageView<unsigned char> image, int border);
+
 
 SAIGA_CORE_API float sharpness(ImageView<const unsigned char> src);
 /**
@@ -6,6 +6,7 @@
 
 #include "saiga/core/image/managedImage.h"
 
+#include "saiga/core/image/depthCodec.h"
 #include "saiga/core/util/BinaryFile.h"
 #include "saiga/core/util/assert.h"
 #include "saiga/core/util/file.h"
@@ -90,6 +91,14 @@ void Image::free()
     vdata.shrink_to_fit();
 }
 
+void Image::reset()
+{
+    height     = 0;
+    width      = 0;
+    pitchBytes = 0;
+    vdata.clear();
+}
+
 void Image::makeZero()
 {
     std::fill(vdata.begin(), vdata.end(), 0);
@@ -104,7 +113,9 @@ bool Image::valid() const
 
 bool Image::load(const std::string& _path)
 {
-    clear();
+    // Keep the memory, so that loading into an existing image doesn't allocate.
+    reset();
+    type = TYPE_UNKNOWN;
 
     auto path = SearchPathes::image(_path);
 
@@ -123,6 +134,13 @@ bool Image::load(const std::string& _path)
         return loadRaw(path);
     }
 
+    if (type == "saigad")
+    {
+        // lossless depth codec
+        auto data = File::loadFileBinary(path);
+        return DecodeDepth(data.data(), data.size(), *this);
+    }
+
     // use libpng for png images
     if (type == "png")
     {
@@ -193,6 +211,18 @@ bool Image::save(const std::string& path) const
         return saveRaw(path);
     }
 
+    if (output_type == "saigad")
+    {
+        if (!DepthCodecSupported(type))
+        {
+            std::cerr << "saigad is only supported for US1 and F1 images" << std::endl;
+            return false;
+        }
+        auto data = EncodeDepth(*this);
+        File::saveFileBinary(path, data.data(), data.size());
+        return true;
+    }
+
     if (output_type == "jpg" && channels(this->type) != 3)
     {
         std::cerr << "jpg is only supported with 3 channels" << std::endl;
@@ -224,7 +254,7 @@ constexpr size_t saiga_image_header_size          = 4 * sizeof(int);
 
 bool Image::loadRaw(const std::string& path)
 {
-    clear();
+    reset();
 
 
 
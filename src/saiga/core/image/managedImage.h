@@ -60,6 +60,10 @@ class SAIGA_CORE_API Image : public ImageBase
 
     void clear();
     void free();
+
+    // Sets the size to 0x0, but keeps the allocated memory.
+    // A following create() or load() reuses it if the new image fits.
+    void reset();
     /**
      * @brief makeZero
      * Sets all data to 0.
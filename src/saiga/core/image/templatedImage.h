@@ -43,6 +43,7 @@ class TemplatedImage : public Image
     void create(int h, int w, int p) { Image::create(h, w, p, TType::type); }
 
     inline T& operator()(int y, int x) { return rowPtr(y)[x]; }
+    inline const T& operator()(int y, int x) const { return rowPtr(y)[x]; }
 
 
     inline T* rowPtr(int y)
@@ -51,6 +52,12 @@ class TemplatedImage : public Image
         return reinterpret_cast<T*>(ptr);
     }
 
+    inline const T* rowPtr(int y) const
+    {
+        auto ptr = data8() + y * pitchBytes;
+        return reinterpret_cast<const T*>(ptr);
+    }
+
     ImageView<T> getImageView() { return Image::getImageView<T>(); }
 
     ImageView<const T> getConstImageView() const { return Image::getConstImageView<T>(); }
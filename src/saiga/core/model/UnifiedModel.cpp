@@ -39,19 +39,15 @@ UnifiedModel::UnifiedModel(const std::string& file_name)
 
     std::string type = fileEnding(file_name);
 
-    if (type == "obj" && false)
+    if (type == "obj")
     {
-#if 0
         ObjModelLoader loader(full_file);
-        *this = loader.out_model;
-        for (auto& v : loader.outVertices)
-        {
-            position.push_back(v.position.head<3>());
-            normal.push_back(v.normal.head<3>());
-            texture_coordinates.push_back(v.texture);
-        }
+        *this = std::move(loader.out_model);
         LocateTextures(full_file);
-#endif
+    }
+    else if (type == "ply")
+    {
+        mesh.push_back(PLYReader(full_file).Mesh());
     }
 #ifdef SAIGA_USE_ASSIMP
     else
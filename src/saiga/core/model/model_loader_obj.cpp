@@ -8,6 +8,8 @@
 
 #include "saiga/core/math/String.h"
 #include "saiga/core/time/all.h"
+#include "saiga/core/util/MemoryMappedFile.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
 #include "saiga/core/util/file.h"
 #include "saiga/core/util/fileChecker.h"
 #include "saiga/core/util/tostring.h"
@@ -15,15 +17,16 @@
 #include "internal/noGraphicsAPI.h"
 
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 
 namespace Saiga
 {
 static StringViewParser lineParser = {"\t ,\n", true};
-static StringViewParser faceParser = {"/", false};
 
 
 struct ObjLine
@@ -128,452 +131,374 @@ std::vector<UnifiedMaterial> LoadMTL(const std::string& file)
 
 
 
-// parsing index vertex
-// examples:
-// v1/vt1/vn1        12/51/1
-// v1//vn1           51//4
-inline ObjModelLoader::IndexedVertex2 parseIV(std::string_view line)
+// Everything of one line aligned chunk of the file.
+struct ObjChunk
 {
-    ObjModelLoader::IndexedVertex2 iv;
-#if 0
-    std::vector<std::string> s = split(line, '/');
-    if (s.size() > 0 && s[0].size() > 0) iv.v = std::atoi(s[0].c_str()) - 1;
-    if (s.size() > 1 && s[1].size() > 0) iv.t = std::atoi(s[1].c_str()) - 1;
-    if (s.size() > 2 && s[2].size() > 0) iv.n = std::atoi(s[2].c_str()) - 1;
-#else
-    faceParser.set(line);
-    std::string_view tmp;
-    tmp = faceParser.next();
-    if (!tmp.empty()) iv.v = to_long(tmp) - 1;
-    tmp = faceParser.next();
-    if (!tmp.empty()) iv.t = to_long(tmp) - 1;
-    tmp = faceParser.next();
-    if (!tmp.empty()) iv.n = to_long(tmp) - 1;
-#endif
-    return iv;
-}
-
+    std::vector<vec3> vertices;
+    std::vector<vec3> normals;
+    std::vector<vec2> texCoords;
+    std::vector<ObjModelLoader::Triangle> faces;
+
+    // Negative (relative) indices are resolved inside the chunk and can therefore point before its first element.
+    // They are moved by the chunk offset after the merge. Stored as (3 * face + corner) * 3 + attribute with the
+    // attribute v = 0, t = 1, n = 2.
+    std::vector<int> relative;
+
+    // usemtl and mtllib lines in file order
+    struct Command
+    {
+        bool mtllib;
+        int face;
+        std::string name;
+    };
+    std::vector<Command> commands;
+};
 
-ObjModelLoader::ObjModelLoader(const std::string& file) : file(file)
+// Same result as to_long for the tokens of a face, but without a temporary string.
+static int ParseIndex(std::string_view str)
 {
-    loadFile(file);
+    const char* p   = str.data();
+    const char* end = p + str.size();
+
+    bool negative = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+')) ++p;
+    long value = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p) value = value * 10 + (*p - '0');
+    return negative ? -value : value;
 }
 
-
-bool ObjModelLoader::loadFile(const std::string& _file)
+// parsing index vertex
+// examples:
+// v1/vt1/vn1        12/51/1
+// v1//vn1           51//4
+// Returns a bit mask of the relative indices.
+static int ParseCorner(std::string_view token, const ObjChunk& chunk, ObjModelLoader::IndexedVertex2& iv)
 {
-    this->file = SearchPathes::model(_file);
-    if (file == "")
+    int* dst[3]         = {&iv.v, &iv.t, &iv.n};
+    const int counts[3] = {(int)chunk.vertices.size(), (int)chunk.texCoords.size(), (int)chunk.normals.size()};
+    int relative        = 0;
+    const char* p       = token.data();
+    const char* end     = p + token.size();
+    for (int a = 0; a < 3 && p != end; ++a)
     {
-        std::cerr << "Could not open file " << _file << std::endl;
-        std::cerr << SearchPathes::model << std::endl;
-        return false;
-    }
-
-    //    std::ifstream stream(file, std::ios::in);
-    //    if (!stream.is_open())
-    //    {
-    //        throw std::runtime_error("Search Pathes broken!");
-    //    }
-
-
-    std::cout << "[ObjModelLoader] Loading " << file << std::endl;
-
-    UnifiedMaterialGroup tg;
-    tg.startFace = 0;
-    tg.numFaces  = 0;
-    out_model.material_groups.push_back(tg);
-
-    std::vector<std::string> data;
-    {
-        //        SAIGA_BLOCK_TIMER();
-        data = File::loadFileStringArray(file);
-        File::removeWindowsLineEnding(data);
-    }
-    {
-        //        SAIGA_BLOCK_TIMER();
-        for (auto& line : data)
+        const char* begin = p;
+        while (p != end && *p != '/') ++p;
+        if (p != begin)
         {
-            lineParser.set(line);
-            parseLine();
+            int index = ParseIndex(std::string_view(begin, p - begin)) - 1;
+            if (index < 0)
+            {
+                // relative indexing, when the index is negativ
+                index = counts[a] + index + 1;
+                relative |= 1 << a;
+            }
+            *dst[a] = index;
         }
+        if (p != end) ++p;
     }
+    return relative;
+}
 
-    // finish last group
-    UnifiedMaterialGroup& lastGroup = out_model.material_groups[out_model.material_groups.size() - 1];
-    lastGroup.numFaces              = faces.size() - lastGroup.startFace;
-
-
-    // remove groups with 0 faces
-    out_model.material_groups.erase(std::remove_if(out_model.material_groups.begin(), out_model.material_groups.end(),
-                                                   [](const UnifiedMaterialGroup& otg) { return otg.numFaces == 0; }),
-                                    out_model.material_groups.end());
-
-    std::cout << "[ObjModelLoader] Done.  "
-              << "V " << vertices.size() << " N " << normals.size() << " T " << texCoords.size() << " F "
-              << faces.size() << " Material Groups " << out_model.material_groups.size() << std::endl;
-
-
-
-    //    std::cout<<"number of vertices "<<vertices.size()<<" number of faces "<<faces.size()<<endl;
-    createVertexIndexList();
-    //    std::cout<<"number of vertices "<<outVertices.size()<<" number of faces "<<outTriangles.size()<<endl;
-    separateVerticesByGroup();
-    //    std::cout<<"number of vertices "<<outVertices.size()<<" number of faces "<<outTriangles.size()<<endl;
+// The tokens of one line. Same as StringViewParser("\t ,\r", true), but with a cheaper delimiter test.
+struct ObjLineTokenizer
+{
+    const char* p;
+    const char* end;
 
-    calculateMissingNormals();
+    static bool isDelim(char c) { return c == ' ' || c == '\t' || c == ',' || c == '\r'; }
 
-    //    std::cout<<"objloader finished :)"<<endl;
-    return true;
-}
+    std::string_view next()
+    {
+        while (p != end && isDelim(*p)) ++p;
+        const char* begin = p;
+        while (p != end && !isDelim(*p)) ++p;
+        return std::string_view(begin, p - begin);
+    }
+};
 
-void ObjModelLoader::separateVerticesByGroup()
+static void ParseChunk(const char* data, const char* end, ObjChunk& chunk)
 {
-    // make sure faces from different triangle groups do not reference the same vertex
-    // needs to be called after createVertexIndexList()
-#if 0
-
-    std::vector<int> vertexReference(outVertices.size(), INVALID_VERTEX_ID);
+    std::vector<ObjModelLoader::IndexedVertex2> polygon;
+    std::vector<int> polygon_relative;
 
-    for (int t = 0; t < (int)out_model.material_groups.size(); ++t)
+    while (data < end)
     {
-        UnifiedMaterialGroup& tg = out_model.material_groups[t];
-        for (int i = 0; i < tg.numFaces; ++i)
+        auto line_end = (const char*)std::memchr(data, '\n', end - data);
+        if (!line_end) line_end = end;
+        ObjLineTokenizer parser = {data, line_end};
+        data                    = line_end + 1;
+
+        auto header = parser.next();
+        if (header == "v" || header == "vn")
+        {
+            vec3 v;
+            v(0) = to_double(parser.next());
+            v(1) = to_double(parser.next());
+            v(2) = to_double(parser.next());
+            (header == "v" ? chunk.vertices : chunk.normals).push_back(v);
+        }
+        else if (header == "vt")
         {
-            ivec3& face = out_model.triangles[i + tg.startFace];
+            vec2 v;
+            v(0) = to_double(parser.next());
+            v(1) = to_double(parser.next());
+            chunk.texCoords.push_back(v);
+        }
+        else if (header == "f")
+        {
+            polygon.clear();
+            polygon_relative.clear();
+            for (auto token = parser.next(); !token.empty(); token = parser.next())
+            {
+                polygon.emplace_back();
+                polygon_relative.push_back(ParseCorner(token, chunk, polygon.back()));
+            }
 
-            for (int j = 0; j < 3; ++j)
+            // Fan triangulation (0, 1, 2), (2, 3, 0), (3, 4, 0), ...
+            for (int k = 2; k < (int)polygon.size(); ++k)
             {
-                int index = face[j];
-                if (vertexReference[index] == INVALID_VERTEX_ID) vertexReference[index] = t;
-                if (vertexReference[index] != t)
+                std::array<int, 3> corners = {0, 1, 2};
+                if (k > 2) corners = {k - 1, k, 0};
+
+                int face = chunk.faces.size();
+                chunk.faces.push_back({polygon[corners[0]], polygon[corners[1]], polygon[corners[2]]});
+                for (int c = 0; c < 3; ++c)
                 {
-                    // duplicate vertices
-                    VertexNT v   = outVertices[index];
-                    int newIndex = outVertices.size();
-                    outVertices.push_back(v);
-                    face[j] = newIndex;
-                    vertexReference.push_back(t);
-                    //                    SAIGA_ASSERT(0);
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        if (polygon_relative[corners[c]] & (1 << a)) chunk.relative.push_back((face * 3 + c) * 3 + a);
+                    }
                 }
             }
         }
+        else if (header == "usemtl" || header == "mtllib")
+        {
+            chunk.commands.push_back({header == "mtllib", (int)chunk.faces.size(), std::string(parser.next())});
+        }
     }
-#endif
 }
 
-void ObjModelLoader::calculateMissingNormals()
-{
-#if 0
-    for (auto tri : out_model.triangles)
-    {
-        auto& v1 = outVertices[tri[0]];
-        auto& v2 = outVertices[tri[1]];
-        auto& v3 = outVertices[tri[2]];
-
-        vec3 normal = normalize(cross(make_vec3(v3.position - v1.position), make_vec3(v2.position - v1.position)));
 
-        if (v1.normal == vec4(0, 0, 0, 0)) v1.normal = make_vec4(normal, 0);
-        if (v2.normal == vec4(0, 0, 0, 0)) v2.normal = make_vec4(normal, 0);
-        if (v3.normal == vec4(0, 0, 0, 0)) v3.normal = make_vec4(normal, 0);
-    }
-#endif
+ObjModelLoader::ObjModelLoader(const std::string& file) : file(file)
+{
+    loadFile(file);
 }
 
-#if 0
-void ObjModelLoader::computeVertexColorAndData()
-{
-    vertexColors.resize(outVertices.size(), make_vec4(1));
-    vertexData.resize(outVertices.size(), make_vec4(0));
 
-    for (UnifiedMaterialGroup& tg : out_model.material_groups)
-    {
-        for (int i = 0; i < tg.numFaces; ++i)
-        {
-            ivec3& face = out_model.triangles[i + tg.startFace];
-            for (int f = 0; f < 3; ++f)
-            {
-                int index            = face[f];
-                vertexColors[index]  = out_model.materials[tg.materialId].color_diffuse;
-                float spec           = dot(out_model.materials[tg.materialId].color_specular, make_vec4(1)) / 4.0f;
-                vertexData[index][0] = spec;
-            }
-        }
-    }
-}
-void ObjModelLoader::toTriangleMesh(TriangleMesh<VertexNC, uint32_t>& mesh)
+bool ObjModelLoader::loadFile(const std::string& _file)
 {
-    if (vertexColors.empty())
+    this->file = SearchPathes::model(_file);
+    if (file == "")
     {
-        computeVertexColorAndData();
+        std::cerr << "Could not open file " << _file << std::endl;
+        std::cerr << SearchPathes::model << std::endl;
+        return false;
     }
 
-    SAIGA_ASSERT(vertexColors.size() == outVertices.size());
-    mesh.faces.reserve( out_model.triangles.size());
-    for (ivec3& oj :  out_model.triangles)
+    MemoryMappedFile mapped(file);
+    if (!mapped)
     {
-        mesh.addFace(oj(0), oj(1), oj(2));
+        std::cerr << "Could not map file " << file << std::endl;
+        return false;
     }
 
-    mesh.vertices.reserve(outTriangles.size());
-    for (unsigned int i = 0; i < outVertices.size(); ++i)
-    {
-        auto& v = outVertices[i];
-        VertexNC vn;
-        vn.position = v.position;
-        vn.normal   = v.normal;
-        vn.color    = vertexColors[i];
-        vn.data     = vertexData[i];
-        mesh.addVertex(vn);
-    }
-}
+    std::cout << "[ObjModelLoader] Loading " << file << std::endl;
 
-void ObjModelLoader::toTriangleMesh(TriangleMesh<VertexNTD, uint32_t>& mesh)
-{
-    //    SAIGA_ASSERT(texCoords.size() == outVertices.size());
-    if (vertexColors.empty())
-    {
-        computeVertexColorAndData();
-    }
-    SAIGA_ASSERT(vertexData.size() == outVertices.size());
+    out_model = UnifiedModel();
+    vertices.clear();
+    normals.clear();
+    texCoords.clear();
+    faces.clear();
 
-    mesh.faces.reserve(outTriangles.size());
-    for (ivec3& oj : outTriangles)
-    {
-        mesh.addFace(oj(0), oj(1), oj(2));
-    }
+    parse(mapped.data(), mapped.size());
 
-    mesh.vertices.reserve(outTriangles.size());
-    for (unsigned int i = 0; i < outVertices.size(); ++i)
-    {
-        auto& v = outVertices[i];
-        VertexNTD vn;
-        vn.position = v.position;
-        vn.normal   = v.normal;
-        vn.texture  = v.texture;
-        vn.data     = vertexData[i];
-        mesh.addVertex(vn);
-    }
+    std::cout << "[ObjModelLoader] Done.  "
+              << "V " << vertices.size() << " N " << normals.size() << " T " << texCoords.size() << " F "
+              << faces.size() << " Material Groups " << out_model.material_groups.size() << std::endl;
+
+    createVertexIndexList();
+    return true;
 }
-#endif
 
-void ObjModelLoader::createVertexIndexList()
+void ObjModelLoader::parse(const char* data, size_t size)
 {
-#if 0
-    std::vector<bool> vertices_used(vertices.size(), false);
+    // Line aligned chunks. A chunk starts after the first newline behind its nominal start.
+    size_t chunk_bytes = std::max<size_t>(chunk_size, 1);
+    int num_chunks     = std::max<size_t>(1, (size + chunk_bytes - 1) / chunk_bytes);
+    std::vector<size_t> chunk_begin(num_chunks + 1, size);
+    chunk_begin[0] = 0;
+    for (int c = 1; c < num_chunks; ++c)
+    {
+        size_t start = std::max(c * chunk_bytes, chunk_begin[c - 1]);
+        auto newline = start < size ? (const char*)std::memchr(data + start, '\n', size - start) : nullptr;
+        chunk_begin[c] = newline ? newline - data + 1 : size;
+    }
 
-    outVertices.resize(vertices.size());
+    std::vector<ObjChunk> chunks(num_chunks);
+    ParallelOptions options;
+    options.grain_size = 1;
+    ParallelFor(
+        0, num_chunks, [&](int c) { ParseChunk(data + chunk_begin[c], data + chunk_begin[c + 1], chunks[c]); },
+        options);
 
-    for (std::vector<IndexedVertex2>& f : faces)
+    // Exclusive prefix sum over the chunk sizes
+    struct Offsets
     {
-        ivec3 fa;
-        for (int i = 0; i < 3; i++)
-        {
-            IndexedVertex2& currentVertex = f[i];
-            int vert                      = currentVertex.v;
-            int norm                      = currentVertex.n;
-            int tex                       = currentVertex.t;
-
-            VertexNT verte;
-            if (vert >= 0)
-            {
-                SAIGA_ASSERT(vert < (int)vertices.size());
-                verte.position = make_vec4(vertices[vert], 1);
-            }
-            if (norm >= 0)
+        int v = 0, t = 0, n = 0, f = 0;
+    };
+    std::vector<Offsets> offsets(num_chunks + 1);
+    for (int c = 0; c < num_chunks; ++c)
+    {
+        offsets[c + 1].v = offsets[c].v + chunks[c].vertices.size();
+        offsets[c + 1].t = offsets[c].t + chunks[c].texCoords.size();
+        offsets[c + 1].n = offsets[c].n + chunks[c].normals.size();
+        offsets[c + 1].f = offsets[c].f + chunks[c].faces.size();
+    }
+    vertices.resize(offsets.back().v);
+    texCoords.resize(offsets.back().t);
+    normals.resize(offsets.back().n);
+    faces.resize(offsets.back().f);
+
+    ParallelFor(
+        0, num_chunks,
+        [&](int c) {
+            auto& chunk = chunks[c];
+            auto& o     = offsets[c];
+            std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + o.v);
+            std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + o.t);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + o.n);
+            std::copy(chunk.faces.begin(), chunk.faces.end(), faces.begin() + o.f);
+
+            const int attribute_offset[3] = {o.v, o.t, o.n};
+            for (int r : chunk.relative)
             {
-                SAIGA_ASSERT(norm < (int)normals.size());
-                verte.normal = make_vec4(normals[norm], 0);
+                auto& iv        = faces[o.f + r / 9][(r / 3) % 3];
+                int* dst[3]     = {&iv.v, &iv.t, &iv.n};
+                *dst[r % 3] += attribute_offset[r % 3];
             }
-            if (tex >= 0)
+            // The commands are still needed below
+            chunk.vertices  = {};
+            chunk.texCoords = {};
+            chunk.normals   = {};
+            chunk.faces     = {};
+        },
+        options);
+
+    // Material groups in file order
+    UnifiedMaterialGroup tg;
+    tg.startFace = 0;
+    tg.numFaces  = 0;
+    out_model.material_groups.push_back(tg);
+    for (int c = 0; c < num_chunks; ++c)
+    {
+        for (auto& command : chunks[c].commands)
+        {
+            if (command.mtllib)
             {
-                SAIGA_ASSERT(tex < (int)texCoords.size());
-                verte.texture = texCoords[tex];
+                FileChecker fc;
+                out_model.materials = LoadMTL(fc.getRelative(file, command.name));
+                continue;
             }
 
+            // finish current group and create new one
+            int face                           = offsets[c].f + command.face;
+            UnifiedMaterialGroup& currentGroup = out_model.material_groups.back();
+            currentGroup.numFaces              = face - currentGroup.startFace;
 
-            int index = INVALID_VERTEX_ID;
-            if (vertices_used[vert])
+            UnifiedMaterialGroup newGroup;
+            newGroup.startFace = face;
+            for (size_t i = 0; i < out_model.materials.size(); ++i)
             {
-                if (verte == outVertices[vert])
+                if (out_model.materials[i].name == command.name)
                 {
-                    index = vert;
+                    newGroup.materialId = i;
+                    break;
                 }
             }
-            else
-            {
-                outVertices[vert]   = verte;
-                index               = vert;
-                vertices_used[vert] = true;
-            }
-
-            if (index == INVALID_VERTEX_ID)
-            {
-                index = outVertices.size();
-                outVertices.push_back(verte);
-            }
-            fa[i] = index;
+            out_model.material_groups.push_back(newGroup);
         }
-
-        out_model.triangles.push_back(fa);
     }
-#endif
-}
-
-std::vector<std::vector<ObjModelLoader::IndexedVertex2>> ObjModelLoader::triangulateFace(
-    const std::vector<IndexedVertex2>& f)
-{
-    std::vector<std::vector<IndexedVertex2>> newFaces;
 
-    // more than 3 indices -> triangulate
-    std::vector<IndexedVertex2> face;
-    int cornerCount = 1;
-    IndexedVertex2 startVertex, lastVertex;
-    for (const IndexedVertex2& currentVertex : f)
-    {
-        if (cornerCount <= 3)
-        {
-            if (cornerCount == 1) startVertex = currentVertex;
-            face.push_back(currentVertex);
-            if (cornerCount == 3) newFaces.push_back(face);
-        }
-        else
-        {
-            face.resize(3);
-            face[0] = lastVertex;
-            face[1] = currentVertex;
-            face[2] = startVertex;
-            newFaces.push_back(face);
-        }
+    // finish last group
+    UnifiedMaterialGroup& lastGroup = out_model.material_groups.back();
+    lastGroup.numFaces              = faces.size() - lastGroup.startFace;
 
-        lastVertex = currentVertex;
-        cornerCount++;
-    }
-    return newFaces;
+    // remove groups with 0 faces
+    out_model.material_groups.erase(std::remove_if(out_model.material_groups.begin(), out_model.material_groups.end(),
+                                                   [](const UnifiedMaterialGroup& otg) { return otg.numFaces == 0; }),
+                                    out_model.material_groups.end());
 }
 
-void ObjModelLoader::parseLine()
+void ObjModelLoader::createVertexIndexList()
 {
-    auto header = lineParser.next();
+    // The first (t, n) combination of each vertex in the current group. v == INVALID_VERTEX_ID marks unused vertices.
+    std::vector<IndexedVertex2> first_use(vertices.size());
+    std::vector<int> new_index(vertices.size());
+    std::vector<int> used;
 
-    if (header == "#")
-    {
-    }
-    else if (header == "usemtl")
+    for (auto& group : out_model.material_groups)
     {
-        // finish current group and create new one
-        if (!out_model.material_groups.empty())
-        {
-            UnifiedMaterialGroup& currentGroup = out_model.material_groups[out_model.material_groups.size() - 1];
-            currentGroup.numFaces              = faces.size() - currentGroup.startFace;
-        }
-        UnifiedMaterialGroup newGroup;
-        newGroup.startFace = faces.size();
+        UnifiedMesh mesh;
+        if (group.materialId >= 0) mesh.material_id = group.materialId;
 
-        //         newGroup.material  = materialLoader.getMaterial(std::string(lineParser.next()));
-        //        newGroup.materialId = materialLoader.getMaterialId(std::string(lineParser.next()));
-
-        std::string mtl_name = std::string(lineParser.next());
-        int mtl_id           = -1;
-        for (size_t i = 0; i < out_model.materials.size(); ++i)
+        used.clear();
+        for (auto i : group.range())
         {
-            if (out_model.materials[i].name == mtl_name)
+            for (auto& iv : faces[i])
             {
-                mtl_id = i;
-                break;
+                SAIGA_ASSERT(iv.v >= 0 && iv.v < (int)vertices.size());
+                if (first_use[iv.v].v == INVALID_VERTEX_ID)
+                {
+                    first_use[iv.v] = iv;
+                    used.push_back(iv.v);
+                }
             }
         }
-        newGroup.materialId = mtl_id;
-
-        out_model.material_groups.push_back(newGroup);
-    }
-    else if (header == "mtllib")
-    {
-        FileChecker fc;
-
-        std::string mtl_file = fc.getRelative(file, std::string(lineParser.next()));
-
-        out_model.materials = LoadMTL(mtl_file);
-    }
-    else if (header == "g")
-    {
-    }
-    else if (header == "o")
-    {
-    }
-    else if (header == "s")
-    {
-    }
-    else if (header == "v")
-    {
-        vec3 v;
-        v(0) = to_double(lineParser.next());
-        v(1) = to_double(lineParser.next());
-        v(2) = to_double(lineParser.next());
-        vertices.push_back(v);
-    }
-    else if (header == "vt")
-    {
-        vec2 v;
-        v(0) = to_double(lineParser.next());
-        v(1) = to_double(lineParser.next());
-        texCoords.push_back(v);
-    }
-    else if (header == "vn")
-    {
-        vec3 v;
-        v(0) = to_double(lineParser.next());
-        v(1) = to_double(lineParser.next());
-        v(2) = to_double(lineParser.next());
-        normals.push_back(v);
-    }
-    else if (header == "f")
-    {
-        parseF();
-    }
-}
-
-
-
-void ObjModelLoader::parseF()
-{
-    ivs.clear();
-
-    std::string_view f = lineParser.next();
-    while (!f.empty())
-    {
-        ivs.push_back(parseIV(f));
-        f = lineParser.next();
-    }
 
-    auto nf = triangulateFace(ivs);
+        // Keep the file order of the vertices
+        std::sort(used.begin(), used.end());
+        for (int i = 0; i < (int)used.size(); ++i) new_index[used[i]] = i;
 
-    // relative indexing, when the index is negativ
-    for (auto& f : nf)
-    {
-        for (auto& i : f)
-        {
-            if (i.v < 0 && i.v != INVALID_VERTEX_ID)
+        auto add_vertex = [&](const IndexedVertex2& iv) {
+            mesh.position.push_back(vertices[iv.v]);
+            if (!normals.empty())
             {
-                int absIndex = vertices.size() + i.v + 1;
-                i.v          = absIndex;
+                SAIGA_ASSERT(iv.n == INVALID_VERTEX_ID || (iv.n >= 0 && iv.n < (int)normals.size()));
+                mesh.normal.push_back(iv.n == INVALID_VERTEX_ID ? vec3::Zero() : normals[iv.n]);
             }
-            if (i.n < 0 && i.n != INVALID_VERTEX_ID)
+            if (!texCoords.empty())
             {
-                int absIndex = normals.size() + i.n + 1;
-                i.n          = absIndex;
+                SAIGA_ASSERT(iv.t == INVALID_VERTEX_ID || (iv.t >= 0 && iv.t < (int)texCoords.size()));
+                mesh.texture_coordinates.push_back(iv.t == INVALID_VERTEX_ID ? vec2::Zero() : texCoords[iv.t]);
             }
-            if (i.t < 0 && i.t != INVALID_VERTEX_ID)
+        };
+        for (int v : used) add_vertex(first_use[v]);
+
+        // Vertices which are used with different normals or texture coordinates are duplicated.
+        std::map<std::array<int, 3>, int> duplicates;
+        mesh.triangles.reserve(group.numFaces);
+        for (auto i : group.range())
+        {
+            ivec3 tri;
+            for (int k = 0; k < 3; ++k)
             {
-                int absIndex = texCoords.size() + i.t + 1;
-                i.t          = absIndex;
+                auto& iv = faces[i][k];
+                auto& fu = first_use[iv.v];
+                if (iv.n == fu.n && iv.t == fu.t)
+                {
+                    tri(k) = new_index[iv.v];
+                    continue;
+                }
+                auto it = duplicates.insert({{iv.v, iv.t, iv.n}, mesh.NumVertices()});
+                if (it.second) add_vertex(iv);
+                tri(k) = it.first->second;
             }
+            mesh.triangles.push_back(tri);
         }
-    }
 
-    faces.insert(faces.end(), nf.begin(), nf.end());
+        for (int v : used) first_use[v] = IndexedVertex2();
+        out_model.mesh.push_back(std::move(mesh));
+    }
 }
 
-
-
 }  // namespace Saiga
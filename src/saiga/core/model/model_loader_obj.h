@@ -13,17 +13,38 @@
 
 #include "UnifiedModel.h"
 
+#include <array>
+
 namespace Saiga
 {
 SAIGA_CORE_API std::vector<UnifiedMaterial> LoadMTL(const std::string& file);
 
 
+/**
+ * Wavefront OBJ loader.
+ *
+ * The file is memory mapped and split into line aligned chunks of 'chunk_size' bytes, which are parsed in parallel
+ * (ParallelFor, see saiga/core/util/Thread/ParallelFor.h). The per-chunk arrays are merged with a prefix sum over the
+ * chunk sizes. Relative (negative) indices are resolved after the merge, usemtl/mtllib lines are applied in file
+ * order. Polygons are triangulated as a fan.
+ *
+ * out_model contains one UnifiedMesh per material group (usemtl). Faces of different groups do not share vertices.
+ * A vertex which is used with different normal or texture indices is duplicated, unused vertices are dropped.
+ * For a file without usemtl and with consistent indices the mesh therefore has the vertices in file order.
+ *
+ * Usage:
+ *    ObjModelLoader loader("bunny.obj");
+ *    UnifiedMesh& mesh = loader.out_model.mesh.front();
+ */
 class SAIGA_CORE_API ObjModelLoader
 {
    public:
     std::string file;
     bool verbose = false;
 
+    // Approximate number of bytes per parser task.
+    size_t chunk_size = 1 << 20;
+
    public:
     ObjModelLoader() {}
     ObjModelLoader(const std::string& file);
@@ -32,21 +53,7 @@ class SAIGA_CORE_API ObjModelLoader
 
     bool loadFile(const std::string& file);
 
-    //    AlignedVector<vec4> vertexData;    // x: specular
-    //    AlignedVector<vec4> vertexColors;  // only when given by the material. Otherwise: white!
-    std::vector<VertexNT> outVertices;
-    // std::vector<ivec3> outTriangles;
-
     UnifiedModel out_model;
-    //    std::vector<UnifiedMaterialGroup> triangleGroups;
-    //    std::vector<UnifiedMaterial> materials;
-    void separateVerticesByGroup();
-    void calculateMissingNormals();
-    void computeVertexColorAndData();
-
-    //    void toTriangleMesh(TriangleMesh<VertexNC, uint32_t>& mesh);
-    //    void toTriangleMesh(TriangleMesh<VertexNTD, uint32_t>& mesh);
-
 
     static constexpr int INVALID_VERTEX_ID = -911365965;
     struct SAIGA_CORE_API IndexedVertex2
@@ -55,6 +62,7 @@ class SAIGA_CORE_API ObjModelLoader
         int n = INVALID_VERTEX_ID;
         int t = INVALID_VERTEX_ID;
     };
+    using Triangle = std::array<IndexedVertex2, 3>;
 
 
    private:
@@ -62,20 +70,11 @@ class SAIGA_CORE_API ObjModelLoader
     std::vector<vec3> normals;
     std::vector<vec2> texCoords;
 
-    std::vector<std::vector<IndexedVertex2>> faces;
-
+    // Triangulated faces of all groups in file order
+    std::vector<Triangle> faces;
 
+    void parse(const char* data, size_t size);
     void createVertexIndexList();
-
-    std::vector<std::vector<IndexedVertex2>> triangulateFace(const std::vector<IndexedVertex2>& face);
-
-
-    // ================== Parser Tmp Variables ================
-
-    std::vector<IndexedVertex2> ivs;
-    void parseLine();
-
-    void parseF();
 };
 
 }  // namespace Saiga
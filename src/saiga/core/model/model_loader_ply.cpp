@@ -6,219 +6,839 @@
 
 #include "model_loader_ply.h"
 
+#include "saiga/core/util/Thread/ParallelFor.h"
 #include "saiga/core/util/color.h"
 #include "saiga/core/util/fileChecker.h"
 
 #include "internal/noGraphicsAPI.h"
 
 #include <algorithm>
+#include <cstdio>
 
 namespace Saiga
 {
-PLYLoader::PLYLoader(const std::string& _file)
+namespace PLY
 {
-    auto file = SearchPathes::model(_file);
-    std::ifstream stream(file, std::ios::binary);
-
-    if (!stream.is_open())
+int ScalarSize(ScalarType type)
+{
+    switch (type)
     {
-        std::cerr << "Could not open file " << file << std::endl;
-        throw std::runtime_error("invalid file: " + file + ", " + _file);
+        case ScalarType::Int8:
+        case ScalarType::UInt8:
+            return 1;
+        case ScalarType::Int16:
+        case ScalarType::UInt16:
+            return 2;
+        case ScalarType::Int32:
+        case ScalarType::UInt32:
+        case ScalarType::Float32:
+            return 4;
+        case ScalarType::Float64:
+            return 8;
     }
+    return 0;
+}
 
-    // open the file:
-    //         std::ifstream file(filename, std::ios::binary);
+const char* ScalarName(ScalarType type)
+{
+    switch (type)
+    {
+        case ScalarType::Int8:
+            return "char";
+        case ScalarType::UInt8:
+            return "uchar";
+        case ScalarType::Int16:
+            return "short";
+        case ScalarType::UInt16:
+            return "ushort";
+        case ScalarType::Int32:
+            return "int";
+        case ScalarType::UInt32:
+            return "uint";
+        case ScalarType::Float32:
+            return "float";
+        case ScalarType::Float64:
+            return "double";
+    }
+    return "unknown";
+}
 
-    // read the data:
-    data = std::vector<char>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+bool ParseScalarType(const std::string& name, ScalarType& type)
+{
+    static const std::pair<const char*, ScalarType> names[] = {
+        {"char", ScalarType::Int8},     {"int8", ScalarType::Int8},       {"uchar", ScalarType::UInt8},
+        {"uint8", ScalarType::UInt8},   {"short", ScalarType::Int16},     {"int16", ScalarType::Int16},
+        {"ushort", ScalarType::UInt16}, {"uint16", ScalarType::UInt16},   {"int", ScalarType::Int32},
+        {"int32", ScalarType::Int32},   {"uint", ScalarType::UInt32},     {"uint32", ScalarType::UInt32},
+        {"float", ScalarType::Float32}, {"float32", ScalarType::Float32}, {"double", ScalarType::Float64},
+        {"float64", ScalarType::Float64}};
+    for (auto& n : names)
+    {
+        if (name == n.first)
+        {
+            type = n.second;
+            return true;
+        }
+    }
+    return false;
+}
 
-    //         std::cout << "filesize: " << data.size() << std::endl;
+Element& Element::AddProperty(const std::string& name, ScalarType type)
+{
+    Property p;
+    p.name = name;
+    p.type = type;
+    if (stride >= 0)
+    {
+        p.offset = stride;
+        stride += ScalarSize(type);
+    }
+    properties.push_back(p);
+    return *this;
+}
 
-    parseHeader();
-    parseMeshBinary();
+Element& Element::AddListProperty(const std::string& name, ScalarType count_type, ScalarType type)
+{
+    Property p;
+    p.name       = name;
+    p.type       = type;
+    p.is_list    = true;
+    p.count_type = count_type;
+    properties.push_back(p);
+
+    stride = -1;
+    for (auto& prop : properties) prop.offset = -1;
+    return *this;
 }
 
-int PLYLoader::sizeoftype(std::string t)
+int Element::PropertyIndex(const std::string& name) const
 {
-    if (t == "float" || t == "int")
+    for (int i = 0; i < (int)properties.size(); ++i)
     {
-        return 4;
+        if (properties[i].name == name) return i;
     }
-    if (t == "uchar")
+    return -1;
+}
+
+Element& Header::AddElement(const std::string& name, size_t count)
+{
+    Element e;
+    e.name  = name;
+    e.count = count;
+    elements.push_back(e);
+    return elements.back();
+}
+
+int Header::ElementIndex(const std::string& name) const
+{
+    for (int i = 0; i < (int)elements.size(); ++i)
     {
-        return 1;
+        if (elements[i].name == name) return i;
     }
-    SAIGA_ASSERT(0);
     return -1;
 }
 
-void PLYLoader::parseHeader()
+std::string Header::ToString() const
+{
+    std::string str = "ply\nformat ";
+    str += format == Format::Ascii                ? "ascii"
+           : format == Format::BinaryLittleEndian ? "binary_little_endian"
+                                                  : "binary_big_endian";
+    str += " 1.0\n";
+    for (auto& c : comments) str += "comment " + c + "\n";
+    for (auto& e : elements)
+    {
+        str += "element " + e.name + " " + std::to_string(e.count) + "\n";
+        for (auto& p : e.properties)
+        {
+            str += "property ";
+            if (p.is_list) str += std::string("list ") + ScalarName(p.count_type) + " ";
+            str += std::string(ScalarName(p.type)) + " " + p.name + "\n";
+        }
+    }
+    str += "end_header\n";
+    return str;
+}
+
+size_t Header::Parse(const char* data, size_t size)
 {
-    // Note: the header is always in ascii and ends with the string end_header
-    std::string str2(data.begin(), data.end());
-    auto pos = str2.find("end_header");
+    *this = Header();
+    StringViewParser parser = {" \t\r", true};
+
+    size_t pos = 0;
+    int line   = 0;
+    while (pos < size)
+    {
+        auto line_end = (const char*)std::memchr(data + pos, '\n', size - pos);
+        if (!line_end) return 0;
+        std::string_view str(data + pos, line_end - (data + pos));
+        pos = line_end - data + 1;
+
+        parser.set(str);
+        auto key = parser.next();
+        if (line++ == 0)
+        {
+            if (key != "ply") return 0;
+        }
+        else if (key == "format")
+        {
+            auto f = parser.next();
+            if (f == "ascii")
+                format = Format::Ascii;
+            else if (f == "binary_little_endian")
+                format = Format::BinaryLittleEndian;
+            else if (f == "binary_big_endian")
+                format = Format::BinaryBigEndian;
+            else
+                return 0;
+        }
+        else if (key == "comment")
+        {
+            auto c = str.substr(str.find("comment") + 7);
+            if (!c.empty() && c.front() == ' ') c.remove_prefix(1);
+            if (!c.empty() && c.back() == '\r') c.remove_suffix(1);
+            comments.push_back(std::string(c));
+        }
+        else if (key == "element")
+        {
+            auto name  = std::string(parser.next());
+            auto count = parser.next();
+            if (name.empty() || count.empty()) return 0;
+            try
+            {
+                AddElement(name, std::stoull(std::string(count)));
+            }
+            catch (const std::logic_error&)
+            {
+                // invalid_argument or out_of_range from stoull
+                return 0;
+            }
+        }
+        else if (key == "property")
+        {
+            if (elements.empty()) return 0;
+            auto type = std::string(parser.next());
+            ScalarType t, count_type;
+            if (type == "list")
+            {
+                auto ct = std::string(parser.next());
+                auto vt = std::string(parser.next());
+                auto n  = std::string(parser.next());
+                if (!ParseScalarType(ct, count_type) || !ParseScalarType(vt, t) || n.empty()) return 0;
+                elements.back().AddListProperty(n, count_type, t);
+            }
+            else
+            {
+                auto n = std::string(parser.next());
+                if (!ParseScalarType(type, t) || n.empty()) return 0;
+                elements.back().AddProperty(n, t);
+            }
+        }
+        else if (key == "end_header")
+        {
+            return pos;
+        }
+    }
+    return 0;
+}
+
+}  // namespace PLY
 
-    SAIGA_ASSERT(pos != std::string::npos);
+using PLY::ScalarType;
 
-    dataStart = pos;
-    // go until next newline
-    while (data[dataStart] != '\n')
+template <typename F>
+static void DispatchScalar(ScalarType type, F&& f)
+{
+    switch (type)
     {
-        dataStart++;
+        case ScalarType::Int8:
+            f(int8_t());
+            break;
+        case ScalarType::UInt8:
+            f(uint8_t());
+            break;
+        case ScalarType::Int16:
+            f(int16_t());
+            break;
+        case ScalarType::UInt16:
+            f(uint16_t());
+            break;
+        case ScalarType::Int32:
+            f(int32_t());
+            break;
+        case ScalarType::UInt32:
+            f(uint32_t());
+            break;
+        case ScalarType::Float32:
+            f(float());
+            break;
+        case ScalarType::Float64:
+            f(double());
+            break;
     }
-    dataStart++;
+}
 
-    std::string header(str2.begin(), str2.begin() + pos);
-    header.erase(std::remove(header.begin(), header.end(), '\r'), header.end());
+template <typename T>
+static T Load(const char* ptr, bool swap)
+{
+    T v;
+    std::memcpy(&v, ptr, sizeof(T));
+    return swap ? PLY::ByteSwap(v) : v;
+}
 
-    std::vector<std::string> headerLines = split(header, '\n');
+static size_t LoadCount(const char* ptr, ScalarType type, bool swap)
+{
+    size_t count = 0;
+    DispatchScalar(type, [&](auto t) { count = (size_t)Load<decltype(t)>(ptr, swap); });
+    return count;
+}
 
-    SAIGA_ASSERT(headerLines[0] == "ply");
+// Tokens of an ascii row
+static void Tokenize(std::string_view line, std::vector<std::string_view>& tokens)
+{
+    StringViewParser parser = {" \t\r", true};
+    parser.set(line);
+    tokens.clear();
+    for (auto t = parser.next(); !t.empty(); t = parser.next()) tokens.push_back(t);
+}
 
-    int elementStatus = -1;
-    for (auto l : headerLines)
+// Returns the next non-empty line starting at 'pos' and moves 'pos' behind it.
+static std::string_view NextLine(const char* data, size_t size, size_t& pos)
+{
+    while (pos < size)
     {
-        //        std::cout << l << std::endl;
-        std::vector<std::string> splitLine = split(l, ' ');
-
-        if (splitLine.size() == 0) continue;
+        auto end      = (const char*)std::memchr(data + pos, '\n', size - pos);
+        size_t length = end ? end - (data + pos) : size - pos;
+        std::string_view line(data + pos, length);
+        pos += length + 1;
+        if (line.find_first_not_of(" \t\r") != std::string_view::npos) return line;
+    }
+    pos = size;
+    return {};
+}
 
-        std::string& type = splitLine[0];
-        //            std::cout << "type " << type << std::endl;
+PLYReader::PLYReader(const std::string& _file)
+{
+    if (!file.open(_file)) throw std::runtime_error("Could not open file " + _file);
 
+    size_t header_size = header.Parse(file.data(), file.size());
+    if (header_size == 0) throw std::runtime_error("Invalid PLY header in " + _file);
+    swap = IsBinary() && (header.format == PLY::Format::BinaryLittleEndian) != PLY::HostIsLittleEndian();
 
-        if (type == "format")
+    // Locate the first row of each element
+    size_t pos = header_size;
+    for (auto& e : header.elements)
+    {
+        element_begin.push_back(pos);
+        if (!IsBinary())
+        {
+            for (size_t i = 0; i < e.count; ++i)
+            {
+                if (NextLine(file.data(), file.size(), pos).empty())
+                    throw std::runtime_error("Unexpected end of file in element " + e.name);
+            }
+        }
+        else if (e.stride >= 0)
         {
-            SAIGA_ASSERT(splitLine[1] == "binary_little_endian");
+            pos += e.count * e.stride;
         }
+        else
+        {
+            for (size_t i = 0; i < e.count; ++i)
+            {
+                for (auto& p : e.properties)
+                {
+                    size_t n = 1;
+                    if (p.is_list)
+                    {
+                        if (pos + PLY::ScalarSize(p.count_type) > file.size())
+                            throw std::runtime_error("Unexpected end of file in element " + e.name);
+                        n = LoadCount(file.data() + pos, p.count_type, swap);
+                        pos += PLY::ScalarSize(p.count_type);
+                    }
+                    pos += n * PLY::ScalarSize(p.type);
+                }
+            }
+        }
+        if (pos > file.size()) throw std::runtime_error("Unexpected end of file in element " + e.name);
+    }
+}
 
-        if (type == "element")
+bool PLYReader::HasProperty(const std::string& element, const std::string& property) const
+{
+    int e = header.ElementIndex(element);
+    return e >= 0 && header.elements[e].PropertyIndex(property) >= 0;
+}
+
+std::pair<int, int> PLYReader::Find(const std::string& element, const std::string& property) const
+{
+    int e = header.ElementIndex(element);
+    SAIGA_ASSERT(e >= 0, "Unknown element " + element);
+    int p = header.elements[e].PropertyIndex(property);
+    SAIGA_ASSERT(p >= 0, "Unknown property " + element + "." + property);
+    return {e, p};
+}
+
+void PLYReader::ReadScalars(int element, size_t first, size_t count, ArrayView<const ScalarTarget> targets,
+                            RowCursor* cursor) const
+{
+    auto& e = header.elements[element];
+    SAIGA_ASSERT(first + count <= e.count);
+    for (auto& t : targets) SAIGA_ASSERT(!e.properties[t.property].is_list);
+
+    if (IsBinary() && e.stride >= 0)
+    {
+        // Fixed row size: blocks of rows in parallel
+        for (auto& t : targets)
         {
-            std::string& ident = splitLine[1];
+            auto& prop = e.properties[t.property];
+            DispatchScalar(prop.type, [&](auto s) {
+                using S = decltype(s);
+                DispatchScalar(t.type, [&](auto d) {
+                    using D          = decltype(d);
+                    const char* src  = file.data() + element_begin[element] + prop.offset + first * e.stride;
+                    char* dst        = (char*)t.out;
+                    const size_t blk = 1 << 16;
+                    ParallelFor(0, (count + blk - 1) / blk, [&](int b) {
+                        size_t end = std::min(count, (b + 1) * blk);
+                        for (size_t i = b * blk; i < end; ++i)
+                        {
+                            D v = static_cast<D>(Load<S>(src + i * e.stride, swap));
+                            std::memcpy(dst + i * t.out_stride, &v, sizeof(D));
+                        }
+                    });
+                });
+            });
+        }
+        return;
+    }
 
-            if (ident == "vertex")
+    auto store = [&](const ScalarTarget& t, size_t i, auto value) {
+        DispatchScalar(t.type, [&](auto d) {
+            auto v = static_cast<decltype(d)>(value);
+            std::memcpy((char*)t.out + i * t.out_stride, &v, sizeof(v));
+        });
+    };
+
+    // Continue behind the previous read if possible, otherwise start at the first row of the element
+    RowCursor local;
+    if (!cursor) cursor = &local;
+    if (cursor->pos == 0 || cursor->row > first)
+    {
+        cursor->row = 0;
+        cursor->pos = element_begin[element];
+    }
+    size_t pos = cursor->pos;
+
+    // Start of each property in the current row (token index or byte offset)
+    std::vector<size_t> start(e.properties.size());
+    std::vector<std::string_view> tokens;
+    for (size_t r = cursor->row; r < first + count; ++r)
+    {
+        if (!IsBinary())
+        {
+            auto line = NextLine(file.data(), file.size(), pos);
+            if (r < first) continue;
+            Tokenize(line, tokens);
+            size_t t = 0;
+            for (size_t k = 0; k < e.properties.size(); ++k)
             {
-                vertexCount   = to_int(splitLine[2]);
-                elementStatus = 1;
+                start[k] = t;
+                t += e.properties[k].is_list ? 1 + (t < tokens.size() ? (size_t)to_double(tokens[t]) : 0) : 1;
             }
-            if (ident == "face")
+            for (auto& target : targets)
             {
-                faceCount     = to_int(splitLine[2]);
-                elementStatus = 2;
+                size_t t = start[target.property];
+                store(target, r - first, t < tokens.size() ? to_double(tokens[t]) : 0.0);
             }
         }
-
-        if (type == "property")
+        else
         {
-            SAIGA_ASSERT(elementStatus != -1);
-
-            if (elementStatus == 1)
+            for (size_t k = 0; k < e.properties.size(); ++k)
             {
-                // vertex property
-                VertexProperty vp;
-                vp.name = splitLine[2];
-                vp.type = splitLine[1];
-                vertexProperties.push_back(vp);
+                auto& p  = e.properties[k];
+                size_t n = 1;
+                if (p.is_list)
+                {
+                    n = LoadCount(file.data() + pos, p.count_type, swap);
+                    pos += PLY::ScalarSize(p.count_type);
+                }
+                start[k] = pos;
+                pos += n * PLY::ScalarSize(p.type);
             }
-            if (elementStatus == 2)
+            if (r < first) continue;
+            for (auto& target : targets)
             {
-                SAIGA_ASSERT(splitLine[1] == "list");
-                SAIGA_ASSERT(splitLine[4] == "vertex_indices");
+                DispatchScalar(e.properties[target.property].type, [&](auto s) {
+                    store(target, r - first, Load<decltype(s)>(file.data() + start[target.property], swap));
+                });
+            }
+        }
+    }
+    cursor->row = first + count;
+    cursor->pos = pos;
+}
 
-                faceVertexCountType = splitLine[2];
-                faceVertexIndexType = splitLine[3];
+void PLYReader::ReadListRaw(int element, int property, ScalarType type, std::vector<size_t>& offsets,
+                            std::vector<char>& values) const
+{
+    auto& e    = header.elements[element];
+    auto& prop = e.properties[property];
+    SAIGA_ASSERT(prop.is_list);
+    const int value_size = PLY::ScalarSize(type);
+
+    offsets.clear();
+    offsets.reserve(e.count + 1);
+    offsets.push_back(0);
+    values.clear();
+
+    auto append = [&](auto value) {
+        DispatchScalar(type, [&](auto d) {
+            auto v = static_cast<decltype(d)>(value);
+            values.insert(values.end(), (const char*)&v, (const char*)&v + value_size);
+        });
+    };
+
+    if (!IsBinary())
+    {
+        size_t pos = element_begin[element];
+        std::vector<std::string_view> tokens;
+        for (size_t r = 0; r < e.count; ++r)
+        {
+            Tokenize(NextLine(file.data(), file.size(), pos), tokens);
+            size_t t = 0;
+            for (int k = 0; k < property; ++k)
+            {
+                t += e.properties[k].is_list ? 1 + (t < tokens.size() ? (size_t)to_double(tokens[t]) : 0) : 1;
             }
+            size_t n = t < tokens.size() ? (size_t)to_double(tokens[t]) : 0;
+            for (size_t i = 0; i < n; ++i) append(t + 1 + i < tokens.size() ? to_double(tokens[t + 1 + i]) : 0.0);
+            offsets.push_back(offsets.back() + n);
         }
+        return;
     }
 
+    DispatchScalar(prop.type, [&](auto s) {
+        using S         = decltype(s);
+        const char* ptr = file.data() + element_begin[element];
+        for (size_t r = 0; r < e.count; ++r)
+        {
+            for (int k = 0; k < (int)e.properties.size(); ++k)
+            {
+                auto& p  = e.properties[k];
+                size_t n = 1;
+                if (p.is_list)
+                {
+                    n = LoadCount(ptr, p.count_type, swap);
+                    ptr += PLY::ScalarSize(p.count_type);
+                }
+                if (k == property)
+                {
+                    for (size_t i = 0; i < n; ++i) append(Load<S>(ptr + i * sizeof(S), swap));
+                    offsets.push_back(offsets.back() + n);
+                }
+                ptr += n * PLY::ScalarSize(p.type);
+            }
+        }
+    });
+}
 
-    //    std::cout << std::endl;
-    //    std::cout << "V " << vertexCount << " F " << faceCount << std::endl;
-    //    std::cout << "Face: " << faceVertexCountType << " - " << faceVertexIndexType << std::endl;
+void PLYReader::ReadPoints(size_t first, size_t count, UnifiedMesh& points, RowCursor* cursor) const
+{
+    points = UnifiedMesh();
+    int e  = header.ElementIndex("vertex");
+    if (e < 0) return;
+    auto& el = header.elements[e];
+
+    // All attributes are collected first and then read in a single pass over the rows.
+    std::vector<ScalarTarget> targets;
+    auto add = [&](std::initializer_list<const char*> names, auto& out) -> bool {
+        using V = typename std::decay_t<decltype(out)>::value_type;
+        for (auto n : names)
+            if (el.PropertyIndex(n) < 0) return false;
+        out.resize(count);
+        int i = 0;
+        for (auto n : names)
+        {
+            targets.push_back({el.PropertyIndex(n), ScalarType::Float32, (float*)out.data() + i++, sizeof(V)});
+        }
+        return true;
+    };
 
-    offsetType.resize(6, std::pair<int, int>(0, -1));
+    add({"x", "y", "z"}, points.position);
+    add({"nx", "ny", "nz"}, points.normal);
+    if (!add({"s", "t"}, points.texture_coordinates) && !add({"u", "v"}, points.texture_coordinates))
+        add({"texture_u", "texture_v"}, points.texture_coordinates);
 
-    vertexSize = 0;
-    for (auto vp : vertexProperties)
+    // Integer colors are normalized to [0, 1]
+    float scale = 1;
+    if (add({"red", "green", "blue"}, points.color))
     {
-        int t = sizeoftype(vp.type);
+        auto type = el.properties[el.PropertyIndex("red")].type;
+        scale     = type == ScalarType::UInt8 ? 1.f / 255 : type == ScalarType::UInt16 ? 1.f / 65535 : 1.f;
+        for (auto& c : points.color) c(3) = 1.f / scale;
+        if (el.PropertyIndex("alpha") >= 0)
+        {
+            targets.push_back(
+                {el.PropertyIndex("alpha"), ScalarType::Float32, points.color.data()->data() + 3, sizeof(vec4)});
+        }
+    }
 
+    if (!targets.empty()) ReadScalars(e, first, count, targets, cursor);
+    if (scale != 1)
+    {
+        for (auto& c : points.color) c *= scale;
+    }
+}
 
-        if (vp.name == "x") offsetType[0] = std::make_pair(vertexSize, t);
-        if (vp.name == "y") offsetType[1] = std::make_pair(vertexSize, t);
-        if (vp.name == "z") offsetType[2] = std::make_pair(vertexSize, t);
-        if (vp.name == "red") offsetType[3] = std::make_pair(vertexSize, t);
-        if (vp.name == "green") offsetType[4] = std::make_pair(vertexSize, t);
-        if (vp.name == "blue") offsetType[5] = std::make_pair(vertexSize, t);
+UnifiedMesh PLYReader::Mesh() const
+{
+    UnifiedMesh mesh;
+    int v = header.ElementIndex("vertex");
+    if (v >= 0) ReadPoints(0, header.elements[v].count, mesh);
+
+    int f = header.ElementIndex("face");
+    if (f < 0) return mesh;
+    int p = header.elements[f].PropertyIndex("vertex_indices");
+    if (p < 0) p = header.elements[f].PropertyIndex("vertex_index");
+    if (p < 0) return mesh;
+
+    std::vector<size_t> offsets;
+    std::vector<char> raw;
+    ReadListRaw(f, p, ScalarType::Int32, offsets, raw);
+    const int* indices = (const int*)raw.data();
+
+    for (size_t i = 0; i < offsets.back(); ++i)
+    {
+        if (indices[i] < 0 || indices[i] >= mesh.NumVertices())
+            throw std::runtime_error("Invalid vertex index " + std::to_string(indices[i]) + " in face list");
+    }
 
-        //        std::cout << "Prop: " << vp.type << " " << vp.name << std::endl;
-        vertexSize += sizeoftype(vp.type);
+    mesh.triangles.reserve(header.elements[f].count);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i)
+    {
+        // Fan triangulation of polygons
+        for (size_t k = offsets[i] + 2; k < offsets[i + 1]; ++k)
+        {
+            mesh.triangles.push_back(ivec3(indices[offsets[i]], indices[k - 1], indices[k]));
+        }
     }
+    return mesh;
+}
 
-    //    std::cout << "vertex size: " << vertexSize << std::endl;
+void PLYReader::StreamPoints(size_t chunk_size, const std::function<void(const UnifiedMesh&, size_t)>& f) const
+{
+    int e = header.ElementIndex("vertex");
+    if (e < 0) return;
+    size_t count = header.elements[e].count;
 
+    UnifiedMesh points;
+    RowCursor cursor;
+    for (size_t first = 0; first < count; first += chunk_size)
+    {
+        ReadPoints(first, std::min(chunk_size, count - first), points, &cursor);
+        f(points, first);
+    }
+}
 
-    SAIGA_ASSERT(vertexCount > 0 && faceCount > 0);
-    //        std::cout << header << std::endl;
+PLYWriter::PLYWriter(const std::string& file, const PLY::Header& header) : strm(file, std::ios::binary), header(header)
+{
+    if (!strm.is_open()) throw std::runtime_error("Could not open file " + file);
+    swap = header.format != PLY::Format::Ascii &&
+           (header.format == PLY::Format::BinaryLittleEndian) != PLY::HostIsLittleEndian();
+    auto str = header.ToString();
+    strm.write(str.data(), str.size());
 }
 
-void PLYLoader::parseMeshBinary()
+PLYWriter::~PLYWriter()
 {
-    for (int i = 0; i < vertexCount; ++i)
+    NextRows(0);
+    if (element < (int)header.elements.size())
     {
-        char* start = data.data() + dataStart + i * vertexSize;
-
+        std::cerr << "PLYWriter: Missing rows in element " << header.elements[element].name << std::endl;
+    }
+}
 
+void PLYWriter::NextRows(size_t count)
+{
+    // Skip the elements which are complete
+    while (element < (int)header.elements.size() && row == header.elements[element].count)
+    {
+        element++;
+        row = 0;
+    }
+    if (count == 0) return;
+    SAIGA_ASSERT(element < (int)header.elements.size(), "All elements have been written.");
+    SAIGA_ASSERT(row + count <= header.elements[element].count, "Too many rows");
+}
 
-        float* x = reinterpret_cast<float*>(start + offsetType[0].first);
-        vec3 pos(x[0], x[1], x[2]);
+void PLYWriter::AppendScalar(const void* value, ScalarType type)
+{
+    if (header.format != PLY::Format::Ascii)
+    {
+        DispatchScalar(type, [&](auto t) {
+            decltype(t) v;
+            std::memcpy(&v, value, sizeof(v));
+            if (swap) v = PLY::ByteSwap(v);
+            buffer.insert(buffer.end(), (const char*)&v, (const char*)&v + sizeof(v));
+        });
+        return;
+    }
 
+    char str[32];
+    int n = 0;
+    DispatchScalar(type, [&](auto t) {
+        using T = decltype(t);
+        T v;
+        std::memcpy(&v, value, sizeof(v));
+        if constexpr (std::is_same_v<T, float>)
+            n = snprintf(str, sizeof(str), "%.9g ", v);
+        else if constexpr (std::is_same_v<T, double>)
+            n = snprintf(str, sizeof(str), "%.17g ", v);
+        else if constexpr (std::is_signed_v<T>)
+            n = snprintf(str, sizeof(str), "%lld ", (long long)v);
+        else
+            n = snprintf(str, sizeof(str), "%llu ", (unsigned long long)v);
+    });
+    buffer.insert(buffer.end(), str, str + n);
+}
 
-        vec3 color(1);
-        if (offsetType[3].second == 1)
+void PLYWriter::WriteRows(size_t count, ArrayView<const ColumnData> columns)
+{
+    NextRows(count);
+    if (count == 0) return;
+    auto& e = header.elements[element];
+    SAIGA_ASSERT(e.stride >= 0, "Use WriteTriangles for list properties.");
+    SAIGA_ASSERT(columns.size() == e.properties.size());
+
+    // Bounded buffer for very large chunks
+    const size_t blk = 1 << 16;
+    for (size_t b = 0; b < count; b += blk)
+    {
+        buffer.clear();
+        for (size_t i = b; i < std::min(count, b + blk); ++i)
         {
-            unsigned char* c = reinterpret_cast<unsigned char*>(start + offsetType[3].first);
-            color            = vec3(c[0], c[1], c[2]);
-            color /= 255.0f;
+            for (size_t k = 0; k < columns.size(); ++k)
+            {
+                AppendScalar((const char*)columns[k].data + i * columns[k].stride, e.properties[k].type);
+            }
+            if (header.format == PLY::Format::Ascii) buffer.back() = '\n';
         }
-        else if (offsetType[3].second == 4)
+        strm.write(buffer.data(), buffer.size());
+    }
+    row += count;
+}
+
+void PLYWriter::WriteTriangles(ArrayView<const ivec3> triangles)
+{
+    NextRows(triangles.size());
+    if (triangles.empty()) return;
+    auto& e = header.elements[element];
+    SAIGA_ASSERT(e.properties.size() == 1 && e.properties[0].is_list);
+    SAIGA_ASSERT(e.properties[0].type == ScalarType::Int32 || e.properties[0].type == ScalarType::UInt32);
+
+    const size_t blk = 1 << 16;
+    for (size_t b = 0; b < triangles.size(); b += blk)
+    {
+        buffer.clear();
+        for (size_t i = b; i < std::min(triangles.size(), b + blk); ++i)
         {
-            float* c = reinterpret_cast<float*>(start + offsetType[3].first);
-            color    = vec3(c[0], c[1], c[2]);
+            // The count is converted to the count type of the list
+            DispatchScalar(e.properties[0].count_type, [&](auto t) {
+                auto n = static_cast<decltype(t)>(3);
+                AppendScalar(&n, e.properties[0].count_type);
+            });
+            for (int k = 0; k < 3; ++k) AppendScalar(&triangles[i](k), e.properties[0].type);
+            if (header.format == PLY::Format::Ascii) buffer.back() = '\n';
         }
-
-
-        VertexNC v;
-        v.position = make_vec4(pos, 1);
-        v.color    = make_vec4(color, 1);
-        mesh.addVertex(v);
+        strm.write(buffer.data(), buffer.size());
     }
+    row += triangles.size();
+}
 
-    int faceStart = dataStart + vertexCount * vertexSize;
-    char* start   = data.data() + faceStart;
-
-    int countSize = sizeoftype(faceVertexCountType);
-
-    for (int i = 0; i < faceCount; ++i)
+void SavePLY(const std::string& file, const UnifiedMesh& mesh, PLY::Format format)
+{
+    PLY::Header header;
+    header.format = format;
+    header.comments.push_back("generated by lib saiga");
+
+    // One column per vertex property, pointing into the attribute arrays of the mesh
+    std::vector<PLYWriter::ColumnData> columns;
+    auto& v = header.AddElement("vertex", mesh.NumVertices());
+    std::vector<ucvec4> color;
+    if (mesh.NumVertices() > 0)
     {
-        int c = 0;
-        if (countSize == 1)
+        const char* xyz[3] = {"x", "y", "z"};
+        for (int i = 0; i < 3; ++i)
         {
-            c = *reinterpret_cast<unsigned char*>(start);
+            v.AddProperty(xyz[i], ScalarType::Float32);
+            columns.push_back({mesh.position.data()->data() + i, sizeof(vec3)});
         }
-        else if (countSize == 4)
+        if (mesh.HasNormal())
         {
-            c = *reinterpret_cast<int*>(start);
+            const char* n[3] = {"nx", "ny", "nz"};
+            for (int i = 0; i < 3; ++i)
+            {
+                v.AddProperty(n[i], ScalarType::Float32);
+                columns.push_back({mesh.normal.data()->data() + i, sizeof(vec3)});
+            }
         }
-        start += countSize;
+        if (mesh.HasColor())
+        {
+            color.resize(mesh.NumVertices());
+            for (int i = 0; i < mesh.NumVertices(); ++i)
+            {
+                vec4 c   = (mesh.color[i].array().max(0).min(1) * 255.f).round();
+                color[i] = c.cast<unsigned char>();
+            }
+            const char* n[4] = {"red", "green", "blue", "alpha"};
+            for (int i = 0; i < 4; ++i)
+            {
+                v.AddProperty(n[i], ScalarType::UInt8);
+                columns.push_back({color.data()->data() + i, sizeof(ucvec4)});
+            }
+        }
+        if (mesh.HasTC())
+        {
+            const char* n[2] = {"s", "t"};
+            for (int i = 0; i < 2; ++i)
+            {
+                v.AddProperty(n[i], ScalarType::Float32);
+                columns.push_back({mesh.texture_coordinates.data()->data() + i, sizeof(vec2)});
+            }
+        }
+    }
+    if (mesh.NumFaces() > 0)
+    {
+        header.AddElement("face", mesh.NumFaces())
+            .AddListProperty("vertex_indices", ScalarType::UInt8, ScalarType::Int32);
+    }
 
-        SAIGA_ASSERT(c == 3);
+    PLYWriter writer(file, header);
+    writer.WriteRows(mesh.NumVertices(), columns);
+    writer.WriteTriangles(mesh.triangles);
+}
 
-        uint32_t* face = reinterpret_cast<uint32_t*>(start);
-        mesh.addFace(face);
+PLYLoader::PLYLoader(const std::string& _file)
+{
+    auto file = SearchPathes::model(_file);
+    if (file.empty())
+    {
+        std::cerr << "Could not open file " << _file << std::endl;
+        throw std::runtime_error("invalid file: " + file + ", " + _file);
+    }
 
-        start += sizeof(uint32_t) * c;
-        //            std::cout << c << std::endl;
+    UnifiedMesh m = PLYReader(file).Mesh();
+    for (int i = 0; i < m.NumVertices(); ++i)
+    {
+        VertexNC v;
+        v.position = make_vec4(m.position[i], 1);
+        v.color    = m.HasColor() ? make_vec4(m.color[i].head<3>(), 1) : make_vec4(1);
+        mesh.addVertex(v);
+    }
+    for (auto t : m.triangles)
+    {
+        mesh.addFace(t(0), t(1), t(2));
     }
 
     mesh.computePerVertexNormal();
@@ -6,57 +6,370 @@
 
 #pragma once
 #include "saiga/core/geometry/triangle_mesh.h"
+#include "saiga/core/model/UnifiedMesh.h"
+#include "saiga/core/util/DataStructures/ArrayView.h"
+#include "saiga/core/util/MemoryMappedFile.h"
 #include "saiga/core/util/color.h"
 #include "saiga/core/util/tostring.h"
 
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <vector>
 
 namespace Saiga
 {
-namespace PLYLoaderDetail
+namespace PLY
 {
-template <typename VertexType>
-static inline int print(std::vector<std::string>& header);
-template <typename VertexType>
-static inline void write(char* ptr, VertexType v);
-};  // namespace PLYLoaderDetail
+enum class ScalarType
+{
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64,
+};
 
-class SAIGA_CORE_API PLYLoader
+enum class Format
+{
+    Ascii,
+    BinaryLittleEndian,
+    BinaryBigEndian,
+};
+
+SAIGA_CORE_API int ScalarSize(ScalarType type);
+
+// The name used in the header (char, uchar, short, ...)
+SAIGA_CORE_API const char* ScalarName(ScalarType type);
+
+// Accepts both naming conventions (uchar and uint8, float and float32, ...). Returns false for unknown types.
+SAIGA_CORE_API bool ParseScalarType(const std::string& name, ScalarType& type);
+
+template <typename T>
+constexpr ScalarType ScalarTypeOf();
+template <>
+constexpr ScalarType ScalarTypeOf<int8_t>()
+{
+    return ScalarType::Int8;
+}
+template <>
+constexpr ScalarType ScalarTypeOf<uint8_t>()
+{
+    return ScalarType::UInt8;
+}
+template <>
+constexpr ScalarType ScalarTypeOf<int16_t>()
+{
+    return ScalarType::Int16;
+}
+template <>
+constexpr ScalarType ScalarTypeOf<uint16_t>()
+{
+    return ScalarType::UInt16;
+}
+template <>
+constexpr ScalarType ScalarTypeOf<int32_t>()
+{
+    return ScalarType::Int32;
+}
+template <>
+constexpr ScalarType ScalarTypeOf<uint32_t>()
+{
+    return ScalarType::UInt32;
+}
+template <>
+constexpr ScalarType ScalarTypeOf<float>()
+{
+    return ScalarType::Float32;
+}
+template <>
+constexpr ScalarType ScalarTypeOf<double>()
+{
+    return ScalarType::Float64;
+}
+
+inline bool HostIsLittleEndian()
+{
+    const uint16_t x = 1;
+    unsigned char c;
+    std::memcpy(&c, &x, 1);
+    return c == 1;
+}
+
+template <typename T>
+inline T ByteSwap(T v)
+{
+    unsigned char b[sizeof(T)];
+    std::memcpy(b, &v, sizeof(T));
+    for (size_t i = 0; i < sizeof(T) / 2; ++i) std::swap(b[i], b[sizeof(T) - 1 - i]);
+    std::memcpy(&v, b, sizeof(T));
+    return v;
+}
+
+struct Property
+{
+    std::string name;
+    ScalarType type = ScalarType::Float32;
+
+    // List properties store 'count_type' followed by count values of 'type'
+    bool is_list          = false;
+    ScalarType count_type = ScalarType::UInt8;
+
+    // Byte offset inside a binary row. Only valid if the element has no list property.
+    int offset = -1;
+};
+
+struct SAIGA_CORE_API Element
+{
+    std::string name;
+    size_t count = 0;
+    std::vector<Property> properties;
+
+    // Bytes per binary row or -1 if the element has a list property
+    int stride = 0;
+
+    Element& AddProperty(const std::string& name, ScalarType type);
+    Element& AddListProperty(const std::string& name, ScalarType count_type, ScalarType type);
+
+    // -1 if the property does not exist
+    int PropertyIndex(const std::string& name) const;
+};
+
+struct SAIGA_CORE_API Header
+{
+    Format format = Format::BinaryLittleEndian;
+    std::vector<std::string> comments;
+    std::vector<Element> elements;
+
+    Element& AddElement(const std::string& name, size_t count);
+
+    // -1 if the element does not exist
+    int ElementIndex(const std::string& name) const;
+
+    // The complete header including the end_header line.
+    std::string ToString() const;
+
+    // Parses the header at the beginning of 'data'.
+    // Returns the size of the header in bytes or 0 if it is invalid.
+    size_t Parse(const char* data, size_t size);
+};
+
+/**
+ * Zero-copy view of one scalar property of a binary element.
+ * The values are read with memcpy (the rows are not aligned) and converted to the host byte order.
+ */
+template <typename T>
+struct Column
+{
+    const char* data = nullptr;
+    size_t stride    = 0;
+    size_t count     = 0;
+    bool swap        = false;
+
+    size_t size() const { return count; }
+    T operator[](size_t i) const
+    {
+        T v;
+        std::memcpy(&v, data + i * stride, sizeof(T));
+        return swap ? ByteSwap(v) : v;
+    }
+};
+
+}  // namespace PLY
+
+/**
+ * Memory mapped reader for PLY files.
+ *
+ * All scalar types, list properties and the ascii, binary_little_endian and binary_big_endian formats are supported.
+ * Only the header is parsed in the constructor, the data is converted when it is accessed:
+ *   - Column: zero-copy view of a scalar property (binary files, element without list property)
+ *   - Read:   converted copy of a scalar property or of a range of rows
+ *   - ReadList: CSR arrays of a list property
+ *
+ * Because the file is memory mapped, ranges of rows can be read out-of-core. The pages are loaded by the OS on
+ * access. StreamPoints uses this to process large point clouds chunk by chunk. Random access into elements with
+ * list properties and into ascii files walks the rows in front of the requested range. StreamPoints continues
+ * from the end of the previous chunk, so each row is parsed only once.
+ *
+ * Usage:
+ *    PLYReader ply("cloud.ply");
+ *    auto x          = ply.Column<float>("vertex", "x");
+ *    auto confidence = ply.Read<float>("vertex", "confidence");
+ *    UnifiedMesh mesh = ply.Mesh();
+ */
+class SAIGA_CORE_API PLYReader
 {
    public:
-    struct VertexProperty
+    // Throws std::runtime_error if the file can not be opened or the header is invalid.
+    PLYReader(const std::string& file);
+
+    const PLY::Header& Header() const { return header; }
+
+    bool HasProperty(const std::string& element, const std::string& property) const;
+
+    // The type T must be the type of the property.
+    template <typename T>
+    PLY::Column<T> Column(const std::string& element, const std::string& property) const
     {
-        std::string name;
-        std::string type;
-    };
+        auto [e, p] = Find(element, property);
+        SAIGA_ASSERT(IsBinary() && header.elements[e].stride >= 0, "Columns require a binary element without lists.");
+        SAIGA_ASSERT(header.elements[e].properties[p].type == PLY::ScalarTypeOf<T>());
+        PLY::Column<T> c;
+        c.data   = file.data() + element_begin[e] + header.elements[e].properties[p].offset;
+        c.stride = header.elements[e].stride;
+        c.count  = header.elements[e].count;
+        c.swap   = swap;
+        return c;
+    }
 
+    // Reads the rows [first, first + out.size()) of a scalar property converted to T.
+    template <typename T>
+    void Read(const std::string& element, const std::string& property, ArrayView<T> out, size_t first = 0) const
+    {
+        auto [e, p] = Find(element, property);
+        ScalarTarget target = {p, PLY::ScalarTypeOf<T>(), out.data(), sizeof(T)};
+        ReadScalars(e, first, out.size(), target);
+    }
 
+    template <typename T>
+    std::vector<T> Read(const std::string& element, const std::string& property) const
+    {
+        std::vector<T> result(header.elements[Find(element, property).first].count);
+        Read<T>(element, property, result);
+        return result;
+    }
 
-    std::vector<std::pair<int, int>> offsetType;
+    // The list of row i is values[offsets[i]] ... values[offsets[i + 1] - 1].
+    template <typename T>
+    void ReadList(const std::string& element, const std::string& property, std::vector<size_t>& offsets,
+                  std::vector<T>& values) const
+    {
+        auto [e, p] = Find(element, property);
+        std::vector<char> raw;
+        ReadListRaw(e, p, PLY::ScalarTypeOf<T>(), offsets, raw);
+        values.resize(offsets.back());
+        std::memcpy(values.data(), raw.data(), values.size() * sizeof(T));
+    }
 
+    /**
+     * Vertex attributes and triangles of the 'vertex' and 'face' elements.
+     * Recognized properties:
+     *   x, y, z
+     *   nx, ny, nz
+     *   red, green, blue, alpha (integers are divided by 255)
+     *   s, t  or u, v  or texture_u, texture_v
+     *   vertex_indices or vertex_index (polygons are triangulated as a fan)
+     */
+    UnifiedMesh Mesh() const;
+
+    // Calls f(points, first) with the vertex attributes of the rows [first, first + points.NumVertices()).
+    // Only chunk_size points are in memory at the same time.
+    void StreamPoints(size_t chunk_size, const std::function<void(const UnifiedMesh&, size_t)>& f) const;
+
+   private:
+    MemoryMappedFile file;
+    PLY::Header header;
+    // Byte offset of the first row of each element
+    std::vector<size_t> element_begin;
+    bool swap = false;
+
+    bool IsBinary() const { return header.format != PLY::Format::Ascii; }
+    std::pair<int, int> Find(const std::string& element, const std::string& property) const;
+    // Destination of one scalar property
+    struct ScalarTarget
+    {
+        int property;
+        PLY::ScalarType type;
+        void* out;
+        size_t out_stride;
+    };
+    // Row and byte position behind the last read of an ascii or list element. Sequential reads continue from here
+    // instead of walking all rows in front of the range again.
+    struct RowCursor
+    {
+        size_t row = 0;
+        size_t pos = 0;
+    };
+
+    // Each row is parsed once for all targets.
+    void ReadScalars(int element, size_t first, size_t count, ArrayView<const ScalarTarget> targets,
+                     RowCursor* cursor = nullptr) const;
+    void ReadListRaw(int element, int property, PLY::ScalarType type, std::vector<size_t>& offsets,
+                     std::vector<char>& values) const;
+    void ReadPoints(size_t first, size_t count, UnifiedMesh& points, RowCursor* cursor = nullptr) const;
+};
+
+/**
+ * Streaming PLY writer.
+ * The header with all element counts is written in the constructor. The rows of the elements are then appended in
+ * header order with any number of WriteRows/WriteTriangles calls, so large point clouds can be written chunk by chunk.
+ *
+ * Usage:
+ *    PLY::Header header;
+ *    header.AddElement("vertex", n).AddProperty("x", PLY::ScalarType::Float32).AddProperty(...);
+ *    PLYWriter writer("points.ply", header);
+ *    // One column per property with the type of the property
+ *    std::vector<PLYWriter::ColumnData> columns = {{x.data(), sizeof(float)}, ...};
+ *    writer.WriteRows(n, columns);
+ */
+class SAIGA_CORE_API PLYWriter
+{
+   public:
+    struct ColumnData
+    {
+        const void* data;
+        // Bytes between two rows
+        size_t stride;
+    };
 
-    int vertexSize;
-    int dataStart;
-    std::vector<char> data;
-    std::vector<VertexProperty> vertexProperties;
+    PLYWriter(const std::string& file, const PLY::Header& header);
+    // Prints a warning if not all rows have been written.
+    ~PLYWriter();
 
-    std::string faceVertexCountType;
-    std::string faceVertexIndexType;
+    // Appends 'count' rows of the current element, which must not contain list properties.
+    void WriteRows(size_t count, ArrayView<const ColumnData> columns);
 
-    TriangleMesh<VertexNC, uint32_t> mesh;
+    // Appends triangles to the current element, which must consist of a single list property with int or uint
+    // values.
+    void WriteTriangles(ArrayView<const ivec3> triangles);
 
-    int vertexCount = -1, faceCount = -1;
+   private:
+    std::ofstream strm;
+    PLY::Header header;
+    bool swap   = false;
+    int element = 0;
+    size_t row  = 0;
+    std::vector<char> buffer;
 
-    PLYLoader(const std::string& file);
+    void NextRows(size_t count);
+    void AppendScalar(const void* value, PLY::ScalarType type);
+};
+
+// Writes position, normal, color (uchar), texture coordinates and triangles of the mesh.
+SAIGA_CORE_API void SavePLY(const std::string& file, const UnifiedMesh& mesh,
+                            PLY::Format format = PLY::Format::BinaryLittleEndian);
 
 
-    int sizeoftype(std::string t);
+namespace PLYLoaderDetail
+{
+template <typename VertexType>
+static inline int print(std::vector<std::string>& header);
+template <typename VertexType>
+static inline void write(char* ptr, VertexType v);
+};  // namespace PLYLoaderDetail
 
-    void parseHeader();
+// Loads the mesh of a PLY file with PLYReader. Vertices without color are white.
+class SAIGA_CORE_API PLYLoader
+{
+   public:
+    TriangleMesh<VertexNC, uint32_t> mesh;
 
-    void parseMeshBinary();
+    PLYLoader(const std::string& file);
 
 
     template <typename VertexType, typename IndexType>
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/core/util/assert.h"
+
+#include <atomic>
+#include <memory>
+
+namespace Saiga
+{
+/**
+ * A growable array, which is allocated in chunks of 2^CHUNK_SIZE_LOG2 elements.
+ *
+ * In contrast to std::vector, growing never moves the existing elements. Pointers and references stay valid and
+ * other threads can read elements while the pool grows. The chunk table has a fixed size, therefore
+ * EnsureCapacity() is thread safe and lock-free. All other non-const functions must be called serially.
+ *
+ * The interface is a subset of std::vector, where size() is the number of allocated (default constructed)
+ * elements.
+ */
+template <typename T, int CHUNK_SIZE_LOG2 = 10, int MAX_CHUNKS = 4096>
+class ChunkedPool
+{
+   public:
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_SIZE_LOG2;
+    static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+    ChunkedPool(size_t n = 0) : chunks(new std::atomic<T*>[MAX_CHUNKS])
+    {
+        for (int c = 0; c < MAX_CHUNKS; ++c) chunks[c] = nullptr;
+        resize(n);
+    }
+
+    ChunkedPool(const ChunkedPool& other) : ChunkedPool() { *this = other; }
+
+    ~ChunkedPool() { resize(0); }
+
+    ChunkedPool& operator=(const ChunkedPool& other)
+    {
+        if (this == &other) return *this;
+        resize(other.size());
+        for (size_t i = 0; i < size(); ++i)
+        {
+            (*this)[i] = other[i];
+        }
+        return *this;
+    }
+
+    T& operator[](size_t i) { return chunks[i >> CHUNK_SIZE_LOG2].load(std::memory_order_acquire)[i & CHUNK_MASK]; }
+    const T& operator[](size_t i) const
+    {
+        return chunks[i >> CHUNK_SIZE_LOG2].load(std::memory_order_acquire)[i & CHUNK_MASK];
+    }
+
+    T& front() { return (*this)[0]; }
+    const T& front() const { return (*this)[0]; }
+
+    size_t size() const { return num_chunks.load() * CHUNK_SIZE; }
+
+    // Makes sure that the elements [0, n) exist.
+    // Can be called concurrently with itself and with element access.
+    void EnsureCapacity(size_t n)
+    {
+        size_t needed_chunks = (n + CHUNK_SIZE - 1) >> CHUNK_SIZE_LOG2;
+        SAIGA_ASSERT(needed_chunks <= MAX_CHUNKS, "ChunkedPool is full.");
+
+        for (size_t c = num_chunks.load(); c < needed_chunks; ++c)
+        {
+            if (chunks[c].load(std::memory_order_acquire)) continue;
+            T* chunk       = new T[CHUNK_SIZE];
+            T* expected    = nullptr;
+            bool exchanged = chunks[c].compare_exchange_strong(expected, chunk, std::memory_order_acq_rel);
+            if (!exchanged)
+            {
+                // Another thread was faster
+                delete[] chunk;
+            }
+        }
+
+        // num_chunks = max(num_chunks, needed_chunks)
+        int current = num_chunks.load();
+        while (current < (int)needed_chunks && !num_chunks.compare_exchange_weak(current, needed_chunks))
+        {
+        }
+    }
+
+    // Grows or shrinks to the smallest number of chunks containing n elements.
+    void resize(size_t n)
+    {
+        EnsureCapacity(n);
+        int needed_chunks = (n + CHUNK_SIZE - 1) >> CHUNK_SIZE_LOG2;
+        for (int c = needed_chunks; c < num_chunks; ++c)
+        {
+            delete[] chunks[c].load();
+            chunks[c] = nullptr;
+        }
+        num_chunks = needed_chunks;
+    }
+
+    void clear() { resize(0); }
+
+   private:
+    std::unique_ptr<std::atomic<T*>[]> chunks;
+    std::atomic_int num_chunks = 0;
+};
+
+}  // namespace Saiga
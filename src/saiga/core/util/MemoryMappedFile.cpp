@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "MemoryMappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace Saiga
+{
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        std::swap(ptr, other.ptr);
+        std::swap(file_size, other.file_size);
+        std::swap(is_empty_file, other.is_empty_file);
+#ifdef _WIN32
+        std::swap(file_handle, other.file_handle);
+        std::swap(mapping_handle, other.mapping_handle);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MemoryMappedFile::open(const std::string& file)
+{
+    close();
+    HANDLE f = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(f, &size))
+    {
+        CloseHandle(f);
+        return false;
+    }
+    file_handle = f;
+    file_size   = size.QuadPart;
+
+    if (file_size == 0)
+    {
+        // Empty files can not be mapped
+        is_empty_file = true;
+        return true;
+    }
+
+    mapping_handle = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle)
+    {
+        close();
+        return false;
+    }
+
+    ptr = (const char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MemoryMappedFile::close()
+{
+    if (ptr) UnmapViewOfFile(ptr);
+    if (mapping_handle) CloseHandle(mapping_handle);
+    if (file_handle) CloseHandle(file_handle);
+    ptr            = nullptr;
+    mapping_handle = nullptr;
+    file_handle    = nullptr;
+    file_size      = 0;
+    is_empty_file  = false;
+}
+
+#else
+
+bool MemoryMappedFile::open(const std::string& file)
+{
+    close();
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    file_size = st.st_size;
+
+    if (file_size == 0)
+    {
+        // Empty files can not be mapped
+        ::close(fd);
+        is_empty_file = true;
+        return true;
+    }
+
+    void* p = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        file_size = 0;
+        return false;
+    }
+    ptr = (const char*)p;
+    return true;
+}
+
+void MemoryMappedFile::close()
+{
+    if (ptr) munmap((void*)ptr, file_size);
+    ptr           = nullptr;
+    file_size     = 0;
+    is_empty_file = false;
+}
+
+#endif
+
+}  // namespace Saiga
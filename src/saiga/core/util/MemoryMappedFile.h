@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+
+#include <cstddef>
+#include <string>
+
+namespace Saiga
+{
+/**
+ * Read-only memory mapping of a complete file.
+ * The pages are loaded lazily by the OS, therefore opening even very large files is cheap.
+ *
+ * Usage:
+ *
+ * MemoryMappedFile file("data.bin");
+ * if (!file) return;
+ * const Header* header = reinterpret_cast<const Header*>(file.data());
+ */
+class SAIGA_CORE_API MemoryMappedFile
+{
+   public:
+    MemoryMappedFile() {}
+    explicit MemoryMappedFile(const std::string& file) { open(file); }
+    ~MemoryMappedFile() { close(); }
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    MemoryMappedFile(MemoryMappedFile&& other) noexcept;
+    MemoryMappedFile& operator=(MemoryMappedFile&& other) noexcept;
+
+    // Returns false if the file does not exist or can not be mapped.
+    bool open(const std::string& file);
+    void close();
+
+    const char* data() const { return ptr; }
+    size_t size() const { return file_size; }
+    bool isOpen() const { return ptr != nullptr || is_empty_file; }
+
+    explicit operator bool() const { return isOpen(); }
+
+   private:
+    const char* ptr    = nullptr;
+    size_t file_size   = 0;
+    bool is_empty_file = false;
+
+#ifdef _WIN32
+    void* file_handle    = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
+
+}  // namespace Saiga
@@ -0,0 +1,243 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+
+#include "omp.h"
+#include "threadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Data-parallel loops on top of the Saiga ThreadPool.
+ *
+ * The range [begin, end) is split into chunks of 'grain_size' elements. One runner task per thread
+ * pulls chunks from a shared counter, so the load is balanced dynamically without creating a task per chunk.
+ * The calling thread also executes chunks and waits with TaskGroup::wait, therefore these functions
+ * can be nested and called from inside pool tasks without oversubscription.
+ * Threads outside of the pool only execute chunks of their own loops, because they all share one thread id
+ * (see OMP::getThreadNum).
+ *
+ * Pool selection:
+ *   - ParallelOptions::pool if set
+ *   - otherwise the globalThreadPool if it was created
+ *   - otherwise an OpenMP parallel for (or a serial loop without OpenMP)
+ *
+ * The chunk boundaries only depend on the range and the grain size, never on the number of threads.
+ * ParallelReduce and ParallelScan combine the per-chunk results in chunk order, so floating point
+ * results are reproducible for a fixed grain size.
+ *
+ * Usage:
+ *
+ * ParallelFor(0, N, [&](int i) { out[i] = f(in[i]); });
+ *
+ * double sum = ParallelReduce(0, N, 0.0, [&](int i) { return data[i]; }, std::plus<double>());
+ */
+namespace Saiga
+{
+struct ParallelOptions
+{
+    // Number of elements per chunk. <= 0 selects a size based on the range only.
+    int grain_size = 0;
+
+    // Upper bound for the number of threads working on this loop. <= 0 uses all threads of the pool.
+    int max_threads = -1;
+
+    ThreadPool* pool = nullptr;
+};
+
+namespace ParallelDetail
+{
+// Independent of the thread count to keep reductions deterministic.
+inline int DefaultGrainSize(int n)
+{
+    constexpr int target_chunks = 256;
+    return std::max(1, (n + target_chunks - 1) / target_chunks);
+}
+
+inline ThreadPool* SelectPool(const ParallelOptions& options)
+{
+    return options.pool ? options.pool : globalThreadPool.get();
+}
+
+// Calls f(chunk_id, chunk_begin, chunk_end) for every chunk.
+template <typename F>
+void ForEachChunk(int begin, int end, int grain, const ParallelOptions& options, F&& f)
+{
+    int n          = end - begin;
+    int num_chunks = (n + grain - 1) / grain;
+    auto chunk     = [&](int c) {
+        int b = begin + c * grain;
+        f(c, b, std::min(b + grain, end));
+    };
+
+    if (num_chunks == 1)
+    {
+        chunk(0);
+        return;
+    }
+
+    ThreadPool* pool = SelectPool(options);
+
+    if (!pool)
+    {
+#ifdef SAIGA_HAS_OMP
+        if (!omp_in_parallel())
+        {
+            int threads = options.max_threads > 0 ? options.max_threads : OMP::getMaxThreads();
+#    pragma omp parallel for schedule(dynamic) num_threads(threads)
+            for (int c = 0; c < num_chunks; ++c)
+            {
+                chunk(c);
+            }
+            return;
+        }
+#endif
+    }
+
+    int threads = pool ? pool->numThreads() + 1 : 1;
+    if (options.max_threads > 0) threads = std::min(threads, options.max_threads);
+    int runners = std::min(threads, num_chunks);
+
+    if (runners <= 1)
+    {
+        for (int c = 0; c < num_chunks; ++c) chunk(c);
+        return;
+    }
+
+    // Threads outside of the pool all get the thread id numThreads(). Another external thread, which picks up a runner
+    // while it helps in TaskGroup::wait, leaves the chunks to the others. The id is therefore unique among the threads
+    // executing chunks of this loop, so per-thread scratch buffers indexed by OMP::getThreadNum() are safe.
+    auto caller                 = std::this_thread::get_id();
+    std::atomic<int> next_chunk = 0;
+    auto runner                 = [&]() {
+        if (pool->currentWorkerId() < 0 && std::this_thread::get_id() != caller) return;
+        for (int c = next_chunk++; c < num_chunks; c = next_chunk++)
+        {
+            chunk(c);
+        }
+    };
+
+    TaskGroup group(pool);
+    for (int r = 1; r < runners; ++r)
+    {
+        group.run(runner);
+    }
+    runner();
+    group.wait();
+}
+}  // namespace ParallelDetail
+
+
+/**
+ * Calls f(chunk_begin, chunk_end) for disjoint sub-ranges covering [begin, end).
+ */
+template <typename F>
+void ParallelForRange(int begin, int end, F&& f, const ParallelOptions& options = {})
+{
+    if (end <= begin) return;
+    int grain = options.grain_size > 0 ? options.grain_size : ParallelDetail::DefaultGrainSize(end - begin);
+    ParallelDetail::ForEachChunk(begin, end, grain, options, [&](int, int b, int e) { f(b, e); });
+}
+
+/**
+ * Calls f(i) for all i in [begin, end).
+ */
+template <typename F>
+void ParallelFor(int begin, int end, F&& f, const ParallelOptions& options = {})
+{
+    ParallelForRange(
+        begin, end,
+        [&](int b, int e) {
+            for (int i = b; i < e; ++i) f(i);
+        },
+        options);
+}
+
+/**
+ * Computes reduce(...reduce(reduce(identity, map(begin)), map(begin+1))..., map(end-1))
+ * with one partial result per chunk.
+ * 'reduce' must be associative. The partial results are combined in chunk order.
+ */
+template <typename T, typename Map, typename Reduce>
+T ParallelReduce(int begin, int end, const T& identity, Map&& map, Reduce&& reduce, const ParallelOptions& options = {})
+{
+    // std::vector<bool> can not be written concurrently
+    static_assert(!std::is_same_v<T, bool>, "Use int or char instead of bool.");
+    if (end <= begin) return identity;
+    int n          = end - begin;
+    int grain      = options.grain_size > 0 ? options.grain_size : ParallelDetail::DefaultGrainSize(n);
+    int num_chunks = (n + grain - 1) / grain;
+
+    std::vector<T> partial(num_chunks, identity);
+    ParallelDetail::ForEachChunk(begin, end, grain, options, [&](int c, int b, int e) {
+        T acc = identity;
+        for (int i = b; i < e; ++i) acc = reduce(acc, map(i));
+        partial[c] = acc;
+    });
+
+    T result = identity;
+    for (auto& p : partial) result = reduce(result, p);
+    return result;
+}
+
+/**
+ * Prefix sum over the values in(i), i in [begin, end).
+ *
+ * out(i, value) is called once per element with
+ *   exclusive: value = in(begin) op ... op in(i-1)   (identity for i == begin)
+ *   inclusive: value = in(begin) op ... op in(i)
+ *
+ * Two passes over the input: per-chunk totals, a serial scan over the chunk totals and a
+ * second parallel pass that writes the output. in(i) must therefore be cheap and side-effect free.
+ * Returns the total over the whole range.
+ */
+template <typename T, typename In, typename Out, typename Op>
+T ParallelScan(int begin, int end, const T& identity, In&& in, Out&& out, Op&& op, bool inclusive = false,
+               const ParallelOptions& options = {})
+{
+    // std::vector<bool> can not be written concurrently
+    static_assert(!std::is_same_v<T, bool>, "Use int or char instead of bool.");
+    if (end <= begin) return identity;
+    int n          = end - begin;
+    int grain      = options.grain_size > 0 ? options.grain_size : ParallelDetail::DefaultGrainSize(n);
+    int num_chunks = (n + grain - 1) / grain;
+
+    std::vector<T> chunk_offset(num_chunks, identity);
+    ParallelDetail::ForEachChunk(begin, end, grain, options, [&](int c, int b, int e) {
+        T acc = identity;
+        for (int i = b; i < e; ++i) acc = op(acc, in(i));
+        chunk_offset[c] = acc;
+    });
+
+    // Exclusive scan over the chunk totals.
+    T total = identity;
+    for (auto& c : chunk_offset)
+    {
+        T sum = op(total, c);
+        c     = total;
+        total = sum;
+    }
+
+    ParallelDetail::ForEachChunk(begin, end, grain, options, [&](int c, int b, int e) {
+        T acc = chunk_offset[c];
+        for (int i = b; i < e; ++i)
+        {
+            T next = op(acc, in(i));
+            out(i, inclusive ? next : acc);
+            acc = next;
+        }
+    });
+    return total;
+}
+
+}  // namespace Saiga
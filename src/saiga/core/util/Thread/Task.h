@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Saiga
+{
+/**
+ * A move-only type-erased 'void()' callable with small buffer optimization.
+ *
+ * Callables which fit into the internal buffer (lambdas that capture a few pointers/references, packaged tasks, ...)
+ * are constructed in-place. Only larger callables fall back to a heap allocation.
+ * This is used as the task type of the ThreadPool, where a std::function + shared_ptr per task is too expensive.
+ *
+ * Usage:
+ *
+ * Task t([&]() { a[i] = b[i]; });
+ * t();
+ */
+class Task
+{
+   public:
+    // Large enough for a std::packaged_task and most small lambdas.
+    static constexpr size_t kBufferSize  = 48;
+    static constexpr size_t kBufferAlign = alignof(std::max_align_t);
+
+    Task() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& f)
+    {
+        using T = std::decay_t<F>;
+        if constexpr (fitsInline<T>())
+        {
+            new (&storage) T(std::forward<F>(f));
+            ops = &InlineOps<T>::table;
+        }
+        else
+        {
+            *reinterpret_cast<T**>(&storage) = new T(std::forward<F>(f));
+            ops                               = &HeapOps<T>::table;
+        }
+    }
+
+    Task(Task&& other) noexcept { moveFrom(other); }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops->invoke(&storage); }
+
+    explicit operator bool() const { return ops != nullptr; }
+
+    void reset()
+    {
+        if (ops)
+        {
+            ops->destroy(&storage);
+            ops = nullptr;
+        }
+    }
+
+    // True if a callable of type F is stored without heap allocation.
+    template <typename F>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(F) <= kBufferSize && alignof(F) <= kBufferAlign && std::is_nothrow_move_constructible_v<F>;
+    }
+
+   private:
+    struct Ops
+    {
+        void (*invoke)(void*);
+        // Move-constructs dst from src and destroys src.
+        void (*relocate)(void* dst, void* src);
+        void (*destroy)(void*);
+    };
+
+    template <typename T>
+    struct InlineOps
+    {
+        static void invoke(void* p) { (*reinterpret_cast<T*>(p))(); }
+        static void relocate(void* dst, void* src)
+        {
+            T* s = reinterpret_cast<T*>(src);
+            new (dst) T(std::move(*s));
+            s->~T();
+        }
+        static void destroy(void* p) { reinterpret_cast<T*>(p)->~T(); }
+        static constexpr Ops table = {&invoke, &relocate, &destroy};
+    };
+
+    template <typename T>
+    struct HeapOps
+    {
+        static void invoke(void* p) { (**reinterpret_cast<T**>(p))(); }
+        static void relocate(void* dst, void* src) { *reinterpret_cast<T**>(dst) = *reinterpret_cast<T**>(src); }
+        static void destroy(void* p) { delete *reinterpret_cast<T**>(p); }
+        static constexpr Ops table = {&invoke, &relocate, &destroy};
+    };
+
+    void moveFrom(Task& other)
+    {
+        if (other.ops)
+        {
+            other.ops->relocate(&storage, &other.storage);
+            ops       = other.ops;
+            other.ops = nullptr;
+        }
+    }
+
+    std::aligned_storage_t<kBufferSize, kBufferAlign> storage;
+    const Ops* ops = nullptr;
+};
+
+}  // namespace Saiga
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+
+#include "SpinLock.h"
+#include "Task.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Saiga
+{
+/**
+ * The per-worker task deque of the ThreadPool.
+ *
+ * The owner pushes and pops at the back (LIFO, good cache locality for nested tasks),
+ * other workers steal from the front (FIFO, oldest and usually largest tasks first).
+ *
+ * Internally this is a growable ring buffer protected by a SpinLock.
+ * The critical sections are only a few instructions long and the lock is almost never contended,
+ * because every worker operates on its own queue most of the time.
+ * The ring buffer only reallocates if it runs full, so a steady state push/pop does not allocate.
+ */
+class SAIGA_ALIGN_CACHE WorkStealingQueue
+{
+   public:
+    explicit WorkStealingQueue(size_t initial_capacity = 256) : buffer(initial_capacity) {}
+
+    void push(Task&& task)
+    {
+        std::unique_lock l(lock);
+        if (count == buffer.size())
+        {
+            grow();
+        }
+        buffer[(head + count) % buffer.size()] = std::move(task);
+        count++;
+        approx_size.store(count, std::memory_order_relaxed);
+    }
+
+    // Owner side. Returns false if the queue is empty.
+    bool pop(Task& task)
+    {
+        if (approx_size.load(std::memory_order_relaxed) == 0) return false;
+        std::unique_lock l(lock);
+        if (count == 0) return false;
+        count--;
+        task = std::move(buffer[(head + count) % buffer.size()]);
+        approx_size.store(count, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Thief side. Returns false if the queue is empty or currently locked by another thread.
+    bool steal(Task& task)
+    {
+        if (approx_size.load(std::memory_order_relaxed) == 0) return false;
+        std::unique_lock l(lock, std::try_to_lock);
+        if (!l.owns_lock() || count == 0) return false;
+        task = std::move(buffer[head]);
+        head = (head + 1) % buffer.size();
+        count--;
+        approx_size.store(count, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t size() const { return approx_size.load(std::memory_order_relaxed); }
+
+   private:
+    void grow()
+    {
+        std::vector<Task> new_buffer(buffer.size() * 2);
+        for (size_t i = 0; i < count; ++i)
+        {
+            new_buffer[i] = std::move(buffer[(head + i) % buffer.size()]);
+        }
+        buffer.swap(new_buffer);
+        head = 0;
+    }
+
+    SpinLock lock;
+    std::vector<Task> buffer;
+    size_t head  = 0;
+    size_t count = 0;
+    // Read without the lock for a fast empty check.
+    std::atomic<size_t> approx_size = 0;
+};
+
+}  // namespace Saiga
@@ -13,6 +13,13 @@
 #endif
 
 #include "saiga/core/util/env.h"
+
+#ifdef SAIGA_OMP_THREADPOOL
+#    include "threadPool.h"
+
+#    include <algorithm>
+#endif
+
 /**
  * This is a preprocessor wrapper for openmp.
  * With that we can make sure code runs with and without openmp.
@@ -23,8 +30,28 @@ namespace Saiga
 {
 namespace OMP
 {
+#ifdef SAIGA_OMP_THREADPOOL
+/**
+ * With SAIGA_OMP_THREADPOOL the helpers below describe the global thread pool when they are called
+ * outside of an OpenMP parallel region. The thread count is then the number of workers + 1,
+ * because the thread that calls ParallelFor also executes chunks. All external threads share the id
+ * numThreads(). ParallelFor lets only the calling external thread execute chunks of a loop, so this id is used
+ * by at most one thread per loop. Inside an OpenMP region they still return the OpenMP values.
+ */
+inline bool UseThreadPool()
+{
+#    ifdef SAIGA_HAS_OMP
+    if (omp_in_parallel()) return false;
+#    endif
+    return globalThreadPool != nullptr;
+}
+#endif
+
 inline int getMaxThreads()
 {
+#ifdef SAIGA_OMP_THREADPOOL
+    if (UseThreadPool()) return globalThreadPool->numThreads() + 1;
+#endif
 #ifdef SAIGA_HAS_OMP
     return omp_get_max_threads();
 #else
@@ -34,6 +61,13 @@ inline int getMaxThreads()
 
 inline int getThreadNum()
 {
+#ifdef SAIGA_OMP_THREADPOOL
+    if (UseThreadPool())
+    {
+        int id = globalThreadPool->currentWorkerId();
+        return id >= 0 ? id : globalThreadPool->numThreads();
+    }
+#endif
 #ifdef SAIGA_HAS_OMP
     return omp_get_thread_num();
 #else
@@ -43,6 +77,9 @@ inline int getThreadNum()
 
 inline int getNumThreads()
 {
+#ifdef SAIGA_OMP_THREADPOOL
+    if (UseThreadPool()) return globalThreadPool->numThreads() + 1;
+#endif
 #ifdef SAIGA_HAS_OMP
     return omp_get_num_threads();
 #else
@@ -56,6 +93,14 @@ inline void setNumThreads(int t)
     omp_set_num_threads(t);
 #else
 #endif
+#ifdef SAIGA_OMP_THREADPOOL
+    // Resize the global pool. Must not be called from inside a task of that pool.
+    if (!globalThreadPool || globalThreadPool->numThreads() + 1 != t)
+    {
+        globalThreadPool.reset();
+        createGlobalThreadPool(std::max(t - 1, 0));
+    }
+#endif
 }
 
 
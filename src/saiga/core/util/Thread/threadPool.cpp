@@ -32,30 +32,24 @@
 
 namespace Saiga
 {
-ThreadPool::ThreadPool(size_t threads, const std::string& name) : name(name), stop(false)
+// The pool and worker id of the current thread.
+// Used to push nested tasks into the local queue of a worker.
+static thread_local const ThreadPool* tl_pool = nullptr;
+static thread_local int tl_worker_id          = -1;
+
+// Number of failed search rounds before an idle worker goes to sleep.
+static constexpr int kSpinRounds = 64;
+
+ThreadPool::ThreadPool(size_t threads, const std::string& name) : name(name)
 {
-    workingThreads = threads;
+    for (size_t i = 0; i < threads + 1; ++i)
+    {
+        queues.push_back(std::make_unique<WorkStealingQueue>());
+    }
+
     for (size_t i = 0; i < threads; ++i)
     {
-        workers.emplace_back([this, i, name] {
-            setThreadName(name + std::to_string(i));
-            for (;;)
-            {
-                std::function<void()> task;
-
-                {
-                    std::unique_lock<std::mutex> lock(this->queue_mutex);
-                    workingThreads--;
-                    this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
-                    if (this->stop && this->tasks.empty()) return;
-                    workingThreads++;
-                    task = std::move(this->tasks.front());
-                    this->tasks.pop();
-                }
-
-                task();
-            }
-        });
+        workers.emplace_back([this, i] { workerMain(i); });
     }
 }
 
@@ -67,7 +61,7 @@ ThreadPool::~ThreadPool()
 void ThreadPool::quit()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         if (stop) return;
         stop = true;
     }
@@ -76,6 +70,177 @@ void ThreadPool::quit()
     workers.clear();
 }
 
+int ThreadPool::currentWorkerId() const
+{
+    return tl_pool == this ? tl_worker_id : -1;
+}
+
+void ThreadPool::push(Task&& task)
+{
+    if (workers.empty())
+    {
+        // This is an empty thread pool
+        // -> execute this task here without adding it to the queue
+        // -> emulate single threaded behaviour
+        task();
+        return;
+    }
+
+    int id = currentWorkerId();
+    if (id < 0)
+    {
+        // don't allow enqueueing from the outside after stopping the pool
+        // (workers can still add nested tasks during shutdown)
+        if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
+        id = workers.size();
+    }
+
+    // Increment before pushing, so that pending never underflows if the task is stolen immediately.
+    pending++;
+    queues[id]->push(std::move(task));
+
+    // The sequentially consistent pending/sleeping pair makes sure that either the sleeping worker sees the new task
+    // in its wait predicate or we see the sleeping worker here.
+    if (sleeping.load() > 0)
+    {
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+        }
+        condition.notify_one();
+    }
+}
+
+bool ThreadPool::findTask(int worker_id, Task& task)
+{
+    int num_queues = queues.size();
+    int injection  = num_queues - 1;
+
+    // 1. Own queue (LIFO)
+    if (worker_id >= 0 && queues[worker_id]->pop(task)) return true;
+
+    // 2. Tasks from external threads (FIFO)
+    if (queues[injection]->steal(task)) return true;
+
+    // 3. Steal from the other workers, starting at the right neighbour.
+    int start = worker_id >= 0 ? worker_id + 1 : 0;
+    for (int i = 0; i < injection; ++i)
+    {
+        int victim = (start + i) % injection;
+        if (victim == worker_id) continue;
+        if (queues[victim]->steal(task)) return true;
+    }
+    return false;
+}
+
+bool ThreadPool::tryRunPendingTask()
+{
+    if (pending.load() == 0) return false;
+
+    Task task;
+    if (!findTask(currentWorkerId(), task)) return false;
+    pending--;
+    task();
+    return true;
+}
+
+void ThreadPool::workerMain(int worker_id)
+{
+    setThreadName(name + std::to_string(worker_id));
+    tl_pool      = this;
+    tl_worker_id = worker_id;
+
+    Task task;
+    int failed_rounds = 0;
+    for (;;)
+    {
+        if (findTask(worker_id, task))
+        {
+            pending--;
+            workingThreads++;
+            task();
+            task.reset();
+            workingThreads--;
+            failed_rounds = 0;
+            continue;
+        }
+
+        if (pending.load() > 0 || failed_rounds < kSpinRounds)
+        {
+            // Either a queue is currently locked by another thread or new work might arrive soon.
+            yield(failed_rounds++);
+            continue;
+        }
+
+        sleeping++;
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            condition.wait(lock, [this] { return stop || pending.load() > 0; });
+        }
+        sleeping--;
+        failed_rounds = 0;
+
+        if (stop && pending.load() == 0) break;
+    }
+
+    tl_pool      = nullptr;
+    tl_worker_id = -1;
+}
+
+TaskGroup::~TaskGroup()
+{
+    // Never throw from the destructor. Exceptions are only reported in wait().
+    helpUntilDone();
+}
+
+void TaskGroup::addPending()
+{
+    for (TaskGroup* g = this; g; g = g->parent)
+    {
+        g->pending++;
+    }
+}
+
+void TaskGroup::finishOne()
+{
+    // Read the parent before decrementing, because the waiting thread might destroy this group immediately after.
+    TaskGroup* p = parent;
+    pending--;
+    if (p) p->finishOne();
+}
+
+void TaskGroup::setException(std::exception_ptr e)
+{
+    std::unique_lock<std::mutex> lock(exception_mutex);
+    if (!exception) exception = e;
+}
+
+void TaskGroup::helpUntilDone()
+{
+    for (unsigned k = 0; pending.load() > 0;)
+    {
+        if (pool && pool->tryRunPendingTask())
+        {
+            k = 0;
+        }
+        else
+        {
+            yield(k++);
+        }
+    }
+}
+
+void TaskGroup::wait()
+{
+    helpUntilDone();
+
+    std::exception_ptr e;
+    {
+        std::unique_lock<std::mutex> lock(exception_mutex);
+        std::swap(e, exception);
+    }
+    if (e) std::rethrow_exception(e);
+}
+
 std::unique_ptr<ThreadPool> globalThreadPool;
 
 void createGlobalThreadPool(int threads)
@@ -83,7 +248,7 @@ void createGlobalThreadPool(int threads)
     if (threads < 0)
     {
 #if defined(_OPENMP)
-        threads = omp_get_thread_num();
+        threads = omp_get_max_threads();
 #else
         threads = std::thread::hardware_concurrency();
         if (threads <= 0)
@@ -27,19 +27,39 @@
 
 #include "saiga/config.h"
 
+#include "SpinLock.h"
+#include "Task.h"
+#include "WorkStealingQueue.h"
+
+#include <atomic>
+#include <exception>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <stdexcept>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 #include <condition_variable>
 
 namespace Saiga
 {
+/**
+ * A work-stealing thread pool.
+ *
+ * Every worker owns a deque of tasks. Tasks spawned from inside a worker are pushed to the back of its own deque
+ * and popped again in LIFO order. Idle workers steal from the front of the other deques.
+ * Tasks submitted from external threads go into a separate injection queue, which is processed in FIFO order.
+ *
+ * Tasks are stored as 'Task' objects, which avoid a heap allocation for small callables.
+ * Use 'schedule' for fire-and-forget tasks (cheapest), 'enqueue' if a std::future is required
+ * and 'TaskGroup' for fork-join parallelism.
+ *
+ * Exceptions thrown by tasks submitted with 'schedule' terminate the program. Use 'enqueue' or a 'TaskGroup'
+ * to propagate them to the caller.
+ */
 class SAIGA_CORE_API ThreadPool
 {
    public:
@@ -47,70 +67,156 @@ class SAIGA_CORE_API ThreadPool
     ~ThreadPool();
 
     template <class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type>;
+    auto enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>;
+
+    // Adds a task without creating a future.
+    template <class F>
+    void schedule(F&& f);
 
     void quit();
 
-    size_t queueSize()
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        return tasks.size();
-    }
-    size_t getWorkingThreads() { return workingThreads; }
+    // Number of tasks that are waiting for execution.
+    size_t queueSize() { return pending.load(); }
+    size_t getWorkingThreads() { return workingThreads.load(); }
+    size_t numThreads() const { return workers.size(); }
+
+    // Id of the calling thread inside this pool or -1 if it is not a worker of this pool.
+    int currentWorkerId() const;
+
+    /**
+     * Executes one pending task on the calling thread.
+     * Returns false if no task was found.
+     * Used by TaskGroup::wait to help instead of blocking.
+     */
+    bool tryRunPendingTask();
 
    private:
-    // number of currently working threads
-    size_t workingThreads = 0;
+    void push(Task&& task);
+    bool findTask(int worker_id, Task& task);
+    void workerMain(int worker_id);
+
     std::string name;
-    // need to keep track of threads so we can join them
     std::vector<std::thread> workers;
-    // the task queue
-    std::queue<std::function<void()> > tasks;
 
-    // synchronization
-    std::mutex queue_mutex;
+    // One queue per worker + one injection queue for external threads at the end.
+    std::vector<std::unique_ptr<WorkStealingQueue>> queues;
+
+    // Number of tasks in all queues.
+    std::atomic<size_t> pending = 0;
+    // Number of threads currently executing a task.
+    std::atomic<size_t> workingThreads = 0;
+    // Number of threads waiting on the condition variable.
+    std::atomic<int> sleeping = 0;
+    std::atomic<bool> stop    = false;
+
+    std::mutex sleep_mutex;
     std::condition_variable condition;
-    bool stop;
 };
 
 template <class F, class... Args>
-auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type>
+auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>
 {
-    using return_type = typename std::result_of<F(Args...)>::type;
+    using return_type = std::invoke_result_t<F, Args...>;
 
+    std::packaged_task<return_type()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    std::future<return_type> res = task.get_future();
+
+    // The packaged task is small enough to be stored inside the task buffer.
+    push(Task(std::move(task)));
+    return res;
+}
 
-    auto task = std::make_shared<std::packaged_task<return_type()> >(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-    std::future<return_type> res = task->get_future();
+template <class F>
+void ThreadPool::schedule(F&& f)
+{
+    push(Task(std::forward<F>(f)));
+}
 
 
-    if (workers.size() == 0)
-    {
-        // This is an empty thread pool
-        // -> execute this task here without adding it to the queue
-        // -> emulate single threaded behaviour
-        (*task)();
-        return res;
-    }
+/**
+ * A group of tasks that can be waited on.
+ *
+ * wait() does not block the calling thread. Instead, it executes pending tasks of the pool
+ * until all tasks of this group are finished. Therefore it is safe to create and wait on task groups
+ * inside a task (nested parallelism) without deadlocking the pool.
+ *
+ * A group can have a parent. Tasks of the child also count as tasks of the parent, so
+ * waiting on the parent also waits for all children.
+ *
+ * The first exception thrown by a task is rethrown in wait().
+ *
+ * Usage:
+ *
+ * TaskGroup group(globalThreadPool.get());
+ * for (int i = 0; i < 10; ++i)
+ * {
+ *     group.run([&, i]() { work(i); });
+ * }
+ * group.wait();
+ */
+class SAIGA_CORE_API TaskGroup
+{
+   public:
+    // If pool is null the tasks are executed directly in run().
+    explicit TaskGroup(ThreadPool* pool, TaskGroup* parent = nullptr) : pool(pool), parent(parent) {}
+    ~TaskGroup();
 
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
 
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+    template <typename F>
+    void run(F&& f);
+
+    void wait();
 
-        // don't allow enqueueing after stopping the pool
-        if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
+    // Number of tasks of this group (including children) which are not finished yet.
+    int numPending() const { return pending.load(); }
 
-        tasks.emplace([task]() { (*task)(); });
+   private:
+    void addPending();
+    void finishOne();
+    void setException(std::exception_ptr e);
+    void helpUntilDone();
+
+    ThreadPool* pool;
+    TaskGroup* parent;
+    std::atomic<int> pending = 0;
+
+    std::mutex exception_mutex;
+    std::exception_ptr exception;
+};
+
+template <typename F>
+void TaskGroup::run(F&& f)
+{
+    addPending();
+    auto task = [this, f = std::forward<F>(f)]() mutable {
+        try
+        {
+            f();
+        }
+        catch (...)
+        {
+            setException(std::current_exception());
+        }
+        finishOne();
+    };
+
+    if (pool)
+    {
+        pool->schedule(std::move(task));
+    }
+    else
+    {
+        task();
     }
-    condition.notify_one();
-    return res;
 }
 
 /**
  * A global thread pool that can be used from everywhere.
  * Create it at the beginning with createGlobalThreadPool.
  *
- * -1 initializes the thread count with omp_get_thread_num
+ * -1 initializes the thread count with omp_get_max_threads
  */
 extern SAIGA_CORE_API std::unique_ptr<ThreadPool> globalThreadPool;
 extern SAIGA_CORE_API void createGlobalThreadPool(int threads = -1);
@@ -37,6 +37,62 @@ std::string concat(const std::vector<std::string>& s, char delim)
     return res;
 }
 
+#ifdef SAIGA_HAS_STRING_VIEW
+double to_double(const std::string_view& str)
+{
+    // [sign] digits [. digits] [(e|E) [sign] digits]
+    const char* p   = str.data();
+    const char* end = p + str.size();
+
+    bool negative = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+')) ++p;
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any_digit = false;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p)
+    {
+        any_digit = true;
+        if (mantissa == 0 && *p == '0') continue;
+        mantissa = mantissa * 10 + (*p - '0');
+        digits++;
+    }
+    if (p != end && *p == '.')
+    {
+        for (++p; p != end && *p >= '0' && *p <= '9'; ++p)
+        {
+            any_digit = true;
+            exponent--;
+            if (mantissa == 0 && *p == '0') continue;
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+        }
+    }
+    if (any_digit && p != end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool negative_exp = p != end && *p == '-';
+        if (p != end && (*p == '-' || *p == '+')) ++p;
+        int e = 0;
+        if (p == end || *p < '0' || *p > '9') e = 1000;
+        for (; p != end && *p >= '0' && *p <= '9' && e < 1000; ++p) e = e * 10 + (*p - '0');
+        exponent += negative_exp ? -e : e;
+    }
+
+    // Both the mantissa and the power of ten are exact doubles, therefore a single multiplication or division is
+    // correctly rounded. Everything else (hex, inf, trailing characters, ...) is left to atof.
+    static constexpr double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (!any_digit || p != end || digits > 19 || mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+    {
+        return std::atof(std::string(str).c_str());
+    }
+    double d = double(mantissa);
+    d        = exponent < 0 ? d / powers[-exponent] : d * powers[exponent];
+    return negative ? -d : d;
+}
+#endif
+
 std::string leadingZeroString(int number, int characterCount)
 {
     std::string n = Saiga::to_string(number);
@@ -108,16 +108,9 @@ inline int to_int(const std::string& str)
 }
 
 #ifdef SAIGA_HAS_STRING_VIEW
-inline double to_double(const std::string_view& str)
-{
-#    if 0
-    double d;
-    std::from_chars(str.data(),str.data()+str.size(),d);
-    return d;
-#    else
-    return std::atof(std::string(str).c_str());
-#    endif
-}
+// Same result as std::atof.
+// Plain decimal numbers with at most 19 significant digits are converted without a temporary string.
+SAIGA_CORE_API double to_double(const std::string_view& str);
 
 inline double to_long(const std::string_view& str)
 {
@@ -8,54 +8,432 @@
 
 #include "saiga/core/util/assert.h"
 
+#include <cstring>
+
 #ifdef SAIGA_USE_ZLIB
 #    include <zlib.h>
 namespace Saiga
 {
-constexpr size_t header_size = 3 * sizeof(size_t);
-constexpr size_t magic_value = 0x6712956A9725DEUL;
+constexpr size_t header_size         = 3 * sizeof(size_t);
+constexpr size_t chunk_header_size   = 2 * sizeof(size_t);
+constexpr size_t magic_value         = 0x6712956A9725DEUL;
+constexpr size_t chunked_magic_value = 0x6712956A9725DFUL;
+
+// The chunk headers are not aligned -> use memcpy
+static size_t ReadValue(const Byte* data)
+{
+    size_t value;
+    memcpy(&value, data, sizeof(size_t));
+    return value;
+}
+
+static Byte* WriteValue(Byte* data, size_t value)
+{
+    memcpy(data, &value, sizeof(size_t));
+    return data + sizeof(size_t);
+}
+
+// Number of chunks which are compressed together by the streaming classes.
+static size_t ChunksPerBatch(const ParallelOptions& options)
+{
+    int threads = options.max_threads > 0 ? options.max_threads : OMP::getMaxThreads();
+    return std::max(2 * threads, 1);
+}
+
+// Compresses the chunks of [data, data + size) in parallel.
+// Each result starts with the chunk header.
+static std::vector<std::vector<Byte>> CompressChunks(const Byte* data, size_t size, size_t chunk_size,
+                                                     const ParallelOptions& options)
+{
+    int num_chunks = (size + chunk_size - 1) / chunk_size;
+    std::vector<std::vector<Byte>> chunks(num_chunks);
+
+    ParallelOptions chunk_options = options;
+    chunk_options.grain_size      = 1;
+    ParallelFor(
+        0, num_chunks,
+        [&](int c) {
+            size_t begin = c * chunk_size;
+            size_t n     = std::min(chunk_size, size - begin);
+
+            auto& chunk            = chunks[c];
+            uLongf compressed_size = compressBound(n);
+            chunk.resize(chunk_header_size + compressed_size);
+            int status = ::compress(chunk.data() + chunk_header_size, &compressed_size, data + begin, n);
+            SAIGA_ASSERT(status == Z_OK);
+
+            WriteValue(WriteValue(chunk.data(), compressed_size), n);
+            chunk.resize(chunk_header_size + compressed_size);
+        },
+        chunk_options);
+    return chunks;
+}
+
+// 'chunk' points to the chunk header.
+static void UncompressChunk(const Byte* chunk, Byte* out, size_t expected_size)
+{
+    size_t compressed_size   = ReadValue(chunk);
+    size_t decompressed_size = ReadValue(chunk + sizeof(size_t));
+    SAIGA_ASSERT(decompressed_size == expected_size);
+
+    uLongf actual_out_size = decompressed_size;
+    int status             = ::uncompress(out, &actual_out_size, chunk + chunk_header_size, compressed_size);
+    SAIGA_ASSERT(status == Z_OK && actual_out_size == decompressed_size);
+}
+
+// Uncompresses consecutive chunks in parallel. The first chunk is written to out, the second to out + chunk_size, ...
+static void UncompressChunks(const std::vector<const Byte*>& chunks, Byte* out, size_t chunk_size,
+                             size_t decompressed_size, const ParallelOptions& options)
+{
+    ParallelOptions chunk_options = options;
+    chunk_options.grain_size      = 1;
+    ParallelFor(
+        0, (int)chunks.size(),
+        [&](int c) {
+            size_t begin = c * chunk_size;
+            UncompressChunk(chunks[c], out + begin, std::min(chunk_size, decompressed_size - begin));
+        },
+        chunk_options);
+}
+
+// The offsets of all chunks of an in-memory container.
+static std::vector<size_t> ChunkOffsets(const Byte* data, size_t& decompressed_size)
+{
+    std::vector<size_t> chunk_offsets;
+    size_t index_offset = ReadValue(data + 2 * sizeof(size_t));
+    if (index_offset != 0)
+    {
+        size_t num_chunks = ReadValue(data + index_offset);
+        decompressed_size = ReadValue(data + index_offset + sizeof(size_t));
+        chunk_offsets.resize(num_chunks);
+        memcpy(chunk_offsets.data(), data + index_offset + 2 * sizeof(size_t), num_chunks * sizeof(size_t));
+        return chunk_offsets;
+    }
+
+    // The container was written to a stream, which is not seekable -> scan the chunk headers.
+    decompressed_size = 0;
+    size_t offset     = header_size;
+    while (size_t compressed_size = ReadValue(data + offset))
+    {
+        chunk_offsets.push_back(offset);
+        decompressed_size += ReadValue(data + offset + sizeof(size_t));
+        offset += chunk_header_size + compressed_size;
+    }
+    return chunk_offsets;
+}
 
-std::vector<unsigned char> compress(const void* data, size_t decompressed_data_size)
+std::vector<unsigned char> compress(const void* data, size_t decompressed_data_size, size_t chunk_size,
+                                    const ParallelOptions& options)
 {
-    size_t c_bounds = compressBound(decompressed_data_size);
+    SAIGA_ASSERT(chunk_size > 0);
+    auto chunks = CompressChunks((const Byte*)data, decompressed_data_size, chunk_size, options);
+
+    size_t num_chunks = chunks.size();
+    std::vector<size_t> chunk_offsets(num_chunks);
+    size_t offset = header_size;
+    for (size_t c = 0; c < num_chunks; ++c)
+    {
+        chunk_offsets[c] = offset;
+        offset += chunks[c].size();
+    }
+    size_t index_offset = offset + chunk_header_size;
 
-    std::vector<Byte> result(c_bounds + header_size);
-    size_t* out_header = (size_t*)result.data();
-    Byte* out_data     = result.data() + header_size;
+    std::vector<Byte> result(index_offset + (2 + num_chunks) * sizeof(size_t));
 
-    uLongf compressed_data_size = c_bounds;
-    ::compress(out_data, &compressed_data_size, (const Byte*)data, decompressed_data_size);
+    // Header
+    WriteValue(WriteValue(WriteValue(result.data(), chunked_magic_value), chunk_size), index_offset);
 
-    // Write header
-    out_header[0] = magic_value;
-    out_header[1] = compressed_data_size;
-    out_header[2] = decompressed_data_size;
+    ParallelFor(
+        0, (int)num_chunks,
+        [&](int c) { memcpy(result.data() + chunk_offsets[c], chunks[c].data(), chunks[c].size()); }, options);
 
-    result.resize(compressed_data_size + header_size);
+    // End marker + index
+    Byte* out = WriteValue(WriteValue(result.data() + offset, 0), 0);
+    out       = WriteValue(WriteValue(out, num_chunks), decompressed_data_size);
+    memcpy(out, chunk_offsets.data(), num_chunks * sizeof(size_t));
     return result;
 }
 
-std::vector<unsigned char> uncompress(const void* data)
+std::vector<unsigned char> uncompress(const void* data, const ParallelOptions& options)
 {
-    const Byte* bdata           = (const Byte*)data;
-    const size_t* header        = (const size_t*)bdata;
-    const Byte* compressed_data = bdata + header_size;
+    const Byte* bdata = (const Byte*)data;
+    size_t magic      = ReadValue(bdata);
 
-    // Read Header
-    SAIGA_ASSERT(header[0] == magic_value);
-    size_t compressed_data_size   = header[1];
-    size_t decompressed_data_size = header[2];
+    if (magic == magic_value)
+    {
+        // Single stream format
+        const size_t* header        = (const size_t*)bdata;
+        const Byte* compressed_data = bdata + header_size;
 
+        size_t compressed_data_size   = header[1];
+        size_t decompressed_data_size = header[2];
 
-    std::vector<unsigned char> result(decompressed_data_size);
-    uLongf actual_out_size = decompressed_data_size;
-    ::uncompress(result.data(), &actual_out_size, compressed_data, compressed_data_size);
+        std::vector<unsigned char> result(decompressed_data_size);
+        uLongf actual_out_size = decompressed_data_size;
+        ::uncompress(result.data(), &actual_out_size, compressed_data, compressed_data_size);
 
-    SAIGA_ASSERT(actual_out_size == decompressed_data_size);
+        SAIGA_ASSERT(actual_out_size == decompressed_data_size);
+        return result;
+    }
 
+    SAIGA_ASSERT(magic == chunked_magic_value);
+    size_t chunk_size = ReadValue(bdata + sizeof(size_t));
+    size_t decompressed_data_size;
+    auto chunk_offsets = ChunkOffsets(bdata, decompressed_data_size);
+
+    std::vector<const Byte*> chunks;
+    for (auto o : chunk_offsets) chunks.push_back(bdata + o);
+
+    std::vector<unsigned char> result(decompressed_data_size);
+    UncompressChunks(chunks, result.data(), chunk_size, decompressed_data_size, options);
     return result;
 }
 
+std::vector<unsigned char> uncompressRange(const void* data, size_t offset, size_t size,
+                                           const ParallelOptions& options)
+{
+    const Byte* bdata = (const Byte*)data;
+    SAIGA_ASSERT(ReadValue(bdata) == chunked_magic_value, "uncompressRange requires a chunked container.");
+    size_t chunk_size = ReadValue(bdata + sizeof(size_t));
+    size_t decompressed_data_size;
+    auto chunk_offsets = ChunkOffsets(bdata, decompressed_data_size);
+
+    SAIGA_ASSERT(offset + size <= decompressed_data_size);
+    if (size == 0) return {};
+
+    size_t first_chunk = offset / chunk_size;
+    size_t last_chunk  = (offset + size - 1) / chunk_size;
+
+    std::vector<const Byte*> chunks;
+    for (size_t c = first_chunk; c <= last_chunk; ++c) chunks.push_back(bdata + chunk_offsets[c]);
+
+    size_t first_byte = first_chunk * chunk_size;
+    std::vector<unsigned char> tmp(std::min(chunks.size() * chunk_size, decompressed_data_size - first_byte));
+    UncompressChunks(chunks, tmp.data(), chunk_size, decompressed_data_size - first_byte, options);
+
+    auto begin = tmp.begin() + (offset - first_byte);
+    return std::vector<unsigned char>(begin, begin + size);
+}
+
+CompressedOutputStream::CompressedOutputStream(std::ostream& strm, size_t chunk_size, const ParallelOptions& options)
+    : strm(strm), chunk_size(chunk_size), chunks_per_batch(ChunksPerBatch(options)), options(options)
+{
+    SAIGA_ASSERT(chunk_size > 0);
+    start = strm.tellp();
+
+    // The index offset is updated in Close()
+    Byte header[header_size];
+    WriteValue(WriteValue(WriteValue(header, chunked_magic_value), chunk_size), 0);
+    strm.write((const char*)header, header_size);
+    offset = header_size;
+}
+
+CompressedOutputStream::~CompressedOutputStream()
+{
+    Close();
+}
+
+void CompressedOutputStream::Write(const void* data, size_t size)
+{
+    SAIGA_ASSERT(!closed);
+    const Byte* ptr    = (const Byte*)data;
+    size_t batch_bytes = chunk_size * chunks_per_batch;
+    while (size > 0)
+    {
+        size_t n = std::min(size, batch_bytes - buffer.size());
+        buffer.insert(buffer.end(), ptr, ptr + n);
+        ptr += n;
+        size -= n;
+        if (buffer.size() == batch_bytes) CompressBuffer();
+    }
+}
+
+void CompressedOutputStream::CompressBuffer()
+{
+    auto chunks = CompressChunks(buffer.data(), buffer.size(), chunk_size, options);
+    for (auto& chunk : chunks)
+    {
+        chunk_offsets.push_back(offset);
+        strm.write((const char*)chunk.data(), chunk.size());
+        offset += chunk.size();
+    }
+    decompressed_size += buffer.size();
+    buffer.clear();
+}
+
+void CompressedOutputStream::Close()
+{
+    if (closed) return;
+    closed = true;
+    if (!buffer.empty()) CompressBuffer();
+
+    // End marker + index
+    size_t index_offset = offset + chunk_header_size;
+    std::vector<Byte> index((4 + chunk_offsets.size()) * sizeof(size_t));
+    Byte* out = WriteValue(WriteValue(index.data(), 0), 0);
+    out       = WriteValue(WriteValue(out, chunk_offsets.size()), decompressed_size);
+    memcpy(out, chunk_offsets.data(), chunk_offsets.size() * sizeof(size_t));
+    strm.write((const char*)index.data(), index.size());
+
+    if (start != std::streampos(-1))
+    {
+        auto end = strm.tellp();
+        Byte value[sizeof(size_t)];
+        WriteValue(value, index_offset);
+        strm.seekp(start + std::streamoff(2 * sizeof(size_t)));
+        strm.write((const char*)value, sizeof(size_t));
+        strm.seekp(end);
+    }
+    SAIGA_ASSERT(strm.good());
+}
+
+CompressedInputStream::CompressedInputStream(std::istream& strm, const ParallelOptions& options)
+    : strm(strm), chunks_per_batch(ChunksPerBatch(options)), options(options)
+{
+    start = strm.tellg();
+
+    Byte header[header_size];
+    strm.read((char*)header, header_size);
+    SAIGA_ASSERT(strm.good() && ReadValue(header) == chunked_magic_value, "Invalid compressed stream.");
+    chunk_size   = ReadValue(header + sizeof(size_t));
+    index_offset = ReadValue(header + 2 * sizeof(size_t));
+}
+
+bool CompressedInputStream::ReadBatch()
+{
+    if (end_of_data) return false;
+
+    std::vector<std::vector<Byte>> chunks;
+    size_t batch_size = 0;
+    while (chunks.size() < chunks_per_batch)
+    {
+        Byte chunk_header[chunk_header_size];
+        strm.read((char*)chunk_header, chunk_header_size);
+        SAIGA_ASSERT(strm.good());
+        size_t compressed_size = ReadValue(chunk_header);
+        if (compressed_size == 0)
+        {
+            end_of_data = true;
+            break;
+        }
+
+        std::vector<Byte> chunk(chunk_header_size + compressed_size);
+        memcpy(chunk.data(), chunk_header, chunk_header_size);
+        strm.read((char*)chunk.data() + chunk_header_size, compressed_size);
+        SAIGA_ASSERT(strm.good());
+        batch_size += ReadValue(chunk_header + sizeof(size_t));
+        chunks.push_back(std::move(chunk));
+    }
+
+    std::vector<const Byte*> chunk_ptrs;
+    for (auto& c : chunks) chunk_ptrs.push_back(c.data());
+
+    // All chunks except the last one of the container are full -> the offsets inside the batch are c * chunk_size
+    buffer.resize(batch_size);
+    UncompressChunks(chunk_ptrs, buffer.data(), chunk_size, batch_size, options);
+    buffer_position = 0;
+    return !chunks.empty();
+}
+
+size_t CompressedInputStream::Read(void* data, size_t size)
+{
+    Byte* out   = (Byte*)data;
+    size_t read = 0;
+    while (read < size)
+    {
+        if (buffer_position == buffer.size() && !ReadBatch()) break;
+
+        size_t n = std::min(size - read, buffer.size() - buffer_position);
+        memcpy(out + read, buffer.data() + buffer_position, n);
+        buffer_position += n;
+        read += n;
+    }
+    return read;
+}
+
+void CompressedInputStream::LoadIndex()
+{
+    if (index_loaded) return;
+    index_loaded = true;
+
+    auto position = strm.tellg();
+    SAIGA_ASSERT(position != std::streampos(-1), "Random access requires a seekable stream.");
+
+    if (index_offset != 0)
+    {
+        Byte index_header[2 * sizeof(size_t)];
+        strm.seekg(start + std::streamoff(index_offset));
+        strm.read((char*)index_header, sizeof(index_header));
+        size_t num_chunks = ReadValue(index_header);
+        decompressed_size = ReadValue(index_header + sizeof(size_t));
+        chunk_offsets.resize(num_chunks);
+        strm.read((char*)chunk_offsets.data(), num_chunks * sizeof(size_t));
+    }
+    else
+    {
+        // Not seekable during writing -> scan the chunk headers
+        decompressed_size = 0;
+        size_t offset     = header_size;
+        for (;;)
+        {
+            Byte chunk_header[chunk_header_size];
+            strm.seekg(start + std::streamoff(offset));
+            strm.read((char*)chunk_header, chunk_header_size);
+            size_t compressed_size = ReadValue(chunk_header);
+            if (compressed_size == 0) break;
+
+            chunk_offsets.push_back(offset);
+            decompressed_size += ReadValue(chunk_header + sizeof(size_t));
+            offset += chunk_header_size + compressed_size;
+        }
+    }
+    SAIGA_ASSERT(strm.good());
+    strm.seekg(position);
+}
+
+size_t CompressedInputStream::Size()
+{
+    LoadIndex();
+    return decompressed_size;
+}
+
+std::vector<unsigned char> CompressedInputStream::ReadRange(size_t offset, size_t size)
+{
+    LoadIndex();
+    SAIGA_ASSERT(offset + size <= decompressed_size);
+    if (size == 0) return {};
+
+    size_t first_chunk = offset / chunk_size;
+    size_t last_chunk  = (offset + size - 1) / chunk_size;
+
+    auto position = strm.tellg();
+    std::vector<std::vector<Byte>> chunks;
+    for (size_t c = first_chunk; c <= last_chunk; ++c)
+    {
+        Byte chunk_header[chunk_header_size];
+        strm.seekg(start + std::streamoff(chunk_offsets[c]));
+        strm.read((char*)chunk_header, chunk_header_size);
+        size_t compressed_size = ReadValue(chunk_header);
+
+        std::vector<Byte> chunk(chunk_header_size + compressed_size);
+        memcpy(chunk.data(), chunk_header, chunk_header_size);
+        strm.read((char*)chunk.data() + chunk_header_size, compressed_size);
+        chunks.push_back(std::move(chunk));
+    }
+    SAIGA_ASSERT(strm.good());
+    strm.seekg(position);
+
+    std::vector<const Byte*> chunk_ptrs;
+    for (auto& c : chunks) chunk_ptrs.push_back(c.data());
+
+    size_t first_byte = first_chunk * chunk_size;
+    std::vector<unsigned char> tmp(std::min(chunks.size() * chunk_size, decompressed_size - first_byte));
+    UncompressChunks(chunk_ptrs, tmp.data(), chunk_size, decompressed_size - first_byte, options);
+
+    auto begin = tmp.begin() + (offset - first_byte);
+    return std::vector<unsigned char>(begin, begin + size);
+}
+
 }  // namespace Saiga
 
 #endif
@@ -7,13 +7,18 @@
 #pragma once
 
 #include "saiga/config.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
 
+#include <iostream>
 #include <vector>
 
 #ifdef SAIGA_USE_ZLIB
 
 namespace Saiga
 {
+// Size of the independently compressed chunks.
+constexpr size_t default_compression_chunk_size = 1024 * 1024;
+
 // Compress and uncompress an array of bytes.
 // In the compressed data, we store the size in a header struct.
 // Therefore we do not need the size for uncompessing.
@@ -24,8 +29,123 @@ namespace Saiga
 //    auto compressed   = compress(data.data(), data.size() * sizeof(int));
 //    auto decompressed = uncompress(compressed.data());
 //
-SAIGA_CORE_API std::vector<unsigned char> compress(const void* data, size_t size);
-SAIGA_CORE_API std::vector<unsigned char> uncompress(const void* data);
+// The data is split into chunks, which are compressed and uncompressed in parallel (see ParallelFor).
+// The result is a chunked container, which can also be read by CompressedInputStream.
+// uncompress() can read the chunked container and the old single-stream format.
+//
+// Layout of the chunked container (all fields are size_t):
+//
+//    header : magic, chunk_size, index_offset (0 if unknown)
+//    chunks : [compressed_size, decompressed_size, zlib stream] for every chunk
+//    end    : 0, 0
+//    index  : num_chunks, decompressed_size, chunk_offset[num_chunks]
+//
+// All chunks except the last one contain exactly chunk_size bytes. Offsets are relative to the header.
+SAIGA_CORE_API std::vector<unsigned char> compress(const void* data, size_t size,
+                                                   size_t chunk_size              = default_compression_chunk_size,
+                                                   const ParallelOptions& options = {});
+SAIGA_CORE_API std::vector<unsigned char> uncompress(const void* data, const ParallelOptions& options = {});
+
+// Uncompresses only the bytes [offset, offset + size) of a chunked container.
+// Only the chunks overlapping this range are uncompressed.
+SAIGA_CORE_API std::vector<unsigned char> uncompressRange(const void* data, size_t offset, size_t size,
+                                                          const ParallelOptions& options = {});
+
+/**
+ * Writes a chunked container (see compress()) to a stream.
+ *
+ * The data is buffered until a batch of chunks is full. The batch is then compressed in parallel and written to
+ * the stream. Therefore, the memory usage is independent of the total size.
+ * If the output stream is seekable, the index offset in the header is updated in Close().
+ *
+ * Example usage:
+ *
+ *    std::ofstream file("data.bin", std::ios::binary);
+ *    CompressedOutputStream strm(file);
+ *    for (auto& block : blocks) strm.Write(&block, sizeof(block));
+ *    strm.Close();
+ */
+class SAIGA_CORE_API CompressedOutputStream
+{
+   public:
+    CompressedOutputStream(std::ostream& strm, size_t chunk_size = default_compression_chunk_size,
+                           const ParallelOptions& options = {});
+    ~CompressedOutputStream();
+
+    CompressedOutputStream(const CompressedOutputStream&) = delete;
+    CompressedOutputStream& operator=(const CompressedOutputStream&) = delete;
+
+    void Write(const void* data, size_t size);
+
+    // Compresses the remaining data and writes the index.
+    // Called by the destructor.
+    void Close();
+
+    // Number of uncompressed bytes
+    size_t Size() const { return decompressed_size + buffer.size(); }
+
+   private:
+    void CompressBuffer();
+
+    std::ostream& strm;
+    std::streampos start;
+    size_t chunk_size;
+    size_t chunks_per_batch;
+    ParallelOptions options;
+
+    // Uncompressed data of the current batch
+    std::vector<unsigned char> buffer;
+    std::vector<size_t> chunk_offsets;
+    size_t offset            = 0;
+    size_t decompressed_size = 0;
+    bool closed              = false;
+};
+
+/**
+ * Reads a chunked container (see compress()) from a stream.
+ *
+ * Read() uncompresses the data sequentially in batches of parallel uncompressed chunks. It only requires
+ * a forward stream.
+ * Size() and ReadRange() use the chunk index and therefore require a seekable stream.
+ */
+class SAIGA_CORE_API CompressedInputStream
+{
+   public:
+    CompressedInputStream(std::istream& strm, const ParallelOptions& options = {});
+
+    // Reads the next 'size' bytes.
+    // Returns the number of bytes read, which is smaller than size only at the end of the data.
+    size_t Read(void* data, size_t size);
+
+    // Total number of uncompressed bytes
+    size_t Size();
+
+    // Uncompresses the bytes [offset, offset + size).
+    // The position of Read() is not changed.
+    std::vector<unsigned char> ReadRange(size_t offset, size_t size);
+
+   private:
+    void LoadIndex();
+    bool ReadBatch();
+
+    std::istream& strm;
+    std::streampos start;
+    size_t chunk_size;
+    size_t index_offset;
+    size_t chunks_per_batch;
+    ParallelOptions options;
+
+    // Sequential read
+    std::vector<unsigned char> buffer;
+    size_t buffer_position = 0;
+    bool end_of_data       = false;
+
+    // Random access
+    bool index_loaded = false;
+    size_t decompressed_size;
+    std::vector<size_t> chunk_offsets;
+};
+
 }  // namespace Saiga
 
 #endif
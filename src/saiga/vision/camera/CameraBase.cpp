@@ -20,6 +20,9 @@ void DatasetParameters::fromConfigFile(const std::string& file)
     INI_GETADD_LONG(ini, group, maxFrames);
     INI_GETADD_BOOL(ini, group, multiThreadedLoad);
     INI_GETADD_BOOL(ini, group, preload);
+    INI_GETADD_LONG(ini, group, prefetch_frames);
+    INI_GETADD_LONG(ini, group, prefetch_threads);
+    INI_GETADD_DOUBLE(ini, group, prefetch_memory_mb);
     INI_GETADD_BOOL(ini, group, normalize_timestamps);
     INI_GETADD_DOUBLE(ini, group, ground_truth_time_offset);
     if (ini.changed()) ini.SaveFile(file.c_str());
@@ -38,6 +41,11 @@ DatasetCameraBase::DatasetCameraBase(const DatasetParameters& params) : params(p
     ResetTime();
 }
 
+DatasetCameraBase::~DatasetCameraBase()
+{
+    StopPrefetch();
+}
+
 void DatasetCameraBase::ResetTime()
 {
     timer.start();
@@ -69,9 +77,99 @@ void DatasetCameraBase::Load()
             loadingBar.addProgress(1);
         }
     }
+    else if (params.prefetch_frames > 0)
+    {
+        frame_state.assign(num_images, FrameState::Unloaded);
+        frame_bytes.assign(num_images, 0);
+        prefetch_pool = std::make_unique<ThreadPool>(std::max(params.prefetch_threads, 1), "Prefetch");
+
+        std::unique_lock<std::mutex> lock(prefetch_mutex);
+        SchedulePrefetch();
+    }
     ResetTime();
 }
 
+// Moves only the images. The meta data stays in the frame.
+static void MoveImages(FrameData& from, FrameData& to)
+{
+    to.image           = std::move(from.image);
+    to.image_rgb       = std::move(from.image_rgb);
+    to.depth_image     = std::move(from.depth_image);
+    to.right_image     = std::move(from.right_image);
+    to.right_image_rgb = std::move(from.right_image_rgb);
+}
+
+void DatasetCameraBase::SchedulePrefetch()
+{
+    if (stop_prefetch) return;
+
+    size_t budget = params.prefetch_memory_mb * 1000 * 1000;
+    while (next_prefetch < (int)frames.size() && next_prefetch < this->currentId + params.prefetch_frames)
+    {
+        // The size is only known after decoding -> use the size of the last loaded frame as estimate.
+        // Until the first frame is loaded, only the current frame is scheduled.
+        bool current = next_prefetch == this->currentId;
+        if (!current && (!frame_bytes_estimate || prefetch_bytes + *frame_bytes_estimate > budget)) break;
+        size_t estimate = frame_bytes_estimate.value_or(0);
+
+        int id          = next_prefetch++;
+        frame_state[id] = FrameState::Loading;
+        frame_bytes[id] = estimate;
+        prefetch_bytes += estimate;
+        prefetch_pool->schedule([this, id]() { PrefetchFrame(id); });
+    }
+}
+
+void DatasetCameraBase::PrefetchFrame(int id)
+{
+    auto& frame = frames[id];
+    {
+        std::unique_lock<std::mutex> lock(prefetch_mutex);
+        if (stop_prefetch) return;
+        if (!free_buffers.empty())
+        {
+            MoveImages(free_buffers.back(), frame);
+            free_buffers.pop_back();
+        }
+    }
+
+    frame.ResetImageData();
+    LoadImageData(frame);
+    size_t bytes = frame.ImageBytes();
+
+    {
+        std::unique_lock<std::mutex> lock(prefetch_mutex);
+        frame_state[id]      = FrameState::Ready;
+        prefetch_bytes       = prefetch_bytes - frame_bytes[id] + bytes;
+        frame_bytes[id]      = bytes;
+        frame_bytes_estimate = bytes;
+        // The estimate might have been too large
+        SchedulePrefetch();
+    }
+    prefetch_cv.notify_all();
+}
+
+void DatasetCameraBase::StopPrefetch()
+{
+    if (!prefetch_pool) return;
+    {
+        std::unique_lock<std::mutex> lock(prefetch_mutex);
+        stop_prefetch = true;
+    }
+    // Skips all pending frames and waits for the running ones
+    prefetch_pool->quit();
+    {
+        std::unique_lock<std::mutex> lock(prefetch_mutex);
+        for (auto& state : frame_state)
+        {
+            if (state == FrameState::Loading) state = FrameState::Unloaded;
+        }
+        prefetch_pool.reset();
+    }
+    // Wake up getImageSync() if it waits for a skipped frame. It then loads the frame itself.
+    prefetch_cv.notify_all();
+}
+
 bool DatasetCameraBase::getImageSync(FrameData& data)
 {
     if (!this->isOpened())
@@ -101,9 +199,39 @@ bool DatasetCameraBase::getImageSync(FrameData& data)
     SAIGA_ASSERT(this->currentId == img.id);
     if (!params.preload)
     {
-        LoadImageData(img);
+        std::unique_lock<std::mutex> lock(prefetch_mutex);
+        // During prefetching the current frame is always scheduled. StopPrefetch() resets the skipped frames to
+        // Unloaded, so this also returns if the camera is closed from another thread.
+        prefetch_cv.wait(lock, [this]() {
+            return frame_state.empty() || frame_state[this->currentId] != FrameState::Loading;
+        });
+        if (prefetch_pool && !stop_prefetch)
+        {
+            prefetch_bytes -= frame_bytes[this->currentId];
+
+            // The old images of 'data' are overwritten below -> keep their memory for the next frames.
+            if (data.ImageBytes() > 0 && (int)free_buffers.size() < params.prefetch_frames)
+            {
+                free_buffers.emplace_back();
+                MoveImages(data, free_buffers.back());
+            }
+
+            this->currentId++;
+            SchedulePrefetch();
+        }
+        else
+        {
+            // Synchronous load. After StopPrefetch() some frames might be already loaded.
+            bool loaded = !frame_state.empty() && frame_state[this->currentId] == FrameState::Ready;
+            lock.unlock();
+            if (!loaded) LoadImageData(img);
+            this->currentId++;
+        }
+    }
+    else
+    {
+        this->currentId++;
     }
-    this->currentId++;
     data = std::move(img);
     return true;
 }
@@ -8,11 +8,15 @@
 #include "saiga/core/time/timer.h"
 #include "saiga/core/util/ProgressBar.h"
 #include "saiga/core/util/Thread/omp.h"
+#include "saiga/core/util/Thread/threadPool.h"
 
 #include "CameraData.h"
 
+#include <condition_variable>
 #include <fstream>
 #include <iomanip>
+#include <mutex>
+#include <optional>
 #include <thread>
 
 namespace Saiga
@@ -73,6 +77,14 @@ struct SAIGA_VISION_API DatasetParameters
     // Load all images to ram at the beginning.
     bool preload = true;
 
+    // Streaming mode (only used if preload == false).
+    // The next 'prefetch_frames' frames are loaded in the background by 'prefetch_threads' threads. Frames are only
+    // scheduled while the decoded images stay below 'prefetch_memory_mb'. The current frame is always loaded.
+    // Set prefetch_frames to 0 to load each frame synchronously in getImageSync.
+    int prefetch_frames       = 8;
+    int prefetch_threads      = 2;
+    double prefetch_memory_mb = 512;
+
     // Subtract the timestamp of the first image from everything.
     bool normalize_timestamps = false;
 
@@ -92,6 +104,7 @@ class SAIGA_VISION_API DatasetCameraBase : public CameraBase
 {
    public:
     DatasetCameraBase(const DatasetParameters& params);
+    virtual ~DatasetCameraBase();
 
     void ResetTime();
 
@@ -114,6 +127,8 @@ class SAIGA_VISION_API DatasetCameraBase : public CameraBase
 
     bool getImageSync(FrameData& data) override;
 
+    void close() override { StopPrefetch(); }
+
     virtual bool isOpened() override { return this->currentId < (int)frames.size(); }
     size_t getFrameCount() { return frames.size(); }
 
@@ -132,6 +147,10 @@ class SAIGA_VISION_API DatasetCameraBase : public CameraBase
 
 
    protected:
+    // Waits for the running background loads and stops prefetching.
+    // Derived classes must call this in their destructor, because LoadImageData might still be running.
+    void StopPrefetch();
+
     AlignedVector<FrameData> frames;
     DatasetParameters params;
     std::vector<Imu::Data> imuData;
@@ -144,6 +163,34 @@ class SAIGA_VISION_API DatasetCameraBase : public CameraBase
     tick_t timeStep;
     tick_t lastFrameTime;
     tick_t nextFrameTime;
+
+    enum class FrameState : char
+    {
+        Unloaded,
+        Loading,
+        Ready,
+    };
+
+    // Schedules frames for background loading until the window or the memory budget is full.
+    // Must be called with prefetch_mutex locked.
+    void SchedulePrefetch();
+    void PrefetchFrame(int id);
+
+    std::unique_ptr<ThreadPool> prefetch_pool;
+    std::mutex prefetch_mutex;
+    std::condition_variable prefetch_cv;
+    std::vector<FrameState> frame_state;
+    // Estimated memory during loading, actual memory after loading
+    std::vector<size_t> frame_bytes;
+    // Memory of the last loaded frame
+    std::optional<size_t> frame_bytes_estimate;
+    // Memory of all frames in [currentId, next_prefetch)
+    size_t prefetch_bytes = 0;
+    int next_prefetch     = 0;
+    bool stop_prefetch    = false;
+
+    // Image buffers of returned frames. They are reused for the next frames.
+    std::vector<FrameData> free_buffers;
 };
 
 
@@ -11,6 +11,7 @@
 #include "saiga/core/util/tostring.h"
 #include "saiga/vision/util/Ini.h"
 
+#include <filesystem>
 #include <fstream>
 namespace Saiga
 {
@@ -198,8 +199,15 @@ void FrameData::Load(const std::string& dir)
     image_rgb.load(dir + "/color.png");
     image.load(dir + "/gray.png");
 
-    // rgbd
-    depth_image.load(dir + "/depth.saigai");
+    // rgbd (losslessly compressed or raw)
+    if (std::filesystem::exists(dir + "/depth.saigad"))
+    {
+        depth_image.load(dir + "/depth.saigad");
+    }
+    else
+    {
+        depth_image.load(dir + "/depth.saigai");
+    }
 
     // stereo
     right_image_rgb.load(dir + "/right_color.png");
@@ -91,6 +91,22 @@ struct SAIGA_VISION_API FrameData : public FrameMetaData
         right_image.free();
         right_image_rgb.free();
     }
+
+    // Like FreeImageData, but the memory is kept and reused by the next load.
+    void ResetImageData()
+    {
+        image.reset();
+        image_rgb.reset();
+        depth_image.reset();
+        right_image.reset();
+        right_image_rgb.reset();
+    }
+
+    // Memory of all images in bytes
+    size_t ImageBytes() const
+    {
+        return image.size() + image_rgb.size() + depth_image.size() + right_image.size() + right_image_rgb.size();
+    }
 };
 
 
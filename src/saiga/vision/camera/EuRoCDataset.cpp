@@ -78,6 +78,11 @@ EuRoCDataset::EuRoCDataset(const DatasetParameters& _params, Sequence sequence)
     Load();
 }
 
+EuRoCDataset::~EuRoCDataset()
+{
+    StopPrefetch();
+}
+
 void EuRoCDataset::LoadImageData(FrameData& data)
 {
     //    std::cout << "EuRoCDataset::LoadImageData " << data.id << std::endl;
@@ -34,6 +34,11 @@ void FileRGBDCamera::preload(const std::string& datasetDir, bool multithreaded)
     std::vector<std::string> depthImages;
     rgbImages   = dir.getFilesEnding(".png");
     depthImages = dir.getFilesEnding(".saigai");
+    if (depthImages.empty())
+    {
+        // losslessly compressed depth images
+        depthImages = dir.getFilesEnding(".saigad");
+    }
 
 
     SAIGA_ASSERT(rgbImages.size() == depthImages.size());
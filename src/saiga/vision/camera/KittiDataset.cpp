@@ -24,6 +24,11 @@ KittiDataset::KittiDataset(const DatasetParameters& params_) : DatasetCameraBase
     Load();
 }
 
+KittiDataset::~KittiDataset()
+{
+    StopPrefetch();
+}
+
 int KittiDataset::LoadMetaData()
 {
     std::cout << "Loading KittiDataset Stereo Dataset: " << params.dir << std::endl;
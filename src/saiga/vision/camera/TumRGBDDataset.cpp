@@ -85,7 +85,10 @@ TumRGBDDataset::TumRGBDDataset(const DatasetParameters& _params, int freiburg)
     Load();
 }
 
-TumRGBDDataset::~TumRGBDDataset() {}
+TumRGBDDataset::~TumRGBDDataset()
+{
+    StopPrefetch();
+}
 
 
 SE3 TumRGBDDataset::getGroundTruth(int frame)
@@ -111,6 +114,9 @@ void TumRGBDDataset::saveRaw(const std::string& dir)
 
 void TumRGBDDataset::LoadImageData(FrameData& data)
 {
+    data.image_rgb.create(intrinsics().imageSize.h, intrinsics().imageSize.w);
+    data.depth_image.create(intrinsics().depthImageSize.h, intrinsics().depthImageSize.w);
+
     Image cimg(data.image_file);
     Image dimg(data.depth_file);
     if (cimg.type == UC3)
@@ -318,11 +324,9 @@ void TumRGBDDataset::load(const std::string& datasetDir, bool multithreaded)
             FrameData& f = frames[i];
             //            makeFrameData(f);
 
-            f.id = i;
-            f.image_rgb.create(intrinsics().imageSize.h, intrinsics().imageSize.w);
-            f.depth_image.create(intrinsics().depthImageSize.h, intrinsics().depthImageSize.w);
+            f.id         = i;
             f.timeStamp  = d.rgb.timestamp;
-            f.image_file       = datasetDir + "/" + d.rgb.img;
+            f.image_file = datasetDir + "/" + d.rgb.img;
             f.depth_file = datasetDir + "/" + d.depth.img;
 
 
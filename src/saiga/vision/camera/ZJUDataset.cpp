@@ -31,6 +31,11 @@ ZJUDataset::ZJUDataset(const DatasetParameters& params) : DatasetCameraBase(para
     Load();
 }
 
+ZJUDataset::~ZJUDataset()
+{
+    StopPrefetch();
+}
+
 void ZJUDataset::LoadImageData(FrameData& data)
 {
     SAIGA_ASSERT(data.image.rows == 0);
@@ -54,7 +54,8 @@ HD Vector<T, 3> ProjectOCam(Vector<T, 3> p, Vector<T, 5> coeff_affine, ArrayView
     {
         if (jacobian_point) jacobian_point->setZero();
         if (jacobian_affine) jacobian_affine->setZero();
-        return Vec3(cx, cy, dist);
+        // Coordinate system switch (see below)
+        return Vec3(cy, cx, dist);
     }
 
     T rho = coeff_poly[0];
@@ -15,7 +15,7 @@ void Rectification::Identity(const IntrinsicsPinholed& K, double bf)
     D_src    = Distortion();
     this->bf = bf;
 }
-Vec2 Rectification::Forward(const Vec2& x)
+Vec2 Rectification::Forward(const Vec2& x) const
 {
     Vec2 p   = K_src.unproject2(x);
     p        = undistortPointGN(p, p, D_src);
@@ -23,7 +23,7 @@ Vec2 Rectification::Forward(const Vec2& x)
     p        = Vec2(p_r(0) / p_r(2), p_r(1) / p_r(2));
     return K_dst.normalizedToImage(p);
 }
-Vec2 Rectification::Backward(const Vec2& x)
+Vec2 Rectification::Backward(const Vec2& x) const
 {
     Vec2 p   = K_dst.unproject2(x);
     Vec3 p_r = R.inverse() * Vec3(p(0), p(1), 1);
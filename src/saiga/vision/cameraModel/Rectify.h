@@ -25,10 +25,10 @@ struct Rectification
 
     void Identity(const IntrinsicsPinholed& K, double bf);
     // unrectified -> rectified
-    Vec2 Forward(const Vec2& x);
+    Vec2 Forward(const Vec2& x) const;
 
     // rectified -> unrectified
-    Vec2 Backward(const Vec2& x);
+    Vec2 Backward(const Vec2& x) const;
 };
 
 
@@ -0,0 +1,443 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "RemapTable.h"
+
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_REMAP_X86
+#    include <immintrin.h>
+#endif
+
+namespace Saiga
+{
+constexpr int F  = RemapTable::fraction;
+constexpr int FB = RemapTable::fraction_bits;
+
+// ============== Scalar kernels ==============
+// All kernels warp one row of the destination image.
+// mx, my are the fixed point source positions of this row (see RemapTable).
+
+// Splits a fixed point position into the top-left pixel and the bilinear weights.
+// x0 is clamped to w-2, so that x0+1 is always inside the image. The weight is then 'fraction'.
+static inline void Decompose(int m, int size, int& i0, int& f)
+{
+    i0 = std::min(m >> FB, size - 2);
+    f  = m - (i0 << FB);
+}
+
+static inline int Round(int m, int size)
+{
+    return std::min((m + F / 2) >> FB, size - 1);
+}
+
+template <typename T>
+static void RemapNearestScalar(const int* mx, const int* my, int n, ImageView<const T> src, T* dst)
+{
+    for (int x = 0; x < n; ++x)
+    {
+        dst[x] = mx[x] == RemapTable::invalid ? T(0) : src(Round(my[x], src.h), Round(mx[x], src.w));
+    }
+}
+
+static inline int BilinearByte(int p00, int p01, int p10, int p11, int fx, int fy)
+{
+    int top    = p00 * (F - fx) + p01 * fx;
+    int bottom = p10 * (F - fx) + p11 * fx;
+    return (top * (F - fy) + bottom * fy + (1 << (2 * FB - 1))) >> (2 * FB);
+}
+
+static void RemapBilinearScalar(const int* mx, const int* my, int n, ImageView<const unsigned char> src,
+                                unsigned char* dst)
+{
+    for (int x = 0; x < n; ++x)
+    {
+        if (mx[x] == RemapTable::invalid)
+        {
+            dst[x] = 0;
+            continue;
+        }
+        int x0, y0, fx, fy;
+        Decompose(mx[x], src.w, x0, fx);
+        Decompose(my[x], src.h, y0, fy);
+        const unsigned char* r0 = src.rowPtr(y0) + x0;
+        const unsigned char* r1 = src.rowPtr(y0 + 1) + x0;
+        dst[x]                  = BilinearByte(r0[0], r0[1], r1[0], r1[1], fx, fy);
+    }
+}
+
+static void RemapBilinearScalar(const int* mx, const int* my, int n, ImageView<const ucvec4> src, ucvec4* dst)
+{
+    for (int x = 0; x < n; ++x)
+    {
+        if (mx[x] == RemapTable::invalid)
+        {
+            dst[x].setZero();
+            continue;
+        }
+        int x0, y0, fx, fy;
+        Decompose(mx[x], src.w, x0, fx);
+        Decompose(my[x], src.h, y0, fy);
+        const ucvec4* r0 = src.rowPtr(y0) + x0;
+        const ucvec4* r1 = src.rowPtr(y0 + 1) + x0;
+        for (int c = 0; c < 4; ++c)
+        {
+            dst[x](c) = BilinearByte(r0[0](c), r0[1](c), r1[0](c), r1[1](c), fx, fy);
+        }
+    }
+}
+
+static void RemapBilinearScalar(const int* mx, const int* my, int n, ImageView<const float> src, float* dst)
+{
+    for (int x = 0; x < n; ++x)
+    {
+        if (mx[x] == RemapTable::invalid)
+        {
+            dst[x] = 0;
+            continue;
+        }
+        int x0, y0, fx, fy;
+        Decompose(mx[x], src.w, x0, fx);
+        Decompose(my[x], src.h, y0, fy);
+        const float* r0 = src.rowPtr(y0) + x0;
+        const float* r1 = src.rowPtr(y0 + 1) + x0;
+        float wx        = fx * (1.0f / F);
+        float wy        = fy * (1.0f / F);
+        float top       = r0[0] + (r0[1] - r0[0]) * wx;
+        float bottom    = r1[0] + (r1[1] - r1[0]) * wx;
+        dst[x]          = top + (bottom - top) * wy;
+    }
+}
+
+#ifdef SAIGA_REMAP_X86
+
+// Computes the byte offsets of the top-left pixels and the weights of 8 destination pixels.
+// Invalid lanes get offset 0 and valid = 0.
+struct Lanes8
+{
+    __m256i offset, fx, fy, valid;
+};
+
+__attribute__((target("avx2"))) static inline Lanes8 LoadLanes(const int* mx, const int* my, int w, int h,
+                                                               int pitch, int bytes_per_pixel)
+{
+    Lanes8 l;
+    __m256i vx = _mm256_loadu_si256((const __m256i*)mx);
+    __m256i vy = _mm256_loadu_si256((const __m256i*)my);
+    l.valid    = _mm256_cmpgt_epi32(vx, _mm256_set1_epi32(RemapTable::invalid));
+
+    __m256i x0 = _mm256_min_epi32(_mm256_srai_epi32(vx, FB), _mm256_set1_epi32(w - 2));
+    __m256i y0 = _mm256_min_epi32(_mm256_srai_epi32(vy, FB), _mm256_set1_epi32(h - 2));
+    l.fx       = _mm256_sub_epi32(vx, _mm256_slli_epi32(x0, FB));
+    l.fy       = _mm256_sub_epi32(vy, _mm256_slli_epi32(y0, FB));
+
+    __m256i offset = _mm256_add_epi32(_mm256_mullo_epi32(y0, _mm256_set1_epi32(pitch)),
+                                      _mm256_mullo_epi32(x0, _mm256_set1_epi32(bytes_per_pixel)));
+    l.offset       = _mm256_and_si256(offset, l.valid);
+    return l;
+}
+
+// Same as BilinearByte for 8 lanes
+__attribute__((target("avx2"))) static inline __m256i BilinearByteAVX2(__m256i p00, __m256i p01, __m256i p10,
+                                                                       __m256i p11, __m256i fx, __m256i fy)
+{
+    const __m256i f = _mm256_set1_epi32(F);
+    __m256i ifx     = _mm256_sub_epi32(f, fx);
+    __m256i ify     = _mm256_sub_epi32(f, fy);
+    __m256i top     = _mm256_add_epi32(_mm256_mullo_epi32(p00, ifx), _mm256_mullo_epi32(p01, fx));
+    __m256i bottom  = _mm256_add_epi32(_mm256_mullo_epi32(p10, ifx), _mm256_mullo_epi32(p11, fx));
+    __m256i v       = _mm256_add_epi32(_mm256_mullo_epi32(top, ify), _mm256_mullo_epi32(bottom, fy));
+    return _mm256_srli_epi32(_mm256_add_epi32(v, _mm256_set1_epi32(1 << (2 * FB - 1))), 2 * FB);
+}
+
+__attribute__((target("avx2"))) static void RemapBilinearAVX2(const int* mx, const int* my, int n,
+                                                              ImageView<const unsigned char> src,
+                                                              unsigned char* dst)
+{
+    const int pitch  = src.pitchBytes;
+    const int* base  = (const int*)src.data8;
+    const __m256i ff = _mm256_set1_epi32(0xFF);
+    // The gathers read 4 bytes. Offsets larger than this are processed by the scalar kernel.
+    const __m256i max_offset = _mm256_set1_epi32((src.h - 1) * pitch + src.w - 4 - pitch);
+
+    int x = 0;
+    for (; x + 8 <= n; x += 8)
+    {
+        Lanes8 l = LoadLanes(mx + x, my + x, src.w, src.h, pitch, 1);
+        if (src.w < 4 || !_mm256_testz_si256(_mm256_cmpgt_epi32(l.offset, max_offset), l.valid))
+        {
+            RemapBilinearScalar(mx + x, my + x, 8, src, dst + x);
+            continue;
+        }
+
+        __m256i g0  = _mm256_i32gather_epi32(base, l.offset, 1);
+        __m256i g1  = _mm256_i32gather_epi32(base, _mm256_add_epi32(l.offset, _mm256_set1_epi32(pitch)), 1);
+        __m256i p00 = _mm256_and_si256(g0, ff);
+        __m256i p01 = _mm256_and_si256(_mm256_srli_epi32(g0, 8), ff);
+        __m256i p10 = _mm256_and_si256(g1, ff);
+        __m256i p11 = _mm256_and_si256(_mm256_srli_epi32(g1, 8), ff);
+
+        __m256i v = _mm256_and_si256(BilinearByteAVX2(p00, p01, p10, p11, l.fx, l.fy), l.valid);
+
+        // 8x int32 -> 8x uint8
+        __m256i v16 = _mm256_packus_epi32(v, v);
+        __m256i v8  = _mm256_packus_epi16(v16, v16);
+        __m128i lo  = _mm256_castsi256_si128(v8);
+        __m128i hi  = _mm256_extracti128_si256(v8, 1);
+        uint64_t result =
+            uint64_t(uint32_t(_mm_cvtsi128_si32(lo))) | (uint64_t(uint32_t(_mm_cvtsi128_si32(hi))) << 32);
+        memcpy(dst + x, &result, 8);
+    }
+    RemapBilinearScalar(mx + x, my + x, n - x, src, dst + x);
+}
+
+__attribute__((target("avx2"))) static void RemapBilinearAVX2(const int* mx, const int* my, int n,
+                                                              ImageView<const ucvec4> src, ucvec4* dst)
+{
+    const int pitch  = src.pitchBytes;
+    const int* base  = (const int*)src.data8;
+    const __m256i ff = _mm256_set1_epi32(0xFF);
+    const __m256i p  = _mm256_set1_epi32(pitch);
+    const __m256i b4 = _mm256_set1_epi32(4);
+
+    int x = 0;
+    for (; x + 8 <= n; x += 8)
+    {
+        Lanes8 l    = LoadLanes(mx + x, my + x, src.w, src.h, pitch, 4);
+        __m256i g00 = _mm256_i32gather_epi32(base, l.offset, 1);
+        __m256i g01 = _mm256_i32gather_epi32(base, _mm256_add_epi32(l.offset, b4), 1);
+        __m256i g10 = _mm256_i32gather_epi32(base, _mm256_add_epi32(l.offset, p), 1);
+        __m256i g11 = _mm256_i32gather_epi32(base, _mm256_add_epi32(l.offset, _mm256_add_epi32(p, b4)), 1);
+
+        __m256i result = _mm256_setzero_si256();
+        for (int c = 0; c < 4; ++c)
+        {
+            __m256i shift = _mm256_set1_epi32(c * 8);
+            __m256i p00   = _mm256_and_si256(_mm256_srlv_epi32(g00, shift), ff);
+            __m256i p01   = _mm256_and_si256(_mm256_srlv_epi32(g01, shift), ff);
+            __m256i p10   = _mm256_and_si256(_mm256_srlv_epi32(g10, shift), ff);
+            __m256i p11   = _mm256_and_si256(_mm256_srlv_epi32(g11, shift), ff);
+            __m256i v     = BilinearByteAVX2(p00, p01, p10, p11, l.fx, l.fy);
+            result        = _mm256_or_si256(result, _mm256_sllv_epi32(v, shift));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + x), _mm256_and_si256(result, l.valid));
+    }
+    RemapBilinearScalar(mx + x, my + x, n - x, src, dst + x);
+}
+
+__attribute__((target("avx2"))) static void RemapBilinearAVX2(const int* mx, const int* my, int n,
+                                                              ImageView<const float> src, float* dst)
+{
+    const int pitch    = src.pitchBytes;
+    const float* base  = (const float*)src.data8;
+    const __m256i p    = _mm256_set1_epi32(pitch);
+    const __m256i b4   = _mm256_set1_epi32(4);
+    const __m256 scale = _mm256_set1_ps(1.0f / F);
+
+    int x = 0;
+    for (; x + 8 <= n; x += 8)
+    {
+        Lanes8 l   = LoadLanes(mx + x, my + x, src.w, src.h, pitch, 4);
+        __m256 p00 = _mm256_i32gather_ps(base, l.offset, 1);
+        __m256 p01 = _mm256_i32gather_ps(base, _mm256_add_epi32(l.offset, b4), 1);
+        __m256 p10 = _mm256_i32gather_ps(base, _mm256_add_epi32(l.offset, p), 1);
+        __m256 p11 = _mm256_i32gather_ps(base, _mm256_add_epi32(l.offset, _mm256_add_epi32(p, b4)), 1);
+
+        __m256 wx     = _mm256_mul_ps(_mm256_cvtepi32_ps(l.fx), scale);
+        __m256 wy     = _mm256_mul_ps(_mm256_cvtepi32_ps(l.fy), scale);
+        __m256 top    = _mm256_add_ps(p00, _mm256_mul_ps(_mm256_sub_ps(p01, p00), wx));
+        __m256 bottom = _mm256_add_ps(p10, _mm256_mul_ps(_mm256_sub_ps(p11, p10), wx));
+        __m256 v      = _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), wy));
+        _mm256_storeu_ps(dst + x, _mm256_and_ps(v, _mm256_castsi256_ps(l.valid)));
+    }
+    RemapBilinearScalar(mx + x, my + x, n - x, src, dst + x);
+}
+
+__attribute__((target("avx2"))) static void RemapNearestAVX2(const int* mx, const int* my, int n,
+                                                             ImageView<const float> src, float* dst)
+{
+    const float* base  = (const float*)src.data8;
+    const __m256i half = _mm256_set1_epi32(F / 2);
+    const __m256i mw   = _mm256_set1_epi32(src.w - 1);
+    const __m256i mh   = _mm256_set1_epi32(src.h - 1);
+    const __m256i p    = _mm256_set1_epi32(src.pitchBytes);
+
+    int x = 0;
+    for (; x + 8 <= n; x += 8)
+    {
+        __m256i vx    = _mm256_loadu_si256((const __m256i*)(mx + x));
+        __m256i vy    = _mm256_loadu_si256((const __m256i*)(my + x));
+        __m256i valid = _mm256_cmpgt_epi32(vx, _mm256_set1_epi32(RemapTable::invalid));
+        __m256i ix    = _mm256_min_epi32(_mm256_srai_epi32(_mm256_add_epi32(vx, half), FB), mw);
+        __m256i iy    = _mm256_min_epi32(_mm256_srai_epi32(_mm256_add_epi32(vy, half), FB), mh);
+        __m256i offset =
+            _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(iy, p), _mm256_slli_epi32(ix, 2)), valid);
+        __m256 v = _mm256_i32gather_ps(base, offset, 1);
+        _mm256_storeu_ps(dst + x, _mm256_and_ps(v, _mm256_castsi256_ps(valid)));
+    }
+    RemapNearestScalar(mx + x, my + x, n - x, src, dst + x);
+}
+#endif
+
+// ============== Runtime dispatch ==============
+
+bool RemapKernelSupported(RemapKernel kernel)
+{
+    switch (kernel)
+    {
+        case RemapKernel::Scalar:
+            return true;
+#ifdef SAIGA_REMAP_X86
+        case RemapKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* RemapKernelName(RemapKernel kernel)
+{
+    switch (kernel)
+    {
+        case RemapKernel::Scalar:
+            return "Scalar";
+        case RemapKernel::AVX2:
+            return "AVX2";
+    }
+    return "Unknown";
+}
+
+static std::atomic<RemapKernel> active_kernel =
+    RemapKernelSupported(RemapKernel::AVX2) ? RemapKernel::AVX2 : RemapKernel::Scalar;
+
+RemapKernel ActiveRemapKernel()
+{
+    return active_kernel;
+}
+
+void SetRemapKernel(RemapKernel kernel)
+{
+    SAIGA_ASSERT(RemapKernelSupported(kernel));
+    active_kernel = kernel;
+}
+
+// ============== RemapTable ==============
+
+void RemapTable::Set(int y, int x, const Vec2& p)
+{
+    bool inside = p.allFinite() && p.x() >= 0 && p.y() >= 0 && p.x() <= src_size.w - 1 && p.y() <= src_size.h - 1;
+    if (inside)
+    {
+        map_x(y, x) = std::min<int>(std::round(p.x() * fraction), (src_size.w - 1) * fraction);
+        map_y(y, x) = std::min<int>(std::round(p.y() * fraction), (src_size.h - 1) * fraction);
+    }
+    else
+    {
+        map_x(y, x) = invalid;
+        map_y(y, x) = invalid;
+    }
+}
+
+bool RemapTable::SourcePosition(int y, int x, vec2& position) const
+{
+    if (map_x(y, x) == invalid) return false;
+    position = vec2(map_x(y, x), map_y(y, x)) * (1.0f / fraction);
+    return true;
+}
+
+RemapTable RemapTable::Undistort(const IntrinsicsPinholed& K, const Distortion& D, ImageDimensions size,
+                                 const IntrinsicsPinholed& K_dst, ImageDimensions dst_size)
+{
+    // Only the forward distortion is evaluated for each pixel.
+    return RemapTable(size, dst_size, [&](const Vec2& p) {
+        Vec2 n = K_dst.unproject2(p);
+        return K.normalizedToImage(distortNormalizedPoint(n, D));
+    });
+}
+
+RemapTable RemapTable::Rectify(Rectification rect, ImageDimensions src_size, ImageDimensions dst_size)
+{
+    return RemapTable(src_size, dst_size, [&](const Vec2& p) { return rect.Backward(p); });
+}
+
+RemapTable RemapTable::OCamToPinhole(const OCam<double>& ocam, const IntrinsicsPinholed& K_dst,
+                                     ImageDimensions dst_size)
+{
+    return RemapTable(ImageDimensions(ocam.h, ocam.w), dst_size, [&](const Vec2& p) {
+        Vec2 n = K_dst.unproject2(p);
+        return ocam.Project(Vec3(n(0), n(1), 1));
+    });
+}
+
+template <typename T, typename RowFunction>
+static void RemapRows(const RemapTable& table, ImageView<const T> src, ImageView<T> dst, RowFunction f)
+{
+    SAIGA_ASSERT(table.valid());
+    SAIGA_ASSERT(src.dimensions() == table.src_size && dst.dimensions() == table.dst_size);
+    for (int y = 0; y < dst.h; ++y)
+    {
+        f(table.map_x.rowPtr(y), table.map_y.rowPtr(y), dst.w, src, dst.rowPtr(y));
+    }
+}
+
+void RemapTable::Remap(ImageView<const unsigned char> src, ImageView<unsigned char> dst,
+                       RemapInterpolation interpolation) const
+{
+    using Row = void (*)(const int*, const int*, int, ImageView<const unsigned char>, unsigned char*);
+    Row f     = interpolation == RemapInterpolation::Nearest ? (Row)RemapNearestScalar<unsigned char>
+                                                             : (Row)RemapBilinearScalar;
+#ifdef SAIGA_REMAP_X86
+    if (active_kernel == RemapKernel::AVX2 && interpolation == RemapInterpolation::Bilinear) f = RemapBilinearAVX2;
+#endif
+    RemapRows(*this, src, dst, f);
+}
+
+void RemapTable::Remap(ImageView<const ucvec4> src, ImageView<ucvec4> dst, RemapInterpolation interpolation) const
+{
+    using Row = void (*)(const int*, const int*, int, ImageView<const ucvec4>, ucvec4*);
+    Row f = interpolation == RemapInterpolation::Nearest ? (Row)RemapNearestScalar<ucvec4> : (Row)RemapBilinearScalar;
+#ifdef SAIGA_REMAP_X86
+    if (active_kernel == RemapKernel::AVX2 && interpolation == RemapInterpolation::Bilinear) f = RemapBilinearAVX2;
+#endif
+    RemapRows(*this, src, dst, f);
+}
+
+void RemapTable::Remap(ImageView<const float> src, ImageView<float> dst, RemapInterpolation interpolation) const
+{
+    using Row = void (*)(const int*, const int*, int, ImageView<const float>, float*);
+    Row f = interpolation == RemapInterpolation::Nearest ? (Row)RemapNearestScalar<float> : (Row)RemapBilinearScalar;
+#ifdef SAIGA_REMAP_X86
+    if (active_kernel == RemapKernel::AVX2)
+    {
+        f = interpolation == RemapInterpolation::Nearest ? (Row)RemapNearestAVX2 : (Row)RemapBilinearAVX2;
+    }
+#endif
+    RemapRows(*this, src, dst, f);
+}
+
+void RemapTable::Remap(ImageView<const uint16_t> src, ImageView<uint16_t> dst) const
+{
+    RemapRows(*this, src, dst, RemapNearestScalar<uint16_t>);
+}
+
+TemplatedImage<vec2> UnprojectUndistortMap(const IntrinsicsPinholed& K, const Distortion& D, ImageDimensions size)
+{
+    TemplatedImage<vec2> result(size);
+    ParallelFor(0, size.h, [&](int i) {
+        for (int j = 0; j < size.w; ++j)
+        {
+            Vec2 p       = K.unproject2(Vec2(j, i));
+            p            = undistortPointGN(p, p, D);
+            result(i, j) = p.cast<float>();
+        }
+    });
+    return result;
+}
+
+}  // namespace Saiga
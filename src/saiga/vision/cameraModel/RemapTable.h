@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/core/image/templatedImage.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
+#include "saiga/vision/VisionIncludes.h"
+
+#include "Distortion.h"
+#include "Intrinsics4.h"
+#include "OCam.h"
+#include "Rectify.h"
+
+namespace Saiga
+{
+enum class RemapKernel
+{
+    Scalar,
+    AVX2,
+};
+
+SAIGA_VISION_API const char* RemapKernelName(RemapKernel kernel);
+SAIGA_VISION_API bool RemapKernelSupported(RemapKernel kernel);
+SAIGA_VISION_API RemapKernel ActiveRemapKernel();
+// The kernel must be supported by the cpu.
+SAIGA_VISION_API void SetRemapKernel(RemapKernel kernel);
+
+enum class RemapInterpolation
+{
+    Nearest,
+    Bilinear,
+};
+
+/**
+ * A precomputed mapping from every pixel of the destination image to a position in the source image.
+ *
+ * The table is built once per camera model (see the static constructors below). Afterwards, images are warped with
+ * Remap(), which only reads the table and does not evaluate the camera model or solve for the inverse distortion.
+ *
+ * The source positions are stored in fixed point with 'fraction_bits' bits after the binary point. Destination pixels
+ * which map outside of the source image are set to 0 by Remap().
+ *
+ * Supported are gray (unsigned char), RGBA (ucvec4) and depth (float, uint16_t) images. Depth images should use
+ * nearest-neighbour interpolation, because bilinear interpolation creates wrong depth values at discontinuities.
+ * uint16_t images only support nearest-neighbour interpolation.
+ *
+ * Example (undistort the frames of a camera):
+ *
+ *    auto table = RemapTable::Undistort(K, D, ImageDimensions(480, 640));
+ *    for (auto& frame : frames)
+ *    {
+ *        table.Remap(frame.image, undistorted.getImageView());
+ *        table.Remap(frame.depth_image, undistorted_depth.getImageView(), RemapInterpolation::Nearest);
+ *    }
+ */
+class SAIGA_VISION_API RemapTable
+{
+   public:
+    static constexpr int fraction_bits = 8;
+    static constexpr int fraction      = 1 << fraction_bits;
+    static constexpr int invalid       = -1;
+
+    RemapTable() {}
+
+    // Generic table. dst_to_src maps a destination pixel (x, y) to the source image (Vec2 -> Vec2).
+    // The table is built in parallel, so dst_to_src must be thread safe.
+    template <typename F>
+    RemapTable(ImageDimensions src_size, ImageDimensions dst_size, F dst_to_src);
+
+    // Maps the distorted image of (K, D) to an undistorted pinhole image with intrinsics K_dst.
+    static RemapTable Undistort(const IntrinsicsPinholed& K, const Distortion& D, ImageDimensions size,
+                                const IntrinsicsPinholed& K_dst, ImageDimensions dst_size);
+    static RemapTable Undistort(const IntrinsicsPinholed& K, const Distortion& D, ImageDimensions size)
+    {
+        return Undistort(K, D, size, K, size);
+    }
+
+    // Maps the unrectified image to the rectified image (see Rectification::Backward).
+    static RemapTable Rectify(Rectification rect, ImageDimensions src_size, ImageDimensions dst_size);
+
+    // Maps a fisheye image to a pinhole image with intrinsics K_dst.
+    static RemapTable OCamToPinhole(const OCam<double>& ocam, const IntrinsicsPinholed& K_dst,
+                                    ImageDimensions dst_size);
+
+    void Remap(ImageView<const unsigned char> src, ImageView<unsigned char> dst,
+               RemapInterpolation interpolation = RemapInterpolation::Bilinear) const;
+    void Remap(ImageView<const ucvec4> src, ImageView<ucvec4> dst,
+               RemapInterpolation interpolation = RemapInterpolation::Bilinear) const;
+    void Remap(ImageView<const float> src, ImageView<float> dst,
+               RemapInterpolation interpolation = RemapInterpolation::Nearest) const;
+    void Remap(ImageView<const uint16_t> src, ImageView<uint16_t> dst) const;
+
+    // The source position of a destination pixel in pixel coordinates.
+    // Returns false if the pixel maps outside of the source image.
+    bool SourcePosition(int y, int x, vec2& position) const;
+
+    bool valid() const { return map_x.valid(); }
+
+    ImageDimensions src_size, dst_size;
+
+    // Fixed point source positions. map_x(y, x) == invalid marks pixels outside of the source image.
+    TemplatedImage<int> map_x, map_y;
+
+   private:
+    void Set(int y, int x, const Vec2& p);
+};
+
+template <typename F>
+RemapTable::RemapTable(ImageDimensions src_size, ImageDimensions dst_size, F dst_to_src)
+    : src_size(src_size), dst_size(dst_size), map_x(dst_size), map_y(dst_size)
+{
+    SAIGA_ASSERT(src_size.w >= 2 && src_size.h >= 2);
+    ParallelFor(0, dst_size.h, [&](int y) {
+        for (int x = 0; x < dst_size.w; ++x)
+        {
+            Set(y, x, dst_to_src(Vec2(x, y)));
+        }
+    });
+}
+
+
+// For each pixel of a distorted image the undistorted point in normalized image space.
+// This is the inverse direction of RemapTable::Undistort. It is used to unproject depth images without resampling
+// them.
+SAIGA_VISION_API TemplatedImage<vec2> UnprojectUndistortMap(const IntrinsicsPinholed& K, const Distortion& D,
+                                                            ImageDimensions size);
+
+}  // namespace Saiga
@@ -0,0 +1,366 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "FastDetector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_FAST_X86
+#    define SAIGA_FAST_INLINE __attribute__((always_inline)) inline
+#else
+#    define SAIGA_FAST_INLINE inline
+#endif
+
+namespace Saiga
+{
+// Corners are only detected at least 'border' pixels away from the image border.
+static constexpr int border = 3;
+
+// The 16 pixels of the circle in the same order as OpenCV.
+static constexpr int circle_x[16] = {0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1};
+static constexpr int circle_y[16] = {3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1, 0, 1, 2, 3};
+
+// The largest threshold for which p is a corner.
+// d[k] > t for 9 contiguous pixels is a dark corner and d[k] < -t a bright corner.
+static int CornerScore(const unsigned char* p, const ptrdiff_t* offsets)
+{
+    int v = p[0];
+    int d[16];
+    for (int k = 0; k < 16; ++k) d[k] = v - p[offsets[k]];
+
+    int best = INT_MIN;
+    for (int start = 0; start < 16; ++start)
+    {
+        int mn = INT_MAX, mx = INT_MIN;
+        for (int j = 0; j < 9; ++j)
+        {
+            int dj = d[(start + j) & 15];
+            mn     = std::min(mn, dj);
+            mx     = std::max(mx, dj);
+        }
+        best = std::max(best, std::max(mn, -mx));
+    }
+    return best - 1;
+}
+
+// ============== Scalar kernel ==============
+// All kernels test the pixels [x, x_end) of one row, append the x position of the corners to 'corners' and write
+// their score. The return value is the first pixel which was not processed (the vector kernels leave a tail).
+
+static bool IsCorner(const unsigned char* p, const ptrdiff_t* offsets, int threshold)
+{
+    int hi = p[0] + threshold;
+    int lo = p[0] - threshold;
+
+    bool bright[16], dark[16];
+    for (int k = 0; k < 16; ++k)
+    {
+        int c     = p[offsets[k]];
+        bright[k] = c > hi;
+        dark[k]   = c < lo;
+    }
+
+    // A 9-arc always contains two neighbouring pixels of {0, 4, 8, 12}.
+    bool quick = false;
+    for (int k = 0; k < 16; k += 4)
+    {
+        quick |= (bright[k] && bright[(k + 4) & 15]) || (dark[k] && dark[(k + 4) & 15]);
+    }
+    if (!quick) return false;
+
+    int run_b = 0, run_d = 0;
+    for (int k = 0; k < 16 + 8; ++k)
+    {
+        run_b = bright[k & 15] ? run_b + 1 : 0;
+        run_d = dark[k & 15] ? run_d + 1 : 0;
+        if (run_b >= 9 || run_d >= 9) return true;
+    }
+    return false;
+}
+
+static int FastRowScalar(const unsigned char* row, const ptrdiff_t* offsets, int x, int x_end, int threshold,
+                         int* scores, std::vector<int>& corners)
+{
+    for (; x < x_end; ++x)
+    {
+        if (IsCorner(row + x, offsets, threshold))
+        {
+            corners.push_back(x);
+            scores[x] = CornerScore(row + x, offsets);
+        }
+    }
+    return x;
+}
+
+#ifdef SAIGA_FAST_X86
+
+// ============== Vector kernel ==============
+// Written once for a GCC vector type of unsigned chars. The kernel is force-inlined into the functions with
+// target("sse2") or target("avx2") below, which then process 16 or 32 pixels at once.
+
+using u8x16 = unsigned char __attribute__((vector_size(16)));
+using u8x32 = unsigned char __attribute__((vector_size(32)));
+
+// The vectors are passed by reference, because the functions without target attribute must not return a 32 byte
+// vector by value.
+template <typename V>
+SAIGA_FAST_INLINE void Load(V& v, const unsigned char* p)
+{
+    std::memcpy(&v, p, sizeof(V));
+}
+
+template <typename V>
+SAIGA_FAST_INLINE bool Any(const V& v)
+{
+    uint64_t w[sizeof(V) / 8];
+    std::memcpy(w, &v, sizeof(V));
+    uint64_t r = 0;
+    for (auto i : w) r |= i;
+    return r != 0;
+}
+
+// Writes 0xFF to 'mask' for each corner and 0 otherwise. Returns false if there is no corner.
+template <typename V>
+SAIGA_FAST_INLINE bool CornerMask(const unsigned char* p, const ptrdiff_t* offsets, int threshold,
+                                  unsigned char* mask)
+{
+    const V zero = V{};
+    const V t    = zero + (unsigned char)threshold;
+
+    // Saturated center +- threshold
+    V c;
+    Load(c, p);
+    V hi = c + t;
+    hi |= (V)(hi < c);
+    V lo = c - t;
+    lo &= ~(V)(lo > c);
+
+    V bright[16], dark[16];
+    for (int k = 0; k < 16; ++k)
+    {
+        V x;
+        Load(x, p + offsets[k]);
+        bright[k] = (V)(x > hi);
+        dark[k]   = (V)(x < lo);
+    }
+
+    V quick = zero;
+    for (int k = 0; k < 16; k += 4)
+    {
+        quick |= (bright[k] & bright[(k + 4) & 15]) | (dark[k] & dark[(k + 4) & 15]);
+    }
+    if (!Any(quick)) return false;
+
+    V run_b = zero, run_d = zero, max_b = zero, max_d = zero;
+    for (int k = 0; k < 16 + 8; ++k)
+    {
+        run_b = (run_b + 1) & bright[k & 15];
+        run_d = (run_d + 1) & dark[k & 15];
+        max_b = max_b > run_b ? max_b : run_b;
+        max_d = max_d > run_d ? max_d : run_d;
+    }
+
+    V corner = (V)(max_b > 8) | (V)(max_d > 8);
+    std::memcpy(mask, &corner, sizeof(V));
+    return Any(corner);
+}
+
+template <typename V>
+SAIGA_FAST_INLINE void AddCorners(const unsigned char* row, const ptrdiff_t* offsets, int x, int x_first,
+                                  const unsigned char* mask, int* scores, std::vector<int>& corners)
+{
+    for (int i = x_first - x; i < int(sizeof(V)); ++i)
+    {
+        if (mask[i])
+        {
+            corners.push_back(x + i);
+            scores[x + i] = CornerScore(row + x + i, offsets);
+        }
+    }
+}
+
+// The remaining pixels of the row, which do not fill a complete vector, are tested with a last vector ending at x_end.
+// It overlaps with the previous vector, therefore only the lanes >= x are used.
+// Rows which are smaller than one vector are left to the caller.
+template <typename V>
+SAIGA_FAST_INLINE int FastRowVector(const unsigned char* row, const ptrdiff_t* offsets, int x, int x_end,
+                                    int threshold, int* scores, std::vector<int>& corners)
+{
+    constexpr int lanes = sizeof(V);
+    unsigned char mask[lanes];
+    for (; x + lanes <= x_end; x += lanes)
+    {
+        if (CornerMask<V>(row + x, offsets, threshold, mask)) AddCorners<V>(row, offsets, x, x, mask, scores, corners);
+    }
+
+    int x_last = x_end - lanes;
+    if (x < x_end && x_last >= border)
+    {
+        if (CornerMask<V>(row + x_last, offsets, threshold, mask))
+            AddCorners<V>(row, offsets, x_last, x, mask, scores, corners);
+        x = x_end;
+    }
+    return x;
+}
+
+__attribute__((target("sse2"))) static int FastRowSSE2(const unsigned char* row, const ptrdiff_t* offsets, int x,
+                                                      int x_end, int threshold, int* scores,
+                                                      std::vector<int>& corners)
+{
+    return FastRowVector<u8x16>(row, offsets, x, x_end, threshold, scores, corners);
+}
+
+// Rows which are smaller than 32 pixels are processed with 16 lanes.
+__attribute__((target("avx2"))) static int FastRowAVX2(const unsigned char* row, const ptrdiff_t* offsets, int x,
+                                                      int x_end, int threshold, int* scores,
+                                                      std::vector<int>& corners)
+{
+    x = FastRowVector<u8x32>(row, offsets, x, x_end, threshold, scores, corners);
+    return FastRowVector<u8x16>(row, offsets, x, x_end, threshold, scores, corners);
+}
+#endif
+
+// ============== Runtime dispatch ==============
+
+bool FastKernelSupported(FastKernel kernel)
+{
+    switch (kernel)
+    {
+        case FastKernel::Scalar:
+            return true;
+#ifdef SAIGA_FAST_X86
+        case FastKernel::SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case FastKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* FastKernelName(FastKernel kernel)
+{
+    switch (kernel)
+    {
+        case FastKernel::Scalar:
+            return "Scalar";
+        case FastKernel::SSE2:
+            return "SSE2";
+        case FastKernel::AVX2:
+            return "AVX2";
+    }
+    return "Unknown";
+}
+
+static FastKernel BestFastKernel()
+{
+    // SSE2 is preferred over AVX2. The grid cells of the ORBExtractor are only ~30 pixels wide, so the 32 pixel
+    // vectors are mostly overlapping and the AVX2 kernel is slower (31 ms vs. 26 ms per EuRoC frame).
+    // AVX2 can still be selected with SetFastKernel.
+    if (FastKernelSupported(FastKernel::SSE2)) return FastKernel::SSE2;
+    if (FastKernelSupported(FastKernel::AVX2)) return FastKernel::AVX2;
+    return FastKernel::Scalar;
+}
+
+static std::atomic<FastKernel> active_kernel = BestFastKernel();
+
+FastKernel ActiveFastKernel()
+{
+    return active_kernel;
+}
+
+void SetFastKernel(FastKernel kernel)
+{
+    SAIGA_ASSERT(FastKernelSupported(kernel));
+    active_kernel = kernel;
+}
+
+// ============== FastDetector ==============
+
+void FastDetector::Detect(ImageView<const unsigned char> image, int threshold, bool nonmax_suppression,
+                          std::vector<KeyPoint<float>>& keypoints)
+{
+    keypoints.clear();
+    threshold = std::clamp(threshold, 0, 255);
+    if (image.w < 2 * border + 1 || image.h < 2 * border + 1) return;
+
+    ptrdiff_t offsets[16];
+    for (int k = 0; k < 16; ++k)
+    {
+        offsets[k] = circle_y[k] * ptrdiff_t(image.pitchBytes) + circle_x[k];
+    }
+
+    auto row_kernel = FastRowScalar;
+#ifdef SAIGA_FAST_X86
+    switch (active_kernel.load())
+    {
+        case FastKernel::SSE2:
+            row_kernel = FastRowSSE2;
+            break;
+        case FastKernel::AVX2:
+            row_kernel = FastRowAVX2;
+            break;
+        default:
+            break;
+    }
+#endif
+
+    for (int i = 0; i < 3; ++i)
+    {
+        scores[i].assign(image.w, 0);
+        corners[i].clear();
+    }
+
+    auto emit = [&](int x, int y, int score) { keypoints.emplace_back(float(x), float(y), 7.f, -1.f, float(score)); };
+
+    // The corners of row y - 1 are emitted after row y has been processed, because the non-maximum suppression
+    // needs the scores of both neighbouring rows. The last iteration only flushes the previous row.
+    for (int y = border; y <= image.h - border; ++y)
+    {
+        auto& score  = scores[y % 3];
+        auto& corner = corners[y % 3];
+        for (auto x : corner) score[x] = 0;
+        corner.clear();
+
+        if (y < image.h - border)
+        {
+            const unsigned char* row = image.rowPtr(y);
+            int x_end                = image.w - border;
+            int x                    = row_kernel(row, offsets, border, x_end, threshold, score.data(), corner);
+            FastRowScalar(row, offsets, x, x_end, threshold, score.data(), corner);
+
+            if (!nonmax_suppression)
+            {
+                for (auto x : corner) emit(x, y, score[x]);
+            }
+        }
+
+        int py = y - 1;
+        if (!nonmax_suppression || py < border) continue;
+
+        const int* prev  = scores[py % 3].data();
+        const int* pprev = scores[(py - 1) % 3].data();
+        const int* curr  = score.data();
+        for (auto x : corners[py % 3])
+        {
+            int s = prev[x];
+            if (s > prev[x - 1] && s > prev[x + 1] && s > pprev[x - 1] && s > pprev[x] && s > pprev[x + 1] &&
+                s > curr[x - 1] && s > curr[x] && s > curr[x + 1])
+            {
+                emit(x, py, s);
+            }
+        }
+    }
+}
+
+}  // namespace Saiga
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/core/image/imageView.h"
+#include "saiga/vision/features/Features.h"
+
+#include <vector>
+
+namespace Saiga
+{
+enum class FastKernel
+{
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+SAIGA_VISION_API const char* FastKernelName(FastKernel kernel);
+SAIGA_VISION_API bool FastKernelSupported(FastKernel kernel);
+// Defaults to SSE2, which is faster than AVX2 on the small grid cells of the ORBExtractor.
+SAIGA_VISION_API FastKernel ActiveFastKernel();
+// The kernel must be supported by the cpu.
+SAIGA_VISION_API void SetFastKernel(FastKernel kernel);
+
+/**
+ * FAST-9 corner detector (16 pixel Bresenham circle with radius 3, 9 contiguous pixels) with optional 3x3
+ * non-maximum suppression.
+ *
+ * The corner test and the score are the same as in OpenCV. Detect(image, threshold, nms) therefore returns the same
+ * keypoints in the same order as cv::FAST(image, keypoints, threshold, nms):
+ *   - point:    pixel position inside 'image' (corners are only detected at least 3 pixels away from the border)
+ *   - size:     7
+ *   - response: the FAST score (largest threshold for which the pixel is still a corner)
+ *
+ * The candidate test of 16 (SSE2) or 32 (AVX2) pixels is evaluated at once. The score is only computed for the
+ * detected corners. The object keeps the row buffers of the non-maximum suppression, so one detector should be used
+ * per thread.
+ *
+ * Example:
+ *    FastDetector fast;
+ *    std::vector<KeyPoint<float>> keypoints;
+ *    fast.Detect(image, 20, true, keypoints);
+ */
+class SAIGA_VISION_API FastDetector
+{
+   public:
+    // Clears 'keypoints' and adds the detected corners.
+    void Detect(ImageView<const unsigned char> image, int threshold, bool nonmax_suppression,
+                std::vector<KeyPoint<float>>& keypoints);
+
+   private:
+    // The score of every pixel in the last 3 rows (0 for non-corners) and the x positions of the corners.
+    std::vector<int> scores[3];
+    std::vector<int> corners[3];
+};
+
+}  // namespace Saiga
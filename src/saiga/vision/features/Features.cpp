@@ -0,0 +1,329 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "Features.h"
+
+#include "saiga/core/util/Thread/ParallelFor.h"
+
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_HAMMING_X86
+#    include <immintrin.h>
+#endif
+
+namespace Saiga
+{
+void OrbDescriptorBlocks::set(ArrayView<const DescriptorORB> descriptors)
+{
+    n = descriptors.size();
+    data.assign(numBlocks() * kBlockSize * kWords, 0);
+    for (int i = 0; i < n; ++i)
+    {
+        int b    = i / kBlockSize;
+        int lane = i % kBlockSize;
+        for (int w = 0; w < kWords; ++w)
+        {
+            data[(b * kWords + w) * kBlockSize + lane] = descriptors[i][w];
+        }
+    }
+}
+
+// ============== Kernels ==============
+// All kernels compute the distances between one query and num_blocks * 8 descriptors in the blocked layout.
+
+using HammingBlockFunction = void (*)(const uint64_t* query, const uint64_t* blocks, int num_blocks, int* out);
+
+static void HammingBlocksScalar(const uint64_t* query, const uint64_t* blocks, int num_blocks, int* out)
+{
+    constexpr int B = OrbDescriptorBlocks::kBlockSize;
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        const uint64_t* block = blocks + b * B * OrbDescriptorBlocks::kWords;
+        for (int lane = 0; lane < B; ++lane)
+        {
+            out[b * B + lane] = popcnt(query[0] ^ block[lane]) + popcnt(query[1] ^ block[B + lane]) +
+                                popcnt(query[2] ^ block[2 * B + lane]) + popcnt(query[3] ^ block[3 * B + lane]);
+        }
+    }
+}
+
+#ifdef SAIGA_HAMMING_X86
+
+// Byte-wise popcount with a 4-bit lookup table (Mula et al. "Faster Population Counts Using AVX2 Instructions").
+__attribute__((target("avx2"))) static inline __m256i PopcountBytesAVX2(__m256i v)
+{
+    const __m256i lookup   = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1,
+                                            2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo             = _mm256_and_si256(v, low_mask);
+    __m256i hi             = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+}
+
+__attribute__((target("avx2"))) static void HammingBlocksAVX2(const uint64_t* query, const uint64_t* blocks,
+                                                              int num_blocks, int* out)
+{
+    __m256i q[4];
+    for (int w = 0; w < 4; ++w) q[w] = _mm256_set1_epi64x(query[w]);
+    const __m256i zero = _mm256_setzero_si256();
+    // Moves the lower 32 bit of the 4 64-bit sums into the lower 128 bit.
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        const uint64_t* block = blocks + b * 32;
+        // Two halves of 4 descriptors each
+        for (int h = 0; h < 2; ++h)
+        {
+            // At most 4 * 8 = 32 bits per byte counter, no overflow.
+            __m256i acc = zero;
+            for (int w = 0; w < 4; ++w)
+            {
+                __m256i t = _mm256_loadu_si256((const __m256i*)(block + w * 8 + h * 4));
+                acc       = _mm256_add_epi8(acc, PopcountBytesAVX2(_mm256_xor_si256(q[w], t)));
+            }
+
+            // Horizontal sum of the 8 byte counters of each 64-bit lane -> distance of one descriptor
+            __m256i sums = _mm256_permutevar8x32_epi32(_mm256_sad_epu8(acc, zero), pack);
+            _mm_storeu_si128((__m128i*)(out + b * 8 + h * 4), _mm256_castsi256_si128(sums));
+        }
+    }
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void HammingBlocksAVX512BW(const uint64_t* query,
+                                                                               const uint64_t* blocks, int num_blocks,
+                                                                               int* out)
+{
+    const __m512i lookup = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+    const __m512i low_mask = _mm512_set1_epi8(0x0f);
+    const __m512i zero     = _mm512_setzero_si512();
+
+    __m512i q[4];
+    for (int w = 0; w < 4; ++w) q[w] = _mm512_set1_epi64(query[w]);
+
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        const uint64_t* block = blocks + b * 32;
+        __m512i acc           = zero;
+        for (int w = 0; w < 4; ++w)
+        {
+            __m512i v  = _mm512_xor_si512(q[w], _mm512_loadu_si512(block + w * 8));
+            __m512i lo = _mm512_and_si512(v, low_mask);
+            __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+            acc        = _mm512_add_epi8(acc, _mm512_shuffle_epi8(lookup, lo));
+            acc        = _mm512_add_epi8(acc, _mm512_shuffle_epi8(lookup, hi));
+        }
+        __m512i sums = _mm512_sad_epu8(acc, zero);
+        _mm256_storeu_si256((__m256i*)(out + b * 8), _mm512_cvtepi64_epi32(sums));
+    }
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq"))) static void HammingBlocksAVX512VPOPCNT(const uint64_t* query,
+                                                                                           const uint64_t* blocks,
+                                                                                           int num_blocks, int* out)
+{
+    __m512i q[4];
+    for (int w = 0; w < 4; ++w) q[w] = _mm512_set1_epi64(query[w]);
+
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        const uint64_t* block = blocks + b * 32;
+        __m512i acc           = _mm512_popcnt_epi64(_mm512_xor_si512(q[0], _mm512_loadu_si512(block)));
+        for (int w = 1; w < 4; ++w)
+        {
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_xor_si512(q[w], _mm512_loadu_si512(block + w * 8))));
+        }
+        _mm256_storeu_si256((__m256i*)(out + b * 8), _mm512_cvtepi64_epi32(acc));
+    }
+}
+#endif
+
+// ============== Runtime dispatch ==============
+
+bool HammingKernelSupported(HammingKernel kernel)
+{
+    switch (kernel)
+    {
+        case HammingKernel::Scalar:
+            return true;
+#ifdef SAIGA_HAMMING_X86
+        case HammingKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+        case HammingKernel::AVX512BW:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+        case HammingKernel::AVX512VPOPCNT:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* HammingKernelName(HammingKernel kernel)
+{
+    switch (kernel)
+    {
+        case HammingKernel::Scalar:
+            return "Scalar";
+        case HammingKernel::AVX2:
+            return "AVX2";
+        case HammingKernel::AVX512BW:
+            return "AVX512BW";
+        case HammingKernel::AVX512VPOPCNT:
+            return "AVX512VPOPCNT";
+    }
+    return "Unknown";
+}
+
+static HammingKernel BestHammingKernel()
+{
+    for (auto k : {HammingKernel::AVX512VPOPCNT, HammingKernel::AVX512BW, HammingKernel::AVX2})
+    {
+        if (HammingKernelSupported(k)) return k;
+    }
+    return HammingKernel::Scalar;
+}
+
+static std::atomic<HammingKernel> active_kernel = BestHammingKernel();
+
+HammingKernel ActiveHammingKernel()
+{
+    return active_kernel;
+}
+
+void SetHammingKernel(HammingKernel kernel)
+{
+    SAIGA_ASSERT(HammingKernelSupported(kernel));
+    active_kernel = kernel;
+}
+
+static HammingBlockFunction GetHammingBlockFunction()
+{
+    switch (active_kernel.load())
+    {
+#ifdef SAIGA_HAMMING_X86
+        case HammingKernel::AVX2:
+            return HammingBlocksAVX2;
+        case HammingKernel::AVX512BW:
+            return HammingBlocksAVX512BW;
+        case HammingKernel::AVX512VPOPCNT:
+            return HammingBlocksAVX512VPOPCNT;
+#endif
+        default:
+            return HammingBlocksScalar;
+    }
+}
+
+void HammingDistanceBlocks(const DescriptorORB& query, const OrbDescriptorBlocks& train, int first_block,
+                           int num_blocks, int* out)
+{
+    SAIGA_ASSERT(first_block >= 0 && first_block + num_blocks <= train.numBlocks());
+    GetHammingBlockFunction()(query.data(), train.block(first_block), num_blocks, out);
+}
+
+// ============== Tiled matching ==============
+
+// 64 blocks * 256 bytes = 16KB of train descriptors stay in L1 while a query tile is processed.
+static constexpr int kTrainTileBlocks = 64;
+static constexpr int kQueryTile       = 64;
+
+void HammingKnn2(ArrayView<const DescriptorORB> query, const OrbDescriptorBlocks& train, std::pair<int, int>* knn2,
+                 std::pair<int, int>* best_query, int threads)
+{
+    constexpr int B                     = OrbDescriptorBlocks::kBlockSize;
+    const std::pair<int, int> no_match = {1000, -1};
+
+    int nq = query.size();
+    int nt = train.size();
+    if (best_query) std::fill(best_query, best_query + nt, no_match);
+    if (nq == 0) return;
+
+    auto kernel    = GetHammingBlockFunction();
+    int num_blocks = train.numBlocks();
+
+    // One contiguous range of queries per thread. Each range has its own copy of the best query per train
+    // descriptor, which are merged afterwards in range order.
+    threads        = std::max(1, std::min(threads, nq));
+    int range_size = (nq + threads - 1) / threads;
+    int num_ranges = (nq + range_size - 1) / range_size;
+    std::vector<std::vector<std::pair<int, int>>> local_best(best_query ? num_ranges : 0);
+
+    ParallelOptions options;
+    options.grain_size  = range_size;
+    options.max_threads = threads;
+
+    ParallelForRange(
+        0, nq,
+        [&](int q_begin, int q_end) {
+            std::vector<int> dist(kTrainTileBlocks * B);
+            std::pair<int, int>* local_best_query = nullptr;
+            if (best_query)
+            {
+                auto& lb = local_best[q_begin / range_size];
+                lb.assign(nt, no_match);
+                local_best_query = lb.data();
+            }
+
+            for (int i = q_begin; i < q_end; ++i)
+            {
+                knn2[i * 2 + 0] = no_match;
+                knn2[i * 2 + 1] = no_match;
+            }
+
+            for (int q0 = q_begin; q0 < q_end; q0 += kQueryTile)
+            {
+                int q1 = std::min(q0 + kQueryTile, q_end);
+                for (int b0 = 0; b0 < num_blocks; b0 += kTrainTileBlocks)
+                {
+                    int tile_blocks = std::min(kTrainTileBlocks, num_blocks - b0);
+                    int t0          = b0 * B;
+                    int t1          = std::min(t0 + tile_blocks * B, nt);
+
+                    for (int i = q0; i < q1; ++i)
+                    {
+                        kernel(query[i].data(), train.block(b0), tile_blocks, dist.data());
+
+                        auto& best   = knn2[i * 2 + 0];
+                        auto& second = knn2[i * 2 + 1];
+                        for (int j = t0; j < t1; ++j)
+                        {
+                            int d = dist[j - t0];
+                            if (d < best.first)
+                            {
+                                second = best;
+                                best   = {d, j};
+                            }
+                            else if (d < second.first)
+                            {
+                                second = {d, j};
+                            }
+
+                            if (local_best_query && d < local_best_query[j].first)
+                            {
+                                local_best_query[j] = {d, i};
+                            }
+                        }
+                    }
+                }
+            }
+        },
+        options);
+
+    // Merge in range order. The strict comparison keeps the smallest query index on ties.
+    for (auto& lb : local_best)
+    {
+        for (int j = 0; j < nt; ++j)
+        {
+            if (lb[j].first < best_query[j].first) best_query[j] = lb[j];
+        }
+    }
+}
+
+}  // namespace Saiga
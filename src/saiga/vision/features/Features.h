@@ -127,10 +127,7 @@ inline int distance(const DescriptorORB& a, const DescriptorORB& b)
     for (int i = 0; i < (int)a.size(); i++)
     {
         auto v = a[i] ^ b[i];
-        // TODO: if this is really a bottleneck we can also use AVX-2
-        // to gain around 25% more performance
-        // according to this source:
-        // https://github.com/kimwalisch/libpopcnt
+        // For one-to-many comparisons use the SIMD kernels of HammingDistanceBlocks/HammingKnn2 below.
         dist += popcnt(v);
     }
 
@@ -295,6 +292,76 @@ struct MeanMatcher
     }
 };
 
+/**
+ * ORB descriptors transposed into blocks of 8 for the batched hamming distance kernels.
+ *
+ * Block layout (4 x 8 uint64_t = 256 bytes):
+ *      [word0 of d0..d7][word1 of d0..d7][word2 of d0..d7][word3 of d0..d7]
+ *
+ * With this structure-of-arrays layout one 256/512-bit register contains the same word of 4/8 descriptors,
+ * so a query is compared to a whole block without horizontal reductions.
+ * The last block is padded with zero-descriptors.
+ */
+class SAIGA_VISION_API OrbDescriptorBlocks
+{
+   public:
+    static constexpr int kBlockSize = 8;
+    static constexpr int kWords     = 4;
+
+    OrbDescriptorBlocks() {}
+    OrbDescriptorBlocks(ArrayView<const DescriptorORB> descriptors) { set(descriptors); }
+
+    void set(ArrayView<const DescriptorORB> descriptors);
+
+    int size() const { return n; }
+    int numBlocks() const { return (n + kBlockSize - 1) / kBlockSize; }
+    const uint64_t* block(int b) const { return data.data() + b * kBlockSize * kWords; }
+
+   private:
+    int n = 0;
+    std::vector<uint64_t> data;
+};
+
+// The batched hamming distance implementations.
+// The fastest supported kernel is selected at runtime by checking the CPU features.
+enum class HammingKernel
+{
+    Scalar = 0,
+    AVX2,
+    // pshufb nibble-lookup on 512-bit registers
+    AVX512BW,
+    // native vpopcntq (Ice Lake and newer)
+    AVX512VPOPCNT,
+};
+
+SAIGA_VISION_API const char* HammingKernelName(HammingKernel kernel);
+SAIGA_VISION_API bool HammingKernelSupported(HammingKernel kernel);
+SAIGA_VISION_API HammingKernel ActiveHammingKernel();
+// Overrides the automatic selection. Mainly used for testing and benchmarking.
+SAIGA_VISION_API void SetHammingKernel(HammingKernel kernel);
+
+/**
+ * Computes the distance between the query and all descriptors in the blocks [first_block, first_block + num_blocks).
+ * out[i] = distance(query, descriptor(first_block * 8 + i))
+ * 'out' must have space for num_blocks * 8 elements.
+ */
+SAIGA_VISION_API void HammingDistanceBlocks(const DescriptorORB& query, const OrbDescriptorBlocks& train,
+                                            int first_block, int num_blocks, int* out);
+
+/**
+ * Cache-tiled brute force 2-nearest-neighbour search.
+ *
+ * knn2 is a row-major (query.size() x 2) array of (distance, index) pairs with the same semantic as
+ * BruteForceMatcher::knn2. Ties are resolved in favour of the smaller train index.
+ *
+ * If best_query is not null, it must point to train.size() elements and receives the nearest query
+ * (distance, index) of every train descriptor. This is computed from the same distance tiles and
+ * used for cross-check (mutual nearest neighbour) matching.
+ */
+SAIGA_VISION_API void HammingKnn2(ArrayView<const DescriptorORB> query, const OrbDescriptorBlocks& train,
+                                  std::pair<int, int>* knn2, std::pair<int, int>* best_query, int threads);
+
+
 template <typename T>
 struct BruteForceMatcher
 {
@@ -322,69 +389,40 @@ struct BruteForceMatcher
 
     void matchKnn2(Saiga::ArrayView<DescriptorORB> desc1, Saiga::ArrayView<DescriptorORB> desc2)
     {
-        knn2.resize(desc1.size(), 2);
-
-        for (int i = 0; i < (int)desc1.size(); ++i)
-        {
-            // init best to infinity distance
-            knn2(i, 0) = {1000, -1};
-            knn2(i, 1) = knn2(i, 0);
-
-
-            for (int j = 0; j < (int)desc2.size(); ++j)
-            {
-                auto dis = distance(desc1[i], desc2[j]);
-
-                if (dis < knn2(i, 0).first)
-                {
-                    // set second best to old best
-                    knn2(i, 1) = knn2(i, 0);
-                    // create new best
-                    knn2(i, 0).first  = dis;
-                    knn2(i, 0).second = j;
-                }
-                else if (dis < knn2(i, 1).first)
-                {
-                    // override second best
-                    knn2(i, 1).first  = dis;
-                    knn2(i, 1).second = j;
-                }
-            }
-        }
+        matchKnn2_omp(desc1, desc2, 1);
     }
 
     void matchKnn2_omp(Saiga::ArrayView<DescriptorORB> desc1, Saiga::ArrayView<DescriptorORB> desc2, int threads)
     {
         knn2.resize(desc1.size(), 2);
+        train_blocks.set(desc2);
+        HammingKnn2(desc1, train_blocks, knn2.data(), nullptr, threads);
+    }
 
-#pragma omp parallel for num_threads(threads)
-        for (int i = 0; i < (int)desc1.size(); ++i)
-        {
-            // init best to infinity distance
-            knn2(i, 0) = {1000, -1};
-            knn2(i, 1) = knn2(i, 0);
-
-
-            for (int j = 0; j < (int)desc2.size(); ++j)
-            {
-                auto dis = distance(desc1[i], desc2[j]);
+    /**
+     * Mutual nearest neighbour matching.
+     * (i, j) is a match if j is the nearest neighbour of i, i is the nearest neighbour of j and
+     * the distance is smaller or equal than the threshold.
+     *
+     * knn2 is also computed, so filterMatches can be used afterwards.
+     */
+    int matchCrossCheck(Saiga::ArrayView<DescriptorORB> desc1, Saiga::ArrayView<DescriptorORB> desc2,
+                        DistanceType threshold, int threads = 1)
+    {
+        knn2.resize(desc1.size(), 2);
+        best_query.resize(desc2.size());
+        train_blocks.set(desc2);
+        HammingKnn2(desc1, train_blocks, knn2.data(), best_query.data(), threads);
 
-                if (dis < knn2(i, 0).first)
-                {
-                    // set second best to old best
-                    knn2(i, 1) = knn2(i, 0);
-                    // create new best
-                    knn2(i, 0).first  = dis;
-                    knn2(i, 0).second = j;
-                }
-                else if (dis < knn2(i, 1).first)
-                {
-                    // override second best
-                    knn2(i, 1).first  = dis;
-                    knn2(i, 1).second = j;
-                }
-            }
+        matches.clear();
+        for (auto i : Range<int>(0, knn2.rows()))
+        {
+            auto [dist, j] = knn2(i, 0);
+            if (j < 0 || dist > threshold) continue;
+            if (best_query[j].second != i) continue;
+            matches.push_back({i, j});
         }
+        return matches.size();
     }
 
     /**
@@ -420,6 +458,10 @@ struct BruteForceMatcher
     Eigen::Matrix<std::pair<DistanceType, int>, -1, 2, Eigen::RowMajor> knn2;
 
     std::vector<std::pair<int, int>> matches;
+
+    // Temporary storage of the match functions
+    OrbDescriptorBlocks train_blocks;
+    std::vector<std::pair<DistanceType, int>> best_query;
 };
 
 }  // namespace Saiga
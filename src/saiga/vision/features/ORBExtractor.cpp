@@ -60,17 +60,9 @@
 
 #include "ORBExtractor.h"
 
-
-#ifdef SAIGA_USE_OPENCV
-
-#    include "saiga/core/time/all.h"
-#    include "saiga/core/util/Thread/omp.h"
-#    include "saiga/vision/opencv/opencv.h"
-
-#    include <opencv2/core/core.hpp>
-#    include <opencv2/features2d/features2d.hpp>
-#    include <opencv2/highgui/highgui.hpp>
-#    include <opencv2/imgproc/imgproc.hpp>
+#include "saiga/core/image/imageTransformations.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
 
 
 namespace Saiga
@@ -90,87 +82,82 @@ ORBExtractor::ORBExtractor(int _nfeatures, float _scaleFactor, int _nlevels, int
 void ORBExtractor::DetectKeypoints()
 {
     const float W = 30;
-#    pragma omp parallel for num_threads(num_threads) schedule(dynamic)
-    for (int level = 0; level < num_levels; ++level)
-    {
-        auto& level_data = levels[level];
-        level_data.keypoints_tmp.clear();
+    ParallelOptions options;
+    options.grain_size  = 1;
+    options.max_threads = num_threads;
+    ParallelFor(
+        0, num_levels,
+        [&](int level) {
+            auto& level_data = levels[level];
+            level_data.keypoints_tmp.clear();
+
+            auto image = level_data.image;
 
-        auto image = Saiga::ImageViewToMat(level_data.image);
+            const int minBorderX = EDGE_THRESHOLD - 3;
+            const int minBorderY = minBorderX;
+            const int maxBorderX = level_data.image.cols - EDGE_THRESHOLD + 3;
+            const int maxBorderY = level_data.image.rows - EDGE_THRESHOLD + 3;
 
-        const int minBorderX = EDGE_THRESHOLD - 3;
-        const int minBorderY = minBorderX;
-        const int maxBorderX = level_data.image.cols - EDGE_THRESHOLD + 3;
-        const int maxBorderY = level_data.image.rows - EDGE_THRESHOLD + 3;
 
+            const float width  = (maxBorderX - minBorderX);
+            const float height = (maxBorderY - minBorderY);
 
-        const float width  = (maxBorderX - minBorderX);
-        const float height = (maxBorderY - minBorderY);
+            const int nCols = width / W;
+            const int nRows = height / W;
+            const int wCell = ceil(width / nCols);
+            const int hCell = ceil(height / nRows);
 
-        const int nCols = width / W;
-        const int nRows = height / W;
-        const int wCell = ceil(width / nCols);
-        const int hCell = ceil(height / nRows);
+            for (int i = 0; i < nRows; i++)
+            {
+                const float iniY = minBorderY + i * hCell;
+                float maxY       = iniY + hCell + 6;
 
-        for (int i = 0; i < nRows; i++)
-        {
-            const float iniY = minBorderY + i * hCell;
-            float maxY       = iniY + hCell + 6;
+                if (iniY >= maxBorderY - 3) continue;
+                if (maxY > maxBorderY) maxY = maxBorderY;
 
-            if (iniY >= maxBorderY - 3) continue;
-            if (maxY > maxBorderY) maxY = maxBorderY;
+                for (int j = 0; j < nCols; j++)
+                {
+                    const float iniX = minBorderX + j * wCell;
+                    float maxX       = iniX + wCell + 6;
+                    if (iniX >= maxBorderX - 6) continue;
+                    if (maxX > maxBorderX) maxX = maxBorderX;
 
-            for (int j = 0; j < nCols; j++)
-            {
-                const float iniX = minBorderX + j * wCell;
-                float maxX       = iniX + wCell + 6;
-                if (iniX >= maxBorderX - 6) continue;
-                if (maxX > maxBorderX) maxX = maxBorderX;
 
+                    auto cell       = image.subImageView(iniY, iniX, maxY - iniY, maxX - iniX);
+                    auto& keys_cell = level_data.keypoints_cell;
 
-                std::vector<cv::KeyPoint> cv_KeysCell;
+                    level_data.fast.Detect(cell, th_fast, true, keys_cell);
 
-                FAST(image.rowRange(iniY, maxY).colRange(iniX, maxX), cv_KeysCell, th_fast, true);
-                int dis_before = cv_KeysCell.size();
+                    if (keys_cell.empty())
+                    {
+                        level_data.fast.Detect(cell, th_fast_min, true, keys_cell);
+                    }
 
-                if (cv_KeysCell.empty())
-                {
-                    FAST(image.rowRange(iniY, maxY).colRange(iniX, maxX), cv_KeysCell, th_fast_min, true);
-                    dis_before = cv_KeysCell.size();
+                    for (auto kp : keys_cell)
+                    {
+                        kp.point.x() += j * wCell;
+                        kp.point.y() += i * hCell;
+                        level_data.keypoints_tmp.push_back(kp);
+                    }
                 }
+            }
 
-                for (auto& cvkp : cv_KeysCell)
-                {
-                    KeypointType kp;
-                    kp.point    = Saiga::vec2(cvkp.pt.x, cvkp.pt.y);
-                    kp.size     = cvkp.size;
-                    kp.angle    = cvkp.angle;
-                    kp.response = cvkp.response;
-                    kp.octave   = cvkp.octave;
+            level_data.keypoints_tmp =
+                level_data.distributor.Distribute(level_data.keypoints_tmp, Saiga::vec2(minBorderX, minBorderY),
+                                                  Saiga::vec2(maxBorderX, maxBorderY), pyramid.Features(level));
 
+            const int scaledPatchSize = PATCH_SIZE * pyramid.Scale(level);
 
-                    kp.point.x() += j * wCell;
-                    kp.point.y() += i * hCell;
-                    level_data.keypoints_tmp.push_back(kp);
-                }
+            for (auto& kp : level_data.keypoints_tmp)
+            {
+                kp.point.x() += minBorderX;
+                kp.point.y() += minBorderY;
+                kp.octave = level;
+                kp.size   = scaledPatchSize;
             }
-        }
-
-        level_data.keypoints_tmp =
-            level_data.distributor.Distribute(level_data.keypoints_tmp, Saiga::vec2(minBorderX, minBorderY),
-                                              Saiga::vec2(maxBorderX, maxBorderY), pyramid.Features(level));
-
-        const int scaledPatchSize = PATCH_SIZE * pyramid.Scale(level);
-
-        for (auto& kp : level_data.keypoints_tmp)
-        {
-            kp.point.x() += minBorderX;
-            kp.point.y() += minBorderY;
-            kp.octave = level;
-            kp.size   = scaledPatchSize;
-            kp.angle  = orb.ComputeAngle(level_data.image, kp.point);
-        }
-    }
+            orb.ComputeAngles(level_data.image, level_data.keypoints_tmp);
+        },
+        options);
 }
 
 
@@ -178,7 +165,6 @@ void ORBExtractor::DetectKeypoints()
 void ORBExtractor::Detect(Saiga::ImageView<unsigned char> inputImage, std::vector<KeypointType>& _keypoints,
                           std::vector<Saiga::DescriptorORB>& outputDescriptors)
 {
-    cv::setNumThreads(1);
     if (inputImage.empty()) return;
 
 
@@ -198,39 +184,40 @@ void ORBExtractor::Detect(Saiga::ImageView<unsigned char> inputImage, std::vecto
     outputDescriptors.resize(nkeypoints);
     _keypoints.resize(nkeypoints);
 
-#    pragma omp parallel for num_threads(num_threads) schedule(dynamic)
-    for (int level = 0; level < num_levels; ++level)
-    {
-        auto& level_data    = levels[level];
-        auto& keypoints     = level_data.keypoints_tmp;
-        int nkeypointsLevel = (int)keypoints.size();
-
-        if (nkeypointsLevel == 0) continue;
-
-        auto image       = Saiga::ImageViewToMat(level_data.image);
-        auto image_gauss = Saiga::ImageViewToMat(level_data.image_gauss.getImageView());
-
-        cv::GaussianBlur(image, image_gauss, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
-
-        int offset = level_data.offset;
-        for (size_t i = 0; i < keypoints.size(); i++)
-        {
-            outputDescriptors[offset + i] =
-                orb.ComputeDescriptor(level_data.image_gauss.getImageView(), keypoints[i].point, keypoints[i].angle);
-        }
-
-        // Scale keypoint coordinates
-        if (level != 0)
-        {
-            float scale = pyramid.Scale(level);
-            for (auto& kp : keypoints) kp.point *= scale;
-        }
-        // And add the keypoints to the output
-        for (int i = 0; i < nkeypointsLevel; ++i)
-        {
-            _keypoints[offset + i] = keypoints[i];
-        }
-    }
+    ParallelOptions options;
+    options.grain_size  = 1;
+    options.max_threads = num_threads;
+    ParallelFor(
+        0, num_levels,
+        [&](int level) {
+            auto& level_data    = levels[level];
+            auto& keypoints     = level_data.keypoints_tmp;
+            int nkeypointsLevel = (int)keypoints.size();
+
+            if (nkeypointsLevel == 0) return;
+
+            // The border is blurred as well, because the rotated pattern reaches a few pixels outside of the
+            // detection area.
+            ImageTransformation::GaussianBlur(level_data.image_with_border.getImageView(),
+                                              level_data.image_gauss_with_border.getImageView(), 3, 2);
+
+            int offset = level_data.offset;
+            orb.ComputeDescriptors(level_data.image_gauss, keypoints,
+                                   ArrayView<Saiga::DescriptorORB>(outputDescriptors.data() + offset, keypoints.size()));
+
+            // Scale keypoint coordinates
+            if (level != 0)
+            {
+                float scale = pyramid.Scale(level);
+                for (auto& kp : keypoints) kp.point *= scale;
+            }
+            // And add the keypoints to the output
+            for (int i = 0; i < nkeypointsLevel; ++i)
+            {
+                _keypoints[offset + i] = keypoints[i];
+            }
+        },
+        options);
 }
 
 void ORBExtractor::AllocatePyramid(int rows, int cols)
@@ -252,7 +239,9 @@ void ORBExtractor::AllocatePyramid(int rows, int cols)
         level_data.image_with_border.create(level_rows_with_border, level_cols_with_border);
         level_data.image = level_data.image_with_border.getImageView().subImageView(EDGE_THRESHOLD, EDGE_THRESHOLD,
                                                                                     level_rows, level_cols);
-        level_data.image_gauss.create(level_rows, level_cols);
+        level_data.image_gauss_with_border.create(level_rows_with_border, level_cols_with_border);
+        level_data.image_gauss = level_data.image_gauss_with_border.getImageView().subImageView(
+            EDGE_THRESHOLD, EDGE_THRESHOLD, level_rows, level_cols);
 
         level_data.keypoints_tmp.reserve(pyramid.total_num_features * 10);
     }
@@ -262,30 +251,18 @@ void ORBExtractor::ComputePyramid(Saiga::ImageView<unsigned char> image)
 {
     AllocatePyramid(image.rows, image.cols);
 
-    cv::Mat cv_image = Saiga::ImageViewToMat(image);
-    assert(cv_image.type() == CV_8UC1);
-
     SAIGA_ASSERT(!levels.empty());
-    cv::copyMakeBorder(cv_image, Saiga::ImageViewToMat(levels.front().image_with_border.getImageView()), EDGE_THRESHOLD,
-                       EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, cv::BORDER_REFLECT_101);
+    image.copyTo(levels.front().image);
+    ImageTransformation::FillBorderReflect101(levels.front().image_with_border.getImageView(), EDGE_THRESHOLD);
 
     for (int level = 1; level < num_levels; ++level)
     {
         auto& level_data      = levels[level];
         auto& level_data_prev = levels[level - 1];
 
-        auto image      = Saiga::ImageViewToMat(level_data.image);
-        auto image_prev = Saiga::ImageViewToMat(level_data_prev.image);
-        auto temp       = Saiga::ImageViewToMat(levels.front().image_with_border.getImageView());
-
-
-        cv::resize(image_prev, image, cv::Size(image.cols, image.rows), 0, 0, cv::INTER_LINEAR);
-
-        cv::copyMakeBorder(image, temp, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
-                           cv::BORDER_REFLECT_101 + cv::BORDER_ISOLATED);
+        ImageTransformation::ResizeBilinear(level_data_prev.image, level_data.image);
+        ImageTransformation::FillBorderReflect101(level_data.image_with_border.getImageView(), EDGE_THRESHOLD);
     }
 }
 
 }  // namespace Saiga
-
-#endif
@@ -30,6 +30,7 @@
 #include "saiga/config.h"
 #include "saiga/core/image/imageView.h"
 #include "saiga/core/image/templatedImage.h"
+#include "saiga/vision/features/FastDetector.h"
 #include "saiga/vision/features/FeatureDistribution.h"
 #include "saiga/vision/features/Features.h"
 #include "saiga/vision/features/OrbDescriptors.h"
@@ -37,8 +38,6 @@
 
 #include <vector>
 
-#ifdef SAIGA_USE_OPENCV
-
 namespace Saiga
 {
 class SAIGA_VISION_API ORBExtractor
@@ -81,14 +80,15 @@ class SAIGA_VISION_API ORBExtractor
         int N;
         int offset;
         Saiga::TemplatedImage<unsigned char> image_with_border;
-        Saiga::TemplatedImage<unsigned char> image_gauss;
+        Saiga::TemplatedImage<unsigned char> image_gauss_with_border;
         Saiga::ImageView<unsigned char> image;
+        Saiga::ImageView<unsigned char> image_gauss;
         std::vector<KeypointType> keypoints_tmp;
+        std::vector<KeypointType> keypoints_cell;
+        Saiga::FastDetector fast;
         Saiga::QuadtreeFeatureDistributor distributor;
     };
     std::vector<Level> levels;
 };
 
 }  // namespace Saiga
-
-#endif
@@ -6,7 +6,13 @@
 
 #include "OrbPattern.h"
 
+#include <atomic>
 #include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_ORB_X86
+#    include <immintrin.h>
+#endif
 using namespace std;
 
 namespace Saiga
@@ -16,11 +22,67 @@ const int HALF_PATCH_SIZE = 15;
 // const int EDGE_THRESHOLD  = 19;
 
 
+// The functions below are shared by the single keypoint and the batched functions, which therefore compute
+// exactly the same floating point values.
+static float AngleFromMoments(int m_01, int m_10)
+{
+    float angle = Saiga::degrees(atan2((float)m_01, (float)m_10));
+    return (angle < 0) * 360 + angle;
+}
+
+static void PatternRotation(float angle_degrees, float& a, float& b)
+{
+    float angle = Saiga::radians(angle_degrees);
+    a           = (float)cos(angle);
+    b           = (float)sin(angle);
+}
+
+static vec2 RotatePatternPoint(const ivec2& p, float a, float b)
+{
+    return vec2(p.x() * a - p.y() * b, p.x() * b + p.y() * a);
+}
+
 ORB::ORB()
 {
     u_max = ORBPattern::AngleUmax();
     descriptor_pattern =
         std::vector<ivec2>(ORBPattern::DescriptorPattern().begin(), ORBPattern::DescriptorPattern().end());
+    SAIGA_ASSERT(descriptor_pattern.size() == 512);
+
+    rotated_patterns.resize(angle_bins);
+    for (int bin = 0; bin < angle_bins; ++bin)
+    {
+        float a, b;
+        PatternRotation(bin * (360.f / angle_bins), a, b);
+        auto& rp = rotated_patterns[bin];
+        for (int k = 0; k < 256; ++k)
+        {
+            vec2 p0 = RotatePatternPoint(descriptor_pattern[2 * k], a, b);
+            vec2 p1 = RotatePatternPoint(descriptor_pattern[2 * k + 1], a, b);
+            rp.x0[k] = p0.x();
+            rp.y0[k] = p0.y();
+            rp.x1[k] = p1.x();
+            rp.y1[k] = p1.y();
+        }
+    }
+
+    for (int v = 0; v <= HALF_PATCH_SIZE; ++v)
+    {
+        int d = v == 0 ? HALF_PATCH_SIZE : u_max[v];
+        for (int i = 0; i < 32; ++i)
+        {
+            int u             = i - HALF_PATCH_SIZE;
+            bool inside       = std::abs(u) <= d;
+            weights_m10[v][i] = inside ? u : 0;
+            weights_m01[v][i] = inside ? v : 0;
+        }
+    }
+}
+
+int ORB::AngleBin(float angle_degrees)
+{
+    int bin = iRound(angle_degrees / (360.f / angle_bins)) % angle_bins;
+    return bin < 0 ? bin + angle_bins : bin;
 }
 
 float ORB::ComputeAngle(Saiga::ImageView<unsigned char> image, const Saiga::vec2& pt)
@@ -49,8 +111,7 @@ float ORB::ComputeAngle(Saiga::ImageView<unsigned char> image, const Saiga::vec2
         }
         m_01 += v * v_sum;
     }
-    float angle = Saiga::degrees(atan2((float)m_01, (float)m_10));
-    return (angle < 0) * 360 + angle;
+    return AngleFromMoments(m_01, m_10);
 }
 
 
@@ -63,8 +124,8 @@ DescriptorORB ORB::ComputeDescriptor(Saiga::ImageView<unsigned char> image, cons
     const ivec2* pattern = descriptor_pattern.data();
 
 
-    float angle = Saiga::radians(angle_degrees);
-    float a = (float)cos(angle), b = (float)sin(angle);
+    float a, b;
+    PatternRotation(angle_degrees, a, b);
 
 #if 0
     const unsigned char* center = &image(iRound(point.y()), iRound(point.x()));
@@ -75,8 +136,9 @@ DescriptorORB ORB::ComputeDescriptor(Saiga::ImageView<unsigned char> image, cons
     auto GET_VALUE = [&](int idx) -> int {
 
 #if 1
-        float fx = point.x() + (pattern[idx].x() * a - pattern[idx].y() * b);
-        float fy = point.y() + (pattern[idx].x() * b + pattern[idx].y() * a);
+        vec2 r   = RotatePatternPoint(pattern[idx], a, b);
+        float fx = point.x() + r.x();
+        float fy = point.y() + r.y();
         int x    = iRound(fx);
         int y    = iRound(fy);
 
@@ -123,4 +185,198 @@ DescriptorORB ORB::ComputeDescriptor(Saiga::ImageView<unsigned char> image, cons
     }
     return result;
 }
+
+// ============== Batched kernels ==============
+
+static void AnglesScalar(ORB& orb, ImageView<unsigned char> image, ArrayView<KeyPoint<float>> keypoints)
+{
+    for (auto& kp : keypoints) kp.angle = orb.ComputeAngle(image, kp.point);
+}
+
+// The descriptor kernels get the rotated pattern of one bin. The test k compares the pixel at (x0[k], y0[k]) with the
+// pixel at (x1[k], y1[k]).
+static void DescriptorScalar(ImageView<unsigned char> image, const vec2& point, const float* x0, const float* y0,
+                             const float* x1, const float* y1, unsigned char* desc)
+{
+    for (int i = 0; i < 32; ++i)
+    {
+        int val = 0;
+        for (int j = 0; j < 8; ++j)
+        {
+            int k  = i * 8 + j;
+            int t0 = image(iRound(point.y() + y0[k]), iRound(point.x() + x0[k]));
+            int t1 = image(iRound(point.y() + y1[k]), iRound(point.x() + x1[k]));
+            val |= (t0 < t1) << j;
+        }
+        desc[i] = (unsigned char)val;
+    }
+}
+
+#ifdef SAIGA_ORB_X86
+#    define SAIGA_ORB_AVX2_INLINE __attribute__((target("avx2"), always_inline)) inline
+
+SAIGA_ORB_AVX2_INLINE int HorizontalSum(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s         = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s         = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+// Multiplies the 32 pixels with the 32 weights and adds the products to acc.
+SAIGA_ORB_AVX2_INLINE __m256i MultiplyAdd(__m256i acc, __m256i pixels16_lo, __m256i pixels16_hi, const short* weights)
+{
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(pixels16_lo, _mm256_loadu_si256((const __m256i*)weights)));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(pixels16_hi, _mm256_loadu_si256((const __m256i*)(weights + 16))));
+}
+
+// Each row of the patch is loaded as 32 pixels [-15, 16] and multiplied with a weight vector, which is zero outside of
+// the circle. All sums are integers, so the moments are identical to the scalar loops.
+__attribute__((target("avx2"))) static void AnglesAVX2(ImageView<unsigned char> image,
+                                                      ArrayView<KeyPoint<float>> keypoints, const short* weights_m10,
+                                                      const short* weights_m01)
+{
+    const int step = (int)image.pitchBytes;
+    for (auto& kp : keypoints)
+    {
+        const unsigned char* center =
+            &image(iRound(kp.point.y()), iRound(kp.point.x())) - HALF_PATCH_SIZE;
+
+        __m256i row = _mm256_loadu_si256((const __m256i*)center);
+        __m256i lo  = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(row));
+        __m256i hi  = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(row, 1));
+        __m256i m10 = MultiplyAdd(_mm256_setzero_si256(), lo, hi, weights_m10);
+        __m256i m01 = _mm256_setzero_si256();
+
+        for (int v = 1; v <= HALF_PATCH_SIZE; ++v)
+        {
+            __m256i plus  = _mm256_loadu_si256((const __m256i*)(center + v * step));
+            __m256i minus = _mm256_loadu_si256((const __m256i*)(center - v * step));
+            __m256i p_lo  = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(plus));
+            __m256i p_hi  = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(plus, 1));
+            __m256i m_lo  = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(minus));
+            __m256i m_hi  = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(minus, 1));
+
+            m10 = MultiplyAdd(m10, _mm256_add_epi16(p_lo, m_lo), _mm256_add_epi16(p_hi, m_hi), weights_m10 + v * 32);
+            m01 = MultiplyAdd(m01, _mm256_sub_epi16(p_lo, m_lo), _mm256_sub_epi16(p_hi, m_hi), weights_m01 + v * 32);
+        }
+        kp.angle = AngleFromMoments(HorizontalSum(m01), HorizontalSum(m10));
+    }
+}
+
+// Byte offsets of 8 pattern points. The rounding is the same as iRound(point + offset) in the scalar code.
+// Precomputed integer offsets per bin would not be bit exact, because the float sum point + offset is not
+// translation invariant near .5.
+SAIGA_ORB_AVX2_INLINE __m256i PatternOffsets(__m256 px, __m256 py, const float* ox, const float* oy, __m256i pitch)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    __m256i x         = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(px, _mm256_loadu_ps(ox)), half));
+    __m256i y         = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(py, _mm256_loadu_ps(oy)), half));
+    return _mm256_add_epi32(_mm256_mullo_epi32(y, pitch), x);
+}
+
+// 8 tests per iteration: two gathers of 8 pixels, one compare and a movemask for the 8 bits of one byte.
+// The gathers read 4 bytes at each pixel, which stays inside the image, because the patch does not reach the last row.
+__attribute__((target("avx2"))) static void DescriptorAVX2(ImageView<unsigned char> image, const vec2& point,
+                                                          const float* x0, const float* y0, const float* x1,
+                                                          const float* y1, unsigned char* desc)
+{
+    const int* base         = (const int*)image.data8;
+    const __m256i pitch     = _mm256_set1_epi32((int)image.pitchBytes);
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+    const __m256 px         = _mm256_set1_ps(point.x());
+    const __m256 py         = _mm256_set1_ps(point.y());
+
+    for (int i = 0; i < 32; ++i)
+    {
+        int k        = i * 8;
+        __m256i off0 = PatternOffsets(px, py, x0 + k, y0 + k, pitch);
+        __m256i off1 = PatternOffsets(px, py, x1 + k, y1 + k, pitch);
+        __m256i t0   = _mm256_and_si256(_mm256_i32gather_epi32(base, off0, 1), byte_mask);
+        __m256i t1   = _mm256_and_si256(_mm256_i32gather_epi32(base, off1, 1), byte_mask);
+        desc[i]      = (unsigned char)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(t1, t0)));
+    }
+}
+#endif
+
+// ============== Runtime dispatch ==============
+
+bool OrbKernelSupported(OrbKernel kernel)
+{
+    switch (kernel)
+    {
+        case OrbKernel::Scalar:
+            return true;
+#ifdef SAIGA_ORB_X86
+        case OrbKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* OrbKernelName(OrbKernel kernel)
+{
+    switch (kernel)
+    {
+        case OrbKernel::Scalar:
+            return "Scalar";
+        case OrbKernel::AVX2:
+            return "AVX2";
+    }
+    return "Unknown";
+}
+
+static OrbKernel BestOrbKernel()
+{
+    if (OrbKernelSupported(OrbKernel::AVX2)) return OrbKernel::AVX2;
+    return OrbKernel::Scalar;
+}
+
+static std::atomic<OrbKernel> active_kernel = BestOrbKernel();
+
+OrbKernel ActiveOrbKernel()
+{
+    return active_kernel;
+}
+
+void SetOrbKernel(OrbKernel kernel)
+{
+    SAIGA_ASSERT(OrbKernelSupported(kernel));
+    active_kernel = kernel;
+}
+
+// ============== Batched functions ==============
+
+void ORB::ComputeAngles(Saiga::ImageView<unsigned char> image, ArrayView<KeyPoint<float>> keypoints)
+{
+#ifdef SAIGA_ORB_X86
+    if (active_kernel.load() == OrbKernel::AVX2)
+    {
+        AnglesAVX2(image, keypoints, weights_m10[0], weights_m01[0]);
+        return;
+    }
+#endif
+    AnglesScalar(*this, image, keypoints);
+}
+
+void ORB::ComputeDescriptors(Saiga::ImageView<unsigned char> image, ArrayView<const KeyPoint<float>> keypoints,
+                             ArrayView<DescriptorORB> descriptors)
+{
+    SAIGA_ASSERT(keypoints.size() == descriptors.size());
+
+    auto kernel = DescriptorScalar;
+#ifdef SAIGA_ORB_X86
+    if (active_kernel.load() == OrbKernel::AVX2) kernel = DescriptorAVX2;
+#endif
+
+    for (size_t i = 0; i < keypoints.size(); ++i)
+    {
+        auto& rp = rotated_patterns[AngleBin(keypoints[i].angle)];
+        kernel(image, keypoints[i].point, rp.x0.data(), rp.y0.data(), rp.x1.data(), rp.y1.data(),
+               (unsigned char*)&descriptors[i]);
+    }
+}
 }  // namespace Saiga
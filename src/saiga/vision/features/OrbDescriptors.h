@@ -20,25 +20,75 @@
 #pragma once
 
 #include "saiga/core/image/imageView.h"
+#include "saiga/core/util/DataStructures/ArrayView.h"
 #include "saiga/vision/features/Features.h"
 //#include "FeatureDistribution2.h"
 
+#include <array>
 #include <list>
 #include <vector>
 
 namespace Saiga
 {
+enum class OrbKernel
+{
+    Scalar,
+    AVX2,
+};
+
+SAIGA_VISION_API const char* OrbKernelName(OrbKernel kernel);
+SAIGA_VISION_API bool OrbKernelSupported(OrbKernel kernel);
+SAIGA_VISION_API OrbKernel ActiveOrbKernel();
+// The kernel must be supported by the cpu.
+SAIGA_VISION_API void SetOrbKernel(OrbKernel kernel);
+
 class SAIGA_VISION_API ORB
 {
    public:
+    // Number of orientations of the batched descriptor computation (12 degree steps as in ORB-SLAM).
+    static constexpr int angle_bins = 30;
+
     ORB();
     float ComputeAngle(Saiga::ImageView<unsigned char> image, const vec2& pt);
     DescriptorORB ComputeDescriptor(Saiga::ImageView<unsigned char> image, const vec2& point, float angle_degrees);
 
+    /**
+     * Batched versions of the functions above for all keypoints of one image.
+     *
+     * ComputeAngles sets keypoint.angle to exactly ComputeAngle(image, keypoint.point).
+     * ComputeDescriptors rounds keypoint.angle to the nearest of the 'angle_bins' orientations and gives exactly
+     * ComputeDescriptor(image, keypoint.point, QuantizeAngle(keypoint.angle)).
+     *
+     * The rotated pattern of each orientation is precomputed, so the descriptors don't need any trigonometric
+     * functions. With the AVX2 kernel the intensity centroid is computed 32 pixels at a time and the pattern pixels
+     * are read with 8-wide gathers.
+     * As for the single keypoint functions, the whole rotated patch must be inside the image, which is the case for
+     * keypoints at least 19 pixels (EDGE_THRESHOLD of the ORBExtractor) away from the border.
+     */
+    void ComputeAngles(Saiga::ImageView<unsigned char> image, ArrayView<KeyPoint<float>> keypoints);
+    void ComputeDescriptors(Saiga::ImageView<unsigned char> image, ArrayView<const KeyPoint<float>> keypoints,
+                            ArrayView<DescriptorORB> descriptors);
+
+    // The bin in [0, angle_bins) which is closest to the angle.
+    static int AngleBin(float angle_degrees);
+    static float QuantizeAngle(float angle_degrees) { return AngleBin(angle_degrees) * (360.f / angle_bins); }
 
    private:
     std::vector<int> u_max;
     std::vector<ivec2> descriptor_pattern;
+
+    // The 256 point pairs of the descriptor rotated to each angle bin (offsets relative to the keypoint).
+    // The first and second point of each pair are stored in separate arrays for the vector kernel.
+    struct RotatedPattern
+    {
+        std::array<float, 256> x0, y0, x1, y1;
+    };
+    std::vector<RotatedPattern> rotated_patterns;
+
+    // Weights of the vectorized intensity centroid for the 32 pixels [-15, 16] of each row v of the circular patch:
+    // u for m_10 and v for m_01 inside the circle, 0 outside.
+    short weights_m10[16][32];
+    short weights_m01[16][32];
 };
 
 
@@ -8,6 +8,10 @@
 #include "ICPDepthMap.h"
 
 #include "saiga/core/time/timer.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
+#include "saiga/vision/kernels/Robust.h"
+
+#include <functional>
 
 namespace Saiga
 {
@@ -124,6 +128,194 @@ SE3 alignDepthMaps(DepthMap referenceDepthMap, DepthMap sourceDepthMap, const SE
     return src.pose;
 }
 
+// Average of the valid depths in each 2x2 block, which are at most 5% farther away than the nearest one.
+static void DownsampleDepth(ImageView<const float> src, ImageView<float> dst)
+{
+    ParallelFor(0, dst.h, [&](int i) {
+        for (int j = 0; j < dst.w; ++j)
+        {
+            float d[4]  = {src(2 * i, 2 * j), src(2 * i, 2 * j + 1), src(2 * i + 1, 2 * j), src(2 * i + 1, 2 * j + 1)};
+            float d_min = std::numeric_limits<float>::infinity();
+            for (auto v : d)
+            {
+                if (v > 0) d_min = std::min(d_min, v);
+            }
+
+            float sum = 0;
+            int count = 0;
+            for (auto v : d)
+            {
+                if (v > 0 && v <= d_min * 1.05f)
+                {
+                    sum += v;
+                    count++;
+                }
+            }
+            dst(i, j) = count > 0 ? sum / count : 0;
+        }
+    });
+}
+
+DepthMapPyramid::DepthMapPyramid(DepthMap depth, const IntrinsicsPinholed& camera, int num_levels)
+{
+    SAIGA_ASSERT(num_levels >= 1);
+    levels.reserve(num_levels);
+
+    IntrinsicsPinholed K = camera;
+    for (int l = 0; l < num_levels; ++l)
+    {
+        int h = l == 0 ? depth.h : levels.back().depth.h / 2;
+        int w = l == 0 ? depth.w : levels.back().depth.w / 2;
+        SAIGA_ASSERT(h > 0 && w > 0);
+        if (l > 0)
+        {
+            // The coarse pixel (x, y) covers the fine pixels 2x and 2x+1, so its center is at 2x + 0.5.
+            K = IntrinsicsPinholed(K.fx * 0.5, K.fy * 0.5, (K.cx - 0.5) * 0.5, (K.cy - 0.5) * 0.5, K.s * 0.5);
+        }
+
+        levels.emplace_back(h, w);
+        auto& level  = levels.back();
+        level.camera = K;
+        if (l == 0)
+        {
+            depth.copyTo(level.depth.getImageView());
+        }
+        else
+        {
+            DownsampleDepth(levels[l - 1].depth.getConstImageView(), level.depth.getImageView());
+        }
+        Depthmap::toPointCloud(level.depth.getImageView(), level.points.getImageView(), K);
+        Depthmap::normalMap(level.points.getImageView(), level.normals.getImageView());
+    }
+}
+
+// The point-to-plane normal equations JtJ * x = Jtb of some source pixels.
+// JtJ and Jtb are accumulated together as the outer product of [J, r, 0] and J, so every column update is two full
+// vector operations (AVX) and the tiles are reduced with a single matrix sum.
+struct DenseICPNormalEquations
+{
+    // [JtJ; Jtb^T; 0]
+    Eigen::Matrix<double, 8, 6> A = Eigen::Matrix<double, 8, 6>::Zero();
+    int n                         = 0;
+
+    DenseICPNormalEquations operator+(const DenseICPNormalEquations& other) const
+    {
+        DenseICPNormalEquations result;
+        result.A = A + other.A;
+        result.n = n + other.n;
+        return result;
+    }
+
+    Eigen::Matrix<double, 6, 1> Solve() const
+    {
+        Eigen::Matrix<double, 6, 6> JtJ = A.topRows<6>();
+        return JtJ.ldlt().solve(A.row(6).transpose());
+    }
+};
+
+// Projective association and accumulation of every stride-th pixel in one row of the source image.
+// (R, t) transforms from source to reference camera space. The residuals and Jacobians are the same as in
+// pointToPlane, but in the reference camera frame.
+static DenseICPNormalEquations AccumulateRow(const DepthMapPyramid::Level& ref, const DepthMapPyramid::Level& src,
+                                             const Mat3& R, const Vec3& t, const DenseICPParams& params, int i,
+                                             int stride)
+{
+    const auto& K   = ref.camera;
+    const int ref_w = ref.points.w;
+    const int ref_h = ref.points.h;
+
+    DenseICPNormalEquations ne;
+    for (int j = 0; j < src.points.w; j += stride)
+    {
+        // The normal is only finite if the point is finite.
+        const Vec3& n0 = src.normals(i, j);
+        if (!n0.allFinite()) continue;
+
+        Vec3 p = R * src.points(i, j) + t;
+        if (p.z() <= 0) continue;
+
+        // Projection and rounding to the nearest pixel. The range check before the conversion also rejects points,
+        // which are too far away from the image to be represented as int.
+        double iz = 1.0 / p.z();
+        double u  = K.fx * p.x() * iz + K.s * p.y() * iz + K.cx + 0.5;
+        double v  = K.fy * p.y() * iz + K.cy + 0.5;
+        if (!(u >= 0 && u < ref_w && v >= 0 && v < ref_h)) continue;
+        int x = int(u);
+        int y = int(v);
+
+        const Vec3& rn = ref.normals(y, x);
+        if (!rn.allFinite()) continue;
+        const Vec3& rp = ref.points(y, x);
+
+        double depth = rp.z();
+        double disTh = params.scaleDistanceThresByDepth ? params.distanceThres * depth : params.distanceThres;
+        Vec3 di      = rp - p;
+        if (di.squaredNorm() >= disTh * disTh || (R * n0).dot(rn) <= params.cosNormalThres) continue;
+
+        double res = rn.dot(di);
+        Eigen::Matrix<double, 8, 1> row;
+        row << rn, p.cross(rn), res, 0;
+
+        // pointToPlane multiplies the row and the residual with the weight
+        double weight = params.useInvDepthAsWeight ? 1.0 / (depth * depth) : 1.0;
+        double w      = weight * weight;
+        if (params.huberThres > 0) w *= Kernel::HuberLoss(params.huberThres, res * res)(1);
+
+        ne.A.noalias() += row * (w * row.head<6>()).transpose();
+        ne.n++;
+    }
+    return ne;
+}
+
+SE3 alignDepthMapsDense(const DepthMapPyramid& ref, const DepthMapPyramid& src, const SE3& refPose, const SE3& srcPose,
+                        const DenseICPParams& params)
+{
+    int num_levels = params.iterations.size();
+    SAIGA_ASSERT(num_levels >= 1);
+    SAIGA_ASSERT(num_levels <= (int)ref.levels.size() && num_levels <= (int)src.levels.size());
+    SAIGA_ASSERT(params.fineStride >= 1);
+
+    ParallelOptions options;
+    options.grain_size = params.tileRows;
+
+    // ref <- src
+    SE3 T = refPose.inverse() * srcPose;
+
+    for (int l = num_levels - 1; l >= 0; --l)
+    {
+        auto& ref_level = ref.levels[l];
+        auto& src_level = src.levels[l];
+        int stride      = l == 0 ? params.fineStride : 1;
+        int rows        = iDivUp(src_level.points.h, stride);
+
+        for (int k = 0; k < params.iterations[num_levels - 1 - l]; ++k)
+        {
+            Mat3 R = T.so3().matrix();
+            Vec3 t = T.translation();
+
+            auto ne = ParallelReduce(
+                0, rows, DenseICPNormalEquations(),
+                [&](int i) { return AccumulateRow(ref_level, src_level, R, t, params, i * stride, stride); },
+                std::plus<DenseICPNormalEquations>(), options);
+            if (ne.n < 6) break;
+
+            Eigen::Matrix<double, 6, 1> x = ne.Solve();
+            T                             = SE3::exp(x) * T;
+            if (x.norm() < params.minUpdate) break;
+        }
+    }
+    return refPose * T;
+}
+
+SE3 alignDepthMapsDense(DepthMap referenceDepthMap, DepthMap sourceDepthMap, const SE3& refPose, const SE3& srcPose,
+                        const IntrinsicsPinholed& camera, const DenseICPParams& params)
+{
+    int num_levels = params.iterations.size();
+    DepthMapPyramid ref(referenceDepthMap, camera, num_levels);
+    DepthMapPyramid src(sourceDepthMap, camera, num_levels);
+    return alignDepthMapsDense(ref, src, refPose, srcPose, params);
+}
+
 
 }  // namespace ICP
 }  // namespace Saiga
@@ -60,5 +60,73 @@ SAIGA_VISION_API SE3 alignDepthMaps(Depthmap::DepthMap referenceDepthMap, Depthm
                                 const SE3& refPose, const SE3& srcPose, const IntrinsicsPinholed& camera, int iterations,
                                 ProjectiveCorrespondencesParams params = ProjectiveCorrespondencesParams());
 
+
+/**
+ * Depth, point and normal pyramid of one depth image for the dense ICP below.
+ * Level 0 has the input resolution, each further level halves it. A coarse depth is the average of the valid depths
+ * in the 2x2 block, which are close to the nearest one, so depth discontinuities are not blurred.
+ *
+ * The pyramid is built once per frame. In frame-to-frame odometry the source pyramid of one frame pair is the
+ * reference pyramid of the next pair.
+ */
+struct SAIGA_VISION_API DepthMapPyramid
+{
+    struct Level
+    {
+        TemplatedImage<float> depth;
+        ArrayImage<Vec3> points;
+        ArrayImage<Vec3> normals;
+        IntrinsicsPinholed camera;
+
+        Level(int h, int w) : depth(h, w), points(h, w), normals(h, w) {}
+    };
+    std::vector<Level> levels;
+
+    DepthMapPyramid(Depthmap::DepthMap depth, const IntrinsicsPinholed& camera, int num_levels);
+};
+
+struct DenseICPParams
+{
+    // Gauss-Newton iterations on each pyramid level, starting at the coarsest one.
+    // The size is the number of used levels.
+    std::vector<int> iterations    = {10, 5, 3};
+    double distanceThres           = 0.1;
+    double cosNormalThres          = 0.9;
+    bool useInvDepthAsWeight       = true;
+    bool scaleDistanceThresByDepth = true;
+
+    // Robust variant: the point-to-plane residuals (in meters) are weighted with the Huber loss. 0 disables it.
+    double huberThres = 0;
+
+    // A level is finished early if the norm of the update is smaller.
+    double minUpdate = 1e-5;
+
+    // Only every stride-th row and column of the finest level is associated. The coarse levels already converged,
+    // so the finest level only refines the pose and a quarter of the pixels gives the same accuracy.
+    int fineStride = 2;
+
+    // Number of image rows, which are associated and reduced by one task.
+    int tileRows = 8;
+};
+
+/**
+ * Coarse-to-fine point-to-plane alignment of two depth image pyramids.
+ * Returns the new source pose (W <- src).
+ *
+ * In each Gauss-Newton iteration the source points are projected into the reference image (projective association
+ * without search radius). Instead of building a correspondence list, every tile of rows directly accumulates its
+ * part of the 6x6 normal equations, which are summed in a fixed order. The results are therefore independent of the
+ * number of threads.
+ */
+SAIGA_VISION_API SE3 alignDepthMapsDense(const DepthMapPyramid& ref, const DepthMapPyramid& src, const SE3& refPose,
+                                         const SE3& srcPose, const DenseICPParams& params = DenseICPParams());
+
+/**
+ * Builds both pyramids and calls the function above.
+ */
+SAIGA_VISION_API SE3 alignDepthMapsDense(Depthmap::DepthMap referenceDepthMap, Depthmap::DepthMap sourceDepthMap,
+                                         const SE3& refPose, const SE3& srcPose, const IntrinsicsPinholed& camera,
+                                         const DenseICPParams& params = DenseICPParams());
+
 }  // namespace ICP
 }  // namespace Saiga
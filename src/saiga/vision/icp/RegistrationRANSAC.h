@@ -21,12 +21,17 @@ namespace Saiga
 /**
  * Computes the best rigid-transformation between two point clouds using the RANSAC algorithm.
  * The error is messuared by projection.
+ *
+ * Model: [Transformation, Scale]
  */
-class RegistrationProjectRANSAC
+class RegistrationProjectRANSAC : public RansacBase<RegistrationProjectRANSAC, std::pair<SE3, double>, 3>
 {
    public:
+    using Model = std::pair<SE3, double>;
+    using Base  = RansacBase<RegistrationProjectRANSAC, Model, 3>;
+
     // Must be set by the user
-    int N;
+    int numPoints = 0;
     SE3 pose1, pose2;
     std::vector<Vec3> points1, points2;
     std::vector<Vec2> ips1, ips2;
@@ -52,102 +57,105 @@ class RegistrationProjectRANSAC
      *
      * @brief solve
      * @param maxIterations
-     * @param stopInliers Early termination when that amount of inliers are found
      */
     std::tuple<SE3, double, int> solve(int maxIterations, bool computeScale)
     {
-        constexpr int sampleSize = 3;
-
-        SAIGA_ASSERT(N > 0);
-        std::uniform_int_distribution<unsigned int> dis(0, N - 1);
-
-
-        std::array<Vec3, sampleSize> A;
-        std::array<Vec3, sampleSize> B;
+        RansacParameters params;
+        params.maxIterations     = maxIterations;
+        params.residualThreshold = threshold;
+        return solve(params, computeScale);
+    }
 
-        SE3 bestT;
-        int bestInliers  = 0;
-        double bestScale = 1;
+    /**
+     * Same as above, but with the full set of ransac parameters (adaptive termination, SPRT, threads).
+     * The solver is called by params.threads OpenMP threads.
+     */
+    std::tuple<SE3, double, int> solve(const RansacParameters& params, bool computeScale)
+    {
+        SAIGA_ASSERT(numPoints > 0);
+        // Keep the random generators alive between calls
+        if (!initialized || params.threads != Params().threads)
+        {
+            init(params);
+            initialized = true;
+        }
+        else
+        {
+            this->params = params;
+        }
+        this->computeScale = computeScale;
 
-        for (int i = 0; i < maxIterations; ++i)
+#pragma omp parallel num_threads(params.threads)
         {
-            // Get 3 matches and store them in A,B
-            for (auto j : Range(0, sampleSize))
-            {
-                auto idx = dis(gen);
-                A[j]     = points1[idx];
-                B[j]     = points2[idx];
-            }
-
-            // fit relative transformation with icp
-            AlignedVector<ICP::Correspondence> corrs;
-            for (int i = 0; i < (int)A.size(); ++i)
-            {
-                ICP::Correspondence c;
-                c.srcPoint = A[i];
-                c.refPoint = B[i];
-                corrs.push_back(c);
-            }
-
-
-            double scale     = 1;
-            double* scalePtr = computeScale ? &scale : nullptr;
-            SE3 rel          = ICP::pointToPointDirect(corrs, scalePtr);
-
-            int currentInliers = 0;
-
-            if (scalePtr)
-            {
-                DSim3 T(rel, scale);
-                // if we have that much scale drift something is broken an
-                if (scale > 0.2 && scale < 5) currentInliers = numInliers(T);
-            }
-            else
-            {
-                currentInliers = numInliers(rel);
-            }
-
-            //            std::cout << "ransac test " << currentInliers << std::endl;
-            if (currentInliers > bestInliers)
-            {
-                bestInliers = currentInliers;
-                bestT       = rel;
-                bestScale   = scale;
-            }
+            compute(numPoints);
         }
-        return {bestT, bestScale, bestInliers};
+
+        if (bestNumInliers == 0) return {SE3(), 1.0, 0};
+        return {bestModel.first, bestModel.second, bestNumInliers};
     }
 
     template <typename Transformation>
     int numInliers(const Transformation& T)
     {
-        int count          = 0;
-        Transformation T12 = T;
-        Transformation T21 = T.inverse();
-        for (auto i : Range(0, N))
+        int count = 0;
+        for (auto i : Range(0, numPoints))
         {
-            Vec3 point1inImage2 = camera2.project3(T12 * points1[i]);
-            Vec3 point2inImage1 = camera1.project3(T21 * points2[i]);
-
-            // projected point is behind one of the cameras
-            if (point1inImage2(2) < 0 || point2inImage1(2) < 0) continue;
-
-            // check reprojection error
-            auto e1 = (point1inImage2.segment<2>(0) - ips2[i]).squaredNorm();
-            auto e2 = (point2inImage1.segment<2>(0) - ips1[i]).squaredNorm();
-            if (e1 < threshold && e2 < threshold)
-            {
-                count++;
-            }
+            count += residual(T, i) < threshold;
         }
         return count;
     }
 
+    bool computeModel(const Subset& set, Model& model)
+    {
+        // fit relative transformation with icp
+        AlignedVector<ICP::Correspondence> corrs;
+        for (auto idx : set)
+        {
+            ICP::Correspondence c;
+            c.srcPoint = points1[idx];
+            c.refPoint = points2[idx];
+            corrs.push_back(c);
+        }
+
+        double scale     = 1;
+        double* scalePtr = computeScale ? &scale : nullptr;
+        SE3 rel          = ICP::pointToPointDirect(corrs, scalePtr);
 
+        // if we have that much scale drift something is broken
+        if (computeScale && (scale <= 0.2 || scale >= 5)) return false;
+
+        model = {rel, scale};
+        return true;
+    }
+
+    double computeResidual(const Model& model, int i)
+    {
+        if (computeScale)
+        {
+            return residual(DSim3(model.first, model.second), i);
+        }
+        return residual(model.first, i);
+    }
 
    private:
-    //    std::mt19937 gen = std::mt19937(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
-    std::mt19937 gen = std::mt19937(92730469346UL);
+    bool computeScale = false;
+    bool initialized  = false;
+
+    // The larger of the two reprojection errors
+    template <typename Transformation>
+    double residual(const Transformation& T12, int i)
+    {
+        Vec3 point1inImage2 = camera2.project3(T12 * points1[i]);
+        Vec3 point2inImage1 = camera1.project3(T12.inverse() * points2[i]);
+
+        // projected point is behind one of the cameras
+        if (point1inImage2(2) < 0 || point2inImage1(2) < 0) return std::numeric_limits<double>::infinity();
+
+        // check reprojection error
+        auto e1 = (point1inImage2.segment<2>(0) - ips2[i]).squaredNorm();
+        auto e2 = (point2inImage1.segment<2>(0) - ips1[i]).squaredNorm();
+        return std::max(e1, e2);
+    }
 };
 
 }  // namespace Saiga
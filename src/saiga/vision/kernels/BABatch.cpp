@@ -0,0 +1,300 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "BABatch.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_BA_BATCH_X86
+#    define SAIGA_BA_BATCH_INLINE __attribute__((always_inline)) inline
+#else
+#    define SAIGA_BA_BATCH_INLINE inline
+#endif
+
+namespace Saiga
+{
+// ============== Kernel ==============
+// The kernel is written once for a generic lane type V, which is either the scalar T or a GCC vector type.
+// The vector types have no target attribute. The kernel is force-inlined into the functions with target("avx2") or
+// target("avx512f") below, which then compile the vector operations to ymm or zmm instructions.
+
+template <typename T>
+struct BABatchParams
+{
+    T R[3][3], t[3];
+    T fx, fy, cx, cy, s, bf;
+
+    BABatchParams(const IntrinsicsPinhole<T>& camera, const Sophus::SE3<T>& pose, T bf)
+        : fx(camera.fx), fy(camera.fy), cx(camera.cx), cy(camera.cy), s(camera.s), bf(bf)
+    {
+        Matrix<T, 3, 3> M = pose.so3().matrix();
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c) R[r][c] = M(r, c);
+            t[r] = pose.translation()(r);
+        }
+    }
+};
+
+template <typename V, typename T>
+SAIGA_BA_BATCH_INLINE V Load(const T* p)
+{
+    V v;
+    std::memcpy(&v, p, sizeof(V));
+    return v;
+}
+
+template <typename V, typename T>
+SAIGA_BA_BATCH_INLINE void Store(T* p, const V& v)
+{
+    std::memcpy(p, &v, sizeof(V));
+}
+
+// Evaluates the observations [i, i + lanes) of the batch.
+// The math is identical to BundleAdjustment() and BundleAdjustmentStereo() in BA.h.
+template <typename V, bool Stereo, bool Jacobians, typename T>
+SAIGA_BA_BATCH_INLINE void BAKernel(const BABatchParams<T>& P, BABatch<T>& B, int i)
+{
+    const V zero = V{} + T(0);
+    const V one  = zero + T(1);
+
+    V px = Load<V>(&B.point_x[i]);
+    V py = Load<V>(&B.point_y[i]);
+    V pz = Load<V>(&B.point_z[i]);
+
+    V x = P.R[0][0] * px + P.R[0][1] * py + P.R[0][2] * pz + P.t[0];
+    V y = P.R[1][0] * px + P.R[1][1] * py + P.R[1][2] * pz + P.t[1];
+    V z = P.R[2][0] * px + P.R[2][1] * py + P.R[2][2] * pz + P.t[2];
+
+    V iz     = one / z;
+    V p_by_x = x * iz;
+    V p_by_y = y * iz;
+
+    V projected_u = P.fx * p_by_x + P.s * p_by_y + P.cx;
+    V projected_v = P.fy * p_by_y + P.cy;
+
+    V w = Load<V>(&B.weight[i]);
+    Store(&B.residual[0][i], V(w * (projected_u - Load<V>(&B.observation_u[i]))));
+    Store(&B.residual[1][i], V(w * (projected_v - Load<V>(&B.observation_v[i]))));
+    Store(&B.depth[i], z);
+
+    V w_stereo = zero;
+    if constexpr (Stereo)
+    {
+        w_stereo = Load<V>(&B.weight_stereo[i]);
+        V stereo = projected_u - P.bf * iz;
+        Store(&B.residual[2][i], V(w_stereo * (Load<V>(&B.stereo_point[i]) - stereo)));
+    }
+
+    if constexpr (Jacobians)
+    {
+        V izz = iz * iz;
+
+        // Pose: derivative of the division by z. Translation (0-2) and rotation (3-5).
+        V a0[6] = {iz, zero, zero - x * izz, zero - y * x * izz, one + x * x * izz, zero - y * iz};
+        V a1[6] = {zero, iz, zero - y * izz, zero - one - y * y * izz, x * y * izz, x * iz};
+        V stereo_correction[6];
+        if constexpr (Stereo)
+        {
+            V bf_izz             = P.bf * izz;
+            stereo_correction[0] = zero;
+            stereo_correction[1] = zero;
+            stereo_correction[2] = zero - bf_izz;
+            stereo_correction[3] = zero - bf_izz * y;
+            stereo_correction[4] = bf_izz * x;
+            stereo_correction[5] = zero;
+        }
+
+        for (int c = 0; c < 6; ++c)
+        {
+            // multiplication by K
+            V j0 = P.fx * a0[c] + P.s * a1[c];
+            V j1 = P.fy * a1[c];
+            Store(&B.jacobian_pose[0][c][i], V(w * j0));
+            Store(&B.jacobian_pose[1][c][i], V(w * j1));
+            if constexpr (Stereo)
+            {
+                Store(&B.jacobian_pose[2][c][i], V(w_stereo * (stereo_correction[c] - j0)));
+            }
+        }
+
+        // Point
+        for (int c = 0; c < 3; ++c)
+        {
+            V b0 = (P.R[0][c] - p_by_x * P.R[2][c]) * iz;
+            V b1 = (P.R[1][c] - p_by_y * P.R[2][c]) * iz;
+            V j0 = P.fx * b0 + P.s * b1;
+            V j1 = P.fy * b1;
+            Store(&B.jacobian_point[0][c][i], V(w * j0));
+            Store(&B.jacobian_point[1][c][i], V(w * j1));
+            if constexpr (Stereo)
+            {
+                Store(&B.jacobian_point[2][c][i], V(w_stereo * (zero - j0 - (P.bf * P.R[2][c]) * izz)));
+            }
+        }
+    }
+}
+
+template <typename V, bool Stereo, bool Jacobians, typename T>
+SAIGA_BA_BATCH_INLINE void BALoop(const BABatchParams<T>& P, BABatch<T>& B)
+{
+    constexpr int lanes = sizeof(V) / sizeof(T);
+    int n               = B.size();
+    int i               = 0;
+    for (; i + lanes <= n; i += lanes)
+    {
+        BAKernel<V, Stereo, Jacobians>(P, B, i);
+    }
+    for (; i < n; ++i)
+    {
+        BAKernel<T, Stereo, Jacobians>(P, B, i);
+    }
+}
+
+template <typename T, bool Stereo, bool Jacobians>
+static void BALoopScalar(const BABatchParams<T>& P, BABatch<T>& B)
+{
+    BALoop<T, Stereo, Jacobians>(P, B);
+}
+
+#ifdef SAIGA_BA_BATCH_X86
+typedef double double4 __attribute__((vector_size(32)));
+typedef float float8 __attribute__((vector_size(32)));
+typedef double double8 __attribute__((vector_size(64)));
+typedef float float16 __attribute__((vector_size(64)));
+
+template <typename T>
+struct BALanes;
+template <>
+struct BALanes<double>
+{
+    using AVX2   = double4;
+    using AVX512 = double8;
+};
+template <>
+struct BALanes<float>
+{
+    using AVX2   = float8;
+    using AVX512 = float16;
+};
+
+template <typename T, bool Stereo, bool Jacobians>
+__attribute__((target("avx2,fma"))) static void BALoopAVX2(const BABatchParams<T>& P, BABatch<T>& B)
+{
+    BALoop<typename BALanes<T>::AVX2, Stereo, Jacobians>(P, B);
+}
+
+template <typename T, bool Stereo, bool Jacobians>
+__attribute__((target("avx512f"))) static void BALoopAVX512(const BABatchParams<T>& P, BABatch<T>& B)
+{
+    BALoop<typename BALanes<T>::AVX512, Stereo, Jacobians>(P, B);
+}
+#endif
+
+// ============== Runtime dispatch ==============
+
+bool BABatchKernelSupported(BABatchKernel kernel)
+{
+    switch (kernel)
+    {
+        case BABatchKernel::Scalar:
+            return true;
+#ifdef SAIGA_BA_BATCH_X86
+        case BABatchKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case BABatchKernel::AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* BABatchKernelName(BABatchKernel kernel)
+{
+    switch (kernel)
+    {
+        case BABatchKernel::Scalar:
+            return "Scalar";
+        case BABatchKernel::AVX2:
+            return "AVX2";
+        case BABatchKernel::AVX512:
+            return "AVX512";
+    }
+    return "Unknown";
+}
+
+// AVX-512 is not selected by default, because on many cpus it lowers the clock frequency of all cores.
+static std::atomic<BABatchKernel> active_kernel =
+    BABatchKernelSupported(BABatchKernel::AVX2) ? BABatchKernel::AVX2 : BABatchKernel::Scalar;
+
+BABatchKernel ActiveBABatchKernel()
+{
+    return active_kernel;
+}
+
+void SetBABatchKernel(BABatchKernel kernel)
+{
+    SAIGA_ASSERT(BABatchKernelSupported(kernel));
+    active_kernel = kernel;
+}
+
+template <typename T, bool Stereo, bool Jacobians>
+static void BADispatch(const BABatchParams<T>& P, BABatch<T>& B)
+{
+    B.ResizeOutput(Jacobians);
+    switch (active_kernel.load())
+    {
+#ifdef SAIGA_BA_BATCH_X86
+        case BABatchKernel::AVX2:
+            BALoopAVX2<T, Stereo, Jacobians>(P, B);
+            break;
+        case BABatchKernel::AVX512:
+            BALoopAVX512<T, Stereo, Jacobians>(P, B);
+            break;
+#endif
+        default:
+            BALoopScalar<T, Stereo, Jacobians>(P, B);
+            break;
+    }
+}
+
+template <typename T>
+void BundleAdjustmentBatch(const IntrinsicsPinhole<T>& camera, const Sophus::SE3<T>& pose, BABatch<T>& batch,
+                           bool jacobians)
+{
+    BABatchParams<T> P(camera, pose, 0);
+    if (jacobians)
+        BADispatch<T, false, true>(P, batch);
+    else
+        BADispatch<T, false, false>(P, batch);
+}
+
+template <typename T>
+void BundleAdjustmentStereoBatch(const StereoCamera4Base<T>& camera, const Sophus::SE3<T>& pose, BABatch<T>& batch,
+                                 bool jacobians)
+{
+    BABatchParams<T> P(camera, pose, camera.bf);
+    if (jacobians)
+        BADispatch<T, true, true>(P, batch);
+    else
+        BADispatch<T, true, false>(P, batch);
+}
+
+template SAIGA_VISION_API void BundleAdjustmentBatch<float>(const IntrinsicsPinhole<float>&, const Sophus::SE3<float>&,
+                                                            BABatch<float>&, bool);
+template SAIGA_VISION_API void BundleAdjustmentBatch<double>(const IntrinsicsPinhole<double>&,
+                                                             const Sophus::SE3<double>&, BABatch<double>&, bool);
+template SAIGA_VISION_API void BundleAdjustmentStereoBatch<float>(const StereoCamera4Base<float>&,
+                                                                  const Sophus::SE3<float>&, BABatch<float>&, bool);
+template SAIGA_VISION_API void BundleAdjustmentStereoBatch<double>(const StereoCamera4Base<double>&,
+                                                                   const Sophus::SE3<double>&, BABatch<double>&, bool);
+
+}  // namespace Saiga
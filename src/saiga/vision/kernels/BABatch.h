@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/vision/VisionTypes.h"
+
+namespace Saiga
+{
+enum class BABatchKernel
+{
+    Scalar,
+    AVX2,
+    AVX512,
+};
+
+SAIGA_VISION_API const char* BABatchKernelName(BABatchKernel kernel);
+SAIGA_VISION_API bool BABatchKernelSupported(BABatchKernel kernel);
+SAIGA_VISION_API BABatchKernel ActiveBABatchKernel();
+// The kernel must be supported by the cpu.
+SAIGA_VISION_API void SetBABatchKernel(BABatchKernel kernel);
+
+/**
+ * Observations of a single image in structure-of-arrays layout.
+ *
+ * The batch kernels below compute the same residuals and Jacobians as BundleAdjustment() and
+ * BundleAdjustmentStereo() from BA.h, but for 4-16 observations at once (depending on the instruction set and T).
+ * Depth observations are converted to stereo observations with ObservationTable::GetStereoPoint().
+ *
+ * Example:
+ *
+ *    batch.Clear();
+ *    for (auto& o : observations) batch.Add(points[o.point], o.pixel, o.weight);
+ *    BundleAdjustmentBatch(camera, pose, batch);
+ *    for (int i = 0; i < batch.size(); ++i)
+ *    {
+ *        Vec2 res                 = batch.Residual<2>(i);
+ *        Matrix<double, 2, 6> J_p = batch.JacobianPose<2>(i);
+ *    }
+ */
+template <typename T>
+class BABatch
+{
+   public:
+    void Clear() { Resize(0); }
+
+    void Resize(int n)
+    {
+        for (auto v : {&point_x, &point_y, &point_z, &observation_u, &observation_v, &stereo_point, &weight,
+                       &weight_stereo})
+        {
+            v->resize(n);
+        }
+    }
+
+    // Mono observation
+    void Set(int i, const Vector<T, 3>& point, const Vector<T, 2>& observation, T w)
+    {
+        Set(i, point, observation, 0, w, 0);
+    }
+
+    // Stereo or depth observation
+    void Set(int i, const Vector<T, 3>& point, const Vector<T, 2>& observation, T observed_stereo_point, T w,
+             T w_stereo)
+    {
+        point_x[i]       = point(0);
+        point_y[i]       = point(1);
+        point_z[i]       = point(2);
+        observation_u[i] = observation(0);
+        observation_v[i] = observation(1);
+        stereo_point[i]  = observed_stereo_point;
+        weight[i]        = w;
+        weight_stereo[i] = w_stereo;
+    }
+
+    void Add(const Vector<T, 3>& point, const Vector<T, 2>& observation, T w)
+    {
+        Resize(size() + 1);
+        Set(size() - 1, point, observation, w);
+    }
+
+    void Add(const Vector<T, 3>& point, const Vector<T, 2>& observation, T observed_stereo_point, T w, T w_stereo)
+    {
+        Resize(size() + 1);
+        Set(size() - 1, point, observation, observed_stereo_point, w, w_stereo);
+    }
+
+    int size() const { return point_x.size(); }
+
+    // Prepares the output arrays for the current size.
+    void ResizeOutput(bool jacobians)
+    {
+        int n = size();
+        for (auto& r : residual) r.resize(n);
+        depth.resize(n);
+        if (!jacobians) return;
+        for (auto& row : jacobian_pose)
+            for (auto& J : row) J.resize(n);
+        for (auto& row : jacobian_point)
+            for (auto& J : row) J.resize(n);
+    }
+
+    // ========== Results ==========
+    // Rows = 2 for BundleAdjustmentBatch and Rows = 3 for BundleAdjustmentStereoBatch.
+
+    template <int Rows>
+    Vector<T, Rows> Residual(int i) const
+    {
+        Vector<T, Rows> r;
+        for (int row = 0; row < Rows; ++row) r(row) = residual[row][i];
+        return r;
+    }
+
+    T Depth(int i) const { return depth[i]; }
+
+    template <int Rows>
+    Matrix<T, Rows, 6> JacobianPose(int i) const
+    {
+        Matrix<T, Rows, 6> J;
+        for (int row = 0; row < Rows; ++row)
+            for (int col = 0; col < 6; ++col) J(row, col) = jacobian_pose[row][col][i];
+        return J;
+    }
+
+    template <int Rows>
+    Matrix<T, Rows, 3> JacobianPoint(int i) const
+    {
+        Matrix<T, Rows, 3> J;
+        for (int row = 0; row < Rows; ++row)
+            for (int col = 0; col < 3; ++col) J(row, col) = jacobian_point[row][col][i];
+        return J;
+    }
+
+    // Input (world points and observations)
+    std::vector<T> point_x, point_y, point_z;
+    std::vector<T> observation_u, observation_v, stereo_point;
+    std::vector<T> weight, weight_stereo;
+
+    // Output
+    std::vector<T> residual[3];
+    std::vector<T> depth;
+    std::vector<T> jacobian_pose[3][6];
+    std::vector<T> jacobian_point[3][3];
+};
+
+// Batched version of BundleAdjustment() (BA.h).
+// If 'jacobians' is false, only the residuals and depths are computed, for example to evaluate the cost.
+template <typename T>
+SAIGA_VISION_API void BundleAdjustmentBatch(const IntrinsicsPinhole<T>& camera, const Sophus::SE3<T>& pose,
+                                            BABatch<T>& batch, bool jacobians = true);
+
+// Batched version of BundleAdjustmentStereo() (BA.h).
+template <typename T>
+SAIGA_VISION_API void BundleAdjustmentStereoBatch(const StereoCamera4Base<T>& camera, const Sophus::SE3<T>& pose,
+                                                  BABatch<T>& batch, bool jacobians = true);
+
+}  // namespace Saiga
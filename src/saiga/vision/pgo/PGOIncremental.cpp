@@ -0,0 +1,307 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "PGOIncremental.h"
+
+#include "saiga/vision/kernels/PGO.h"
+
+namespace Saiga
+{
+// Returns the block at 'row'. A new block is initialized to zero.
+static PGOIncremental::Block& GetBlock(PGOIncremental::BlockColumn& column, int row)
+{
+    auto it = column.find(row);
+    if (it == column.end())
+    {
+        it = column.emplace(row, PGOIncremental::Block::Zero()).first;
+    }
+    return it->second;
+}
+
+void PGOIncremental::create(PoseGraph& scene)
+{
+    this->scene  = &scene;
+    num_vertices = 0;
+    num_edges    = 0;
+    x_lin.clear();
+    delta.clear();
+    constant.clear();
+    vertex_edges.clear();
+    H.clear();
+    b.clear();
+    edge_linearization.clear();
+    L.clear();
+}
+
+void PGOIncremental::AddVertex(int i)
+{
+    auto& v = scene->vertices[i];
+    x_lin.push_back(v.Pose());
+    delta.push_back(Vec6::Zero());
+    constant.push_back(v.constant);
+    vertex_edges.emplace_back();
+    b.push_back(Vec6::Zero());
+    L.emplace_back();
+
+    H.emplace_back();
+    H.back()[i] = Block::Identity() * options.damping;
+}
+
+void PGOIncremental::AddBlock(int row, int col, const Block& block)
+{
+    if (row >= col)
+    {
+        GetBlock(H[col], row) += block;
+    }
+    else
+    {
+        GetBlock(H[row], col) += block.transpose();
+    }
+}
+
+void PGOIncremental::LinearizeEdge(int k, bool remove_old)
+{
+    auto& e   = scene->edges[k];
+    auto& lin = edge_linearization[k];
+    int i     = e.from;
+    int j     = e.to;
+
+    if (remove_old)
+    {
+        AddBlock(i, i, -lin.H_ii);
+        AddBlock(i, j, -lin.H_ij);
+        AddBlock(j, j, -lin.H_jj);
+        b[i] -= lin.b_i;
+        b[j] -= lin.b_j;
+    }
+
+    Block J_i, J_j;
+    Vec6 res = relPoseError(e.GetSE3(), x_lin[i], x_lin[j], e.weight, e.weight, &J_i, &J_j);
+    if (constant[i]) J_i.setZero();
+    if (constant[j]) J_j.setZero();
+
+    lin.H_ii = J_i.transpose() * J_i;
+    lin.H_ij = J_i.transpose() * J_j;
+    lin.H_jj = J_j.transpose() * J_j;
+    lin.b_i  = -J_i.transpose() * res;
+    lin.b_j  = -J_j.transpose() * res;
+
+    AddBlock(i, i, lin.H_ii);
+    AddBlock(i, j, lin.H_ij);
+    AddBlock(j, j, lin.H_jj);
+    b[i] += lin.b_i;
+    b[j] += lin.b_j;
+}
+
+void PGOIncremental::Factorize(int first_column)
+{
+    int n = num_vertices;
+    for (int j = first_column; j < n; ++j)
+    {
+        L[j] = H[j];
+    }
+
+    // The columns < first_column of L are unchanged, because H only changed in the trailing block.
+    // Their contribution to the trailing block is subtracted here (Schur complement).
+    auto update_trailing = [&](const BlockColumn& column, BlockColumn::const_iterator begin) {
+        for (auto a = begin; a != column.end(); ++a)
+        {
+            for (auto c = begin; c != std::next(a); ++c)
+            {
+                // a->first >= c->first
+                GetBlock(L[c->first], a->first).noalias() -= a->second * c->second.transpose();
+            }
+        }
+    };
+
+    for (int j = 0; j < first_column; ++j)
+    {
+        auto begin = L[j].lower_bound(first_column);
+        update_trailing(L[j], begin);
+    }
+
+    // Right-looking block Cholesky of the trailing block
+    for (int j = first_column; j < n; ++j)
+    {
+        auto& column = L[j];
+        auto diag    = column.begin();
+        SAIGA_ASSERT(diag->first == j);
+
+        Eigen::LLT<Block> llt(diag->second);
+        SAIGA_ASSERT(llt.info() == Eigen::Success, "PGOIncremental: The system is not positive definite.");
+        diag->second = llt.matrixL();
+
+        // L(r, j) = S(r, j) * L(j, j)^-T
+        auto L_jj = diag->second.triangularView<Eigen::Lower>();
+        for (auto it = std::next(diag); it != column.end(); ++it)
+        {
+            it->second = L_jj.solve(it->second.transpose()).transpose();
+        }
+        update_trailing(column, std::next(diag));
+    }
+}
+
+void PGOIncremental::SolveDelta()
+{
+    int n = num_vertices;
+    delta = b;
+
+    // L * y = b
+    for (int j = 0; j < n; ++j)
+    {
+        auto diag = L[j].begin();
+        delta[j]  = diag->second.triangularView<Eigen::Lower>().solve(delta[j]);
+        for (auto it = std::next(diag); it != L[j].end(); ++it)
+        {
+            delta[it->first] -= it->second * delta[j];
+        }
+    }
+
+    // L^T * x = y
+    for (int j = n - 1; j >= 0; --j)
+    {
+        auto diag = L[j].begin();
+        for (auto it = std::next(diag); it != L[j].end(); ++it)
+        {
+            delta[j] -= it->second.transpose() * delta[it->first];
+        }
+        delta[j] = diag->second.transpose().triangularView<Eigen::Upper>().solve(delta[j]);
+    }
+}
+
+void PGOIncremental::WriteBack()
+{
+    for (int i = 0; i < num_vertices; ++i)
+    {
+        if (constant[i]) continue;
+        scene->vertices[i].SetPose(Sophus::se3_expd(delta[i]) * x_lin[i]);
+    }
+}
+
+PGOIncrementalResult PGOIncremental::Update()
+{
+    SAIGA_ASSERT(scene, "Call create() first.");
+    PGOIncrementalResult result;
+
+    int first_changed = num_vertices;
+    for (int i = num_vertices; i < (int)scene->vertices.size(); ++i)
+    {
+        AddVertex(i);
+    }
+    num_vertices = scene->vertices.size();
+
+    // Gauge freedom
+    if (std::find(constant.begin(), constant.end(), true) == constant.end() && num_vertices > 0)
+    {
+        constant[0] = true;
+    }
+
+    bool large_loop_closure = false;
+    for (int k = num_edges; k < (int)scene->edges.size(); ++k)
+    {
+        auto& e = scene->edges[k];
+        SAIGA_ASSERT(e.from >= 0 && e.to >= 0 && e.from < num_vertices && e.to < num_vertices && e.from != e.to);
+
+        edge_linearization.emplace_back();
+        vertex_edges[e.from].push_back(k);
+        vertex_edges[e.to].push_back(k);
+        LinearizeEdge(k, false);
+
+        first_changed = std::min({first_changed, e.from, e.to});
+        large_loop_closure |= std::abs(e.from - e.to) > options.loop_closure_threshold;
+    }
+    num_edges = scene->edges.size();
+
+    if (large_loop_closure)
+    {
+        return FullSolve();
+    }
+
+    if (first_changed == num_vertices)
+    {
+        return result;
+    }
+
+    Factorize(first_changed);
+    SolveDelta();
+    result.refactored_vertices += num_vertices - first_changed;
+
+    std::vector<int> edge_marker(num_edges, -1);
+    for (int step = 0; step < options.max_relinearization_steps; ++step)
+    {
+        // First move the linearization points and then relinearize the edges, because an edge can connect two
+        // relinearized vertices.
+        std::vector<int> relinearized;
+        for (int i = 0; i < num_vertices; ++i)
+        {
+            if (constant[i] || delta[i].norm() <= options.relinearize_threshold) continue;
+            x_lin[i] = Sophus::se3_expd(delta[i]) * x_lin[i];
+            delta[i].setZero();
+            relinearized.push_back(i);
+        }
+        result.relinearized_vertices += relinearized.size();
+
+        first_changed = num_vertices;
+        for (auto i : relinearized)
+        {
+            for (auto k : vertex_edges[i])
+            {
+                if (edge_marker[k] == step) continue;
+                edge_marker[k] = step;
+                LinearizeEdge(k, true);
+                first_changed = std::min({first_changed, scene->edges[k].from, scene->edges[k].to});
+            }
+        }
+        if (first_changed == num_vertices) break;
+
+        Factorize(first_changed);
+        SolveDelta();
+        result.refactored_vertices += num_vertices - first_changed;
+    }
+
+    WriteBack();
+    return result;
+}
+
+PGOIncrementalResult PGOIncremental::FullSolve()
+{
+    PGOIncrementalResult result;
+    result.full_solve = true;
+
+    for (int it = 0; it < options.full_solve_iterations; ++it)
+    {
+        double max_delta = 0;
+        for (int i = 0; i < num_vertices; ++i)
+        {
+            max_delta = std::max(max_delta, delta[i].norm());
+            x_lin[i]  = Sophus::se3_expd(delta[i]) * x_lin[i];
+            delta[i].setZero();
+        }
+        if (it > 0 && max_delta < options.relinearize_threshold) break;
+
+        // Rebuild the system at the new linearization point
+        for (int i = 0; i < num_vertices; ++i)
+        {
+            H[i].clear();
+            H[i][i] = Block::Identity() * options.damping;
+            b[i].setZero();
+        }
+        for (int k = 0; k < num_edges; ++k)
+        {
+            LinearizeEdge(k, false);
+        }
+        result.relinearized_vertices += num_vertices;
+
+        Factorize(0);
+        SolveDelta();
+        result.refactored_vertices += num_vertices;
+    }
+
+    WriteBack();
+    return result;
+}
+
+}  // namespace Saiga
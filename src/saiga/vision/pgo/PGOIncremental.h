@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/vision/pgo/PGOBase.h"
+
+#include <map>
+
+namespace Saiga
+{
+struct PGOIncrementalOptions
+{
+    // Vertices whose delta (norm of the se3 tangent) exceeds this threshold are relinearized.
+    double relinearize_threshold = 1e-3;
+
+    // Maximum number of relinearize + re-solve steps per Update().
+    int max_relinearization_steps = 3;
+
+    // A new edge between vertices i and j with |i - j| > loop_closure_threshold triggers a full re-solve.
+    int loop_closure_threshold = 100;
+
+    // Gauss-Newton iterations of a full re-solve.
+    int full_solve_iterations = 5;
+
+    // Added to the diagonal. Regularizes vertices without edges. Does not change the optimum, because the damping
+    // acts on the delta to the linearization point.
+    double damping = 1e-6;
+};
+
+struct PGOIncrementalResult
+{
+    // Number of vertices (block columns) whose Cholesky factor was recomputed in this update.
+    int refactored_vertices   = 0;
+    int relinearized_vertices = 0;
+    bool full_solve           = false;
+};
+
+/**
+ * Incremental SE3 pose graph optimization for growing pose graphs.
+ *
+ * Vertices and edges are appended to the PoseGraph and Update() is called. In contrast to PGORec, the linear system
+ * and its Cholesky factorization are kept across calls. The approach is similar to iSAM:
+ *
+ *  - The variables are ordered by vertex id (= chronologically). A new edge (i, j) only changes the factor columns
+ *    >= min(i, j). For odometry edges, which connect the newest vertices, only a few columns are refactored.
+ *  - Every vertex has its own linearization point. The system is solved for the delta to these points.
+ *    Only vertices whose delta exceeds relinearize_threshold are relinearized (fluid relinearization).
+ *  - An edge spanning more than loop_closure_threshold vertices (a large loop closure) triggers a full re-solve,
+ *    which relinearizes all vertices and iterates Gauss-Newton until convergence.
+ *
+ * The estimates are written back to the pose graph after each Update(). Changes to the vertex poses of already
+ * added vertices are ignored. Edges must not be removed or reordered.
+ * If no vertex is constant, the first vertex is kept fixed.
+ *
+ * Example:
+ *
+ *    PGOIncremental pgo;
+ *    pgo.create(graph);
+ *    while (running)
+ *    {
+ *        graph.vertices.push_back(new_vertex);
+ *        graph.edges.push_back(odometry_edge);
+ *        pgo.Update();
+ *    }
+ */
+class SAIGA_VISION_API PGOIncremental : public PGOBase
+{
+   public:
+    using Block = Eigen::Matrix<double, 6, 6>;
+    // Block column of a lower triangular matrix. Maps the row to the block.
+    using BlockColumn = std::map<int, Block, std::less<int>, Eigen::aligned_allocator<std::pair<const int, Block>>>;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    PGOIncremental(const PGOIncrementalOptions& options = PGOIncrementalOptions())
+        : PGOBase("incremental PGO"), options(options)
+    {
+    }
+    virtual ~PGOIncremental() {}
+
+    // Resets the optimizer. The current vertices and edges of the scene are added by the next Update().
+    virtual void create(PoseGraph& scene) override;
+
+    // Adds the new vertices and edges of the pose graph and updates the estimate.
+    PGOIncrementalResult Update();
+
+    // Relinearizes all vertices and solves the complete system.
+    PGOIncrementalResult FullSolve();
+
+    PGOIncrementalOptions options;
+
+   private:
+    struct EdgeLinearization
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        Block H_ii, H_ij, H_jj;
+        Vec6 b_i, b_j;
+    };
+
+    PoseGraph* scene = nullptr;
+    int num_vertices = 0;
+    int num_edges    = 0;
+
+    AlignedVector<SE3> x_lin;
+    AlignedVector<Vec6> delta;
+    std::vector<char> constant;
+    std::vector<std::vector<int>> vertex_edges;
+
+    // Lower triangle of the linear system H * delta = b
+    std::vector<BlockColumn> H;
+    AlignedVector<Vec6> b;
+    AlignedVector<EdgeLinearization> edge_linearization;
+
+    // Cholesky factor of H
+    std::vector<BlockColumn> L;
+
+    void AddVertex(int i);
+    void AddBlock(int row, int col, const Block& block);
+    // Computes the linearization of edge k at x_lin and adds it to the system.
+    // The previous linearization of this edge is removed from the system.
+    void LinearizeEdge(int k, bool remove_old);
+    // Recomputes the columns [first_column, n) of L.
+    void Factorize(int first_column);
+    void SolveDelta();
+    void WriteBack();
+};
+
+}  // namespace Saiga
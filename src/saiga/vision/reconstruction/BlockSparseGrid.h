@@ -8,10 +8,16 @@
 #include "saiga/core/geometry/all.h"
 #include "saiga/core/image/all.h"
 #include "saiga/core/util/BinaryFile.h"
+#include "saiga/core/util/DataStructures/ChunkedPool.h"
 #include "saiga/core/util/ProgressBar.h"
 #include "saiga/core/util/Thread/SpinLock.h"
 #include "saiga/core/util/Thread/omp.h"
 
+#include "BlockStorage.h"
+
+#include <atomic>
+#include <memory>
+
 
 namespace Saiga
 {
@@ -28,13 +34,11 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     // Given a VOXEL_BLOCK_SIZE of 8 a voxel blocks consists of 8*8*8=512 voxels.
     //
     // Due to the sparse storage, each voxel block has to known it's own index.
-    // The next_index points to the next voxel block in the same hash bucket.
     struct VoxelBlock
     {
         //        Voxel data[VOXEL_BLOCK_SIZE][VOXEL_BLOCK_SIZE][VOXEL_BLOCK_SIZE];
         std::array<std::array<std::array<Voxel, 8>, 8>, 8> data;
         VoxelBlockIndex index = VoxelBlockIndex(-973454, -973454, -973454);
-        int next_index        = -1;
 
         // the weight of all voxels is 0
         bool Empty()
@@ -53,34 +57,50 @@ struct SAIGA_TEMPLATE BlockSparseGrid
         }
     };
 
+    // Entry of the hash map: block index -> position in the block pool.
+    // The nodes of one hash bucket form a linked list. New nodes are prepended with a CAS on the bucket head.
+    struct HashNode
+    {
+        VoxelBlockIndex index;
+        int next = -1;
+        // -1 while the block is allocated by the inserting thread
+        std::atomic_int block_id = -1;
+
+        HashNode() {}
+        HashNode(const HashNode& other) { *this = other; }
+        HashNode& operator=(const HashNode& other)
+        {
+            index    = other.index;
+            next     = other.next;
+            block_id = other.block_id.load();
+            return *this;
+        }
+    };
 
-    BlockSparseGrid(float voxel_size = 0.01, int reserve_blocks = 1000, int hash_size = 100000)
-        : voxel_size(voxel_size),
-          voxel_size_inv(1.0 / voxel_size),
-          hash_size(hash_size),
-          blocks(reserve_blocks),
-          first_hashed_block(hash_size, -1),
-          hash_locks(hash_size)
 
+    BlockSparseGrid(float voxel_size = 0.01, int reserve_blocks = 1000, int hash_size = 100000)
+        : voxel_size(voxel_size), voxel_size_inv(1.0 / voxel_size), hash_size(hash_size), blocks(reserve_blocks)
     {
         block_size_inv = 1.0 / (voxel_size * VOXEL_BLOCK_SIZE);
+        ResetHash();
     }
 
     BlockSparseGrid(const BlockSparseGrid& other)
     {
-        voxel_size         = other.voxel_size;
-        voxel_size_inv     = other.voxel_size_inv;
-        hash_size          = other.hash_size;
-        blocks             = other.blocks;
-        first_hashed_block = other.first_hashed_block;
-        hash_locks         = std::vector<SpinLock>(hash_size);
-        current_blocks     = other.current_blocks.load();
+        SAIGA_ASSERT(!other.storage, "Streaming grids can not be copied.");
+        voxel_size     = other.voxel_size;
+        voxel_size_inv = other.voxel_size_inv;
+        block_size_inv = other.block_size_inv;
+        hash_size      = other.hash_size;
+        blocks         = other.blocks;
+        current_blocks = other.current_blocks.load();
+        RebuildHash();
     }
 
     size_t Memory()
     {
         size_t mem_blocks = blocks.size() * sizeof(VoxelBlock);
-        size_t mem_hash   = first_hashed_block.size() * sizeof(int);
+        size_t mem_hash   = first_hashed_block.size() * sizeof(int) + hash_nodes.size() * sizeof(HashNode);
         return mem_blocks + mem_hash + sizeof(*this);
     }
 
@@ -90,6 +110,7 @@ struct SAIGA_TEMPLATE BlockSparseGrid
 
     // Insert a new block into the TSDF and returns a pointer to it.
     // If the block already exists, nothing is inserted.
+    // In streaming mode an evicted block is paged in instead.
     VoxelBlock* InsertBlock(const VoxelBlockIndex& i)
     {
         int h      = H(i);
@@ -101,22 +122,15 @@ struct SAIGA_TEMPLATE BlockSparseGrid
             return block;
         }
 
-        // Create block and insert as the first element.
-        int new_index = current_blocks.fetch_add(1);
-
-        if (new_index >= (int)blocks.size())
+        if (storage && storage->Contains(i))
         {
-            blocks.resize(blocks.size() * 2);
+            return PageIn(i);
         }
 
-        int hash                 = H(i);
-        auto* new_block          = &blocks[new_index];
-        new_block->index         = i;
-        new_block->next_index    = first_hashed_block[hash];
-        first_hashed_block[hash] = new_index;
-        return new_block;
+        return AllocateBlock(i, h);
     }
 
+    // Not thread safe.
     bool EraseBlock(const VoxelBlockIndex& i)
     {
         int block_id = GetBlockId(i);
@@ -126,87 +140,93 @@ struct SAIGA_TEMPLATE BlockSparseGrid
         int h = H(i);
         if (!EraseBlockWithHole(i, h)) return false;
 
-        if (block_id == current_blocks - 1)
-        {
-            // The removed block is at the end of the array -> just remove
-            //            std::cout << "remove end" << std::endl;
-            current_blocks--;
-            return true;
-        }
-        else
+        int last_id = current_blocks - 1;
+        if (block_id != last_id)
         {
-            SAIGA_ASSERT(current_blocks >= 2);
             // The removed block is somewhere in the middle
-            // -> Remove last
-            auto last_b = blocks[current_blocks - 1];
+            // -> Move the last block into the hole
+            auto& last_b = blocks[last_id];
             SAIGA_ASSERT(last_b.index != i);
 
-            int last_h = H(last_b.index);
-            SAIGA_ASSERT(GetBlockId(last_b.index) == current_blocks - 1);
-
-            EraseBlockWithHole(last_b.index, last_h);
-            auto* new_block = &blocks[block_id];
+            auto* last_node = FindNode(last_b.index, H(last_b.index));
+            SAIGA_ASSERT(last_node && last_node->block_id == last_id);
 
-            *new_block                 = last_b;
-            new_block->next_index      = first_hashed_block[last_h];
-            first_hashed_block[last_h] = block_id;
-            current_blocks--;
-            return true;
+            blocks[block_id]    = last_b;
+            last_node->block_id = block_id;
         }
+        current_blocks--;
+        return true;
     }
 
+    // Removes the block from the hash map, but not from the block array.
+    // Not thread safe.
     bool EraseBlockWithHole(const VoxelBlockIndex& i, int hash)
     {
-        int* block_id_ptr = &first_hashed_block[hash];
+        int prev_id = -1;
+        int node_id = first_hashed_block[hash];
 
-        bool found = false;
-
-        while (*block_id_ptr != -1)
+        while (node_id != -1)
         {
-            auto& b = blocks[*block_id_ptr];
-
-            if (b.index == i)
-            {
-                found = true;
-                break;
-            }
-
-            block_id_ptr = &b.next_index;
+            if (hash_nodes[node_id].index == i) break;
+            prev_id = node_id;
+            node_id = hash_nodes[node_id].next;
         }
-        if (!found) return false;
+        if (node_id == -1) return false;
 
-        *block_id_ptr = blocks[*block_id_ptr].next_index;
+        int next = hash_nodes[node_id].next;
+        if (prev_id == -1)
+        {
+            first_hashed_block[hash] = next;
+        }
+        else
+        {
+            hash_nodes[prev_id].next = next;
+        }
+        free_hash_nodes.push_back(node_id);
         return true;
     }
 
-    VoxelBlock* InsertBlockLock(const VoxelBlockIndex& i)
+    // Lock-free insertion, which can be called concurrently from multiple threads.
+    // Lookups (GetBlock, GetVoxel, ...) can run at the same time.
+    // Does not page in evicted blocks, therefore it can not be used in streaming mode.
+    VoxelBlock* InsertBlockConcurrent(const VoxelBlockIndex& i)
     {
-        int h = H(i);
+        SAIGA_ASSERT(!storage);
+        int h    = H(i);
+        int head = first_hashed_block[h].load(std::memory_order_acquire);
 
-        std::unique_lock lock(hash_locks[h]);
+        int block_id = FindInList(i, head, -1);
+        if (block_id >= 0) return &blocks[block_id];
 
-        auto block = GetBlock(i, h);
+        int node_id = num_hash_nodes.fetch_add(1);
+        hash_nodes.EnsureCapacity(node_id + 1);
+        auto& node = hash_nodes[node_id];
+        node.index = i;
+        node.block_id.store(-1, std::memory_order_relaxed);
 
-        if (block)
+        while (true)
         {
-            // block already exists
-            return block;
-        }
-
-        // Create block and insert as the first element.
-        int new_index = current_blocks.fetch_add(1);
+            node.next = head;
+            if (first_hashed_block[h].compare_exchange_weak(head, node_id, std::memory_order_acq_rel,
+                                                            std::memory_order_acquire))
+            {
+                break;
+            }
 
-        if (new_index >= (int)blocks.size())
-        {
-            SAIGA_EXIT_ERROR("Resizing not allowed during parallel insertion!");
+            // Other threads have prepended nodes. 'head' is now the new bucket head, so only the new nodes have to be
+            // checked.
+            block_id = FindInList(i, head, node.next);
+            if (block_id >= 0)
+            {
+                // The same block was inserted by another thread. Our node was never linked and stays unused.
+                return &blocks[block_id];
+            }
         }
 
-        int hash                 = H(i);
-        auto* new_block          = &blocks[new_index];
-        new_block->index         = i;
-        new_block->next_index    = first_hashed_block[hash];
-        first_hashed_block[hash] = new_index;
-        return new_block;
+        // The node is linked, therefore no other thread can create this block.
+        block_id = NewBlock(i);
+        node.block_id.store(block_id, std::memory_order_release);
+        return &blocks[block_id];
     }
 
     void AllocateAroundPoint(const vec3& position, int r = 1)
@@ -351,8 +371,107 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     }
 
 
+    // Releases unused memory of the block pool.
     void Compact() { blocks.resize(current_blocks); }
 
+    // ========== Out-of-core streaming ==========
+    //
+    // In streaming mode only a subset of the blocks is kept in memory. All other blocks are stored in a swap file
+    // (see BlockStorage.h). GetBlock() and GetVoxel() only see the resident blocks. Evicted blocks are paged back in
+    // by InsertBlock(), PageIn() and PageInRegion().
+
+    void EnableStreaming(const std::string& swap_file, bool compress = true)
+    {
+        storage = std::make_shared<BlockStorage>(swap_file, compress);
+    }
+
+    bool Streaming() const { return storage != nullptr; }
+
+    // Writes the block to the swap file and removes it from memory.
+    void EvictBlock(const VoxelBlockIndex& i)
+    {
+        SAIGA_ASSERT(storage);
+        auto* block = GetBlock(i);
+        SAIGA_ASSERT(block);
+        storage->Write(i, &block->data, sizeof(block->data));
+        EraseBlock(i);
+    }
+
+    // Evicts all resident blocks outside of the given region.
+    // Returns the number of evicted blocks.
+    int EvictOutside(const iRect<3>& region)
+    {
+        int evicted = 0;
+        for (int i = 0; i < current_blocks; ++i)
+        {
+            auto index = blocks[i].index;
+            if (!region.Contains(index))
+            {
+                // EraseBlock moves the last block to position i
+                EvictBlock(index);
+                evicted++;
+                i--;
+            }
+        }
+        return evicted;
+    }
+
+    void EvictAll()
+    {
+        while (current_blocks > 0)
+        {
+            EvictBlock(blocks[current_blocks - 1].index);
+        }
+    }
+
+    // Loads the block from the swap file.
+    // Returns nullptr if the block is not stored.
+    VoxelBlock* PageIn(const VoxelBlockIndex& i)
+    {
+        SAIGA_ASSERT(storage);
+        if (!storage->Contains(i)) return nullptr;
+        SAIGA_ASSERT(!GetBlock(i));
+
+        auto* block = AllocateBlock(i, H(i));
+        storage->Read(i, &block->data, sizeof(block->data));
+        return block;
+    }
+
+    // Pages in all evicted blocks inside the region.
+    void PageInRegion(const iRect<3>& region)
+    {
+        SAIGA_ASSERT(storage);
+        for (auto& index : region.ToPoints())
+        {
+            PageIn(index);
+        }
+    }
+
+    void PageInAll()
+    {
+        if (!storage) return;
+        for (auto& index : storage->StoredBlocks())
+        {
+            PageIn(index);
+        }
+    }
+
+    // The indices of all blocks, resident and evicted.
+    std::vector<VoxelBlockIndex> AllBlockIndices()
+    {
+        std::vector<VoxelBlockIndex> result;
+        for (int i = 0; i < current_blocks; ++i)
+        {
+            result.push_back(blocks[i].index);
+        }
+        if (storage)
+        {
+            auto stored = storage->StoredBlocks();
+            result.insert(result.end(), stored.begin(), stored.end());
+        }
+        return result;
+    }
+
     int Size() { return current_blocks; }
 
    public:
@@ -364,22 +483,52 @@ struct SAIGA_TEMPLATE BlockSparseGrid
 
     unsigned int hash_size;
     std::atomic_int current_blocks = 0;
-    std::vector<VoxelBlock> blocks;
-    std::vector<int> first_hashed_block;
-    std::vector<SpinLock> hash_locks;
 
+    // The pool grows in chunks and never moves existing blocks.
+    ChunkedPool<VoxelBlock, 8, (1 << 14)> blocks;
+
+    // Head of the node list for each hash bucket
+    std::vector<std::atomic_int> first_hashed_block;
+    ChunkedPool<HashNode, 12> hash_nodes;
+    std::atomic_int num_hash_nodes = 0;
+    // Nodes released by EraseBlock, which are reused by the serial InsertBlock
+    std::vector<int> free_hash_nodes;
+
+    // Only used in streaming mode
+    std::shared_ptr<BlockStorage> storage;
 
     void Clear()
     {
         current_blocks = 0;
-        for (auto& b : blocks)
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            blocks[i] = VoxelBlock();
+        }
+        ResetHash();
+    }
+
+    // Clears the hash map and inserts all blocks in [0, current_blocks) again.
+    void RebuildHash()
+    {
+        ResetHash();
+        for (int b = 0; b < current_blocks; ++b)
         {
-            b = VoxelBlock();
+            int h = H(blocks[b].index);
+            SAIGA_ASSERT(GetBlockId(blocks[b].index, h) == -1);
+            LinkNode(blocks[b].index, h, b);
         }
+    }
+
+    void ResetHash()
+    {
+        first_hashed_block = std::vector<std::atomic_int>(hash_size);
         for (auto& i : first_hashed_block)
         {
             i = -1;
         }
+        hash_nodes.clear();
+        num_hash_nodes = 0;
+        free_hash_nodes.clear();
     }
 
 
@@ -392,25 +541,92 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     }
 
 
-    int GetBlockId(const VoxelBlockIndex& i) { return GetBlockId(i, H(i)); }
+    // Appends a zero initialized block to the pool and returns its id.
+    // Thread safe.
+    int NewBlock(const VoxelBlockIndex& i)
+    {
+        int new_index = current_blocks.fetch_add(1);
+        blocks.EnsureCapacity(new_index + 1);
 
-    // Returns the actual (memory) block id
-    // returns -1 if it does not exist
-    int GetBlockId(const VoxelBlockIndex& i, int hash)
+        auto& new_block = blocks[new_index];
+        new_block.data  = {};
+        new_block.index = i;
+        return new_index;
+    }
+
+    // Inserts a hash node for the given block as the first element of the bucket.
+    // Not thread safe.
+    void LinkNode(const VoxelBlockIndex& i, int hash, int block_id)
     {
-        int block_id = first_hashed_block[hash];
+        int node_id;
+        if (!free_hash_nodes.empty())
+        {
+            node_id = free_hash_nodes.back();
+            free_hash_nodes.pop_back();
+        }
+        else
+        {
+            node_id = num_hash_nodes.fetch_add(1);
+            hash_nodes.EnsureCapacity(node_id + 1);
+        }
+
+        auto& node               = hash_nodes[node_id];
+        node.index               = i;
+        node.block_id            = block_id;
+        node.next                = first_hashed_block[hash];
+        first_hashed_block[hash] = node_id;
+    }
+
+    // Create block and insert it into the hash map.
+    // The block must not exist. Not thread safe.
+    VoxelBlock* AllocateBlock(const VoxelBlockIndex& i, int hash)
+    {
+        int new_index = NewBlock(i);
+        LinkNode(i, hash, new_index);
+        return &blocks[new_index];
+    }
 
-        while (block_id != -1)
+    // Searches the bucket list from node_id until end_node_id (exclusive).
+    // Returns the block id or -1 if it was not found.
+    int FindInList(const VoxelBlockIndex& i, int node_id, int end_node_id)
+    {
+        while (node_id != end_node_id)
         {
-            auto* block = &blocks[block_id];
-            if (block->index == i)
+            auto& node = hash_nodes[node_id];
+            if (node.index == i)
             {
-                break;
+                // Wait until the inserting thread has published the block.
+                // yield() gives up the time slice if the inserting thread was preempted.
+                int block_id;
+                for (unsigned k = 0; (block_id = node.block_id.load(std::memory_order_acquire)) == -1; ++k)
+                {
+                    yield(k);
+                }
+                return block_id;
             }
+            node_id = node.next;
+        }
+        return -1;
+    }
 
-            block_id = block->next_index;
+    HashNode* FindNode(const VoxelBlockIndex& i, int hash)
+    {
+        int node_id = first_hashed_block[hash];
+        while (node_id != -1)
+        {
+            if (hash_nodes[node_id].index == i) return &hash_nodes[node_id];
+            node_id = hash_nodes[node_id].next;
         }
-        return block_id;
+        return nullptr;
+    }
+
+    int GetBlockId(const VoxelBlockIndex& i) { return GetBlockId(i, H(i)); }
+
+    // Returns the actual (memory) block id
+    // returns -1 if it does not exist
+    int GetBlockId(const VoxelBlockIndex& i, int hash)
+    {
+        return FindInList(i, first_hashed_block[hash].load(std::memory_order_acquire), -1);
     }
 
     VoxelBlock* GetBlock(const VoxelBlockIndex& i, int hash)
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "BlockStorage.h"
+
+#include "saiga/core/util/assert.h"
+#include "saiga/core/util/zlib.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Saiga
+{
+BlockStorage::BlockStorage(const std::string& file, bool compress) : file(file), compress(compress)
+{
+#ifndef SAIGA_USE_ZLIB
+    this->compress = false;
+#endif
+    strm.open(file, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!strm.is_open())
+    {
+        SAIGA_EXIT_ERROR("Could not open block storage file " + file);
+    }
+}
+
+BlockStorage::~BlockStorage()
+{
+    strm.close();
+    std::remove(file.c_str());
+}
+
+bool BlockStorage::Contains(const ivec3& index) const
+{
+    auto it = slots.find(index);
+    return it != slots.end() && it->second.stored;
+}
+
+void BlockStorage::Write(const ivec3& index, const void* data, size_t size)
+{
+    const char* write_data = (const char*)data;
+    size_t write_size      = size;
+
+#ifdef SAIGA_USE_ZLIB
+    std::vector<unsigned char> compressed_data;
+    if (compress)
+    {
+        compressed_data = Saiga::compress(data, size);
+        write_data      = (const char*)compressed_data.data();
+        write_size      = compressed_data.size();
+    }
+#endif
+
+    auto& slot = slots[index];
+    SAIGA_ASSERT(!slot.stored);
+
+    if (write_size > slot.capacity)
+    {
+        // Does not fit into the old slot -> append
+        slot.offset   = file_size;
+        slot.capacity = write_size;
+        file_size += write_size;
+    }
+    slot.size   = write_size;
+    slot.stored = true;
+    num_stored++;
+
+    strm.seekp(slot.offset);
+    strm.write(write_data, write_size);
+    SAIGA_ASSERT(strm.good());
+}
+
+bool BlockStorage::Read(const ivec3& index, void* data, size_t size)
+{
+    if (!Peek(index, data, size)) return false;
+
+    // The slot is kept, so a later Write of the same block can reuse the space.
+    slots[index].stored = false;
+    num_stored--;
+    return true;
+}
+
+bool BlockStorage::Peek(const ivec3& index, void* data, size_t size)
+{
+    auto it = slots.find(index);
+    if (it == slots.end() || !it->second.stored) return false;
+
+    auto& slot = it->second;
+    std::vector<char> read_data(slot.size);
+    strm.seekg(slot.offset);
+    strm.read(read_data.data(), slot.size);
+    SAIGA_ASSERT(strm.good());
+
+    if (compress)
+    {
+#ifdef SAIGA_USE_ZLIB
+        auto uncompressed_data = Saiga::uncompress(read_data.data());
+        SAIGA_ASSERT(uncompressed_data.size() == size);
+        memcpy(data, uncompressed_data.data(), size);
+#endif
+    }
+    else
+    {
+        SAIGA_ASSERT(read_data.size() == size);
+        memcpy(data, read_data.data(), size);
+    }
+    return true;
+}
+
+std::vector<ivec3> BlockStorage::StoredBlocks() const
+{
+    std::vector<ivec3> result;
+    result.reserve(num_stored);
+    for (auto& s : slots)
+    {
+        if (s.second.stored) result.push_back(s.first);
+    }
+    return result;
+}
+
+}  // namespace Saiga
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/config.h"
+#include "saiga/core/geometry/iRect.h"
+#include "saiga/core/math/math.h"
+
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+namespace Saiga
+{
+// Out-of-core storage for the blocks of a BlockSparseGrid.
+//
+// All blocks are written to a single swap file. If saiga was compiled with zlib support, each block is compressed
+// before writing. The file offset of each block is kept in an in-memory index. When a block is written a second
+// time (after it was paged in and evicted again) the old slot in the file is reused if the new data fits.
+//
+// This class is not thread safe.
+class SAIGA_VISION_API BlockStorage
+{
+   public:
+    BlockStorage(const std::string& file, bool compress = true);
+    ~BlockStorage();
+
+    BlockStorage(const BlockStorage&) = delete;
+    BlockStorage& operator=(const BlockStorage&) = delete;
+
+    // True if the block is currently stored in the file.
+    bool Contains(const ivec3& index) const;
+
+    void Write(const ivec3& index, const void* data, size_t size);
+
+    // Reads the block and removes it from the storage.
+    // Returns false if the block is not stored.
+    bool Read(const ivec3& index, void* data, size_t size);
+
+    // Reads the block without removing it from the storage.
+    // Returns false if the block is not stored.
+    bool Peek(const ivec3& index, void* data, size_t size);
+
+    // The indices of all stored blocks
+    std::vector<ivec3> StoredBlocks() const;
+
+    int Size() const { return num_stored; }
+    size_t FileSize() const { return file_size; }
+
+   private:
+    struct Slot
+    {
+        size_t offset   = 0;
+        size_t size     = 0;
+        size_t capacity = 0;
+        bool stored     = false;
+    };
+
+    std::string file;
+    std::fstream strm;
+    bool compress;
+
+    std::unordered_map<ivec3, Slot> slots;
+    int num_stored   = 0;
+    size_t file_size = 0;
+};
+
+}  // namespace Saiga
@@ -95,29 +95,27 @@ int EightPointRansac::solve(ArrayView<const Vec2> _points1, ArrayView<const Vec2
 
 
 
-    int idx;
-    idx = compute(points1.size());
+    int num_inliers = compute(points1.size());
 
 
 
 #pragma omp single
     {
-        //            std::cout << "best idx " << idx << std::endl;
-        bestE = models[idx];
+        bestE = bestModel;
 
 
         bestInlierMatches.clear();
-        bestInlierMatches.reserve(numInliers[idx]);
+        bestInlierMatches.reserve(num_inliers);
         for (int i = 0; i < N; ++i)
         {
-            if (inliers[idx][i]) bestInlierMatches.push_back(i);
+            if (bestInliers[i]) bestInlierMatches.push_back(i);
         }
 
-        inlierMask = inliers[idx];
+        inlierMask = bestInliers;
     }
 
 
-    return numInliers[idx];
+    return num_inliers;
 }
 
 bool EightPointRansac::computeModel(const RansacBase::Subset& set, EightPointRansac::Model& model)
@@ -68,20 +68,12 @@ int HomographyRansac::solve(ArrayView<const Vec2> _points1, ArrayView<const Vec2
     points1 = _points1;
     points2 = _points2;
 
-    int idx = 0;
-
 #pragma omp parallel num_threads(params.threads)
     {
-        int l_idx = compute(points1.size());
-
-        if (OMP::getThreadNum() == 0)
-        {
-            // fix write/write face condition
-            idx = l_idx;
-        }
+        compute(points1.size());
     }
-    bestH = models[idx];
-    return numInliers[idx];
+    bestH = bestModel;
+    return bestNumInliers;
 }
 
 bool HomographyRansac::computeModel(const RansacBase::Subset& set, HomographyRansac::Model& model)
@@ -374,4 +374,17 @@ std::pair<std::array<std::array<vec3, 3>, 16>, int> MarchingCubes(const std::arr
     return {triangles, ntriang};
 }
 
+const int* MarchingCubesTriangleEdges(int cube_case)
+{
+    return triTable[cube_case];
+}
+
+std::array<int, 2> MarchingCubesEdgeCorners(int edge)
+{
+    // Same order as the VertexInterp calls above
+    static constexpr int edge_corners[12][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6},
+                                                {6, 7}, {7, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+    return {edge_corners[edge][0], edge_corners[edge][1]};
+}
+
 }  // namespace Saiga
@@ -19,4 +19,11 @@ namespace Saiga
 std::pair<std::array<std::array<vec3, 3>, 16>, int> SAIGA_VISION_API
 MarchingCubes(const std::array<std::pair<vec3, float>, 8>& cell, float isolevel);
 
+// Low level interface for indexed extraction (see SparseTSDF::ExtractSurfaceIndexed).
+// The case index has bit i set if the value of corner i is below the isolevel.
+// Returns the triangles of this case as edge ids, terminated by -1.
+// Edge e connects the corners MarchingCubesEdgeCorners(e).
+SAIGA_VISION_API const int* MarchingCubesTriangleEdges(int cube_case);
+SAIGA_VISION_API std::array<int, 2> MarchingCubesEdgeCorners(int edge);
+
 }  // namespace Saiga
@@ -174,7 +174,8 @@ float Distance(const std::vector<Triangle>& triangles, const vec3& p)
 }
 
 
-std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, float voxel_size, int r)
+std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, float voxel_size, int r,
+                                       MeshToTSDFSign sign_mode)
 {
     std::shared_ptr<SparseTSDF> tsdf = std::make_shared<SparseTSDF>(voxel_size);
 
@@ -228,7 +229,7 @@ std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, f
 
 
 
-    AccelerationStructure::ObjectMedianBVH bvh(triangles);
+    AccelerationStructure::SAHBVH bvh(triangles);
     bvh.triangle_epsilon = 0;
     {
         ProgressBar bar(std::cout, "M2TSDF Compute Unsigned Distance", tsdf->current_blocks);
@@ -271,6 +272,36 @@ std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, f
 
 
 
+    if (sign_mode == MeshToTSDFSign::WindingNumber)
+    {
+        bvh.ComputeWindingNumberData();
+
+        ProgressBar bar(std::cout, "M2TSDF Compute Sign", tsdf->current_blocks);
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < tsdf->current_blocks; ++i)
+        {
+            auto& b = tsdf->blocks[i];
+            for (int i = 0; i < tsdf->VOXEL_BLOCK_SIZE; ++i)
+            {
+                for (int j = 0; j < tsdf->VOXEL_BLOCK_SIZE; ++j)
+                {
+                    for (int k = 0; k < tsdf->VOXEL_BLOCK_SIZE; ++k)
+                    {
+                        vec3 global_pos = tsdf->GlobalPosition(b.index, i, j, k);
+                        auto& cell      = b.data[i][j][k];
+
+                        // |w| instead of w to support both triangle orientations
+                        if (std::abs(bvh.WindingNumber(global_pos)) < 0.5f)
+                        {
+                            cell.distance = std::abs(cell.distance);
+                        }
+                    }
+                }
+            }
+            bar.addProgress(1);
+        }
+    }
+    else
     {
         std::vector<Vec3> directions = {Vec3(1, 0, 0),  Vec3(0, 1, 0),  Vec3(0, 0, 1),
                                         Vec3(-1, 0, 0), Vec3(0, -1, 0), Vec3(0, 0, -1)};
@@ -306,7 +337,7 @@ std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, f
                             Ray r;
                             r.direction = d.cast<float>();
                             r.origin    = global_pos.cast<float>();
-                            if (bvh.getAll(r).empty())
+                            if (!bvh.AnyHit(r))
                             {
                                 cell.distance = std::abs(cell.distance);
                                 break;
@@ -42,8 +42,19 @@ SAIGA_VISION_API SimplePointCloud MeshToPointCloudPoissonDisc2(const std::vector
 
 SAIGA_VISION_API float Distance(const std::vector<Triangle>& triangles, const vec3& p);
 
+// How MeshToTSDF decides if a voxel is inside or outside of the mesh.
+enum class MeshToTSDFSign
+{
+    // Generalized winding number (see AccelerationStructure::BVH::WindingNumber).
+    // Requires consistently oriented triangles, but works with small holes.
+    WindingNumber,
+    // Outside, if at least one of 106 rays does not hit the mesh. Requires a watertight mesh.
+    RayCasting,
+};
+
 // Convert a list of triangles to a block-sparse TSDF
-// This method is slow, because it computes the point-surface distances analytically.
+// The point-surface distances are computed analytically with a SAH BVH.
 SAIGA_VISION_API std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, float voxel_size,
-                                                        int r);
+                                                        int r,
+                                                        MeshToTSDFSign sign_mode = MeshToTSDFSign::WindingNumber);
 }  // namespace Saiga
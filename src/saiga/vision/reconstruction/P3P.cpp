@@ -200,23 +200,22 @@ int P3PRansac::solve(ArrayView<const Vec3> _worldPoints, ArrayView<const Vec2> _
     }
 
 
-    int idx;
-    idx = compute(_worldPoints.size());
+    int num_inliers = compute(_worldPoints.size());
 
 #pragma omp single
     {
-        bestT      = models[idx];
-        inlierMask = inliers[idx];
+        bestT      = bestModel;
+        inlierMask = bestInliers;
 
         bestInlierMatches.clear();
-        bestInlierMatches.reserve(numInliers[idx]);
+        bestInlierMatches.reserve(num_inliers);
         for (int i = 0; i < N; ++i)
         {
-            if (inliers[idx][i]) bestInlierMatches.push_back(i);
+            if (bestInliers[i]) bestInlierMatches.push_back(i);
         }
     }
 
-    return numInliers[idx];
+    return num_inliers;
 }
 
 bool P3PRansac::computeModel(const RansacBase::Subset& set, P3PRansac::Model& model)
@@ -6,8 +6,11 @@
 
 #include "SparseTSDF.h"
 
+#include "saiga/core/util/Algorithm.h"
 #include "saiga/core/util/file.h"
 #include "saiga/core/util/zlib.h"
+
+#include <fstream>
 namespace Saiga
 {
 void SparseTSDF::EraseEmptyBlocks()
@@ -27,19 +30,32 @@ void SparseTSDF::EraseEmptyBlocks()
 std::vector<std::vector<SparseTSDF::Triangle>> SparseTSDF::ExtractSurface(double iso, float outlier_factor,
                                                                           float min_weight, int threads, bool verbose)
 {
+    return ExtractSurface(iso, outlier_factor, min_weight, threads, verbose, Bounds());
+}
+
+std::vector<std::vector<SparseTSDF::Triangle>> SparseTSDF::ExtractSurface(double iso, float outlier_factor,
+                                                                          float min_weight, int threads, bool verbose,
+                                                                          const iRect<3>& region)
+{
+    std::vector<int> block_ids;
+    for (int b = 0; b < current_blocks; ++b)
+    {
+        if (region.Contains(blocks[b].index)) block_ids.push_back(b);
+    }
+
     std::stringstream sstrm;
-    ProgressBar loading_bar(verbose ? std::cout : sstrm, "Ex. Surface", current_blocks);
+    ProgressBar loading_bar(verbose ? std::cout : sstrm, "Ex. Surface", block_ids.size());
 
     //        std::vector<std::vector<std::array<vec3, 3>>> triangle_soup_thread(threads);
 
     // Each block generates a list of triangles
-    std::vector<std::vector<Triangle>> triangle_soup_per_block(current_blocks);
+    std::vector<std::vector<Triangle>> triangle_soup_per_block(block_ids.size());
 
 #pragma omp parallel for num_threads(threads)
-    for (int b = 0; b < current_blocks; ++b)
+    for (int b = 0; b < (int)block_ids.size(); ++b)
     {
         auto& triangle_soup = triangle_soup_per_block[b];
-        auto& block         = blocks[b];
+        auto& block         = blocks[block_ids[b]];
         // Compute positions and values of (n+1) x (n+1) x (n+1) block.
         // The (+1) data point is taken from neighbouring blocks to close the holes.
         std::pair<vec3, float> local_data[VOXEL_BLOCK_SIZE + 1][VOXEL_BLOCK_SIZE + 1][VOXEL_BLOCK_SIZE + 1];
@@ -137,6 +153,51 @@ std::vector<std::vector<SparseTSDF::Triangle>> SparseTSDF::ExtractSurface(double
     return triangle_soup_per_block;
 }
 
+std::vector<std::vector<SparseTSDF::Triangle>> SparseTSDF::ExtractSurfaceStreaming(double iso, float outlier_factor,
+                                                                                   float min_weight, int threads,
+                                                                                   bool verbose, int chunk_size)
+{
+    SAIGA_ASSERT(Streaming());
+    SAIGA_ASSERT(chunk_size > 0);
+
+    // Group all blocks by chunk
+    std::unordered_map<ivec3, int> chunk_map;
+    for (auto& index : AllBlockIndices())
+    {
+        ivec3 chunk(iFloorDiv(index.x(), chunk_size), iFloorDiv(index.y(), chunk_size),
+                    iFloorDiv(index.z(), chunk_size));
+        chunk_map[chunk]++;
+    }
+
+    std::vector<ivec3> chunks;
+    for (auto& c : chunk_map) chunks.push_back(c.first);
+    std::sort(chunks.begin(), chunks.end(), [](const ivec3& a, const ivec3& b) {
+        return std::make_tuple(a.z(), a.y(), a.x()) < std::make_tuple(b.z(), b.y(), b.x());
+    });
+
+    std::stringstream sstrm;
+    ProgressBar loading_bar(verbose ? std::cout : sstrm, "Ex. Surface", chunks.size());
+
+    std::vector<std::vector<Triangle>> triangle_soup_per_chunk(chunks.size());
+    for (int c = 0; c < (int)chunks.size(); ++c)
+    {
+        iRect<3> region(chunks[c] * chunk_size, chunks[c] * chunk_size + ivec3(chunk_size, chunk_size, chunk_size));
+
+        // The marching cubes of a block also read the first voxel of the neighbours in +x, +y, +z direction
+        iRect<3> resident_region(region.begin, region.end + ivec3::Ones());
+        EvictOutside(resident_region);
+        PageInRegion(resident_region);
+
+        auto triangles = ExtractSurface(iso, outlier_factor, min_weight, threads, false, region);
+        for (auto& t : triangles)
+        {
+            triangle_soup_per_chunk[c].insert(triangle_soup_per_chunk[c].end(), t.begin(), t.end());
+        }
+        loading_bar.addProgress(1);
+    }
+    return triangle_soup_per_chunk;
+}
+
 UnifiedMesh SparseTSDF::CreateMesh(const std::vector<std::vector<SparseTSDF::Triangle>>& triangles, bool post_process)
 {
     UnifiedMesh mesh;
@@ -160,33 +221,384 @@ UnifiedMesh SparseTSDF::CreateMesh(const std::vector<std::vector<SparseTSDF::Tri
     return mesh;
 }
 
+UnifiedMesh SparseTSDF::ExtractSurfaceIndexed(double iso, float outlier_factor, float min_weight, int threads,
+                                              bool verbose)
+{
+    constexpr int N = VOXEL_BLOCK_SIZE;
+    // Number of voxel edges owned by one block. An edge is owned by the block of its lower voxel.
+    constexpr int EDGES_PER_BLOCK = N * N * N * 3;
+    // The sample grid of a block covers [-1, N+1] to compute the gradient at all edge vertices.
+    constexpr int S = N + 3;
+
+    // Corner offsets (z, y, x) of a cell. Same order as in ExtractSurface.
+    static constexpr int cell_corners[8][3] = {{0, 0, 0}, {0, 0, 1}, {1, 0, 1}, {1, 0, 0},
+                                               {0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0}};
+
+    // The lower voxel (z, y, x) and the axis of the 12 cell edges
+    std::array<std::array<int, 4>, 12> cell_edges;
+    for (int e = 0; e < 12; ++e)
+    {
+        auto [c0, c1] = MarchingCubesEdgeCorners(e);
+        for (int d = 0; d < 3; ++d)
+        {
+            cell_edges[e][d] = std::min(cell_corners[c0][d], cell_corners[c1][d]);
+            if (cell_corners[c0][d] != cell_corners[c1][d]) cell_edges[e][3] = d;
+        }
+    }
+
+    struct BlockSurface
+    {
+        // The owned edges with a surface vertex sorted by id. Edge id = ((z * N + y) * N + x) * 3 + axis
+        std::vector<int> edges;
+        std::vector<vec3> positions;
+        std::vector<vec3> normals;
+
+        // Triangles as edge references: owner * EDGES_PER_BLOCK + edge id
+        std::vector<ivec3> triangles;
+
+        // Block id of this block and the neighbours in +x, +y, +z direction.
+        // owner = dz * 4 + dy * 2 + dx
+        std::array<int, 8> owner_block;
+    };
+
+    int num_blocks = current_blocks;
+    std::vector<BlockSurface> surfaces(num_blocks);
+
+    std::stringstream sstrm;
+    ProgressBar loading_bar(verbose ? std::cout : sstrm, "Ex. Surface", num_blocks);
+
+#pragma omp parallel for num_threads(threads)
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        auto& surface = surfaces[b];
+        auto& block   = blocks[b];
+
+        // Look up all 26 neighbours once
+        const VoxelBlock* neighbours[3][3][3];
+        for (int dz = -1; dz <= 1; ++dz)
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    int id = GetBlockId(block.index + ivec3(dx, dy, dz));
+                    neighbours[dz + 1][dy + 1][dx + 1] = id >= 0 ? &blocks[id] : nullptr;
+                    if (dz >= 0 && dy >= 0 && dx >= 0) surface.owner_block[dz * 4 + dy * 2 + dx] = id;
+                }
+            }
+        }
+
+        // Local sample grid. Invalid samples are infinite.
+        float sdf[S][S][S];
+        for (int z = -1; z <= N + 1; ++z)
+        {
+            int bz = z < 0 ? 0 : (z < N ? 1 : 2);
+            for (int y = -1; y <= N + 1; ++y)
+            {
+                int by = y < 0 ? 0 : (y < N ? 1 : 2);
+                for (int x = -1; x <= N + 1; ++x)
+                {
+                    int bx      = x < 0 ? 0 : (x < N ? 1 : 2);
+                    auto* read  = neighbours[bz][by][bx];
+                    float value = std::numeric_limits<float>::infinity();
+                    if (read)
+                    {
+                        auto& v = read->data[z - (bz - 1) * N][y - (by - 1) * N][x - (bx - 1) * N];
+                        if (v.weight > min_weight) value = v.distance;
+                    }
+                    sdf[z + 1][y + 1][x + 1] = value;
+                }
+            }
+        }
+        auto sample = [&](int z, int y, int x) { return sdf[z + 1][y + 1][x + 1]; };
+
+        // Central differences. One sided at the border of the valid region.
+        auto gradient = [&](int z, int y, int x) {
+            vec3 g = vec3::Zero();
+            float c = sample(z, y, x);
+            for (int d = 0; d < 3; ++d)
+            {
+                int o[3] = {0, 0, 0};
+                o[d]     = 1;
+                float p  = sample(z + o[0], y + o[1], x + o[2]);
+                float m  = sample(z - o[0], y - o[1], x - o[2]);
+
+                float diff = 0;
+                if (std::isfinite(p) && std::isfinite(m))
+                    diff = (p - m) * 0.5f;
+                else if (std::isfinite(p))
+                    diff = p - c;
+                else if (std::isfinite(m))
+                    diff = c - m;
+                // d = 0 is the z axis
+                g(2 - d) = diff;
+            }
+            return g;
+        };
+
+        // Vertices of the owned edges
+        for (int z = 0; z < N; ++z)
+        {
+            for (int y = 0; y < N; ++y)
+            {
+                for (int x = 0; x < N; ++x)
+                {
+                    float v0 = sample(z, y, x);
+                    if (!std::isfinite(v0)) continue;
+
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        int o[3] = {0, 0, 0};
+                        o[axis]  = 1;
+                        float v1 = sample(z + o[0], y + o[1], x + o[2]);
+                        if (!std::isfinite(v1) || (v0 < iso) == (v1 < iso)) continue;
+
+                        // Same special cases as VertexInterp in MarchingCubes.cpp
+                        float mu;
+                        if (std::abs(iso - v0) < 0.00001)
+                            mu = 0;
+                        else if (std::abs(iso - v1) < 0.00001)
+                            mu = 1;
+                        else if (std::abs(v0 - v1) < 0.00001)
+                            mu = 0;
+                        else
+                            mu = (iso - v0) / (v1 - v0);
+
+                        vec3 p0 = GlobalPosition(block.index, z, y, x);
+                        vec3 p1 = GlobalPosition(block.index, z + o[0], y + o[1], x + o[2]);
+                        vec3 n  = (1 - mu) * gradient(z, y, x) + mu * gradient(z + o[0], y + o[1], x + o[2]);
+
+                        float l = n.norm();
+                        surface.edges.push_back(((z * N + y) * N + x) * 3 + axis);
+                        surface.positions.push_back(p0 + mu * (p1 - p0));
+                        surface.normals.push_back(l < 0.00001 ? n : n / l);
+                    }
+                }
+            }
+        }
+
+        // Triangles of the cells. A cell is processed by the block of its lower corner.
+        for (int z = 0; z < N; ++z)
+        {
+            for (int y = 0; y < N; ++y)
+            {
+                for (int x = 0; x < N; ++x)
+                {
+                    bool finite   = true;
+                    float abs_max = 0;
+                    int cube_case = 0;
+                    for (int c = 0; c < 8; ++c)
+                    {
+                        float v = sample(z + cell_corners[c][0], y + cell_corners[c][1], x + cell_corners[c][2]);
+                        finite &= std::isfinite(v);
+                        abs_max = std::max(abs_max, std::abs(v));
+                        if (v < iso) cube_case |= (1 << c);
+                    }
+                    if (!finite || abs_max > outlier_factor * voxel_size) continue;
+
+                    const int* tri_edges = MarchingCubesTriangleEdges(cube_case);
+                    for (int t = 0; tri_edges[t] != -1; t += 3)
+                    {
+                        ivec3 tri;
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            auto& e = cell_edges[tri_edges[t + i]];
+                            int lz = z + e[0], ly = y + e[1], lx = x + e[2];
+                            int dz = lz / N, dy = ly / N, dx = lx / N;
+                            int id = (((lz - dz * N) * N + (ly - dy * N)) * N + (lx - dx * N)) * 3 + e[3];
+                            tri(i) = (dz * 4 + dy * 2 + dx) * EDGES_PER_BLOCK + id;
+                        }
+                        surface.triangles.push_back(tri);
+                    }
+                }
+            }
+        }
+        loading_bar.addProgress(1);
+    }
+
+    // Output offsets of each block
+    std::vector<int> vertex_offset(num_blocks), triangle_offset(num_blocks);
+    int num_vertices = 0, num_triangles = 0;
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        vertex_offset[b]   = num_vertices;
+        triangle_offset[b] = num_triangles;
+        num_vertices += surfaces[b].edges.size();
+        num_triangles += surfaces[b].triangles.size();
+    }
+
+    UnifiedMesh mesh;
+    mesh.position.resize(num_vertices);
+    mesh.normal.resize(num_vertices);
+    mesh.triangles.resize(num_triangles);
+
+#pragma omp parallel for num_threads(threads)
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        auto& surface = surfaces[b];
+        std::copy(surface.positions.begin(), surface.positions.end(), mesh.position.begin() + vertex_offset[b]);
+        std::copy(surface.normals.begin(), surface.normals.end(), mesh.normal.begin() + vertex_offset[b]);
+
+        for (int t = 0; t < (int)surface.triangles.size(); ++t)
+        {
+            ivec3 tri;
+            for (int i = 0; i < 3; ++i)
+            {
+                int ref   = surface.triangles[t](i);
+                int owner = surface.owner_block[ref / EDGES_PER_BLOCK];
+                SAIGA_ASSERT(owner >= 0);
+
+                // Both corners of the edge are valid -> the owner has created the vertex
+                auto& edges = surfaces[owner].edges;
+                auto it     = std::lower_bound(edges.begin(), edges.end(), ref % EDGES_PER_BLOCK);
+                SAIGA_ASSERT(it != edges.end() && *it == ref % EDGES_PER_BLOCK);
+                tri(i) = vertex_offset[owner] + int(it - edges.begin());
+            }
+            mesh.triangles[triangle_offset[b] + t] = tri;
+        }
+    }
+
+    // Remove vertices, which are only adjacent to discarded (outlier) cells.
+    std::vector<int> vertex_map(num_vertices, 0);
+    for (auto& t : mesh.triangles)
+    {
+        for (int i = 0; i < 3; ++i) vertex_map[t(i)] = 1;
+    }
+    int num_used = Saiga::exclusive_scan(vertex_map.begin(), vertex_map.end(), vertex_map.begin(), 0);
+    if (num_used < num_vertices)
+    {
+        for (auto& t : mesh.triangles)
+        {
+            for (int i = 0; i < 3; ++i) t(i) = vertex_map[t(i)];
+        }
+        // vertex_map is monotonic -> compact in place
+        for (int v = 0; v < num_vertices; ++v)
+        {
+            int target = vertex_map[v];
+            bool used  = v + 1 < num_vertices ? vertex_map[v + 1] != target : target < num_used;
+            if (!used) continue;
+            mesh.position[target] = mesh.position[v];
+            mesh.normal[target]   = mesh.normal[v];
+        }
+        mesh.position.resize(num_used);
+        mesh.normal.resize(num_used);
+    }
+
+    mesh.SetVertexColor(vec4(1, 1, 1, 1));
+    return mesh;
+}
+
+
+// The TSDF files start with a magic number and a version. Files without it use the legacy layout, which stored the
+// complete block array (including the unused reserve and the hash chains) followed by the hash bucket heads.
+static constexpr uint32_t tsdf_file_magic   = 0x46445354;  // "TSDF"
+static constexpr uint32_t tsdf_file_version = 2;
+
+// Voxel block of the legacy format with the intrusive hash chain
+struct LegacyVoxelBlock
+{
+    decltype(SparseTSDF::VoxelBlock::data) data;
+    SparseTSDF::VoxelBlockIndex index;
+    int next_index;
+};
+
+template <typename Stream>
+static void ReadTSDF(Stream& strm, SparseTSDF& tsdf)
+{
+    uint32_t magic;
+    strm >> magic;
+    if (magic == tsdf_file_magic)
+    {
+        uint32_t version;
+        strm >> version;
+        SAIGA_ASSERT(version == tsdf_file_version, "Unknown TSDF file version " + std::to_string(version));
+        strm >> tsdf.voxel_size >> tsdf.voxel_size_inv >> tsdf.block_size_inv >> tsdf.hash_size >>
+            tsdf.current_blocks;
+        // Only the used blocks are stored. The hash map is recomputed.
+        tsdf.blocks.resize(tsdf.current_blocks);
+        for (int i = 0; i < tsdf.current_blocks; ++i)
+        {
+            strm >> tsdf.blocks[i];
+        }
+    }
+    else
+    {
+        // Legacy layout: the first value is the voxel size
+        std::memcpy(&tsdf.voxel_size, &magic, sizeof(float));
+        strm >> tsdf.voxel_size_inv >> tsdf.block_size_inv >> tsdf.hash_size >> tsdf.current_blocks;
+        std::vector<LegacyVoxelBlock> legacy_blocks;
+        std::vector<int> legacy_hash;
+        strm >> legacy_blocks >> legacy_hash;
+        SAIGA_ASSERT(tsdf.current_blocks <= (int)legacy_blocks.size(), "Invalid TSDF file");
+
+        tsdf.blocks.resize(tsdf.current_blocks);
+        for (int i = 0; i < tsdf.current_blocks; ++i)
+        {
+            tsdf.blocks[i].data  = legacy_blocks[i].data;
+            tsdf.blocks[i].index = legacy_blocks[i].index;
+        }
+    }
+    tsdf.RebuildHash();
+}
+
+// Calls write(block) for the resident blocks followed by the evicted blocks of a streaming TSDF.
+// The evicted blocks are read from the swap file one at a time and stay evicted.
+template <typename Write>
+static void WriteAllBlocks(SparseTSDF& tsdf, Write write)
+{
+    for (int i = 0; i < tsdf.current_blocks; ++i)
+    {
+        write(tsdf.blocks[i]);
+    }
+    if (tsdf.storage)
+    {
+        SparseTSDF::VoxelBlock block;
+        for (auto& index : tsdf.storage->StoredBlocks())
+        {
+            block.index = index;
+            tsdf.storage->Peek(index, &block.data, sizeof(block.data));
+            write(block);
+        }
+    }
+}
+
+static int NumAllBlocks(const SparseTSDF& tsdf)
+{
+    return tsdf.current_blocks + (tsdf.storage ? tsdf.storage->Size() : 0);
+}
 
 void SparseTSDF::Save(const std::string& file)
 {
     BinaryFile strm(file, std::ios_base::out);
-    strm << voxel_size << voxel_size_inv << block_size_inv << hash_size << current_blocks;
-    strm << blocks;
-    strm << first_hashed_block;
+    strm << tsdf_file_magic << tsdf_file_version;
+    strm << voxel_size << voxel_size_inv << block_size_inv << hash_size << NumAllBlocks(*this);
+    WriteAllBlocks(*this, [&](const VoxelBlock& block) { strm << block; });
 }
 
 void SparseTSDF::Load(const std::string& file)
 {
     BinaryFile strm(file, std::ios_base::in);
     SAIGA_ASSERT(strm.strm.is_open());
-    strm >> voxel_size >> voxel_size_inv >> block_size_inv >> hash_size >> current_blocks;
-    strm >> blocks;
-    strm >> first_hashed_block;
+    ReadTSDF(strm, *this);
 }
 
 void SparseTSDF::SaveCompressed(const std::string& file)
 {
 #ifdef SAIGA_USE_ZLIB
-    BinaryOutputVector strm;
-    strm << voxel_size << voxel_size_inv << block_size_inv << hash_size << current_blocks;
-    strm << blocks;
-    strm << first_hashed_block;
-    auto compressed = compress(strm.data.data(), strm.data.size());
-    File::saveFileBinary(file, compressed.data(), compressed.size());
+    // The blocks are streamed into the compressor, which avoids an uncompressed copy of the whole TSDF.
+    std::ofstream ostrm(file, std::ios::binary);
+    SAIGA_ASSERT(ostrm.is_open(), "Could not open file " + file);
+    CompressedOutputStream strm(ostrm);
+    auto write = [&](const auto& v) { strm.Write(&v, sizeof(v)); };
+    write(tsdf_file_magic);
+    write(tsdf_file_version);
+    write(voxel_size);
+    write(voxel_size_inv);
+    write(block_size_inv);
+    write(hash_size);
+    write(NumAllBlocks(*this));
+    WriteAllBlocks(*this, write);
+    strm.Close();
 #else
     SAIGA_EXIT_ERROR("zlib not found.");
 #endif
@@ -198,9 +610,7 @@ void SparseTSDF::LoadCompressed(const std::string& file)
     auto compressed_data = File::loadFileBinary(file);
     auto data            = uncompress(compressed_data.data());
     BinaryInputVector strm(data.data(), data.size());
-    strm >> voxel_size >> voxel_size_inv >> block_size_inv >> hash_size >> current_blocks;
-    strm >> blocks;
-    strm >> first_hashed_block;
+    ReadTSDF(strm, *this);
 #else
     SAIGA_EXIT_ERROR("zlib not found.");
 #endif
@@ -210,14 +620,12 @@ bool SparseTSDF::operator==(const SparseTSDF& other) const
 {
     if (voxel_size != other.voxel_size || voxel_size_inv != other.voxel_size_inv ||
         block_size_inv != other.block_size_inv || hash_size != other.hash_size ||
-        current_blocks != other.current_blocks || first_hashed_block != other.first_hashed_block)
+        current_blocks != other.current_blocks)
     {
         return false;
     }
 
-    if (blocks.size() != other.blocks.size()) return false;
-
-    for (int i = 0; i < (int)std::min(blocks.size(), other.blocks.size()); ++i)
+    for (int i = 0; i < current_blocks; ++i)
     {
         auto& b1 = blocks[i];
         auto& b2 = other.blocks[i];
@@ -342,7 +750,8 @@ void SparseTSDF::SetForAll(float distance, float weight)
 std::ostream& operator<<(std::ostream& strm, const SparseTSDF& tsdf)
 {
     size_t mem_blocks = tsdf.blocks.size() * sizeof(SparseTSDF::VoxelBlock);
-    size_t mem_hash   = tsdf.first_hashed_block.size() * sizeof(int);
+    size_t mem_hash   = tsdf.first_hashed_block.size() * sizeof(int) +
+                      tsdf.hash_nodes.size() * sizeof(SparseTSDF::HashNode);
 
     // Compute some statistics
     std::vector<double> distances;
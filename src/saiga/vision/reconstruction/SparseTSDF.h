@@ -9,7 +9,6 @@
 #include "saiga/core/image/all.h"
 #include "saiga/core/util/BinaryFile.h"
 #include "saiga/core/util/ProgressBar.h"
-#include "saiga/core/util/Thread/SpinLock.h"
 #include "saiga/core/util/Thread/omp.h"
 #include "saiga/core/model/UnifiedMesh.h"
 #include "BlockSparseGrid.h"
@@ -51,16 +50,7 @@ struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
     SparseTSDF(const std::string& file) { Load(file); }
 
 
-    SparseTSDF(const SparseTSDF& other)
-    {
-        voxel_size         = other.voxel_size;
-        voxel_size_inv     = other.voxel_size_inv;
-        hash_size          = other.hash_size;
-        blocks             = other.blocks;
-        first_hashed_block = other.first_hashed_block;
-        hash_locks         = std::vector<SpinLock>(hash_size);
-        current_blocks     = other.current_blocks.load();
-    }
+    SparseTSDF(const SparseTSDF& other) : BlockSparseGrid(other) {}
 
     SAIGA_VISION_API friend std::ostream& operator<<(std::ostream& os, const SparseTSDF& tsdf);
 
@@ -281,9 +271,27 @@ struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
     std::vector<std::vector<Triangle>> ExtractSurface(double iso, float outlier_factor, float min_weight, int threads,
                                                       bool verbose);
 
+    // Same as above, but only the resident blocks inside 'region' generate triangles.
+    // The neighbours in +x, +y, +z direction must also be resident to close the holes at the region boundary.
+    std::vector<std::vector<Triangle>> ExtractSurface(double iso, float outlier_factor, float min_weight, int threads,
+                                                      bool verbose, const iRect<3>& region);
+
+    // Surface extraction in streaming mode (see BlockSparseGrid::EnableStreaming).
+    // The grid is processed in chunks of chunk_size^3 blocks. Only one chunk (+ border) is resident at a time.
+    // Returns for each chunk a list of triangles.
+    std::vector<std::vector<Triangle>> ExtractSurfaceStreaming(double iso, float outlier_factor, float min_weight,
+                                                               int threads, bool verbose, int chunk_size = 16);
+
     // Create a triangle mesh from the list of triangles
     UnifiedMesh CreateMesh(const std::vector<std::vector<Triangle>>& triangles, bool post_process);
 
+    // Indexed surface extraction. The parameters are the same as in ExtractSurface.
+    //
+    // In contrast to ExtractSurface + CreateMesh, no triangle soup is generated. Each surface vertex belongs to one
+    // voxel edge and is shared by all adjacent cells, also across block boundaries. The mesh is therefore welded
+    // without a RemoveDoubles pass. The vertex normals are computed from the sdf gradient.
+    UnifiedMesh ExtractSurfaceIndexed(double iso, float outlier_factor, float min_weight, int threads, bool verbose);
+
     void ClampDistance(float distance);
 
     // Sets all voxels to 0 where the abs distance is > theshold
@@ -297,6 +305,7 @@ struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
     void SetForAll(float distance, float weight);
 
 
+    // In streaming mode the evicted blocks are read from the swap file and saved as well.
     void Save(const std::string& file);
     void Load(const std::string& file);
 
@@ -7,6 +7,8 @@
 
 #include "saiga/core/geometry/all.h"
 #include "saiga/core/imgui/imgui.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
+#include "saiga/vision/cameraModel/RemapTable.h"
 
 #include "MarchingCubes.h"
 #include "fstream"
@@ -21,34 +23,45 @@ void FusionScene::Preprocess()
     triangle_soup.clear();
     mesh = UnifiedMesh();
     tsdf = std::make_unique<SparseTSDF>(params.voxelSize, params.block_count, params.hash_size);
+    if (params.streaming)
+    {
+        tsdf->EnableStreaming(params.streaming_file);
+    }
 
     if (images.empty()) return;
 
-    depth_map_size = images.front().depthMap.dimensions();
-    unproject_undistort_map.create(depth_map_size);
+    depth_map_size          = images.front().depthMap.dimensions();
+    unproject_undistort_map = UnprojectUndistortMap(K, dis, depth_map_size);
+}
 
-    ProgressBar loading_bar(params.verbose ? std::cout : strm, "Preprocess ", depth_map_size.rows);
-#pragma omp parallel for
-    for (int i = 0; i < unproject_undistort_map.rows; ++i)
-    {
-        for (auto j : unproject_undistort_map.colRange())
-        {
-            Vec2 p(j, i);
-            p = K.unproject2(p);
-            p = undistortPointGN(p, p, dis);
 
-            unproject_undistort_map(i, j) = p.cast<float>();
-        }
-        loading_bar.addProgress(1);
+iRect<3> FusionScene::ActiveRegion(const FusionImage& image)
+{
+    // Bounding box of the view frustum, which is cut at the maximum integration distance.
+    // AnalyseSparseStructure() does not allocate blocks beyond that distance.
+    float max_depth = params.maxIntegrationDistance;
+    auto invV       = image.V.inverse().cast<float>();
+
+    iRect<3> region(tsdf->GetBlockIndex(invV.translation()));
+    for (auto corner : {vec2(0, 0), vec2(depth_map_size.w, 0), vec2(0, depth_map_size.h),
+                        vec2(depth_map_size.w, depth_map_size.h)})
+    {
+        Vec2 p   = K.unproject2(corner.cast<double>());
+        p        = undistortPointGN(p, p, dis);
+        vec3 pos = invV * (vec3(p(0), p(1), 1) * max_depth);
+        region   = iRect<3>(region, iRect<3>(tsdf->GetBlockIndex(pos)));
     }
+    return region.Expand(params.streaming_border);
 }
 
-
-
 void FusionScene::AnalyseSparseStructure()
 {
     ProgressBar loading_bar(params.verbose ? std::cout : strm, "Analysing  ", Size());
 
+    // The rows of each depth map are processed in parallel with the lock-free insertion.
+    // In streaming mode InsertBlock() may page in blocks from the swap file, which is not thread safe.
+    bool concurrent = !tsdf->Streaming();
+
     // #pragma omp parallel for
     for (int i = 0; i < Size(); ++i)
     {
@@ -63,9 +76,8 @@ void FusionScene::AnalyseSparseStructure()
 
         //        std::set<std::tuple<int, int, int>> leset;
 
-        //        for (auto i : dm.depthMap.rowRange())
-        for (int i = 0; i < dm.depthMap.rows; ++i)
-        {
+        // Allocates all blocks in the truncation range along the rays of one image row.
+        auto process_row = [&](int i) {
             for (auto j : dm.depthMap.colRange())
             {
                 auto depth = dm.depthMap(i, j);
@@ -157,7 +169,14 @@ void FusionScene::AnalyseSparseStructure()
                 while (true)
                 {
                     //                    leset.insert({idCurrentVoxel(0), idCurrentVoxel(1), idCurrentVoxel(2)});
-                    tsdf->InsertBlock(idCurrentVoxel);
+                    if (concurrent)
+                    {
+                        tsdf->InsertBlockConcurrent(idCurrentVoxel);
+                    }
+                    else
+                    {
+                        tsdf->InsertBlock(idCurrentVoxel);
+                    }
                     // Traverse voxel grid
                     if (tMax.x() < tMax.y() && tMax.x() < tMax.z())
                     {
@@ -179,6 +198,18 @@ void FusionScene::AnalyseSparseStructure()
                     }
                 }
             }
+        };
+
+        if (concurrent)
+        {
+            ParallelFor(0, dm.depthMap.rows, process_row);
+        }
+        else
+        {
+            for (int i = 0; i < dm.depthMap.rows; ++i)
+            {
+                process_row(i);
+            }
         }
 
         //        dm.truncated_blocks.clear();
@@ -199,9 +230,7 @@ void FusionScene::ComputeWeight()
         return;
     }
     ProgressBar loading_bar(params.verbose ? std::cout : strm, "Comp Weight", Size());
-#pragma omp parallel for
-    for (int i = 0; i < Size(); ++i)
-    {
+    ParallelFor(0, Size(), [&](int i) {
         auto& dm = images[i];
 
         dm.confidence.create(dm.depthMap.dimensions());
@@ -249,7 +278,7 @@ void FusionScene::ComputeWeight()
         }
         //        exit(0);
         loading_bar.addProgress(1);
-    }
+    });
 }
 
 void FusionScene::Visibility()
@@ -266,9 +295,7 @@ void FusionScene::Visibility()
         }
 
 
-#pragma omp parallel for
-        for (int i = 0; i < Size(); ++i)
-        {
+        ParallelFor(0, Size(), [&](int i) {
             auto& dm = images[i];
             dm.visible_blocks.clear();
 
@@ -303,7 +330,7 @@ void FusionScene::Visibility()
                 dm.visible_blocks.push_back(block.index);
             }
             loading_bar.addProgress(1);
-        }
+        });
     }
 }
 
@@ -318,9 +345,7 @@ void FusionScene::Integrate()
         {
             auto& dm = images[i];
 
-#pragma omp parallel for
-            for (int i = 0; i < (int)dm.visible_blocks.size(); ++i)
-            {
+            ParallelFor(0, (int)dm.visible_blocks.size(), [&](int i) {
                 auto& id    = dm.visible_blocks[i];
                 auto* block = tsdf->GetBlock(id);
                 SAIGA_ASSERT(block);
@@ -505,7 +530,7 @@ void FusionScene::Integrate()
                         }
                     }
                 }
-            }
+            });
 
             loading_bar.addProgress(1);
         }
@@ -718,8 +743,23 @@ void FusionScene::ExtractMesh()
 {
     mesh = UnifiedMesh();
 
-    auto triangle_soup_per_block =
-        tsdf->ExtractSurface(params.extract_iso, params.extract_outlier_factor, 0, 4, params.verbose);
+    bool indexed = params.extract_indexed && !tsdf->Streaming();
+
+    std::vector<std::vector<SparseTSDF::Triangle>> triangle_soup_per_block;
+    if (indexed)
+    {
+        mesh = tsdf->ExtractSurfaceIndexed(params.extract_iso, params.extract_outlier_factor, 0, 4, params.verbose);
+    }
+    else if (tsdf->Streaming())
+    {
+        triangle_soup_per_block = tsdf->ExtractSurfaceStreaming(params.extract_iso, params.extract_outlier_factor, 0,
+                                                                4, params.verbose, params.streaming_chunk_size);
+    }
+    else
+    {
+        triangle_soup_per_block =
+            tsdf->ExtractSurface(params.extract_iso, params.extract_outlier_factor, 0, 4, params.verbose);
+    }
 
     int sum = 0;
     for (auto& v : triangle_soup_per_block)
@@ -732,7 +772,10 @@ void FusionScene::ExtractMesh()
         triangle_soup_inclusive_prefix_sum.push_back(sum);
     }
 
-    mesh = tsdf->CreateMesh(triangle_soup_per_block, params.post_process_mesh);
+    if (!indexed)
+    {
+        mesh = tsdf->CreateMesh(triangle_soup_per_block, params.post_process_mesh);
+    }
     //    for (auto& t : triangle_soup)
     //    {
     //        VertexNC tri[3];
@@ -764,6 +807,23 @@ void FusionScene::ExtractMesh()
 void FusionScene::Fuse()
 {
     std::cout << "Fusing " << Size() << " depth maps..." << std::endl;
+
+    if (params.streaming)
+    {
+        // Integrate the depth maps one by one, so that only the blocks around the current frustum are resident.
+        SAIGA_ASSERT(!params.point_based);
+        std::vector<FusionImage> input;
+        std::swap(input, images);
+        for (int i = 0; i < (int)input.size(); ++i)
+        {
+            FuseIncrement(input[i], i == 0);
+        }
+        images = std::move(input);
+        ExtractMesh();
+        std::cout << *tsdf << std::endl;
+        return;
+    }
+
     Preprocess();
     AnalyseSparseStructure();
     ComputeWeight();
@@ -789,6 +849,14 @@ void FusionScene::FuseIncrement(const FusionImage& image, bool first)
     {
         Preprocess();
     }
+    if (tsdf->Streaming())
+    {
+        // Blocks inside the frustum, which were evicted by an earlier image, have to be resident. Otherwise the
+        // visibility test skips them and they miss the free space updates.
+        auto region = ActiveRegion(image);
+        tsdf->EvictOutside(region);
+        tsdf->PageInRegion(region);
+    }
     AnalyseSparseStructure();
     ComputeWeight();
     Integrate();
@@ -57,6 +57,11 @@ struct SAIGA_VISION_API FusionParams
     int block_count        = 25 * 1000;
     bool post_process_mesh = true;
 
+    // Use SparseTSDF::ExtractSurfaceIndexed, which creates a welded mesh with gradient normals.
+    // In this mode FusionScene::triangle_soup is not filled and post_process_mesh is ignored.
+    // Not available in streaming mode.
+    bool extract_indexed = false;
+
     // added to projet image points.
     // for example -0.5 for opengl renders
     Vec2 ip_offset = Vec2::Zero();
@@ -66,6 +71,16 @@ struct SAIGA_VISION_API FusionParams
     bool point_based     = false;
     std::string out_file = "outmesh_sparse.off";
 
+    // Out-of-core fusion for large scenes.
+    // The depth maps are integrated one by one. Before each integration, all blocks outside the frustum of the
+    // current camera (+ streaming_border blocks) are compressed and evicted to streaming_file. The mesh is then
+    // extracted in chunks of streaming_chunk_size^3 blocks. The peak memory therefore only depends on the size of
+    // the active region.
+    bool streaming             = false;
+    std::string streaming_file = "tsdf_blocks.swap";
+    int streaming_border       = 1;
+    int streaming_chunk_size   = 16;
+
     void imgui();
 };
 
@@ -113,6 +128,8 @@ struct SAIGA_VISION_API FusionScene
 
 
     void Preprocess();
+    // The blocks which can be touched when integrating this image. Only used in streaming mode.
+    iRect<3> ActiveRegion(const FusionImage& image);
     void AnalyseSparseStructure();
     void ComputeWeight();
     void Visibility();
@@ -173,21 +173,21 @@ void BARec::init()
     pointCameraCountsScan.resize(m);
     observations = 0;
 
+    // The image points might have changed since the last compress()
+    scene.buildObservationTable();
+    auto& obs = scene.observationTable();
+
     std::vector<int> innerElements;
+    innerElements.reserve(obs.size());
     for (auto&& info : validImages)
     {
         auto imgId  = info.sceneImageId;
         auto offset = info.variableId;
-        //        std::cout << imgId << " " << offset << std::endl;
         if (offset == -1) continue;
 
-        auto& img = scene.images[imgId];
-
-        for (auto& ip : img.stereoPoints)
+        for (int o = obs.imageBegin(imgId); o < obs.imageEnd(imgId); ++o)
         {
-            if (ip.wp == -1) continue;
-
-            int j = pointToValidMap[ip.wp];
+            int j = pointToValidMap[obs.pointId[o]];
             cameraPointCounts[offset]++;
             pointCameraCounts[j]++;
             innerElements.push_back(j);
@@ -223,6 +223,8 @@ void BARec::init()
 
     SAIGA_ASSERT(baOptions.helper_threads > 0);
     localChi2.resize(baOptions.helper_threads);
+    monoBatches.resize(baOptions.helper_threads);
+    stereoBatches.resize(baOptions.helper_threads);
     pointDiagTemp.resize(baOptions.helper_threads - 1);
     pointResTemp.resize(baOptions.helper_threads - 1);
     for (auto& a : pointDiagTemp) a.resize(m);
@@ -237,6 +239,15 @@ void BARec::init()
                               ? Eigen::Recursive::LinearSolverOptions::SolverType::Direct
                               : Eigen::Recursive::LinearSolverOptions::SolverType::Iterative;
     loptions.buildExplizitSchur = optimizationOptions.buildExplizitSchur;
+    loptions.mixedPrecision     = optimizationOptions.mixedPrecision;
+
+    bool iterative = loptions.solverType == Eigen::Recursive::LinearSolverOptions::SolverType::Iterative;
+    if (loptions.mixedPrecision && (baOptions.solver_threads != 1 || !iterative))
+    {
+        std::cerr << "BARec: mixedPrecision is only implemented for the iterative solver with solver_threads == 1. "
+                     "The linear system is solved in double."
+                  << std::endl;
+    }
 
     if (baOptions.solver_threads == 1)
     {
@@ -339,6 +350,41 @@ void BARec::init()
     }
 }
 
+void BARec::FillBatch(int image, ObservationBatch& mono, ObservationBatch& stereo)
+{
+    Scene& scene = *_scene;
+    auto& obs    = scene.observationTable();
+    int begin    = obs.imageBegin(image);
+    int end      = obs.imageEnd(image);
+
+    int num_stereo = 0;
+    for (int o = begin; o < end; ++o) num_stereo += obs.IsStereoOrDepth(o);
+    mono.batch.Resize(end - begin - num_stereo);
+    mono.observations.resize(end - begin - num_stereo);
+    stereo.batch.Resize(num_stereo);
+    stereo.observations.resize(num_stereo);
+
+    int m = 0, s = 0;
+    for (int o = begin; o < end; ++o)
+    {
+        BlockBAScalar w = obs.weight[o] * scene.scale();
+        int j           = pointToValidMap[obs.pointId[o]];
+        SAIGA_ASSERT(j >= 0);
+        auto& wp = x_v[j];
+
+        if (obs.IsStereoOrDepth(o))
+        {
+            stereo.batch.Set(s, wp, obs.pixel[o], obs.GetStereoPoint(o, scene.bf), w, w * scene.stereo_weight);
+            stereo.observations[s++] = o;
+        }
+        else
+        {
+            mono.batch.Set(m, wp, obs.pixel[o], w);
+            mono.observations[m++] = o;
+        }
+    }
+}
+
 double BARec::computeQuadraticForm()
 {
     Scene& scene = *_scene;
@@ -368,8 +414,10 @@ double BARec::computeQuadraticForm()
     {
         int tid = OMP::getThreadNum();
 
-        double& newChi2 = localChi2[tid];
-        newChi2         = 0;
+        double& newChi2    = localChi2[tid];
+        newChi2            = 0;
+        auto& mono_batch   = monoBatches[tid];
+        auto& stereo_batch = stereoBatches[tid];
         BDiag* bdiagArray;
         BRes* bresArray;
 
@@ -400,7 +448,7 @@ double BARec::computeQuadraticForm()
             // int imgid        = info.sceneImageId;
             int actualOffset = info.variableId;
 
-            int k = A.w.outerIndexPtr()[actualOffset];
+            int k_begin = A.w.outerIndexPtr()[actualOffset];
 
             bool constant = actualOffset == -1;
             //            std::cout << "img " << imgid << " " << actualOffset << " " << k << " const " << constant <<
@@ -412,6 +460,7 @@ double BARec::computeQuadraticForm()
             auto& extr   = x_u[info.validId];
             auto& camera = scene.intrinsics[img.intr];
             StereoCamera4 scam(camera, scene.bf);
+            auto& obs = scene.observationTable();
 
 
 
@@ -425,83 +474,43 @@ double BARec::computeQuadraticForm()
                 targetPoseRes.setZero();
             }
 
-            for (auto& ip : img.stereoPoints)
-            {
-                if (ip.wp == -1) continue;
-                if (ip.outlier)
-                {
-                    if (!constant)
-                    {
-                        A.w.valuePtr()[k].get().setZero();
-                        ++k;
-                    }
-                    continue;
-                }
-                BlockBAScalar w = ip.weight * scene.scale();
-                int j           = pointToValidMap[ip.wp];
-
+            // Outliers are not part of the observation table
+            int begin = obs.imageBegin(info.sceneImageId);
+            int end   = obs.imageEnd(info.sceneImageId);
+            FillBatch(info.sceneImageId, mono_batch, stereo_batch);
+            BundleAdjustmentBatch(camera, extr, mono_batch.batch);
+            BundleAdjustmentStereoBatch(scam, extr, stereo_batch.batch);
 
-                auto& wp = x_v[j];
-
-                WElem& targetPosePoint = A.w.valuePtr()[k].get();
-
-                BDiag& targetPointPoint = bdiagArray[j];
-                BRes& targetPointRes    = bresArray[j];
-
-                if (ip.IsStereoOrDepth())
+            auto accumulate = [&](auto rows, const ObservationBatch& batch, double huber) {
+                constexpr int Rows = decltype(rows)::value;
+                for (int l = 0; l < batch.batch.size(); ++l)
                 {
-                    auto stereo_point = ip.GetStereoPoint(scene.bf);
+                    int o = batch.observations[l];
+                    int j = pointToValidMap[obs.pointId[o]];
 
-                    Matrix<double, 3, 6> JrowPose;
-                    Matrix<double, 3, 3> JrowPoint;
-                    auto [res, depth] = BundleAdjustmentStereo(scam, ip.point, stereo_point, extr, wp, w,
-                                                               w * scene.stereo_weight, &JrowPose, &JrowPoint);
+                    Vector<T, Rows> res          = batch.batch.template Residual<Rows>(l);
+                    Matrix<T, Rows, 6> JrowPose  = batch.batch.template JacobianPose<Rows>(l);
+                    Matrix<T, Rows, 3> JrowPoint = batch.batch.template JacobianPoint<Rows>(l);
+                    BDiag& targetPointPoint      = bdiagArray[j];
+                    BRes& targetPointRes         = bresArray[j];
 
                     T loss_weight = 1.0;
                     auto res_2    = res.squaredNorm();
-                    if (baOptions.huberStereo > 0)
+                    if (huber > 0)
                     {
-                        auto rw = Kernel::HuberLoss<T>(baOptions.huberStereo, res_2);
-                        //                        auto rw     = Kernel::CauchyLoss<T>(baOptions.huberStereo, res_2);
+                        auto rw     = Kernel::HuberLoss<T>(huber, res_2);
                         res_2       = rw(0);
                         loss_weight = rw(1);
                     }
-                    //                    if (!valid_depth) loss_weight = 0;
-
-
                     newChi2 += res_2;
 
                     if (!constant)
                     {
-                        auto& targetPosePose = A.u.diagonal()(actualOffset).get();
-                        auto& targetPoseRes  = b.u(actualOffset).get();
-                        targetPosePose += loss_weight * JrowPose.transpose() * JrowPose;
-                        targetPosePoint = loss_weight * JrowPose.transpose() * JrowPoint;
-                        targetPoseRes -= loss_weight * JrowPose.transpose() * res;
-                    }
-                    targetPointPoint += loss_weight * JrowPoint.transpose() * JrowPoint;
-                    targetPointRes -= loss_weight * JrowPoint.transpose() * res;
-                }
-                else
-                {
-                    Matrix<double, 2, 6> JrowPose;
-                    Matrix<double, 2, 3> JrowPoint;
-                    auto [res, depth] = BundleAdjustment(camera, ip.point, extr, wp, w, &JrowPose, &JrowPoint);
+                        // The pose-point blocks of this image are stored in observation order
+                        int k = k_begin + (o - begin);
+                        SAIGA_ASSERT(A.w.innerIndexPtr()[k] == j);
+                        WElem& targetPosePoint = A.w.valuePtr()[k].get();
 
-                    T loss_weight = 1.0;
-                    auto res_2    = res.squaredNorm();
-                    if (baOptions.huberMono > 0)
-                    {
-                        auto rw = Kernel::HuberLoss<T>(baOptions.huberMono, res_2);
-                        //                        auto rw     = Kernel::CauchyLoss<T>(baOptions.huberMono, res_2);
-                        res_2       = rw(0);
-                        loss_weight = rw(1);
-                    }
-                    newChi2 += res_2;
-
-                    //                    if (!valid_depth) loss_weight = 0;
-                    if (!constant)
-                    {
                         auto& targetPosePose = A.u.diagonal()(actualOffset).get();
                         auto& targetPoseRes  = b.u(actualOffset).get();
                         targetPosePose += loss_weight * JrowPose.transpose() * JrowPose;
@@ -511,13 +520,10 @@ double BARec::computeQuadraticForm()
                     targetPointPoint += loss_weight * JrowPoint.transpose() * JrowPoint;
                     targetPointRes -= loss_weight * JrowPoint.transpose() * res;
                 }
-
-                if (!constant)
-                {
-                    SAIGA_ASSERT(A.w.innerIndexPtr()[k] == j);
-                    ++k;
-                }
-            }
+            };
+            accumulate(std::integral_constant<int, 3>(), stereo_batch, baOptions.huberStereo);
+            accumulate(std::integral_constant<int, 2>(), mono_batch, baOptions.huberMono);
+            SAIGA_ASSERT(mono_batch.batch.size() + stereo_batch.batch.size() == end - begin);
         }
 
 #pragma omp for
@@ -682,57 +688,40 @@ double BARec::computeCost()
     {
         int tid = OMP::getThreadNum();
 
-        double& newChi2 = localChi2[tid];
-        newChi2         = 0;
+        double& newChi2    = localChi2[tid];
+        newChi2            = 0;
+        auto& mono_batch   = monoBatches[tid];
+        auto& stereo_batch = stereoBatches[tid];
 #pragma omp for
         for (auto valid_id = 0; valid_id < (int)validImages.size(); ++valid_id)
         {
             auto info = validImages[valid_id];
             SAIGA_ASSERT(info);
-            auto& img  = scene.images[info.sceneImageId];
-            auto& extr = x_u[info.validId];
-            //            auto& extr2  = scene.extrinsics[img.extr];
-            //            auto& extr   = extr2.se3;
+            auto& img    = scene.images[info.sceneImageId];
+            auto& extr   = x_u[info.validId];
             auto& camera = scene.intrinsics[img.intr];
-
             StereoCamera4 scam(camera, scene.bf);
 
-            for (auto& ip : img.stereoPoints)
-            {
-                if (!ip) continue;
-                BlockBAScalar w = ip.weight * scene.scale();
-                int j           = pointToValidMap[ip.wp];
-                SAIGA_ASSERT(j >= 0);
-                auto& wp = x_v[j];
+            // Residual-only evaluation
+            FillBatch(info.sceneImageId, mono_batch, stereo_batch);
+            BundleAdjustmentBatch(camera, extr, mono_batch.batch, false);
+            BundleAdjustmentStereoBatch(scam, extr, stereo_batch.batch, false);
 
-                if (ip.IsStereoOrDepth())
-                {
-                    auto stereo_point = ip.GetStereoPoint(scene.bf);
-                    auto [res, depth] =
-                        BundleAdjustmentStereo(scam, ip.point, stereo_point, extr, wp, w, w * scene.stereo_weight);
-                    auto res_2 = res.squaredNorm();
-                    if (baOptions.huberStereo > 0)
-                    {
-                        auto rw = Kernel::HuberLoss<T>(baOptions.huberStereo, res_2);
-                        //                        auto rw = Kernel::CauchyLoss<T>(baOptions.huberStereo, res_2);
-                        res_2 = rw(0);
-                    }
-                    newChi2 += res_2;
-                }
-                else
+            auto accumulate = [&](auto rows, const ObservationBatch& batch, double huber) {
+                constexpr int Rows = decltype(rows)::value;
+                for (int l = 0; l < batch.batch.size(); ++l)
                 {
-                    auto [res, depth] = BundleAdjustment(scam, ip.point, extr, wp, w);
-
-                    auto res_2 = res.squaredNorm();
-                    if (baOptions.huberMono > 0)
+                    auto res_2 = batch.batch.template Residual<Rows>(l).squaredNorm();
+                    if (huber > 0)
                     {
-                        auto rw = Kernel::HuberLoss<T>(baOptions.huberMono, res_2);
-                        //                        auto rw = Kernel::CauchyLoss<T>(baOptions.huberMono, res_2);
-                        res_2 = rw(0);
+                        auto rw = Kernel::HuberLoss<T>(huber, res_2);
+                        res_2   = rw(0);
                     }
                     newChi2 += res_2;
                 }
-            }
+            };
+            accumulate(std::integral_constant<int, 3>(), stereo_batch, baOptions.huberStereo);
+            accumulate(std::integral_constant<int, 2>(), mono_batch, baOptions.huberMono);
         }
     }
 
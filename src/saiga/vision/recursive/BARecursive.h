@@ -7,6 +7,7 @@
 
 #pragma once
 #include "saiga/vision/ba/BABase.h"
+#include "saiga/vision/kernels/BABatch.h"
 #include "saiga/vision/scene/Scene.h"
 
 #include "Recursive.h"
@@ -119,6 +120,17 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     std::vector<double> localChi2;
     double chi2_sum;
 
+    // The observations of one image, split into mono and stereo observations for the batched BA kernels.
+    struct ObservationBatch
+    {
+        BABatch<BlockBAScalar> batch;
+        // observation table index of each batch element
+        std::vector<int> observations;
+    };
+    // one per thread
+    std::vector<ObservationBatch> monoBatches, stereoBatches;
+    void FillBatch(int image, ObservationBatch& mono, ObservationBatch& stereo);
+
 
     // ============== LM Functions ==============
 
@@ -13,5 +13,6 @@
 #include "Cholesky/Cholesky.h"
 #include "Cholesky/RecursiveSimplicialCholesky.h"
 #include "Cholesky/RecursiveSimplicialCholesky2.h"
+#include "Cholesky/RecursiveSupernodalCholesky.h"
 #include "Cholesky/SparseCholesky.h"
 #include "Cholesky/SparseTriangular.h"
@@ -0,0 +1,521 @@
+/**
+ * This file is part of the Eigen Recursive Matrix Extension (ERME).
+ *
+ * Copyright (c) 2019 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "../Core.h"
+#include "Eigen/Cholesky"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace Eigen
+{
+/**
+ * Supernodal LL^T factorization of a sparse, symmetric positive definite block matrix.
+ *
+ * The scalar type of the matrix must be a Recursive::MatrixScalar with a fixed size square block
+ * (for example the Schur complement of BA or the system matrix of PGO).
+ *
+ * Analysis:
+ *   - AMD ordering on the block pattern
+ *   - Elimination tree and the column structure of L (in block units)
+ *   - Consecutive columns with nested structure are merged to supernodes. A supernode is stored as a dense,
+ *     column major panel of scalars containing the diagonal block and all off-diagonal rows.
+ *
+ * Factorization (left looking):
+ *   Every supernode first gathers the updates of its descendants with a dense matrix product each.
+ *   Afterwards the diagonal block is factorized with a dense LLT and the off-diagonal rows are computed
+ *   with a triangular solve. The inner loops therefore only contain dense level 3 kernels.
+ *   Supernodes with the same height in the supernodal elimination tree are independent and are processed
+ *   in parallel with OpenMP. The large supernodes near the root are processed alone, where Eigen's
+ *   (OpenMP) parallel matrix product can take over.
+ *
+ * Usage is the same as for RecursiveSimplicialLDLT:
+ *
+ *   RecursiveSupernodalLLT<AType, Eigen::Upper> llt;
+ *   llt.compute(A);
+ *   x = llt.solve(b);
+ *
+ *   // New values, same pattern
+ *   llt.factorize(A);
+ *   x = llt.solve(b);
+ */
+template <typename _MatrixType, int _UpLo = Lower,
+          typename _Ordering = AMDOrdering<typename _MatrixType::StorageIndex> >
+class RecursiveSupernodalLLT
+{
+   public:
+    using MatrixType    = _MatrixType;
+    using Scalar        = typename MatrixType::Scalar;
+    using StorageIndex  = typename MatrixType::StorageIndex;
+    using Block         = typename Scalar::M;
+    using T             = typename Block::Scalar;
+    using DenseMatrix   = Matrix<T, Dynamic, Dynamic>;
+    using DenseVector   = Matrix<T, Dynamic, 1>;
+    using PanelMap      = Map<DenseMatrix>;
+    using ConstPanelMap = Map<const DenseMatrix>;
+
+    static constexpr int UpLo      = _UpLo;
+    static constexpr int blockSize = Block::RowsAtCompileTime;
+    static_assert(blockSize != Dynamic && blockSize == int(Block::ColsAtCompileTime),
+                  "Only fixed size square blocks are supported.");
+
+    // Supernodes are not grown beyond this number of block columns.
+    int maxSupernodeSize = 64;
+
+    // Maximum fraction of explicitly stored zero blocks in a relaxed supernode.
+    double relaxedZeros = 0.2;
+
+    RecursiveSupernodalLLT() {}
+    explicit RecursiveSupernodalLLT(const MatrixType& matrix) { compute(matrix); }
+
+    Index rows() const { return m_size; }
+    Index cols() const { return m_size; }
+    Index numSupernodes() const { return m_superStart.empty() ? 0 : m_superStart.size() - 1; }
+
+    /** \returns \c Success if the last factorization was successful,
+     *          \c NumericalIssue if the matrix is not positive definite.
+     */
+    ComputationInfo info() const { return m_info; }
+
+    RecursiveSupernodalLLT& compute(const MatrixType& matrix)
+    {
+        analyzePattern(matrix);
+        factorize(matrix);
+        return *this;
+    }
+
+    void analyzePattern(const MatrixType& a)
+    {
+        eigen_assert(a.rows() == a.cols());
+        const StorageIndex n = StorageIndex(a.rows());
+        m_size               = n;
+
+        // ===== Fill reducing ordering =====
+        {
+            std::vector<Triplet<double, StorageIndex> > trips;
+            trips.reserve(a.nonZeros() * 2);
+            forEachEntry(a, [&](StorageIndex row, StorageIndex col, const Scalar&) {
+                trips.emplace_back(row, col, 1);
+                trips.emplace_back(col, row, 1);
+            });
+            SparseMatrix<double, ColMajor, StorageIndex> pattern(n, n);
+            pattern.setFromTriplets(trips.begin(), trips.end());
+
+            PermutationMatrix<Dynamic, Dynamic, StorageIndex> pinv;
+            _Ordering ordering;
+            ordering(pattern, pinv);
+
+            m_perm.resize(n);
+            if (pinv.size() == 0)
+            {
+                std::iota(m_perm.begin(), m_perm.end(), 0);
+            }
+            else
+            {
+                for (StorageIndex i = 0; i < n; ++i) m_perm[pinv.indices()[i]] = i;
+            }
+        }
+
+        // ===== Strictly lower pattern of the permuted matrix. adj[k] = {i < k : A(k,i) != 0} =====
+        std::vector<StorageIndex> adjStart(n + 1, 0), adj;
+        forEachEntry(a, [&](StorageIndex row, StorageIndex col, const Scalar&) {
+            StorageIndex i = m_perm[row], j = m_perm[col];
+            if (i != j) adjStart[std::max(i, j) + 1]++;
+        });
+        std::partial_sum(adjStart.begin(), adjStart.end(), adjStart.begin());
+        adj.resize(adjStart[n]);
+        {
+            std::vector<StorageIndex> fill(adjStart.begin(), adjStart.end() - 1);
+            forEachEntry(a, [&](StorageIndex row, StorageIndex col, const Scalar&) {
+                StorageIndex i = m_perm[row], j = m_perm[col];
+                if (i != j) adj[fill[std::max(i, j)]++] = std::min(i, j);
+            });
+        }
+
+        // ===== Elimination tree and the structure of every column of L =====
+        // Same row traversal as in RecursiveSimplicialLDLT. In the first pass only the column counts are computed.
+        std::vector<StorageIndex> parent(n, -1), tags(n), colStart(n + 1, 0), colRows;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            std::vector<StorageIndex> fill(colStart.begin(), colStart.end() - 1);
+            std::fill(tags.begin(), tags.end(), -1);
+            for (StorageIndex k = 0; k < n; ++k)
+            {
+                tags[k] = k;
+                for (StorageIndex p = adjStart[k]; p < adjStart[k + 1]; ++p)
+                {
+                    for (StorageIndex i = adj[p]; tags[i] != k; i = parent[i])
+                    {
+                        if (pass == 0)
+                        {
+                            if (parent[i] == -1) parent[i] = k;
+                            colStart[i + 1]++;
+                        }
+                        else
+                        {
+                            colRows[fill[i]++] = k;
+                        }
+                        tags[i] = k;
+                    }
+                }
+            }
+            if (pass == 0)
+            {
+                std::partial_sum(colStart.begin(), colStart.end(), colStart.begin());
+                colRows.resize(colStart[n]);
+            }
+        }
+        auto colCount = [&](StorageIndex j) { return colStart[j + 1] - colStart[j]; };
+
+        // ===== Supernodes =====
+        // Column j-1 can be merged into the supernode of its parent j. The panel of the merged supernode is
+        // {columns} + struct(j), which contains struct(j-1). If struct(j-1) != {j} + struct(j) the missing
+        // entries are stored as explicit zeros (relaxed supernodes). Merging is allowed as long as the
+        // fraction of explicit zeros stays below relaxedZeros.
+        m_superStart.clear();
+        m_columnToSuper.resize(n);
+        double zeros = 0, entries = 0;
+        for (StorageIndex j = 0; j < n; ++j)
+        {
+            bool merge = false;
+            if (j > 0 && parent[j - 1] == j && j - m_superStart.back() < maxSupernodeSize)
+            {
+                // All columns of the current supernode grow by delta rows.
+                double width      = j - m_superStart.back();
+                double delta      = colCount(j) + 1 - colCount(j - 1);
+                double newZeros   = zeros + width * delta;
+                double newEntries = entries + width * delta + colCount(j) + 1;
+                merge             = delta == 0 || newZeros <= relaxedZeros * newEntries;
+                if (merge)
+                {
+                    zeros   = newZeros;
+                    entries = newEntries;
+                }
+            }
+            if (!merge)
+            {
+                m_superStart.push_back(j);
+                zeros   = 0;
+                entries = colCount(j) + 1;
+            }
+            m_columnToSuper[j] = StorageIndex(m_superStart.size() - 1);
+        }
+        m_superStart.push_back(n);
+        const StorageIndex numSuper = StorageIndex(numSupernodes());
+
+        // Panel rows: the columns of the supernode followed by the off-diagonal structure of the last column.
+        m_rowStart.resize(numSuper + 1);
+        m_valueStart.resize(numSuper + 1);
+        m_rowStart[0]   = 0;
+        m_valueStart[0] = 0;
+        m_rows.clear();
+        for (StorageIndex s = 0; s < numSuper; ++s)
+        {
+            StorageIndex first = m_superStart[s], last = m_superStart[s + 1] - 1;
+            for (StorageIndex j = first; j <= last; ++j) m_rows.push_back(j);
+            m_rows.insert(m_rows.end(), colRows.begin() + colStart[last], colRows.begin() + colStart[last + 1]);
+            m_rowStart[s + 1] = StorageIndex(m_rows.size());
+
+            Index panelRows     = (m_rowStart[s + 1] - m_rowStart[s]) * blockSize;
+            Index panelCols     = (last - first + 1) * blockSize;
+            m_valueStart[s + 1] = m_valueStart[s] + panelRows * panelCols;
+        }
+        m_values.resize(m_valueStart[numSuper]);
+
+        // ===== Left looking updates =====
+        // The off-diagonal rows of a supernode d, which are columns of the supernode s, form a
+        // contiguous range [begin, end) in d's panel. All rows >= begin are then updated by d.
+        m_updateStart.assign(numSuper + 1, 0);
+        m_updates.clear();
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            std::vector<StorageIndex> fill(m_updateStart.begin(), m_updateStart.end() - 1);
+            if (pass == 1) m_updates.resize(m_updateStart[numSuper]);
+            for (StorageIndex d = 0; d < numSuper; ++d)
+            {
+                StorageIndex p   = m_rowStart[d] + (m_superStart[d + 1] - m_superStart[d]);
+                StorageIndex end = m_rowStart[d + 1];
+                while (p < end)
+                {
+                    StorageIndex s = m_columnToSuper[m_rows[p]];
+                    StorageIndex q = p;
+                    while (q < end && m_columnToSuper[m_rows[q]] == s) ++q;
+                    if (pass == 0)
+                        m_updateStart[s + 1]++;
+                    else
+                        m_updates[fill[s]++] = {d, p - m_rowStart[d], q - m_rowStart[d]};
+                    p = q;
+                }
+            }
+            if (pass == 0) std::partial_sum(m_updateStart.begin(), m_updateStart.end(), m_updateStart.begin());
+        }
+
+        // ===== Level sets of the supernodal elimination tree =====
+        // A child always has a smaller index than its parent.
+        std::vector<StorageIndex> height(numSuper, 0);
+        StorageIndex maxHeight = 0;
+        for (StorageIndex s = 0; s < numSuper; ++s)
+        {
+            StorageIndex p = parent[m_superStart[s + 1] - 1];
+            if (p != -1)
+            {
+                StorageIndex ps = m_columnToSuper[p];
+                height[ps]      = std::max(height[ps], StorageIndex(height[s] + 1));
+            }
+            maxHeight = std::max(maxHeight, height[s]);
+        }
+        m_levelStart.assign(maxHeight + 2, 0);
+        for (StorageIndex s = 0; s < numSuper; ++s) m_levelStart[height[s] + 1]++;
+        std::partial_sum(m_levelStart.begin(), m_levelStart.end(), m_levelStart.begin());
+        m_levelNodes.resize(numSuper);
+        {
+            std::vector<StorageIndex> fill(m_levelStart.begin(), m_levelStart.end() - 1);
+            for (StorageIndex s = 0; s < numSuper; ++s) m_levelNodes[fill[height[s]]++] = s;
+        }
+
+        m_analysisIsOk      = true;
+        m_factorizationIsOk = false;
+        m_info              = Success;
+    }
+
+    /**
+     * Numeric factorization. The pattern of a must be the same as in the last analyzePattern().
+     */
+    void factorize(const MatrixType& a)
+    {
+        eigen_assert(m_analysisIsOk && "You must first call analyzePattern()");
+        eigen_assert(a.rows() == m_size && a.cols() == m_size);
+
+        std::fill(m_values.begin(), m_values.end(), T(0));
+
+        // Scatter the lower triangle of the permuted matrix into the panels.
+        // Every entry has a unique target, so the outer loop can run in parallel.
+        const Index outerSize = a.outerSize();
+#pragma omp parallel for schedule(static) if (outerSize > 1000)
+        for (Index k = 0; k < outerSize; ++k)
+        {
+            for (typename MatrixType::InnerIterator it(a, k); it; ++it)
+            {
+                StorageIndex row = StorageIndex(it.row()), col = StorageIndex(it.col());
+                if (!inTriangle(row, col)) continue;
+                StorageIndex i = m_perm[row], j = m_perm[col];
+                if (i >= j)
+                    panelBlock(i, j) = it.value().get();
+                else
+                    panelBlock(j, i) = it.value().get().transpose();
+            }
+        }
+
+        bool ok = true;
+        for (size_t l = 0; l + 1 < m_levelStart.size() && ok; ++l)
+        {
+            const int levelBegin = m_levelStart[l], levelEnd = m_levelStart[l + 1];
+#pragma omp parallel for schedule(dynamic) if (levelEnd - levelBegin > 1) reduction(&& : ok)
+            for (int idx = levelBegin; idx < levelEnd; ++idx)
+            {
+                ok = factorizeSupernode(m_levelNodes[idx]) && ok;
+            }
+        }
+
+        m_info              = ok ? Success : NumericalIssue;
+        m_factorizationIsOk = true;
+    }
+
+    /**
+     * Solves A * x = b. The result has the same (block) type as b.
+     */
+    template <typename Rhs>
+    Rhs solve(const Rhs& b) const
+    {
+        eigen_assert(m_factorizationIsOk && "The matrix must be factorized before solving.");
+        eigen_assert(b.rows() == m_size);
+        constexpr int bs = blockSize;
+
+        DenseVector y(m_size * bs);
+        for (Index i = 0; i < m_size; ++i) y.template segment<bs>(m_perm[i] * bs) = b(i).get();
+
+        DenseVector tmp;
+        const Index numSuper = numSupernodes();
+
+        // Forward substitution L * y = b
+        for (Index s = 0; s < numSuper; ++s)
+        {
+            Index ncols = m_superStart[s + 1] - m_superStart[s];
+            Index noff  = m_rowStart[s + 1] - m_rowStart[s] - ncols;
+            auto L      = panel(s);
+            auto ys     = y.segment(m_superStart[s] * bs, ncols * bs);
+
+            L.topRows(ncols * bs).template triangularView<Lower>().solveInPlace(ys);
+            if (noff == 0) continue;
+
+            tmp.noalias()              = L.bottomRows(noff * bs) * ys;
+            const StorageIndex* offRow = &m_rows[m_rowStart[s] + ncols];
+            for (Index i = 0; i < noff; ++i)
+            {
+                y.template segment<bs>(offRow[i] * bs) -= tmp.template segment<bs>(i * bs);
+            }
+        }
+
+        // Backward substitution L^T * x = y
+        for (Index s = numSuper - 1; s >= 0; --s)
+        {
+            Index ncols = m_superStart[s + 1] - m_superStart[s];
+            Index noff  = m_rowStart[s + 1] - m_rowStart[s] - ncols;
+            auto L      = panel(s);
+            auto ys     = y.segment(m_superStart[s] * bs, ncols * bs);
+
+            if (noff > 0)
+            {
+                tmp.resize(noff * bs);
+                const StorageIndex* offRow = &m_rows[m_rowStart[s] + ncols];
+                for (Index i = 0; i < noff; ++i)
+                {
+                    tmp.template segment<bs>(i * bs) = y.template segment<bs>(offRow[i] * bs);
+                }
+                ys.noalias() -= L.bottomRows(noff * bs).transpose() * tmp;
+            }
+            L.topRows(ncols * bs).transpose().template triangularView<Upper>().solveInPlace(ys);
+        }
+
+        Rhs x(m_size);
+        for (Index i = 0; i < m_size; ++i) x(i).get() = y.template segment<bs>(m_perm[i] * bs);
+        return x;
+    }
+
+   private:
+    struct Update
+    {
+        StorageIndex source;
+        // Panel rows of the source supernode
+        StorageIndex begin, end;
+    };
+
+    bool inTriangle(StorageIndex row, StorageIndex col) const
+    {
+        return (UpLo & Upper) == Upper ? col >= row : row >= col;
+    }
+
+    template <typename F>
+    void forEachEntry(const MatrixType& a, F f) const
+    {
+        for (Index k = 0; k < a.outerSize(); ++k)
+        {
+            for (typename MatrixType::InnerIterator it(a, k); it; ++it)
+            {
+                StorageIndex row = StorageIndex(it.row()), col = StorageIndex(it.col());
+                if (inTriangle(row, col)) f(row, col, it.value());
+            }
+        }
+    }
+
+    PanelMap panel(Index s)
+    {
+        return PanelMap(m_values.data() + m_valueStart[s], (m_rowStart[s + 1] - m_rowStart[s]) * blockSize,
+                        (m_superStart[s + 1] - m_superStart[s]) * blockSize);
+    }
+    ConstPanelMap panel(Index s) const
+    {
+        return ConstPanelMap(m_values.data() + m_valueStart[s], (m_rowStart[s + 1] - m_rowStart[s]) * blockSize,
+                             (m_superStart[s + 1] - m_superStart[s]) * blockSize);
+    }
+
+    // The block L(row, col) with row >= col in the panel of col's supernode.
+    auto panelBlock(StorageIndex row, StorageIndex col)
+    {
+        StorageIndex s   = m_columnToSuper[col];
+        auto rowsBegin   = m_rows.begin() + m_rowStart[s];
+        auto rowsEnd     = m_rows.begin() + m_rowStart[s + 1];
+        Index localRow   = std::lower_bound(rowsBegin, rowsEnd, row) - rowsBegin;
+        Index localCol   = col - m_superStart[s];
+        Index panelRows  = (m_rowStart[s + 1] - m_rowStart[s]) * blockSize;
+        T* blockPtr      = m_values.data() + m_valueStart[s] + localCol * blockSize * panelRows + localRow * blockSize;
+        eigen_assert(localRow < rowsEnd - rowsBegin && rowsBegin[localRow] == row);
+        return Map<Matrix<T, blockSize, blockSize>, 0, OuterStride<> >(blockPtr, OuterStride<>(panelRows));
+    }
+
+    bool factorizeSupernode(StorageIndex s)
+    {
+        constexpr int bs           = blockSize;
+        const Index first          = m_superStart[s];
+        const Index ncols          = m_superStart[s + 1] - first;
+        const Index nrows          = m_rowStart[s + 1] - m_rowStart[s];
+        const StorageIndex* target = &m_rows[m_rowStart[s]];
+        auto L                     = panel(s);
+
+        // Gather the updates L(:, d) * L(cols(s), d)^T of all descendants d.
+        DenseMatrix C;
+        for (StorageIndex u = m_updateStart[s]; u < m_updateStart[s + 1]; ++u)
+        {
+            const Update& up           = m_updates[u];
+            const StorageIndex* source = &m_rows[m_rowStart[up.source]];
+            ConstPanelMap Ld           = const_cast<const RecursiveSupernodalLLT*>(this)->panel(up.source);
+
+            const Index m = (m_rowStart[up.source + 1] - m_rowStart[up.source]) - up.begin;
+            const Index k = up.end - up.begin;
+            C.noalias()   = Ld.bottomRows(m * bs) * Ld.middleRows(up.begin * bs, k * bs).transpose();
+
+            // The source rows are a subset of the target rows and both are sorted.
+            Index pos = 0;
+            for (Index i = 0; i < m; ++i)
+            {
+                StorageIndex row = source[up.begin + i];
+                while (target[pos] != row) ++pos;
+                // Only the lower triangle of the diagonal block is needed.
+                Index jmax = std::min(i + 1, k);
+                for (Index j = 0; j < jmax; ++j)
+                {
+                    Index col = source[up.begin + j] - first;
+                    L.template block<bs, bs>(pos * bs, col * bs) -= C.template block<bs, bs>(i * bs, j * bs);
+                }
+            }
+        }
+
+        Ref<DenseMatrix> diag = L.topRows(ncols * bs);
+        LLT<Ref<DenseMatrix> > llt(diag);
+        if (llt.info() != Success) return false;
+
+        if (nrows > ncols)
+        {
+            auto off = L.bottomRows((nrows - ncols) * bs);
+            diag.template triangularView<Lower>().transpose().template solveInPlace<OnTheRight>(off);
+        }
+        return true;
+    }
+
+    ComputationInfo m_info   = InvalidInput;
+    bool m_analysisIsOk      = false;
+    bool m_factorizationIsOk = false;
+    Index m_size             = 0;
+
+    // Original index -> permuted index
+    std::vector<StorageIndex> m_perm;
+
+    // Supernode s contains the block columns [m_superStart[s], m_superStart[s+1])
+    std::vector<StorageIndex> m_superStart;
+    std::vector<StorageIndex> m_columnToSuper;
+
+    // Block rows of each panel: the diagonal block followed by the sorted off-diagonal rows
+    std::vector<StorageIndex> m_rowStart;
+    std::vector<StorageIndex> m_rows;
+
+    // Dense column major panels
+    std::vector<Index> m_valueStart;
+    std::vector<T> m_values;
+
+    std::vector<StorageIndex> m_updateStart;
+    std::vector<Update> m_updates;
+
+    // Supernodes sorted by their height in the elimination tree
+    std::vector<StorageIndex> m_levelStart;
+    std::vector<StorageIndex> m_levelNodes;
+};
+
+}  // namespace Eigen
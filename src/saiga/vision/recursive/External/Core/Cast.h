@@ -0,0 +1,165 @@
+﻿/**
+ * This file is part of the Eigen Recursive Matrix Extension (ERME).
+ *
+ * Copyright (c) 2019 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "MatrixScalar.h"
+
+namespace Eigen::Recursive
+{
+/**
+ * Replaces the base scalar of a recursive matrix type.
+ *
+ * Example:
+ *    CastScalar<SparseMatrix<MatrixScalar<Matrix<double, 6, 3>>, RowMajor>, float>::type
+ *    == SparseMatrix<MatrixScalar<Matrix<float, 6, 3>>, RowMajor>
+ */
+template <typename T, typename NewScalar>
+struct CastScalar
+{
+    static_assert(internal::is_arithmetic<T>::value, "Unsupported type.");
+    using type = NewScalar;
+};
+
+template <typename Scalar, int Rows, int Cols, int Options, int MaxRows, int MaxCols, typename NewScalar>
+struct CastScalar<Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols>, NewScalar>
+{
+    using type = Matrix<typename CastScalar<Scalar, NewScalar>::type, Rows, Cols, Options, MaxRows, MaxCols>;
+};
+
+template <typename G, typename NewScalar>
+struct CastScalar<MatrixScalar<G>, NewScalar>
+{
+    using type = MatrixScalar<typename CastScalar<G, NewScalar>::type>;
+};
+
+template <typename Scalar, int Size, typename NewScalar>
+struct CastScalar<DiagonalMatrix<Scalar, Size>, NewScalar>
+{
+    using type = DiagonalMatrix<typename CastScalar<Scalar, NewScalar>::type, Size>;
+};
+
+template <typename Scalar, int Options, typename StorageIndex, typename NewScalar>
+struct CastScalar<SparseMatrix<Scalar, Options, StorageIndex>, NewScalar>
+{
+    using type = SparseMatrix<typename CastScalar<Scalar, NewScalar>::type, Options, StorageIndex>;
+};
+
+
+// Dense matrices
+template <typename T>
+struct CastImpl
+{
+    using Scalar    = typename T::Scalar;
+    using ChildType = CastImpl<Scalar>;
+
+    template <typename Dst>
+    static void get(const T& src, Dst& dst)
+    {
+        if constexpr (internal::is_arithmetic<Scalar>::value)
+        {
+            dst = src.template cast<typename Dst::Scalar>();
+        }
+        else
+        {
+            dst.resize(src.rows(), src.cols());
+            for (int i = 0; i < src.rows(); ++i)
+            {
+                for (int j = 0; j < src.cols(); ++j)
+                {
+                    ChildType::get(src(i, j), dst(i, j));
+                }
+            }
+        }
+    }
+};
+
+template <>
+struct CastImpl<double>
+{
+    template <typename Dst>
+    static void get(double src, Dst& dst)
+    {
+        dst = Dst(src);
+    }
+};
+
+template <>
+struct CastImpl<float>
+{
+    template <typename Dst>
+    static void get(float src, Dst& dst)
+    {
+        dst = Dst(src);
+    }
+};
+
+template <typename G>
+struct CastImpl<MatrixScalar<G>>
+{
+    using ChildType = CastImpl<G>;
+
+    template <typename Dst>
+    static void get(const MatrixScalar<G>& src, Dst& dst)
+    {
+        ChildType::get(src.get(), dst.get());
+    }
+};
+
+template <typename Scalar, int Size>
+struct CastImpl<DiagonalMatrix<Scalar, Size>>
+{
+    using ChildType = CastImpl<typename DiagonalMatrix<Scalar, Size>::DiagonalVectorType>;
+
+    template <typename Dst>
+    static void get(const DiagonalMatrix<Scalar, Size>& src, Dst& dst)
+    {
+        dst.resize(src.rows());
+        ChildType::get(src.diagonal(), dst.diagonal());
+    }
+};
+
+// The structure is copied and only the values are converted.
+template <typename Scalar, int Options, typename StorageIndex>
+struct CastImpl<SparseMatrix<Scalar, Options, StorageIndex>>
+{
+    using ChildType = CastImpl<Scalar>;
+
+    template <typename Dst>
+    static void get(const SparseMatrix<Scalar, Options, StorageIndex>& src, Dst& dst)
+    {
+        eigen_assert(src.isCompressed());
+        auto nnz = src.nonZeros();
+        dst.resize(src.rows(), src.cols());
+        dst.resizeNonZeros(nnz);
+        for (Index i = 0; i <= src.outerSize(); ++i) dst.outerIndexPtr()[i] = src.outerIndexPtr()[i];
+        for (Index k = 0; k < nnz; ++k)
+        {
+            dst.innerIndexPtr()[k] = src.innerIndexPtr()[k];
+            ChildType::get(src.valuePtr()[k], dst.valuePtr()[k]);
+        }
+    }
+};
+
+
+/**
+ * Converts a recursive matrix to a different base scalar.
+ * The type of 'dst' is usually CastScalar<Src, NewScalar>::type.
+ *
+ * Example:
+ *    Eigen::SparseMatrix<MatrixScalar<Matrix<double, 6, 3>>> A;
+ *    CastScalar<decltype(A), float>::type B;
+ *    castScalar(A, B);
+ */
+template <typename Src, typename Dst>
+void castScalar(const Src& src, Dst& dst)
+{
+    CastImpl<Src>::get(src, dst);
+}
+
+}  // namespace Eigen::Recursive
@@ -27,10 +27,19 @@ struct LinearSolverOptions
     // Schur complement options (not used by every solver)
     bool buildExplizitSchur = false;
 
-    // Well the cholmod supernodal ist extremly fast
-    // -> Maybe in the future when I have implemented a supernodal recursive factorization
-    //      I switch it back to false ;)
-    bool cholmod = true;
+    // Iterative Schur solver with block diagonal U (BA):
+    // The reduced system is copied to float and solved with a float PCG. The solution is then refined with the
+    // residual of the double system until it satisfies iterativeTolerance or maxRefinementSteps is reached.
+    // maxIterativeIterations limits the total number of PCG iterations of all steps.
+    bool mixedPrecision    = false;
+    int maxRefinementSteps = 3;
+
+    // Direct solver for sparse block matrices:
+    //   cholmod:    Cholmod's supernodal LLT on the expanded matrix (only if cholmod is available)
+    //   supernodal: RecursiveSupernodalLLT on the block matrix (falls back to the ldlt if A is not positive definite)
+    //   otherwise:  RecursiveSimplicialLDLT on the block matrix
+    bool cholmod    = false;
+    bool supernodal = true;
 };
 
 /**
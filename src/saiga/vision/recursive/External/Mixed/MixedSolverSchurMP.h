@@ -59,8 +59,9 @@ class MixedSymmetricRecursiveSolver<
     using S1Type = Eigen::SparseMatrix<UBlock, Eigen::RowMajor>;
     using S2Type = Eigen::SparseMatrix<VBlock, Eigen::RowMajor>;
 
-    using LDLT         = Eigen::RecursiveSimplicialLDLT<S1Type, Eigen::Upper>;
-    using InnerSolver1 = MixedSymmetricRecursiveSolver<S1Type, XUType>;
+    using LDLT          = Eigen::RecursiveSimplicialLDLT<S1Type, Eigen::Upper>;
+    using SupernodalLLT = Eigen::RecursiveSupernodalLLT<S1Type, Eigen::Upper>;
+    using InnerSolver1  = MixedSymmetricRecursiveSolver<S1Type, XUType>;
 
 
     void resize(int n, int m)
@@ -87,6 +88,7 @@ class MixedSymmetricRecursiveSolver<
             hasWT         = true;
             explizitSchur = true;
             ldlt          = nullptr;
+            supernodal    = nullptr;
         }
         else
         {
@@ -150,17 +152,41 @@ class MixedSymmetricRecursiveSolver<
 
         if (solverOptions.solverType == LinearSolverOptions::SolverType::Direct)
         {
-            // Direct recusive ldlt solver
-            if (!ldlt)
+            bool solved = false;
+            if (solverOptions.supernodal)
             {
-                ldlt = std::make_unique<LDLT>();
-                ldlt->compute(S1);
+                // The supernodal LLT requires S to be positive definite.
+                // If this is not the case we fall back to the ldlt below.
+                if (!supernodal)
+                {
+                    supernodal = std::make_unique<SupernodalLLT>();
+                    supernodal->compute(S1);
+                }
+                else
+                {
+                    supernodal->factorize(S1);
+                }
+                if (supernodal->info() == Eigen::Success)
+                {
+                    da     = supernodal->solve(ej);
+                    solved = true;
+                }
             }
-            else
+
+            if (!solved)
             {
-                ldlt->factorize(S1);
+                // Direct recusive ldlt solver
+                if (!ldlt)
+                {
+                    ldlt = std::make_unique<LDLT>();
+                    ldlt->compute(S1);
+                }
+                else
+                {
+                    ldlt->factorize(S1);
+                }
+                da = ldlt->solve(ej);
             }
-            da = ldlt->solve(ej);
         }
         else
         {
@@ -216,6 +242,7 @@ class MixedSymmetricRecursiveSolver<
     //    InnerSolver1 solver1;
 
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<SupernodalLLT> supernodal;
 
     bool patternAnalyzed = false;
     bool hasWT           = true;
@@ -268,8 +295,18 @@ class MixedSymmetricRecursiveSolver<
     using S1Type = Eigen::SparseMatrix<UBlock, Eigen::RowMajor>;
     using S2Type = Eigen::SparseMatrix<VBlock, Eigen::RowMajor>;
 
-    using LDLT         = Eigen::RecursiveSimplicialLDLT<S1Type, Eigen::Upper>;
-    using InnerSolver1 = MixedSymmetricRecursiveSolver<S1Type, XUType>;
+    using LDLT          = Eigen::RecursiveSimplicialLDLT<S1Type, Eigen::Upper>;
+    using SupernodalLLT = Eigen::RecursiveSupernodalLLT<S1Type, Eigen::Upper>;
+    using InnerSolver1  = MixedSymmetricRecursiveSolver<S1Type, XUType>;
+
+    // Float types of the mixed precision solver
+    using UBlockF  = typename CastScalar<UBlock, float>::type;
+    using AUTypeF  = typename CastScalar<AUType, float>::type;
+    using AWTypeF  = typename CastScalar<AWType, float>::type;
+    using AWTTypeF = typename CastScalar<AWTType, float>::type;
+    using XUTypeF  = typename CastScalar<XUType, float>::type;
+    using XVTypeF  = typename CastScalar<XVType, float>::type;
+    using S1TypeF  = typename CastScalar<S1Type, float>::type;
 
 
     void resize(int n, int m)
@@ -287,6 +324,17 @@ class MixedSymmetricRecursiveSolver<
         tmp.resize(n);
     }
 
+    void resizeMixedPrecision()
+    {
+        P_f.resize(n);
+        residual.resize(n);
+        delta.resize(n);
+        residual_f.resize(n);
+        delta_f.resize(n);
+        tmp_f.resize(n);
+        q_f.resize(m);
+    }
+
 
     void analyzePattern(const AType& A, const LinearSolverOptions& solverOptions)
     {
@@ -297,6 +345,7 @@ class MixedSymmetricRecursiveSolver<
             hasWT         = true;
             explizitSchur = true;
             ldlt          = nullptr;
+            supernodal    = nullptr;
         }
         else
         {
@@ -363,28 +412,44 @@ class MixedSymmetricRecursiveSolver<
 
         if (solverOptions.solverType == LinearSolverOptions::SolverType::Direct)
         {
-            // Direct recusive ldlt solver
-            if (!ldlt)
+            bool solved = false;
+            if (solverOptions.supernodal)
             {
-                ldlt = std::make_unique<LDLT>();
-                ldlt->compute(S1);
+                // The supernodal LLT requires S to be positive definite.
+                // If this is not the case we fall back to the ldlt below.
+                if (!supernodal)
+                {
+                    supernodal = std::make_unique<SupernodalLLT>();
+                    supernodal->compute(S1);
+                }
+                else
+                {
+                    supernodal->factorize(S1);
+                }
+                if (supernodal->info() == Eigen::Success)
+                {
+                    da     = supernodal->solve(ej);
+                    solved = true;
+                }
             }
-            else
+
+            if (!solved)
             {
-                ldlt->factorize(S1);
+                // Direct recusive ldlt solver
+                if (!ldlt)
+                {
+                    ldlt = std::make_unique<LDLT>();
+                    ldlt->compute(S1);
+                }
+                else
+                {
+                    ldlt->factorize(S1);
+                }
+                da = ldlt->solve(ej);
             }
-            da = ldlt->solve(ej);
         }
         else
         {
-            if (explizitSchur)
-            {
-                P.compute(S1);
-            }
-            else
-            {
-                P.compute(Sdiag);
-            }
             da.setZero();
 
             // Iterative CG solver
@@ -392,33 +457,50 @@ class MixedSymmetricRecursiveSolver<
             double tol         = solverOptions.iterativeTolerance;
             //            XUType tmp(n);
 
-            recursive_conjugate_gradient(
-                [&](const XUType& v, XUType& result) {
-                    // x = U * p - Y * WT * p
-                    if (explizitSchur)
+            auto applyS = [&](const XUType& v, XUType& result) {
+                // x = U * p - Y * WT * p
+                if (explizitSchur)
+                {
+                    //                    if constexpr (denseSchur)
+                    //                        denseMV(S1, v, result);
+                    //                    else
+                    result = S1.template selfadjointView<Eigen::Upper>() * v;
+                    //                    std::cout << expand(result) << std::endl << std::endl;
+                }
+                else
+                {
+                    if (hasWT)
                     {
-                        //                    if constexpr (denseSchur)
-                        //                        denseMV(S1, v, result);
-                        //                    else
-                        result = S1.template selfadjointView<Eigen::Upper>() * v;
-                        //                    std::cout << expand(result) << std::endl << std::endl;
+                        tmp = Y * (WT * v);
                     }
                     else
                     {
-                        if (hasWT)
-                        {
-                            tmp = Y * (WT * v);
-                        }
-                        else
-                        {
-                            multSparseRowTransposedVector(W, v, q);
-                            tmp = Y * q;
-                        }
-                        result = (U.diagonal().array() * v.array()) - tmp.array();
-                        //                    std::cout << expand(result) << std::endl << std::endl;
+                        multSparseRowTransposedVector(W, v, q);
+                        tmp = Y * q;
                     }
-                },
-                ej, da, P, iters, tol);
+                    result = (U.diagonal().array() * v.array()) - tmp.array();
+                    //                    std::cout << expand(result) << std::endl << std::endl;
+                }
+            };
+
+            if (solverOptions.mixedPrecision)
+            {
+                // The implicit float Schur complement is built from WT
+                eigen_assert(hasWT);
+                solveMixedPrecision(U, da, applyS, solverOptions);
+            }
+            else
+            {
+                if (explizitSchur)
+                {
+                    P.compute(S1);
+                }
+                else
+                {
+                    P.compute(Sdiag);
+                }
+                recursive_conjugate_gradient(applyS, ej, da, P, iters, tol);
+            }
         }
 
 
@@ -437,6 +519,71 @@ class MixedSymmetricRecursiveSolver<
     }
 
 
+    // Solves S * da = ej with iterative refinement. The corrections are computed with a float PCG on a float copy
+    // of S (explicit) or of U, Y and WT (implicit). The residual is always computed with the double system 'applyS',
+    // therefore the final accuracy is the same as for the double PCG.
+    template <typename ApplyS>
+    void solveMixedPrecision(const AUType& U, XUType& da, const ApplyS& applyS,
+                             const LinearSolverOptions& solverOptions)
+    {
+        if (P_f.rows() != n) resizeMixedPrecision();
+
+        if (explizitSchur)
+        {
+            castScalar(S1, S1_f);
+            P_f.compute(S1_f);
+        }
+        else
+        {
+            castScalar(U, U_f);
+            castScalar(Y, Y_f);
+            castScalar(WT, WT_f);
+            castScalar(Sdiag, Sdiag_f);
+            P_f.compute(Sdiag_f);
+        }
+
+        auto applyS_f = [&](const XUTypeF& v, XUTypeF& result) {
+            if (explizitSchur)
+            {
+                result = S1_f.template selfadjointView<Eigen::Upper>() * v;
+            }
+            else
+            {
+                q_f    = WT_f * v;
+                tmp_f  = Y_f * q_f;
+                result = (U_f.diagonal().array() * v.array()) - tmp_f.array();
+            }
+        };
+
+        double tol             = solverOptions.iterativeTolerance;
+        double threshold       = tol * tol * squaredNorm(ej);
+        Eigen::Index remaining = solverOptions.maxIterativeIterations;
+
+        // da = 0  ->  residual = ej
+        residual             = ej;
+        double residualNorm2 = squaredNorm(ej);
+        for (int step = 0; step <= solverOptions.maxRefinementSteps && remaining > 0; ++step)
+        {
+            castScalar(residual, residual_f);
+            delta_f.setZero();
+
+            // The correction only has to reduce the current residual to the threshold of the complete system.
+            // The iterations of all steps together are limited by maxIterativeIterations.
+            Eigen::Index iters = remaining;
+            float tol_f        = std::min(1.0, std::sqrt(threshold / residualNorm2));
+            recursive_conjugate_gradient(applyS_f, residual_f, delta_f, P_f, iters, tol_f);
+            remaining -= std::max<Eigen::Index>(iters, 1);
+
+            castScalar(delta_f, delta);
+            da += delta;
+
+            applyS(da, residual);
+            residual      = ej - residual;
+            residualNorm2 = squaredNorm(residual);
+            if (residualNorm2 <= threshold) break;
+        }
+    }
+
     void analyzePattern_omp(const AType& A, const LinearSolverOptions& solverOptions)
     {
 #pragma omp single
@@ -563,6 +710,21 @@ class MixedSymmetricRecursiveSolver<
     //    InnerSolver1 solver1;
 
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<SupernodalLLT> supernodal;
+
+    // ==== Mixed precision tmps ====
+    XUType residual;
+    XUType delta;
+    AUTypeF U_f;
+    AWTypeF Y_f;
+    AWTTypeF WT_f;
+    Eigen::DiagonalMatrix<UBlockF, -1> Sdiag_f;
+    S1TypeF S1_f;
+    RecursiveDiagonalPreconditioner<UBlockF> P_f;
+    XUTypeF residual_f;
+    XUTypeF delta_f;
+    XUTypeF tmp_f;
+    XVTypeF q_f;
 
     bool patternAnalyzed = false;
     bool hasWT           = true;
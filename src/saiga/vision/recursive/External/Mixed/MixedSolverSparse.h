@@ -27,8 +27,9 @@ template <typename T, int _Options, typename XType>
 class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<T>, _Options>, XType>
 {
    public:
-    using AType = typename Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<T>, _Options>;
-    using LDLT  = Eigen::RecursiveSimplicialLDLT<AType, Eigen::Upper>;
+    using AType         = typename Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<T>, _Options>;
+    using LDLT          = Eigen::RecursiveSimplicialLDLT<AType, Eigen::Upper>;
+    using SupernodalLLT = Eigen::RecursiveSupernodalLLT<AType, Eigen::Upper>;
 
     using ExpandedType = Eigen::SparseMatrix<typename T::Scalar, Eigen::RowMajor>;
 #ifdef SOLVER_USE_CHOLMOD
@@ -40,7 +41,8 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
 
     void Init()
     {
-        ldlt = nullptr;
+        ldlt       = nullptr;
+        supernodal = nullptr;
 #ifdef SOLVER_USE_CHOLMOD
         cholmodldlt = nullptr;
 #endif
@@ -81,6 +83,25 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
             else
 #endif
             {
+                if (solverOptions.supernodal)
+                {
+                    // Falls back to the ldlt below if A is not positive definite.
+                    if (!supernodal)
+                    {
+                        supernodal = std::make_unique<SupernodalLLT>();
+                        supernodal->compute(A);
+                    }
+                    else
+                    {
+                        supernodal->factorize(A);
+                    }
+                    if (supernodal->info() == Eigen::Success)
+                    {
+                        x = supernodal->solve(b);
+                        return;
+                    }
+                }
+
                 if (!ldlt)
                 {
 #if 0
@@ -154,6 +175,7 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
 
    private:
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<SupernodalLLT> supernodal;
     Eigen::PermutationMatrix<-1> permFull;
     std::vector<int> orderingFull;
 #ifdef SOLVER_USE_CHOLMOD
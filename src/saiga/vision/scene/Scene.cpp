@@ -85,6 +85,7 @@ void Scene::clear()
     worldPoints.clear();
     images.clear();
     rel_pose_constraints.clear();
+    obsTable.clear();
 }
 
 void Scene::reserve(int _images, int points, int observations)
@@ -353,6 +354,7 @@ void Scene::compress()
         if (img.validPoints == 0) std::cout << "invalid camera " << i << std::endl;
         i++;
     }
+    buildObservationTable();
 }
 
 std::vector<int> Scene::validImages()
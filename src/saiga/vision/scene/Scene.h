@@ -11,6 +11,8 @@
 #include "saiga/core/util/statistics.h"
 #include "saiga/vision/VisionTypes.h"
 
+#include "SceneObservationTable.h"
+
 #include <vector>
 
 
@@ -182,6 +184,9 @@ class SAIGA_VISION_API Scene
 
     double bf            = 1;
     double stereo_weight = 1;
+
+    SceneObservationTable obsTable;
+
     // similar to vector::clear:
     // reset, but keep memory
     void clear();
@@ -246,8 +251,14 @@ class SAIGA_VISION_API Scene
     void removeCamera(int id);
 
     // removes all worldpoints/imagepoints/images, which do not have any reference
+    // Also rebuilds the observation table.
     void compress();
 
+    // Contiguous CSR/SoA copy of all valid observations. See SceneObservationTable.h.
+    // Call buildObservationTable() after changing the image points outside of compress().
+    void buildObservationTable() { obsTable.build(*this); }
+    const SceneObservationTable& observationTable() const { return obsTable; }
+
     std::vector<int> validImages();
     std::vector<int> validPoints();
 
@@ -256,8 +267,16 @@ class SAIGA_VISION_API Scene
 
     // returns true if the scene was changed by a user action
     bool imgui();
+
+    // Human readable text format. load() also detects and reads binary scene files.
     void save(const std::string& file);
     void load(const std::string& file);
+
+    // Versioned binary format with one array per attribute (SoA).
+    // Loading maps the file into memory and copies the arrays without any parsing.
+    // If 'compress' is set the payload is zlib compressed, which requires SAIGA_USE_ZLIB.
+    void saveBinary(const std::string& file, bool compress = false);
+    void loadBinary(const std::string& file);
     double chi2Huber(double huber);
 };
 
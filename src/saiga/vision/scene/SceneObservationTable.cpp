@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "SceneObservationTable.h"
+
+#include "saiga/core/util/Algorithm.h"
+
+#include "Scene.h"
+
+namespace Saiga
+{
+void SceneObservationTable::build(const Scene& scene)
+{
+    int num_images = scene.images.size();
+    int num_points = scene.worldPoints.size();
+
+    imageOffsets.resize(num_images + 1);
+    pointOffsets.assign(num_points + 1, 0);
+
+    // Count pass
+    int total = 0;
+    for (int i = 0; i < num_images; ++i)
+    {
+        imageOffsets[i] = total;
+        for (auto& ip : scene.images[i].stereoPoints)
+        {
+            if (!ip) continue;
+            SAIGA_ASSERT(ip.wp < num_points);
+            pointOffsets[ip.wp]++;
+            total++;
+        }
+    }
+    imageOffsets[num_images] = total;
+
+    imageId.resize(total);
+    pointId.resize(total);
+    imagePointId.resize(total);
+    pixel.resize(total);
+    depth.resize(total);
+    weight.resize(total);
+    pointObservations.resize(total);
+
+    auto point_total = Saiga::exclusive_scan(pointOffsets.begin(), pointOffsets.end() - 1, pointOffsets.begin(), 0);
+    SAIGA_ASSERT(point_total == total);
+    pointOffsets[num_points] = total;
+
+    // Fill pass. Images are traversed in order, therefore the point lists are sorted by image.
+    std::vector<int> point_fill(pointOffsets.begin(), pointOffsets.end() - 1);
+    int k = 0;
+    for (int i = 0; i < num_images; ++i)
+    {
+        auto& img = scene.images[i];
+        for (int ipid = 0; ipid < (int)img.stereoPoints.size(); ++ipid)
+        {
+            auto& ip = img.stereoPoints[ipid];
+            if (!ip) continue;
+            imageId[k]                             = i;
+            pointId[k]                             = ip.wp;
+            imagePointId[k]                        = ipid;
+            pixel[k]                               = ip.point;
+            depth[k]                               = ip.depth;
+            weight[k]                              = ip.weight;
+            pointObservations[point_fill[ip.wp]++] = k;
+            k++;
+        }
+    }
+}
+
+void SceneObservationTable::clear()
+{
+    imageOffsets.clear();
+    pointOffsets.clear();
+    pointObservations.clear();
+    imageId.clear();
+    pointId.clear();
+    imagePointId.clear();
+    pixel.clear();
+    depth.clear();
+    weight.clear();
+}
+
+}  // namespace Saiga
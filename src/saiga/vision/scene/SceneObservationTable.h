@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/vision/VisionTypes.h"
+
+#include <vector>
+
+namespace Saiga
+{
+class Scene;
+
+/**
+ * Compact copy of all valid observations (wp != -1 and not an outlier) of a scene.
+ *
+ * The observations are sorted by image and stored as one contiguous array per attribute (SoA).
+ * The observations of image i are in the range [imageOffsets[i], imageOffsets[i+1]).
+ *
+ * The point -> observation mapping is a second CSR structure on top of that:
+ * pointObservations[pointOffsets[j]] ... pointObservations[pointOffsets[j+1]-1] are the observation indices of
+ * world point j, sorted by image.
+ *
+ * The table is a snapshot. It is rebuilt by Scene::compress() and Scene::buildObservationTable(), but not by
+ * direct modifications of SceneImage::stereoPoints.
+ */
+struct SAIGA_VISION_API SceneObservationTable
+{
+    // size = images + 1
+    std::vector<int> imageOffsets;
+
+    // size = worldPoints + 1
+    std::vector<int> pointOffsets;
+    std::vector<int> pointObservations;
+
+    // ========== Observation columns ==========
+    std::vector<int> imageId;
+    std::vector<int> pointId;
+    // index into SceneImage::stereoPoints
+    std::vector<int> imagePointId;
+    AlignedVector<Vec2> pixel;
+    std::vector<double> depth;
+    std::vector<float> weight;
+
+    int size() const { return imageId.size(); }
+    int numImages() const { return imageOffsets.empty() ? 0 : imageOffsets.size() - 1; }
+    int numPoints() const { return pointOffsets.empty() ? 0 : pointOffsets.size() - 1; }
+
+    int imageBegin(int image) const { return imageOffsets[image]; }
+    int imageEnd(int image) const { return imageOffsets[image + 1]; }
+    int pointBegin(int point) const { return pointOffsets[point]; }
+    int pointEnd(int point) const { return pointOffsets[point + 1]; }
+
+    bool IsStereoOrDepth(int obs) const { return depth[obs] > 0; }
+    double GetStereoPoint(int obs, double bf) const { return pixel[obs](0) - bf / depth[obs]; }
+
+    void build(const Scene& scene);
+    void clear();
+};
+
+}  // namespace Saiga
@@ -5,15 +5,88 @@
  */
 
 #include "saiga/core/imgui/imgui.h"
+#include "saiga/core/util/MemoryMappedFile.h"
 #include "saiga/core/util/assert.h"
 #include "saiga/core/util/fileChecker.h"
+#include "saiga/core/util/zlib.h"
 #include "saiga/vision/util/Random.h"
 
 #include "Scene.h"
 
+#include <cstring>
 #include <fstream>
 namespace Saiga
 {
+// ============================= Binary Scene Format =============================
+//
+// [SceneBinaryHeader] [payload]
+//
+// The payload is optionally zlib compressed (see core/util/zlib.h) and consists of one array per
+// attribute. Every array starts at an 8 byte aligned offset, which is stored in the header.
+// All values are stored in native byte order.
+//
+//   Intrinsics               double[5 * num_intrinsics]   fx fy cx cy s
+//   ImagePose                double[7 * num_images]       SE3::params()
+//   ImageVelocity            double[7 * num_images]       SE3::params()
+//   ImageConstant            uint8[num_images]
+//   ImageIntrinsics          int32[num_images]
+//   ImageObservationOffset   int64[num_images + 1]        Observations of image i: [offset[i], offset[i+1])
+//   ObservationWorldPoint    int32[num_observations]
+//   ObservationDepth         double[num_observations]
+//   ObservationPoint         double[2 * num_observations]
+//   ObservationWeight        float[num_observations]
+//   WorldPointPosition       double[3 * num_world_points]
+//
+namespace
+{
+enum SceneSection
+{
+    Intrinsics = 0,
+    ImagePose,
+    ImageVelocity,
+    ImageConstant,
+    ImageIntrinsics,
+    ImageObservationOffset,
+    ObservationWorldPoint,
+    ObservationDepth,
+    ObservationPoint,
+    ObservationWeight,
+    WorldPointPosition,
+    NumSceneSections
+};
+
+constexpr char scene_binary_magic[8]    = {'S', 'A', 'I', 'G', 'A', 'S', 'C', 'N'};
+constexpr uint32_t scene_binary_version = 2;
+
+struct SceneBinaryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t compressed;
+    int64_t num_intrinsics;
+    int64_t num_images;
+    int64_t num_observations;
+    int64_t num_world_points;
+    double bf;
+    double global_scale;
+    // Uncompressed size of the payload
+    uint64_t payload_size;
+    // Size of the payload in the file. Equal to payload_size if it is not compressed.
+    uint64_t file_payload_size;
+    uint64_t section_offset[NumSceneSections];
+    uint64_t section_size[NumSceneSections];
+};
+static_assert(sizeof(SceneBinaryHeader) % 8 == 0, "The payload must be 8 byte aligned.");
+
+bool IsBinarySceneFile(const std::string& file)
+{
+    std::ifstream strm(file, std::ios::binary);
+    char magic[sizeof(scene_binary_magic)];
+    if (!strm.read(magic, sizeof(magic))) return false;
+    return std::memcmp(magic, scene_binary_magic, sizeof(magic)) == 0;
+}
+}  // namespace
+
 bool Scene::imgui()
 {
     ImGui::PushID(473441235);
@@ -132,6 +205,12 @@ void Scene::load(const std::string& file)
         return;
     }
 
+    if (IsBinarySceneFile(f))
+    {
+        loadBinary(f);
+        return;
+    }
+
     std::ifstream strm(f);
     SAIGA_ASSERT(strm.is_open());
 
@@ -199,6 +278,223 @@ void Scene::load(const std::string& file)
     SAIGA_ASSERT(valid());
 }
 
+void Scene::saveBinary(const std::string& file, bool compress)
+{
+    SAIGA_ASSERT(valid());
+    std::cout << "Saving binary scene to " << file << "." << std::endl;
+
+    SceneBinaryHeader header = {};
+    std::memcpy(header.magic, scene_binary_magic, sizeof(header.magic));
+    header.version          = scene_binary_version;
+    header.compressed       = compress;
+    header.num_intrinsics   = intrinsics.size();
+    header.num_images       = images.size();
+    header.num_world_points = worldPoints.size();
+    header.bf               = bf;
+    header.global_scale     = globalScale;
+    for (auto& img : images) header.num_observations += img.stereoPoints.size();
+
+    int64_t ni = header.num_intrinsics, n = header.num_images, m = header.num_observations;
+    header.section_size[Intrinsics]             = 5 * ni * sizeof(double);
+    header.section_size[ImagePose]              = 7 * n * sizeof(double);
+    header.section_size[ImageVelocity]          = 7 * n * sizeof(double);
+    header.section_size[ImageConstant]          = n * sizeof(uint8_t);
+    header.section_size[ImageIntrinsics]        = n * sizeof(int32_t);
+    header.section_size[ImageObservationOffset] = (n + 1) * sizeof(int64_t);
+    header.section_size[ObservationWorldPoint]  = m * sizeof(int32_t);
+    header.section_size[ObservationDepth]       = m * sizeof(double);
+    header.section_size[ObservationPoint]       = 2 * m * sizeof(double);
+    header.section_size[ObservationWeight]      = m * sizeof(float);
+    header.section_size[WorldPointPosition]     = 3 * header.num_world_points * sizeof(double);
+
+    uint64_t offset = 0;
+    for (int s = 0; s < NumSceneSections; ++s)
+    {
+        header.section_offset[s] = offset;
+        offset                   = iAlignUp(offset + header.section_size[s], 8);
+    }
+    header.payload_size = offset;
+
+    std::vector<char> payload(header.payload_size, 0);
+    auto section = [&](SceneSection s) { return payload.data() + header.section_offset[s]; };
+
+    auto intr_coeffs = (double*)section(Intrinsics);
+    for (int64_t i = 0; i < ni; ++i)
+    {
+        Vec5 c = intrinsics[i].coeffs();
+        std::memcpy(intr_coeffs + 5 * i, c.data(), 5 * sizeof(double));
+    }
+
+    auto pose       = (double*)section(ImagePose);
+    auto velocity   = (double*)section(ImageVelocity);
+    auto constant   = (uint8_t*)section(ImageConstant);
+    auto image_intr = (int32_t*)section(ImageIntrinsics);
+    auto obs_offset = (int64_t*)section(ImageObservationOffset);
+    auto obs_wp     = (int32_t*)section(ObservationWorldPoint);
+    auto obs_depth  = (double*)section(ObservationDepth);
+    auto obs_point  = (double*)section(ObservationPoint);
+    auto obs_weight = (float*)section(ObservationWeight);
+    int64_t current = 0;
+    for (int64_t i = 0; i < n; ++i)
+    {
+        auto& img = images[i];
+        std::memcpy(pose + 7 * i, img.se3.data(), 7 * sizeof(double));
+        std::memcpy(velocity + 7 * i, img.velocity.data(), 7 * sizeof(double));
+        constant[i]   = img.constant;
+        image_intr[i] = img.intr;
+        obs_offset[i] = current;
+        for (auto& ip : img.stereoPoints)
+        {
+            obs_wp[current]            = ip.wp;
+            obs_depth[current]         = ip.depth;
+            obs_point[2 * current + 0] = ip.point(0);
+            obs_point[2 * current + 1] = ip.point(1);
+            obs_weight[current]        = ip.weight;
+            current++;
+        }
+    }
+    obs_offset[n] = current;
+
+    auto wp_position = (double*)section(WorldPointPosition);
+    for (size_t i = 0; i < worldPoints.size(); ++i)
+    {
+        std::memcpy(wp_position + 3 * i, worldPoints[i].p.data(), 3 * sizeof(double));
+    }
+
+    std::vector<unsigned char> compressed_data;
+    const char* file_payload = payload.data();
+    header.file_payload_size = payload.size();
+    if (compress)
+    {
+#ifdef SAIGA_USE_ZLIB
+        compressed_data          = Saiga::compress(payload.data(), payload.size());
+        file_payload             = (const char*)compressed_data.data();
+        header.file_payload_size = compressed_data.size();
+#else
+        SAIGA_EXIT_ERROR("zlib not found.");
+#endif
+    }
+
+    std::ofstream strm(file, std::ios::binary | std::ios::out);
+    SAIGA_ASSERT(strm.is_open());
+    strm.write((const char*)&header, sizeof(header));
+    strm.write(file_payload, header.file_payload_size);
+}
+
+void Scene::loadBinary(const std::string& file)
+{
+    std::cout << "Loading binary scene from " << file << "." << std::endl;
+
+    (*this)       = Scene();
+    std::string f = SearchPathes::data(file);
+    MemoryMappedFile mapped_file;
+    if (f.empty() || !mapped_file.open(f))
+    {
+        std::cout << "could not find file " << file << std::endl;
+        return;
+    }
+
+    SceneBinaryHeader header;
+    if (mapped_file.size() < sizeof(header)) SAIGA_EXIT_ERROR("Invalid scene file.");
+    std::memcpy(&header, mapped_file.data(), sizeof(header));
+    if (std::memcmp(header.magic, scene_binary_magic, sizeof(header.magic)) != 0)
+    {
+        SAIGA_EXIT_ERROR("Invalid magic number.");
+    }
+    if (header.version != scene_binary_version)
+    {
+        SAIGA_EXIT_ERROR("Unsupported scene file version " + std::to_string(header.version) + ".");
+    }
+
+    // Checked before uncompressing, because the zlib container is read without bounds checks.
+    // The file checks below are also active if asserts are disabled.
+    if (mapped_file.size() - sizeof(header) < header.file_payload_size) SAIGA_EXIT_ERROR("Truncated scene file.");
+    if (!header.compressed && header.file_payload_size != header.payload_size)
+    {
+        SAIGA_EXIT_ERROR("Invalid scene file.");
+    }
+
+    // The mapped file is page aligned and the header size is a multiple of 8.
+    // The arrays can therefore be accessed directly.
+    const char* payload = mapped_file.data() + sizeof(header);
+    std::vector<unsigned char> uncompressed;
+    if (header.compressed)
+    {
+#ifdef SAIGA_USE_ZLIB
+        uncompressed = Saiga::uncompress(payload);
+        if (uncompressed.size() != header.payload_size) SAIGA_EXIT_ERROR("Invalid scene file.");
+        payload = (const char*)uncompressed.data();
+#else
+        SAIGA_EXIT_ERROR("zlib not found.");
+#endif
+    }
+
+    int64_t ni = header.num_intrinsics, n = header.num_images, m = header.num_observations;
+    auto section = [&](SceneSection s, uint64_t expected_size) {
+        if (header.section_size[s] != expected_size ||
+            header.section_offset[s] + header.section_size[s] > header.payload_size)
+        {
+            SAIGA_EXIT_ERROR("Invalid scene file.");
+        }
+        return payload + header.section_offset[s];
+    };
+
+    bf          = header.bf;
+    globalScale = header.global_scale;
+
+    auto intr_coeffs = (const double*)section(Intrinsics, 5 * ni * sizeof(double));
+    intrinsics.resize(ni);
+    for (int64_t i = 0; i < ni; ++i)
+    {
+        intrinsics[i] = Vec5(Eigen::Map<const Vec5>(intr_coeffs + 5 * i));
+    }
+
+    auto pose       = (const double*)section(ImagePose, 7 * n * sizeof(double));
+    auto velocity   = (const double*)section(ImageVelocity, 7 * n * sizeof(double));
+    auto constant   = (const uint8_t*)section(ImageConstant, n * sizeof(uint8_t));
+    auto image_intr = (const int32_t*)section(ImageIntrinsics, n * sizeof(int32_t));
+    auto obs_offset = (const int64_t*)section(ImageObservationOffset, (n + 1) * sizeof(int64_t));
+    auto obs_wp     = (const int32_t*)section(ObservationWorldPoint, m * sizeof(int32_t));
+    auto obs_depth  = (const double*)section(ObservationDepth, m * sizeof(double));
+    auto obs_point  = (const double*)section(ObservationPoint, 2 * m * sizeof(double));
+    auto obs_weight = (const float*)section(ObservationWeight, m * sizeof(float));
+    if (obs_offset[0] != 0 || obs_offset[n] != m) SAIGA_EXIT_ERROR("Invalid scene file.");
+
+    images.resize(n);
+    for (int64_t i = 0; i < n; ++i)
+    {
+        auto& img = images[i];
+        std::memcpy(img.se3.data(), pose + 7 * i, 7 * sizeof(double));
+        std::memcpy(img.velocity.data(), velocity + 7 * i, 7 * sizeof(double));
+        img.constant = constant[i];
+        img.intr     = image_intr[i];
+        if (img.intr < 0 || img.intr >= ni) SAIGA_EXIT_ERROR("Invalid scene file.");
+
+        int64_t begin = obs_offset[i], end = obs_offset[i + 1];
+        if (begin > end || end > m) SAIGA_EXIT_ERROR("Invalid scene file.");
+        img.stereoPoints.resize(end - begin);
+        for (int64_t j = begin; j < end; ++j)
+        {
+            auto& ip  = img.stereoPoints[j - begin];
+            ip.wp     = obs_wp[j];
+            if (ip.wp < -1 || ip.wp >= header.num_world_points) SAIGA_EXIT_ERROR("Invalid scene file.");
+            ip.depth  = obs_depth[j];
+            ip.point  = Vec2(obs_point[2 * j], obs_point[2 * j + 1]);
+            ip.weight = obs_weight[j];
+        }
+    }
+
+    auto wp_position = (const double*)section(WorldPointPosition, 3 * header.num_world_points * sizeof(double));
+    worldPoints.resize(header.num_world_points);
+    for (size_t i = 0; i < worldPoints.size(); ++i)
+    {
+        worldPoints[i].p = Vec3(Eigen::Map<const Vec3>(wp_position + 3 * i));
+    }
+
+    fixWorldPointReferences();
+    SAIGA_ASSERT(valid());
+}
+
 
 std::ostream& operator<<(std::ostream& strm, Scene& scene)
 {
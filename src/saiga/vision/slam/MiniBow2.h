@@ -1113,4 +1113,215 @@ std::ostream& operator<<(std::ostream& os, const TemplatedVocabulary<Descriptor>
     return os;
 }
 
+// --------------------------------------------------------------------------
+
+/**
+ * Inverted-file database of bow vectors for place recognition and relocalization.
+ *
+ * For every word the database stores the list of entries that contain this word. A query only visits the
+ * lists of the words in the query vector, so the cost grows with the number of shared words and not with
+ * the number of entries. The scores are identical to FeatureVector::score.
+ *
+ * Optionally the feature vector (direct index) of each entry is stored for guided matching.
+ *
+ * Entry ids are chosen by the user (for example the keyframe id) and should be small non-negative integers,
+ * because some per-entry data is stored in dense arrays.
+ *
+ * Concurrent queries are thread-safe, because the scratch buffers are thread_local. Modifications (add, remove,
+ * clear) must not run concurrently with queries or with each other.
+ *
+ * Usage:
+ *
+ * Database db(voc);
+ * db.add(kf->id, kf->bow, kf->fv);
+ * auto candidates = db.query(frame.bow, 10);
+ */
+class Database
+{
+   public:
+    using EntryId = int;
+
+    struct QueryResult
+    {
+        EntryId id;
+        WordValue score;
+        // Number of words shared with the query
+        int common_words;
+    };
+
+    /**
+     * @param num_words the size of the vocabulary
+     * @param use_direct_index store the feature vector of each entry
+     */
+    Database(int num_words, bool use_direct_index = true)
+        : inverted_file(num_words), use_direct_index(use_direct_index)
+    {
+    }
+
+    template <class Descriptor>
+    Database(const TemplatedVocabulary<Descriptor>& voc, bool use_direct_index = true)
+        : Database(voc.size(), use_direct_index)
+    {
+    }
+
+    /**
+     * Adds a new entry. If the id already exists, the old entry is replaced.
+     */
+    void add(EntryId id, const BowVector& bow, const FeatureVector& fv = {})
+    {
+        SAIGA_ASSERT(id >= 0);
+        if (contains(id)) remove(id);
+
+        if (id >= entries.size())
+        {
+            entries.resize(id + 1);
+        }
+
+        auto& e = entries[id];
+        e.valid = true;
+        e.bow   = bow;
+        if (use_direct_index) e.fv = fv;
+
+        for (auto& [word, value] : bow)
+        {
+            SAIGA_ASSERT(word >= 0 && word < inverted_file.size());
+            inverted_file[word].push_back({id, value});
+        }
+        num_entries++;
+    }
+
+    /**
+     * Removes an entry. The cost is linear in the length of the inverted lists of its words.
+     */
+    void remove(EntryId id)
+    {
+        if (!contains(id)) return;
+        auto& e = entries[id];
+        for (auto& w : e.bow)
+        {
+            auto& list = inverted_file[w.first];
+            auto it    = std::find_if(list.begin(), list.end(), [id](const Posting& p) { return p.id == id; });
+            SAIGA_ASSERT(it != list.end());
+            // The order inside a list does not matter
+            *it = list.back();
+            list.pop_back();
+        }
+        e = Entry();
+        num_entries--;
+    }
+
+    void clear()
+    {
+        for (auto& list : inverted_file) list.clear();
+        entries.clear();
+        num_entries = 0;
+    }
+
+    bool contains(EntryId id) const { return id >= 0 && id < entries.size() && entries[id].valid; }
+    int size() const { return num_entries; }
+    int numWords() const { return inverted_file.size(); }
+
+    const BowVector& getBowVector(EntryId id) const
+    {
+        SAIGA_ASSERT(contains(id));
+        return entries[id].bow;
+    }
+
+    // Empty if the direct index is disabled
+    const FeatureVector& getFeatureVector(EntryId id) const
+    {
+        SAIGA_ASSERT(contains(id));
+        return entries[id].fv;
+    }
+
+    /**
+     * Returns the 'max_results' entries with the highest score, sorted by decreasing score.
+     * Only entries with score >= min_score are returned.
+     */
+    std::vector<QueryResult> query(const BowVector& bow, int max_results, WordValue min_score = 0) const
+    {
+        return query(bow, max_results, min_score, [](EntryId) { return true; });
+    }
+
+    /**
+     * Same as above, but only entries for which filter(id) returns true are considered.
+     * For example, to skip the keyframes connected to the query keyframe.
+     *
+     * Thread safe: concurrent queries use thread local accumulators. The filter must not query again.
+     */
+    template <typename Filter>
+    std::vector<QueryResult> query(const BowVector& bow, int max_results, WordValue min_score, Filter filter) const
+    {
+        // Accumulate the L1 score over the shared words. The words of the query are visited in increasing order,
+        // so the summation order (and therefore the result) equals FeatureVector::score.
+        // The dense accumulators are indexed by entry id and are zero outside of query().
+        static thread_local std::vector<WordValue> tmp_scores;
+        static thread_local std::vector<int> tmp_common;
+        static thread_local std::vector<EntryId> tmp_touched;
+        if (tmp_scores.size() < entries.size())
+        {
+            tmp_scores.resize(entries.size(), 0);
+            tmp_common.resize(entries.size(), 0);
+        }
+        tmp_touched.clear();
+        for (auto& [word, qi] : bow)
+        {
+            for (auto& p : inverted_file[word])
+            {
+                if (tmp_common[p.id] == 0) tmp_touched.push_back(p.id);
+                tmp_scores[p.id] += std::abs(qi - p.value) - std::abs(qi) - std::abs(p.value);
+                tmp_common[p.id]++;
+            }
+        }
+
+        std::vector<QueryResult> result;
+        result.reserve(tmp_touched.size());
+        for (auto id : tmp_touched)
+        {
+            WordValue score = tmp_scores[id] * WordValue(-0.5);
+            if (score >= min_score && filter(id))
+            {
+                result.push_back({id, score, tmp_common[id]});
+            }
+            // Reset only the touched entries
+            tmp_scores[id] = 0;
+            tmp_common[id] = 0;
+        }
+
+        // Ties are broken by id to get a deterministic order
+        auto cmp = [](const QueryResult& a, const QueryResult& b) {
+            return a.score > b.score || (a.score == b.score && a.id < b.id);
+        };
+        if (max_results >= 0 && result.size() > max_results)
+        {
+            std::partial_sort(result.begin(), result.begin() + max_results, result.end(), cmp);
+            result.resize(max_results);
+        }
+        else
+        {
+            std::sort(result.begin(), result.end(), cmp);
+        }
+        return result;
+    }
+
+   private:
+    struct Posting
+    {
+        EntryId id;
+        WordValue value;
+    };
+
+    struct Entry
+    {
+        bool valid = false;
+        BowVector bow;
+        FeatureVector fv;
+    };
+
+    std::vector<std::vector<Posting>> inverted_file;
+    std::vector<Entry> entries;
+    bool use_direct_index;
+    int num_entries = 0;
+};
+
 }  // namespace MiniBow2
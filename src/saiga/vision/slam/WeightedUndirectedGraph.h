@@ -8,16 +8,138 @@
 
 #include "saiga/config.h"
 #include "saiga/core/math/math.h"
+#include "saiga/core/util/DataStructures/ArrayView.h"
+#include "saiga/core/util/assert.h"
 
-#include <vector>
+#include <algorithm>
 #include <fstream>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 namespace Saiga
 {
+/**
+ * Graph algorithms on sparse weighted undirected graphs, for example the covisibility graph of keyframes.
+ *
+ * The graph type must provide:
+ *    int NumNodes() const
+ *    void ForEachNeighbor(int node, F f) const   calls f(int neighbor, T weight) for all edges of node
+ *
+ * Both WeightedUndirectedGraph (incremental) and CSRGraph (static) implement this interface.
+ */
+
+// Maximum spanning forest with Prim's algorithm and a binary heap in O(E log V).
+// The strongest edges are kept. Returns the parent of each node. Roots (one per connected component) have parent -1.
+template <typename Graph>
+std::vector<int> MaximumSpanningForest(const Graph& graph)
+{
+    using T = typename Graph::WeightType;
+    int n   = graph.NumNodes();
+
+    std::vector<int> parents(n, -1);
+    std::vector<bool> visited(n, false);
+
+    // (weight, node, parent). Outdated entries are skipped when they are popped (lazy deletion).
+    using Entry = std::tuple<T, int, int>;
+    auto cmp    = [](const Entry& a, const Entry& b) {
+        // Ties are broken by the ids, so that the result does not depend on the order of the neighbors.
+        if (std::get<0>(a) != std::get<0>(b)) return std::get<0>(a) < std::get<0>(b);
+        if (std::get<1>(a) != std::get<1>(b)) return std::get<1>(a) > std::get<1>(b);
+        return std::get<2>(a) > std::get<2>(b);
+    };
+    std::priority_queue<Entry, std::vector<Entry>, decltype(cmp)> queue(cmp);
+
+    for (int root = 0; root < n; ++root)
+    {
+        if (visited[root]) continue;
+        visited[root] = true;
+        graph.ForEachNeighbor(root, [&](int j, T w) { queue.emplace(w, j, root); });
+
+        while (!queue.empty())
+        {
+            auto [weight, node, parent] = queue.top();
+            queue.pop();
+            if (visited[node]) continue;
+
+            visited[node] = true;
+            parents[node] = parent;
+            graph.ForEachNeighbor(node, [&](int j, T w) {
+                if (!visited[j]) queue.emplace(w, j, node);
+            });
+        }
+    }
+    return parents;
+}
+
+// Assigns a component id to each node. Returns the number of components.
+template <typename Graph>
+int ConnectedComponents(const Graph& graph, std::vector<int>& component)
+{
+    using T = typename Graph::WeightType;
+    int n   = graph.NumNodes();
+    component.assign(n, -1);
+
+    int num_components = 0;
+    std::vector<int> stack;
+    for (int root = 0; root < n; ++root)
+    {
+        if (component[root] != -1) continue;
+        component[root] = num_components;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int node = stack.back();
+            stack.pop_back();
+            graph.ForEachNeighbor(node, [&](int j, T) {
+                if (component[j] == -1)
+                {
+                    component[j] = num_components;
+                    stack.push_back(j);
+                }
+            });
+        }
+        num_components++;
+    }
+    return num_components;
+}
+
+// The k neighbors with the largest weight sorted by decreasing weight.
+template <typename Graph>
+std::vector<std::pair<int, typename Graph::WeightType>> StrongestNeighbors(const Graph& graph, int node, int k)
+{
+    using T = typename Graph::WeightType;
+    std::vector<std::pair<int, T>> result;
+    graph.ForEachNeighbor(node, [&](int j, T w) { result.emplace_back(j, w); });
+
+    auto cmp = [](const auto& a, const auto& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
+    if (k < (int)result.size())
+    {
+        std::partial_sort(result.begin(), result.begin() + k, result.end(), cmp);
+        result.resize(k);
+    }
+    else
+    {
+        std::sort(result.begin(), result.end(), cmp);
+    }
+    return result;
+}
+
+/**
+ * A weighted undirected graph with hashed adjacency lists.
+ *
+ * Designed for incremental updates, for example the covisibility weights between keyframes, which change whenever
+ * a map point is added or removed. Adding, updating and removing an edge is O(1). The memory is O(V + E).
+ * For static graphs see CSRGraph, which is more compact and faster to traverse.
+ */
 template <typename T>
 class WeightedUndirectedGraph
 {
    public:
+    using WeightType                  = T;
     static constexpr T invalid_weight = std::numeric_limits<T>::max();
 
     WeightedUndirectedGraph(int n = 0) { Resize(n); }
@@ -25,11 +147,23 @@ class WeightedUndirectedGraph
     void Resize(int n)
     {
         this->n = n;
-        adjacencyMatrix.resize(n, n);
+        adjacency.resize(n);
         Clear();
     }
 
-    void Clear() { adjacencyMatrix.setConstant(invalid_weight); }
+    void Clear()
+    {
+        for (auto& a : adjacency) a.clear();
+        num_edges = 0;
+        parents.clear();
+    }
+
+    // Adds a new node without edges. Returns its id.
+    int AddNode()
+    {
+        adjacency.emplace_back();
+        return n++;
+    }
 
     struct Edge
     {
@@ -39,151 +173,132 @@ class WeightedUndirectedGraph
 
     void AddEdge(const Edge& edge) { AddEdge(edge.from, edge.to, edge.weight); }
 
+    // Adds the edge or overwrites its weight.
     void AddEdge(int from, int to, T weight)
     {
-        adjacencyMatrix(from, to) = weight;
-        adjacencyMatrix(to, from) = weight;
+        SAIGA_ASSERT(from != to);
+        auto [it, inserted] = adjacency[from].insert_or_assign(to, weight);
+        adjacency[to][from] = weight;
+        if (inserted) num_edges++;
     }
 
-
-
-    void BuildMST()
+    // Adds 'delta' to the weight of the edge. The edge is created if it does not exist and removed if the weight
+    // reaches 0. Use this to update covisibility counts.
+    void AddWeight(int from, int to, T delta)
     {
-        // Efficient Implementation of Prim's algorithm.
-        // Starting at any vertex, the  edge with the highest weight is added to the graph.
-        // This is done until all vertices are added or we detect that the graph is not connected.
-
-
-        // mark nodes already added
-        visited.resize(n);
-        std::fill(visited.begin(), visited.end(), false);
-
-        parents.resize(n);
-        std::fill(parents.begin(), parents.end(), -1);
-
-        current_weight.resize(n);
-        std::fill(current_weight.begin(), current_weight.end(), std::numeric_limits<T>::min());
-
-        // Set weight of node 0 so it will be selected in the first iteration
-        // Don't set visited otherwise it would not be selected.
-        parents[0]        = -1;
-        current_weight[0] = 1;
+        SAIGA_ASSERT(from != to);
+        auto [it, inserted] = adjacency[from].try_emplace(to, T(0));
+        it->second += delta;
+        if (it->second == T(0))
+        {
+            adjacency[from].erase(it);
+            adjacency[to].erase(from);
+            if (!inserted) num_edges--;
+            return;
+        }
+        adjacency[to][from] = it->second;
+        if (inserted) num_edges++;
+    }
 
-        for (int i = 0; i < n - 1; ++i)
+    void RemoveEdge(int from, int to)
+    {
+        if (adjacency[from].erase(to))
         {
-            // find node with largest weight
-            int next_node   = -1;
-            int best_weight = -1;
-            for (int j = 0; j < n; ++j)
-            {
-                // already added to the graph
-                if (visited[j]) continue;
+            adjacency[to].erase(from);
+            num_edges--;
+        }
+    }
 
-                if (current_weight[j] > best_weight)
-                {
-                    best_weight = current_weight[j];
-                    next_node   = j;
-                }
-            }
+    // Removes all edges of this node. The node id stays valid.
+    void RemoveEdges(int node)
+    {
+        for (auto& [j, w] : adjacency[node]) adjacency[j].erase(node);
+        num_edges -= adjacency[node].size();
+        adjacency[node].clear();
+    }
 
-            // The graph is not connected
-            if (next_node == -1) break;
+    // Returns invalid_weight if the edge does not exist.
+    T Weight(int from, int to) const
+    {
+        auto it = adjacency[from].find(to);
+        return it == adjacency[from].end() ? invalid_weight : it->second;
+    }
 
-            SAIGA_ASSERT(next_node != -1);
+    int NumNodes() const { return n; }
+    int NumEdges() const { return num_edges; }
+    int Degree(int node) const { return adjacency[node].size(); }
 
-            visited[next_node] = true;
+    template <typename F>
+    void ForEachNeighbor(int node, F f) const
+    {
+        for (auto& [j, w] : adjacency[node]) f(j, w);
+    }
 
-            // update weight of adjacency nodes
-            for (int j = 0; j < n; ++j)
-            {
-                if (visited[j]) continue;
-                auto v = adjacencyMatrix(next_node, j);
-                if (v != invalid_weight && v > current_weight[j])
-                {
-                    current_weight[j] = v;
-                    parents[j]        = next_node;
-                }
-            }
-        }
+    // The k strongest neighbors of node.
+    std::vector<std::pair<int, T>> StrongestNeighbors(int node, int k) const
+    {
+        return Saiga::StrongestNeighbors(*this, node, k);
     }
 
+    int ConnectedComponents(std::vector<int>& component) const { return Saiga::ConnectedComponents(*this, component); }
 
+    // Computes the maximum spanning tree (a forest if the graph is not connected) in O(E log V).
+    // The result is accessed by the GetMST* functions below.
+    void BuildMST() { parents = MaximumSpanningForest(*this); }
 
-    WeightedUndirectedGraph GetMSTAsGraph()
+    WeightedUndirectedGraph GetMSTAsGraph() const
     {
         WeightedUndirectedGraph output(n);
-        for (int i = 1; i < n; i++)
+        for (int i = 0; i < n; i++)
         {
             if (parents[i] >= 0)
             {
-                Edge e;
-                e.from   = parents[i];
-                e.to     = i;
-                e.weight = adjacencyMatrix(i, parents[i]);
-                output.AddEdge(e);
+                output.AddEdge(parents[i], i, Weight(i, parents[i]));
             }
         }
-
         return output;
     }
 
-    std::vector<Edge> GetMSTEdgesForNode(int node)
+    std::vector<Edge> GetMSTEdgesForNode(int node) const
     {
-        std::vector<WeightedUndirectedGraph::Edge> result;
-
-        for (int i = 1; i < n; i++)
+        std::vector<Edge> result;
+        if (parents[node] >= 0)
         {
-            if (parents[i] >= 0)
-            {
-                if (i == node)
-                {
-                    Edge e;
-                    e.from   = i;
-                    e.to     = parents[i];
-                    e.weight = adjacencyMatrix(i, parents[i]);
-                    result.push_back(e);
-                }
-                else if (parents[i] == node)
-                {
-                    Edge e;
-                    e.from   = parents[i];
-                    e.to     = i;
-                    e.weight = adjacencyMatrix(i, parents[i]);
-                    result.push_back(e);
-                }
-            }
+            result.push_back({node, parents[node], double(Weight(node, parents[node]))});
+        }
+        // The children of node are neighbors in the graph
+        for (auto& [j, w] : adjacency[node])
+        {
+            if (parents[j] == node) result.push_back({node, j, double(w)});
         }
         return result;
     }
 
-    T WeightOfWeakestMSTEdge()
+    T WeightOfWeakestMSTEdge() const
     {
         T w = std::numeric_limits<T>::max();
-        for (int i = 1; i < n; i++)
+        for (int i = 0; i < n; i++)
         {
             if (parents[i] >= 0)
             {
-                w = std::min(w, adjacencyMatrix(i, parents[i]));
+                w = std::min(w, Weight(i, parents[i]));
             }
         }
         return w;
     }
 
-    T WeightOfWeakestEdge()
+    T WeightOfWeakestEdge() const
     {
         T w = std::numeric_limits<T>::max();
-        for (int i = 0; i < n; ++i)
+        for (auto& a : adjacency)
         {
-            for (int j = 0; j < n; ++j)
-            {
-                w = std::min(w, adjacencyMatrix(i, j));
-            }
+            for (auto& [j, v] : a) w = std::min(w, v);
         }
         return w;
     }
 
 
-    void CreateDotFile(const std::string& file, const std::vector<std::string>& node_names = {})
+    void CreateDotFile(const std::string& file, const std::vector<std::string>& node_names = {}) const
     {
         std::ofstream strm(file);
         SAIGA_ASSERT(strm.is_open());
@@ -203,12 +318,9 @@ class WeightedUndirectedGraph
 
         for (int i = 0; i < n; ++i)
         {
-            for (int j = 0; j < i; ++j)
+            for (auto& [j, v] : adjacency[i])
             {
-                auto v = adjacencyMatrix(i, j);
-                if (v == invalid_weight) continue;
-
-
+                if (j >= i) continue;
                 strm << "\t" << nameforid(i) << " -- " << nameforid(j) << " [label=\"" << v
                      << "\", dir=none, len=" << 1.0 / (v / 300.0) << "]" << std::endl;
             }
@@ -219,20 +331,13 @@ class WeightedUndirectedGraph
 
 
 
-    std::vector<Edge> GetEdgesForNode(int node)
+    std::vector<Edge> GetEdgesForNode(int node) const
     {
-        std::vector<WeightedUndirectedGraph::Edge> result;
-        for (int i = 0; i < n; ++i)
+        std::vector<Edge> result;
+        result.reserve(adjacency[node].size());
+        for (auto& [j, w] : adjacency[node])
         {
-            auto v = adjacencyMatrix(node, i);
-            if (v != invalid_weight)
-            {
-                Edge e;
-                e.from   = node;
-                e.to     = i;
-                e.weight = v;
-                result.push_back(e);
-            }
+            result.push_back({node, j, double(w)});
         }
         return result;
     }
@@ -240,11 +345,82 @@ class WeightedUndirectedGraph
     int n;
 
    private:
-    Eigen::Matrix<T, -1, -1> adjacencyMatrix;
+    // adjacency[i][j] is the weight of edge (i,j). Every edge is stored in both directions.
+    std::vector<std::unordered_map<int, T>> adjacency;
+    int num_edges = 0;
 
-    // Tmp variables to store and compute the MST
-    std::vector<bool> visited;
+    // Parent of each node in the MST
     std::vector<int> parents;
-    std::vector<T> current_weight;
 };
+
+/**
+ * A static weighted undirected graph in compressed sparse row format.
+ *
+ * The neighbors of node i are neighbors[offsets[i]] ... neighbors[offsets[i+1]-1] sorted by id.
+ * Build it from a WeightedUndirectedGraph once the graph does not change anymore.
+ */
+template <typename T>
+class CSRGraph
+{
+   public:
+    using WeightType = T;
+
+    CSRGraph() {}
+    CSRGraph(const WeightedUndirectedGraph<T>& graph)
+    {
+        int n = graph.NumNodes();
+        offsets.resize(n + 1);
+        offsets[0] = 0;
+        neighbors.reserve(2 * graph.NumEdges());
+        weights.reserve(2 * graph.NumEdges());
+
+        std::vector<std::pair<int, T>> row;
+        for (int i = 0; i < n; ++i)
+        {
+            row.clear();
+            graph.ForEachNeighbor(i, [&](int j, T w) { row.emplace_back(j, w); });
+            std::sort(row.begin(), row.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (auto [j, w] : row)
+            {
+                neighbors.push_back(j);
+                weights.push_back(w);
+            }
+            offsets[i + 1] = neighbors.size();
+        }
+    }
+
+    int NumNodes() const { return int(offsets.size()) - 1; }
+    int NumEdges() const { return neighbors.size() / 2; }
+    int Degree(int node) const { return offsets[node + 1] - offsets[node]; }
+
+    ArrayView<const int> Neighbors(int node) const
+    {
+        return ArrayView<const int>(neighbors.data() + offsets[node], Degree(node));
+    }
+    ArrayView<const T> Weights(int node) const
+    {
+        return ArrayView<const T>(weights.data() + offsets[node], Degree(node));
+    }
+
+    // Binary search in the sorted neighbors. Returns invalid_weight if the edge does not exist.
+    T Weight(int from, int to) const
+    {
+        auto begin = neighbors.begin() + offsets[from];
+        auto end   = neighbors.begin() + offsets[from + 1];
+        auto it    = std::lower_bound(begin, end, to);
+        return (it != end && *it == to) ? weights[it - neighbors.begin()]
+                                        : WeightedUndirectedGraph<T>::invalid_weight;
+    }
+
+    template <typename F>
+    void ForEachNeighbor(int node, F f) const
+    {
+        for (int e = offsets[node]; e < offsets[node + 1]; ++e) f(neighbors[e], weights[e]);
+    }
+
+    std::vector<int> offsets;
+    std::vector<int> neighbors;
+    std::vector<T> weights;
+};
+
 }  // namespace Saiga
@@ -7,6 +7,8 @@
 
 #include "Depthmap.h"
 
+#include "saiga/core/model/model_loader_ply.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
 
 namespace Saiga
 {
@@ -15,8 +17,7 @@ namespace Depthmap
 void toPointCloud(DepthMap dm, DepthPointCloud pc, const IntrinsicsPinholed& camera)
 {
     SAIGA_ASSERT(dm.h == pc.h && dm.w == pc.w);
-    for (int i = 0; i < dm.h; ++i)
-    {
+    ParallelFor(0, dm.h, [&](int i) {
         for (int j = 0; j < dm.w; ++j)
         {
             Vec2 ip(j, i);
@@ -29,15 +30,14 @@ void toPointCloud(DepthMap dm, DepthPointCloud pc, const IntrinsicsPinholed& cam
                 result = infinityVec3();
             pc(i, j) = result;
         }
-    }
+    });
 }
 
 
 void normalMap(DepthPointCloud pc, DepthNormalMap normals)
 {
     SAIGA_ASSERT(normals.h == pc.h && normals.w == pc.w);
-    for (int i = 0; i < normals.h; ++i)
-    {
+    ParallelFor(0, normals.h, [&](int i) {
         for (int j = 0; j < normals.w; ++j)
         {
             // center, left, right, up, down
@@ -65,6 +65,47 @@ void normalMap(DepthPointCloud pc, DepthNormalMap normals)
                 normals(i, j) = infinityVec3();
             }
         }
+    });
+}
+
+void savePointCloudPLY(const std::string& file, DepthPointCloud pc, const Vec3& color)
+{
+    auto valid = [](const Vec3& p) { return p.allFinite(); };
+
+    size_t count = 0;
+    for (int i = 0; i < pc.h; ++i)
+    {
+        for (int j = 0; j < pc.w; ++j) count += valid(pc(i, j));
+    }
+
+    PLY::Header header;
+    header.AddElement("vertex", count)
+        .AddProperty("x", PLY::ScalarType::Float32)
+        .AddProperty("y", PLY::ScalarType::Float32)
+        .AddProperty("z", PLY::ScalarType::Float32)
+        .AddProperty("red", PLY::ScalarType::UInt8)
+        .AddProperty("green", PLY::ScalarType::UInt8)
+        .AddProperty("blue", PLY::ScalarType::UInt8);
+    PLYWriter writer(file, header);
+
+    // The same color for all points (stride 0). The points are written one image row at a time.
+    ucvec3 c = (color.array().max(0).min(1) * 255).round().cast<unsigned char>();
+    std::vector<vec3> points;
+    std::vector<PLYWriter::ColumnData> columns(6);
+    for (int i = 0; i < pc.h; ++i)
+    {
+        points.clear();
+        for (int j = 0; j < pc.w; ++j)
+        {
+            if (valid(pc(i, j))) points.push_back(pc(i, j).cast<float>());
+        }
+        if (points.empty()) continue;
+        for (int k = 0; k < 3; ++k)
+        {
+            columns[k]     = {points.data()->data() + k, sizeof(vec3)};
+            columns[3 + k] = {c.data() + k, 0};
+        }
+        writer.WriteRows(points.size(), columns);
     }
 }
 
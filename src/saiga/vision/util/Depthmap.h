@@ -44,7 +44,7 @@ SAIGA_VISION_API void normalMap(DepthPointCloud pc, DepthNormalMap normals);
 
 
 /**
- * Exports the point cloud in ASCII .ply format.
+ * Exports the finite points of the point cloud in binary .ply format.
  * This can be viewed for example with meshlab.
  */
 SAIGA_VISION_API void savePointCloudPLY(const std::string& file, DepthPointCloud pc, const Vec3& color = Vec3(1, 0, 0));
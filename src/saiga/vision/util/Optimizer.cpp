@@ -36,6 +36,7 @@ void OptimizationOptions::imgui()
     {
         ImGui::InputInt("maxIterativeIterations", &maxIterativeIterations);
         ImGui::InputDouble("iterativeTolerance", &iterativeTolerance);
+        ImGui::Checkbox("mixedPrecision", &mixedPrecision);
     }
 
     ImGui::Checkbox("debugOutput", &debugOutput);
@@ -53,6 +54,7 @@ std::ostream& operator<<(std::ostream& strm, const OptimizationOptions& op)
         strm << " solverType: CG Schur" << std::endl;
         strm << " maxIterativeIterations: " << op.maxIterativeIterations << std::endl;
         strm << " iterativeTolerance: " << op.iterativeTolerance << std::endl;
+        strm << " mixedPrecision: " << op.mixedPrecision << std::endl;
     }
     else
     {
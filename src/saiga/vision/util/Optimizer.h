@@ -43,6 +43,10 @@ struct SAIGA_VISION_API OptimizationOptions
     double iterativeTolerance  = 1e-5;
     bool buildExplizitSchur    = false;
 
+    // Solve the linear system in float with iterative refinement in double.
+    // Only used by the iterative solver of BARec with solver_threads == 1. Other solvers print a warning.
+    bool mixedPrecision = false;
+
     // early termiante if the chi2 delta is smaller than this value
     double minChi2Delta  = 1e-5;
     double initialLambda = 1.00e-04;
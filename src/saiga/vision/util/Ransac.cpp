@@ -9,4 +9,32 @@
 namespace Saiga
 {
 uint64_t ransacRandomSeed = 92730469346UL;
+
+int RansacAdaptiveIterations(double inlierRatio, double confidence, int sampleSize, double acceptance)
+{
+    // Probability that one hypothesis is an accepted all-inlier sample
+    double p = std::pow(inlierRatio, sampleSize) * acceptance;
+    if (!(p > 0)) return std::numeric_limits<int>::max();
+    if (p >= 1) return 1;
+
+    double its = std::ceil(std::log(1 - confidence) / std::log(1 - p));
+    return its >= std::numeric_limits<int>::max() ? std::numeric_limits<int>::max() : std::max(1, int(its));
+}
+
+double RansacSprtThreshold(double delta, double epsilon, double modelCost)
+{
+    // Kullback-Leibler divergence between the two hypotheses 'bad model' and 'good model'
+    double C = (1 - delta) * std::log((1 - delta) / (1 - epsilon)) + delta * std::log(delta / epsilon);
+
+    double K = modelCost * C + 1;
+    double A = K;
+    for (int i = 0; i < 10; ++i)
+    {
+        double next = K + std::log(A);
+        if (std::abs(next - A) < 1e-5) break;
+        A = next;
+    }
+    return A;
+}
+
 }  // namespace Saiga
@@ -9,6 +9,10 @@
 #include "saiga/core/util/Thread/omp.h"
 #include "saiga/vision/VisionTypes.h"
 
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
 
 namespace Saiga
 {
@@ -21,6 +25,7 @@ SAIGA_VISION_API extern uint64_t ransacRandomSeed;
 
 struct RansacParameters
 {
+    // Upper bound on the number of hypotheses.
     int maxIterations = -1;
 
     // compared to the value which is returned from computeResidual.
@@ -34,9 +39,55 @@ struct RansacParameters
     // Number of omp threads in that group
     // Note:
     int threads = 1;
+
+    // Stop early when, with probability 'confidence', at least one all-inlier sample has been drawn.
+    // The bound is computed from the best inlier ratio found so far and can only decrease.
+    bool adaptive     = false;
+    double confidence = 0.999;
+
+    // Wald's sequential probability ratio test (Matas, Chum 2005).
+    // The residuals of a hypothesis are evaluated in order and the hypothesis is rejected as soon as
+    // the likelihood ratio 'bad model / good model' exceeds a threshold. Bad models are therefore
+    // discarded after a few residuals.
+    bool sprt = false;
+    // Initial guess of the probability that a point is consistent with a bad model.
+    // It is re-estimated from the rejected hypotheses.
+    double sprtDelta = 0.01;
+    // Lower bound of the inlier ratio. The best inlier ratio found so far is used if it is larger.
+    double sprtEpsilon = 0.1;
+    // Cost of one computeModel call measured in computeResidual calls.
+    double sprtModelCost = 200;
 };
 
+/**
+ * Number of iterations required to draw at least one all-inlier sample of size 'sampleSize'
+ * with the given probability. 'acceptance' is the probability that an all-inlier hypothesis
+ * passes the verification (1 without SPRT).
+ */
+SAIGA_VISION_API int RansacAdaptiveIterations(double inlierRatio, double confidence, int sampleSize,
+                                              double acceptance = 1.0);
+
+/**
+ * The SPRT decision threshold A for the given delta and epsilon.
+ * Solves A = modelCost * C + 1 + log(A) by fixed point iteration (Chum, Matas 2008).
+ */
+SAIGA_VISION_API double RansacSprtThreshold(double delta, double epsilon, double modelCost);
+
 
+/**
+ * Base class of the RANSAC solvers (five point, eight point, homography, P3P, ...).
+ *
+ * The derived class implements
+ *      bool computeModel(const Subset& set, Model& model);
+ *      double computeResidual(const Model& model, int i);
+ *
+ * compute() must be called by all threads of an OpenMP parallel region with params.threads threads.
+ * Each thread keeps only its best model and inlier mask. After compute() the result is stored in
+ * bestModel, bestInliers and bestNumInliers.
+ *
+ * By default all params.maxIterations hypotheses are evaluated on all points. The options in
+ * RansacParameters enable early termination and SPRT. A PROSAC ordering can be set with setMatchQuality().
+ */
 template <typename Derived, typename Model, int ModelSize>
 class RansacBase
 {
@@ -45,28 +96,42 @@ class RansacBase
     {
         params = _params;
         SAIGA_ASSERT(params.maxIterations > 0);
-        SAIGA_ASSERT(OMP::getNumThreads() == 1);
-
-        numInliers.resize(params.maxIterations);
-        models.resize(params.maxIterations);
-
-        residuals.resize(params.maxIterations);
-        for (auto&& r : residuals) r.reserve(params.reserveN);
-
-        inliers.resize(params.maxIterations);
-        for (auto&& r : inliers) r.reserve(params.reserveN);
-
+#ifdef SAIGA_HAS_OMP
+        SAIGA_ASSERT(!omp_in_parallel());
+#endif
         SAIGA_ASSERT(params.threads >= 1);
-        generators.resize(params.threads);
-        threadLocalBestModel.resize(params.threads);
+
+        threadData.resize(params.threads);
         for (int i = 0; i < params.threads; ++i)
         {
-            generators[i].seed(ransacRandomSeed + 6643838879UL * i);
+            auto& td = threadData[i];
+            td.inliers.reserve(params.reserveN);
+            td.tmpInliers.reserve(params.reserveN);
+            td.generator.seed(ransacRandomSeed + 6643838879UL * i);
         }
+        bestInliers.reserve(params.reserveN);
     }
 
     const RansacParameters& Params() const { return params; }
 
+    // Number of samples drawn in the last call of compute()
+    int Iterations() const { return numIterations; }
+
+    /**
+     * Enables PROSAC (Chum, Matas 2005) for the next call of compute().
+     * quality[i] is the quality of correspondence i, higher is better. For descriptor distances pass for
+     * example the negative distance or the ratio to the second best match. The samples are drawn from the
+     * best correspondences first and the sampling set grows until it is uniform over all points.
+     * Must be called outside of the parallel region.
+     */
+    void setMatchQuality(ArrayView<const double> quality)
+    {
+        prosacOrder.resize(quality.size());
+        std::iota(prosacOrder.begin(), prosacOrder.end(), 0);
+        std::stable_sort(prosacOrder.begin(), prosacOrder.end(),
+                         [&](int a, int b) { return quality[a] > quality[b]; });
+    }
+
    protected:
     // indices of subset
     using Subset = std::array<int, ModelSize>;
@@ -75,99 +140,262 @@ class RansacBase
     RansacBase(const RansacParameters& _params) { init(_params); }
 
 
-
+    // Returns the number of inliers of the best model.
     int compute(int _N)
     {
         SAIGA_ASSERT(params.maxIterations > 0);
         SAIGA_ASSERT(OMP::getNumThreads() == params.threads);
 
-        int tid = OMP::getThreadNum();
-        // compute random sample subsets
-        std::uniform_int_distribution<int> dis(0, _N - 1);
-        auto& gen = generators[tid];
-
-
-        auto& bestModel = threadLocalBestModel[tid]();
-        bestModel       = {0, 0};
+        int tid  = OMP::getThreadNum();
+        auto& td = threadData[tid];
 
-
-#pragma omp for
-        for (int it = 0; it < params.maxIterations; ++it)
+#pragma omp single
         {
-            auto& model     = models[it];
-            auto& inlier    = inliers[it];
-            auto& residual  = residuals[it];
-            auto& numInlier = numInliers[it];
-
-            numInlier = 0;
-            residual.resize(_N);
-            inlier.resize(_N);
-
-            Subset set;
-            for (auto j : Range(0, ModelSize))
-            {
-                auto idx = dis(gen);
-                set[j]   = idx;
-            }
-
-            if (!derived().computeModel(set, model)) continue;
+            N              = _N;
+            iterationLimit = params.maxIterations;
+            sharedBest     = 0;
+            SAIGA_ASSERT(prosacOrder.empty() || prosacOrder.size() == N);
+        }
 
-            for (int j = 0; j < _N; ++j)
+        td.numInliers = 0;
+        td.iterations = 0;
+        td.inliers.resize(_N);
+        td.tmpInliers.resize(_N);
+        td.sprtDelta          = params.sprtDelta;
+        td.sprtEpsilon        = -1;
+        td.sprtA              = std::numeric_limits<double>::infinity();
+        td.sprtADelta         = td.sprtDelta;
+        td.sprtInlierRatioSum = 0;
+        td.sprtRejected       = 0;
+        td.prosacN            = ModelSize;
+        td.prosacTn           = params.maxIterations;
+        td.prosacTnPrime      = 1;
+        for (int i = 0; i < ModelSize; ++i) td.prosacTn *= double(ModelSize - i) / (_N - i);
+
+        if (_N >= ModelSize)
+        {
+            // Iterations are distributed with a fixed stride, so the result does not depend on the scheduling
+            // if all iterations are evaluated.
+            for (int it = tid; it < iterationLimit.load(std::memory_order_relaxed); it += params.threads)
             {
-                residual[j] = derived().computeResidual(model, j);
+                td.iterations++;
 
-                bool inl  = residual[j] < params.residualThreshold;
-                inlier[j] = inl;
-                numInlier += inl;
-            }
+                Subset set = prosacOrder.empty() ? sampleUniform(td.generator, _N) : sampleProsac(td, it + 1);
+                Model model;
+                if (!derived().computeModel(set, model)) continue;
 
-            if (numInlier > bestModel.first)
-            {
-                bestModel.first  = numInlier;
-                bestModel.second = it;
+                int numInlier = evaluate(td, model);
+                if (numInlier > td.numInliers)
+                {
+                    td.numInliers = numInlier;
+                    td.model      = model;
+                    std::swap(td.inliers, td.tmpInliers);
+                    publishBest(td, numInlier);
+                }
             }
         }
 
+        // All threads have to be finished before the results are merged
+#pragma omp barrier
+
 #pragma omp single
         {
-            N             = _N;
-            bestIdx       = 0;
-            int bestCount = 0;
+            bestNumInliers = 0;
+            numIterations  = 0;
+            int bestThread = -1;
             for (int th = 0; th < params.threads; ++th)
             {
-                auto&& thbestModel = threadLocalBestModel[th]();
-                auto inl           = thbestModel.first;
-                auto it            = thbestModel.second;
-                //                std::cout << "th best " << th << " " << it << " " << inl << std::endl;
-                if (inl > bestCount)
+                numIterations += threadData[th].iterations;
+                if (threadData[th].numInliers > bestNumInliers)
                 {
-                    bestCount = inl;
-                    bestIdx   = it;
+                    bestNumInliers = threadData[th].numInliers;
+                    bestThread     = th;
                 }
             }
+            if (bestThread >= 0)
+            {
+                bestModel   = threadData[bestThread].model;
+                bestInliers = threadData[bestThread].inliers;
+            }
+            else
+            {
+                bestModel = Model();
+                bestInliers.assign(N, 0);
+            }
+            prosacOrder.clear();
         }
-        return bestIdx;
+        return bestNumInliers;
     }
 
 
     // total number of sample points
     int N;
     RansacParameters params;
-    AlignedVector<std::vector<double>> residuals;
-    AlignedVector<std::vector<char>> inliers;
-    AlignedVector<int> numInliers;
-    AlignedVector<Model> models;
 
-    // make sure we don't run into false sharing
-    AlignedVector<AlignedStruct<std::pair<int, int>, SAIGA_CACHE_LINE_SIZE>> threadLocalBestModel;
+    // The result of compute()
+    Model bestModel;
+    std::vector<char> bestInliers;
+    int bestNumInliers = 0;
+    int numIterations  = 0;
 
-    // each thread has one generator
-    std::vector<std::mt19937> generators;
+   private:
+    struct ThreadData
+    {
+        Model model;
+        int numInliers = 0;
+        int iterations = 0;
+        std::vector<char> inliers, tmpInliers;
 
-    int bestIdx;
+        // each thread has one generator
+        std::mt19937 generator;
+
+        // SPRT state. sprtADelta is the delta that was used to compute sprtA.
+        double sprtDelta, sprtEpsilon, sprtA, sprtADelta;
+        double sprtInlierRatioSum;
+        int sprtRejected;
+
+        // PROSAC state
+        int prosacN;
+        double prosacTn;
+        int prosacTnPrime;
+    };
+    AlignedVector<ThreadData> threadData;
+
+    // Shared between the threads of the current compute() call.
+    // Both only decrease (iterationLimit) or increase (sharedBest), so relaxed atomics are sufficient.
+    std::atomic_int iterationLimit = 0;
+    std::atomic_int sharedBest     = 0;
+
+    std::vector<int> prosacOrder;
 
-   private:
     Derived& derived() { return *static_cast<Derived*>(this); }
+
+    static bool contains(const Subset& set, int n, int idx)
+    {
+        for (int j = 0; j < n; ++j)
+            if (set[j] == idx) return true;
+        return false;
+    }
+
+    // Distinct random indices from [0, n) written to set[first, ModelSize).
+    static void sampleDistinct(std::mt19937& gen, int n, Subset& set, int first)
+    {
+        std::uniform_int_distribution<int> dis(0, n - 1);
+        for (int j = first; j < ModelSize; ++j)
+        {
+            int idx;
+            do
+            {
+                idx = dis(gen);
+            } while (contains(set, j, idx));
+            set[j] = idx;
+        }
+    }
+
+    static Subset sampleUniform(std::mt19937& gen, int n)
+    {
+        Subset set;
+        sampleDistinct(gen, n, set, 0);
+        return set;
+    }
+
+    // t is the 1-based iteration index. It is increasing for each thread.
+    Subset sampleProsac(ThreadData& td, int t)
+    {
+        // Grow the sampling set (Chum, Matas 2005, Section 2.3)
+        while (t > td.prosacTnPrime && td.prosacN < N)
+        {
+            double tn1 = td.prosacTn * (td.prosacN + 1) / (td.prosacN + 1 - ModelSize);
+            td.prosacTnPrime += int(std::ceil(tn1 - td.prosacTn));
+            td.prosacTn = tn1;
+            td.prosacN++;
+        }
+
+        Subset set;
+        if (td.prosacTnPrime < t)
+        {
+            sampleDistinct(td.generator, td.prosacN, set, 0);
+        }
+        else
+        {
+            // The newest point and ModelSize-1 points from the better ones
+            set[0] = td.prosacN - 1;
+            sampleDistinct(td.generator, td.prosacN - 1, set, 1);
+        }
+        for (auto& i : set) i = prosacOrder[i];
+        return set;
+    }
+
+    // Computes the inlier mask in td.tmpInliers. Returns -1 if the hypothesis was rejected by the SPRT.
+    int evaluate(ThreadData& td, const Model& model)
+    {
+        bool sprt = params.sprt && updateSprt(td);
+        double ratioInlier  = sprt ? td.sprtDelta / td.sprtEpsilon : 1;
+        double ratioOutlier = sprt ? (1 - td.sprtDelta) / (1 - td.sprtEpsilon) : 1;
+
+        auto& inlier  = td.tmpInliers;
+        int numInlier = 0;
+        double lambda = 1;
+        for (int j = 0; j < N; ++j)
+        {
+            bool inl  = derived().computeResidual(model, j) < params.residualThreshold;
+            inlier[j] = inl;
+            numInlier += inl;
+
+            if (sprt)
+            {
+                lambda *= inl ? ratioInlier : ratioOutlier;
+                if (lambda > td.sprtA)
+                {
+                    // Rejected. Re-estimate delta from the consistent points of the rejected models.
+                    // The initial guess is kept as one sample so that delta stays positive.
+                    td.sprtInlierRatioSum += double(numInlier) / (j + 1);
+                    td.sprtRejected++;
+                    td.sprtDelta = (td.sprtInlierRatioSum + params.sprtDelta) / (td.sprtRejected + 1);
+                    return -1;
+                }
+            }
+        }
+        return numInlier;
+    }
+
+    // Updates epsilon and the threshold A. Returns false if the test is not applicable.
+    bool updateSprt(ThreadData& td)
+    {
+        int best       = sharedBest.load(std::memory_order_relaxed);
+        double epsilon = std::max(params.sprtEpsilon, double(best) / N);
+        if (td.sprtDelta >= epsilon || epsilon >= 1) return false;
+
+        // Only recompute A if epsilon or delta changed significantly
+        if (epsilon != td.sprtEpsilon || std::abs(td.sprtDelta - td.sprtADelta) > 0.05 * td.sprtADelta)
+        {
+            td.sprtEpsilon = epsilon;
+            td.sprtADelta  = td.sprtDelta;
+            td.sprtA       = RansacSprtThreshold(td.sprtDelta, td.sprtEpsilon, params.sprtModelCost);
+        }
+        return true;
+    }
+
+    // Called when a thread found a new best model. Updates the shared inlier count (used by the SPRT)
+    // and the adaptive iteration bound.
+    void publishBest(ThreadData& td, int numInlier)
+    {
+        int its = params.maxIterations;
+        if (params.adaptive)
+        {
+            // An all-inlier hypothesis is rejected by the SPRT with probability 1/A
+            double acceptance = params.sprt ? 1.0 - 1.0 / td.sprtA : 1.0;
+            its = RansacAdaptiveIterations(double(numInlier) / N, params.confidence, ModelSize, acceptance);
+        }
+        int best = sharedBest.load(std::memory_order_relaxed);
+        while (numInlier > best && !sharedBest.compare_exchange_weak(best, numInlier, std::memory_order_relaxed))
+        {
+        }
+        int limit = iterationLimit.load(std::memory_order_relaxed);
+        while (its < limit && !iterationLimit.compare_exchange_weak(limit, its, std::memory_order_relaxed))
+        {
+        }
+    }
 };
 
 inline int RansacIterationsFromProbability(int input_N, double probability, int minInliers, int maxIterations)
@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#include "saiga/core/image/depthCodec.h"
+#include "saiga/core/image/templatedImage.h"
+#include "saiga/core/math/random.h"
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+
+using namespace Saiga;
+
+// A slanted plane with a moving box in front of it and some invalid pixels.
+template <typename T>
+TemplatedImage<T> SyntheticDepth(int h, int w, int frame, T scale)
+{
+    TemplatedImage<T> img(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            float d = 2 + 0.002f * x + 0.001f * y;
+            if (std::abs(x - 20 - frame * 3) < 15 && std::abs(y - h / 2) < 15) d = 1;
+            if ((x * 7 + y * 13) % 101 == 0) d = 0;
+            d += Random::sampleDouble(0, 0.002);
+            img(y, x) = T(d * scale);
+        }
+    }
+    return img;
+}
+
+template <typename T>
+void CheckRoundTrip(const TemplatedImage<T>& img, const TemplatedImage<T>* previous = nullptr)
+{
+    auto data = EncodeDepth(img, previous);
+    EXPECT_EQ(DepthFrameIsTemporal(data.data(), data.size()), previous != nullptr);
+
+    TemplatedImage<T> img2;
+    EXPECT_TRUE(DecodeDepth(data.data(), data.size(), img2, previous));
+    EXPECT_EQ(img.dimensions(), img2.dimensions());
+    EXPECT_EQ(img, img2);
+}
+
+TEST(DepthCodec, RoundTrip)
+{
+    for (int w : {1, 7, 8, 9, 17, 64, 113})
+    {
+        CheckRoundTrip(SyntheticDepth<uint16_t>(31, w, 0, 1000));
+        CheckRoundTrip(SyntheticDepth<float>(31, w, 0, 1));
+    }
+}
+
+TEST(DepthCodec, Extremes)
+{
+    // Maximum residuals -> escape codes
+    TemplatedImage<uint16_t> img(16, 33);
+    for (int i = 0; i < img.rows * img.cols; ++i)
+    {
+        img(i / img.cols, i % img.cols) = i % 2 == 0 ? 0 : 65535;
+    }
+    CheckRoundTrip(img);
+
+    TemplatedImage<float> imgf(16, 33);
+    for (int i = 0; i < imgf.rows * imgf.cols; ++i)
+    {
+        imgf(i / imgf.cols, i % imgf.cols) = i % 3 == 0 ? -1e30f : (i % 3 == 1 ? 1e30f : 0.f);
+    }
+    CheckRoundTrip(imgf);
+}
+
+TEST(DepthCodec, Temporal)
+{
+    auto img1 = SyntheticDepth<uint16_t>(120, 160, 0, 1000);
+    auto img2 = SyntheticDepth<uint16_t>(120, 160, 1, 1000);
+    CheckRoundTrip(img2, &img1);
+
+    // A static scene is much smaller with temporal prediction
+    auto spatial  = EncodeDepth(img1);
+    auto temporal = EncodeDepth(img1, &img1);
+    EXPECT_LT(temporal.size() * 10, spatial.size());
+
+    // Decoding a temporal frame without the previous frame fails
+    TemplatedImage<uint16_t> result;
+    EXPECT_FALSE(DecodeDepth(temporal.data(), temporal.size(), result));
+}
+
+TEST(DepthCodec, Corrupted)
+{
+    auto img  = SyntheticDepth<uint16_t>(64, 64, 0, 1000);
+    auto data = EncodeDepth(img);
+
+    Image result;
+    EXPECT_FALSE(DecodeDepth(data.data(), data.size() / 2, result));
+    EXPECT_FALSE(DecodeDepth(data.data(), 10, result));
+}
+
+TEST(DepthCodec, Kernels)
+{
+    auto img1 = SyntheticDepth<uint16_t>(60, 101, 0, 1000);
+    auto img2 = SyntheticDepth<uint16_t>(60, 101, 2, 1000);
+
+    auto old_kernel = ActiveDepthCodecKernel();
+    std::vector<std::vector<unsigned char>> results;
+    for (auto kernel : {DepthCodecKernel::Scalar, DepthCodecKernel::AVX2})
+    {
+        if (!DepthCodecKernelSupported(kernel)) continue;
+        SetDepthCodecKernel(kernel);
+
+        // All kernels produce the same stream
+        auto data = EncodeDepth(img2, &img1);
+        if (!results.empty()) EXPECT_EQ(data, results.front());
+        results.push_back(data);
+        CheckRoundTrip(img2, &img1);
+    }
+    SetDepthCodecKernel(old_kernel);
+}
+
+TEST(DepthCodec, SaveLoad)
+{
+    std::string file = "depth_codec_test.saigad";
+    auto img         = SyntheticDepth<uint16_t>(48, 64, 0, 1000);
+    EXPECT_TRUE(img.save(file));
+
+    TemplatedImage<uint16_t> img2(file);
+    EXPECT_EQ(img, img2);
+
+    auto imgf = SyntheticDepth<float>(48, 64, 0, 1);
+    EXPECT_TRUE(imgf.save(file));
+    TemplatedImage<float> imgf2(file);
+    EXPECT_EQ(imgf, imgf2);
+
+    // Only depth images
+    TemplatedImage<ucvec3> rgb(8, 8);
+    rgb.makeZero();
+    EXPECT_FALSE(rgb.save(file));
+    std::filesystem::remove(file);
+}
+
+TEST(DepthCodec, Sequence)
+{
+    std::string file = "depth_codec_test.sequence";
+    std::vector<TemplatedImage<uint16_t>> frames;
+    for (int i = 0; i < 23; ++i) frames.push_back(SyntheticDepth<uint16_t>(40, 80, i, 1000));
+
+    {
+        DepthSequenceWriter writer(file, 10);
+        for (auto& f : frames) writer.Add(f);
+        EXPECT_EQ(writer.NumFrames(), frames.size());
+    }
+
+    DepthSequenceReader reader(file);
+    EXPECT_EQ(reader.NumFrames(), frames.size());
+
+    TemplatedImage<uint16_t> img;
+    for (auto& f : frames)
+    {
+        EXPECT_TRUE(reader.Read(img));
+        EXPECT_EQ(img, f);
+    }
+    EXPECT_FALSE(reader.Read(img));
+
+    for (int i : {17, 0, 10, 9, 22})
+    {
+        reader.Seek(i);
+        EXPECT_TRUE(reader.Read(img));
+        EXPECT_EQ(img, frames[i]);
+    }
+    std::filesystem::remove(file);
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/core/model/model_loader_obj.h"
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace Saiga
+{
+TEST(ObjModelLoader, Simple)
+{
+    std::ofstream("obj_test.mtl") << "newmtl red\nKd 1 0 0\n";
+    std::ofstream("obj_test.obj") << "mtllib obj_test.mtl\n"
+                                     "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 5 5 5\n"
+                                     "vn 0 0 1\r\n"
+                                     "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+                                     "# quad with texture coordinates\n"
+                                     "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+                                     "f 1/2/1 3/3/1 4/4/1\n"
+                                     "usemtl red\n"
+                                     "f -5//-1 -4//-1 -3//-1\n"
+                                     "usemtl missing\n"
+                                     "f 1 2 3";
+
+    ObjModelLoader loader("obj_test.obj");
+    auto& model = loader.out_model;
+
+    ASSERT_EQ(model.materials.size(), 1);
+    EXPECT_EQ(model.materials[0].name, "red");
+    EXPECT_EQ(model.materials[0].color_diffuse(0), 1);
+
+    ASSERT_EQ(model.material_groups.size(), 3);
+    ASSERT_EQ(model.mesh.size(), 3);
+    EXPECT_EQ(model.material_groups[0].numFaces, 3);
+    EXPECT_EQ(model.material_groups[1].startFace, 3);
+    EXPECT_EQ(model.material_groups[1].materialId, 0);
+    EXPECT_EQ(model.material_groups[2].materialId, -1);
+
+    // The unused vertex 5 is dropped, vertex 1 is duplicated because of the different texture coordinate.
+    auto& m0 = model.mesh[0];
+    ASSERT_EQ(m0.NumVertices(), 5);
+    EXPECT_EQ(m0.triangles, (std::vector<ivec3>{ivec3(0, 1, 2), ivec3(2, 3, 0), ivec3(4, 2, 3)}));
+    EXPECT_EQ(m0.position[4], vec3(0, 0, 0));
+    EXPECT_EQ(m0.texture_coordinates[3], vec2(0, 1));
+    EXPECT_EQ(m0.texture_coordinates[4], vec2(1, 0));
+    EXPECT_EQ(m0.normal[2], vec3(0, 0, 1));
+
+    auto& m1 = model.mesh[1];
+    ASSERT_EQ(m1.NumVertices(), 3);
+    EXPECT_EQ(m1.material_id, 0);
+    EXPECT_EQ(m1.position[2], vec3(1, 1, 0));
+    EXPECT_EQ(m1.normal[1], vec3(0, 0, 1));
+    EXPECT_EQ(m1.texture_coordinates[1], vec2(0, 0));
+
+    auto& m2 = model.mesh[2];
+    EXPECT_EQ(m2.triangles, (std::vector<ivec3>{ivec3(0, 1, 2)}));
+    EXPECT_EQ(m2.normal[0], vec3(0, 0, 0));
+
+    std::filesystem::remove("obj_test.obj");
+    std::filesystem::remove("obj_test.mtl");
+}
+
+TEST(ObjModelLoader, Chunks)
+{
+    // Polygons with absolute and relative indices and material switches.
+    // The result must not depend on the chunk size.
+    std::ofstream strm("obj_test_chunks.obj");
+    strm << "mtllib obj_test_chunks.mtl\n";
+    int num_vertices = 0, num_triangles = 0;
+    for (int i = 0; i < 3000; ++i)
+    {
+        int type = Random::uniformInt(0, 9);
+        if (type < 4 || num_vertices < 10)
+        {
+            vec3 p = Random::MatrixUniform<vec3>(-100, 100);
+            strm << "v " << p(0) << " " << p(1) << "\t" << p(2) << "\n";
+            strm << "vn " << p(2) << " " << p(1) << " " << p(0) << "\n";
+            strm << "vt " << p(0) * 1e-7 << "," << p(1) << "\n";
+            num_vertices++;
+        }
+        else if (type < 9)
+        {
+            int n = Random::uniformInt(3, 6);
+            strm << "f";
+            for (int k = 0; k < n; ++k)
+            {
+                int v = Random::uniformInt(1, num_vertices);
+                if (Random::sampleBool(0.3)) v = v - num_vertices - 1;
+                strm << " " << v << "/" << v << (Random::sampleBool(0.5) ? "/" + std::to_string(v) : "");
+            }
+            strm << "\n";
+            num_triangles += n - 2;
+        }
+        else
+        {
+            strm << "usemtl m" << Random::uniformInt(0, 3) << "\n";
+        }
+    }
+    strm.close();
+    std::ofstream("obj_test_chunks.mtl") << "newmtl m0\nnewmtl m1\nnewmtl m2\n";
+
+    ObjModelLoader single;
+    single.chunk_size = 1 << 30;
+    single.loadFile("obj_test_chunks.obj");
+    EXPECT_EQ(single.out_model.TotalTriangles(), num_triangles);
+    EXPECT_EQ(single.out_model.materials.size(), 3);
+
+    for (size_t chunk_size : {1, 37, 1000})
+    {
+        ObjModelLoader loader;
+        loader.chunk_size = chunk_size;
+        loader.loadFile("obj_test_chunks.obj");
+
+        ASSERT_EQ(loader.out_model.mesh.size(), single.out_model.mesh.size());
+        for (size_t i = 0; i < single.out_model.mesh.size(); ++i)
+        {
+            auto& a = loader.out_model.mesh[i];
+            auto& b = single.out_model.mesh[i];
+            EXPECT_EQ(a.material_id, b.material_id);
+            EXPECT_EQ(a.position, b.position);
+            EXPECT_EQ(a.normal, b.normal);
+            EXPECT_EQ(a.texture_coordinates, b.texture_coordinates);
+            EXPECT_EQ(a.triangles, b.triangles);
+        }
+    }
+
+    std::filesystem::remove("obj_test_chunks.obj");
+    std::filesystem::remove("obj_test_chunks.mtl");
+}
+
+}  // namespace Saiga
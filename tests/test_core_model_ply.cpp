@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/core/model/model_loader_ply.h"
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace Saiga
+{
+static UnifiedMesh RandomMesh(int n)
+{
+    UnifiedMesh mesh;
+    for (int i = 0; i < n; ++i)
+    {
+        mesh.position.push_back(Random::MatrixUniform<vec3>(-100, 100));
+        mesh.normal.push_back(Random::MatrixUniform<vec3>(-1, 1));
+        mesh.color.push_back(make_vec4(Random::uniformInt(0, 255), Random::uniformInt(0, 255), 0, 255) / 255.f);
+        mesh.texture_coordinates.push_back(Random::MatrixUniform<vec2>(0, 1));
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        mesh.triangles.push_back(ivec3(i, Random::uniformInt(0, n - 1), Random::uniformInt(0, n - 1)));
+    }
+    return mesh;
+}
+
+TEST(PLY, MeshRoundtrip)
+{
+    auto mesh = RandomMesh(1000);
+    for (auto format : {PLY::Format::Ascii, PLY::Format::BinaryLittleEndian, PLY::Format::BinaryBigEndian})
+    {
+        SavePLY("ply_test.ply", mesh, format);
+        PLYReader reader("ply_test.ply");
+        EXPECT_EQ(reader.Header().format, format);
+
+        auto loaded = reader.Mesh();
+        EXPECT_EQ(loaded.position, mesh.position);
+        EXPECT_EQ(loaded.normal, mesh.normal);
+        EXPECT_EQ(loaded.texture_coordinates, mesh.texture_coordinates);
+        EXPECT_EQ(loaded.triangles, mesh.triangles);
+        ASSERT_EQ(loaded.color.size(), mesh.color.size());
+        for (int i = 0; i < mesh.NumVertices(); ++i)
+        {
+            EXPECT_NEAR((loaded.color[i] - mesh.color[i]).norm(), 0, 1e-6);
+        }
+
+        // Big endian files can not be mapped directly, but are converted during the read
+        if (format != PLY::Format::Ascii)
+        {
+            auto x = reader.Column<float>("vertex", "x");
+            ASSERT_EQ(x.size(), mesh.NumVertices());
+            EXPECT_EQ(x[17], mesh.position[17].x());
+        }
+    }
+    std::filesystem::remove("ply_test.ply");
+}
+
+TEST(PLY, CustomProperties)
+{
+    // Point cloud with an extra property, written in two chunks
+    int n = 5000;
+    std::vector<vec3> points(n);
+    std::vector<double> confidence(n);
+    for (int i = 0; i < n; ++i)
+    {
+        points[i]     = Random::MatrixUniform<vec3>(-1, 1);
+        confidence[i] = Random::sampleDouble(0, 1);
+    }
+
+    for (auto format : {PLY::Format::Ascii, PLY::Format::BinaryLittleEndian, PLY::Format::BinaryBigEndian})
+    {
+        {
+            PLY::Header header;
+            header.format = format;
+            header.AddElement("vertex", n)
+                .AddProperty("x", PLY::ScalarType::Float32)
+                .AddProperty("y", PLY::ScalarType::Float32)
+                .AddProperty("z", PLY::ScalarType::Float32)
+                .AddProperty("confidence", PLY::ScalarType::Float64);
+            PLYWriter writer("ply_test_custom.ply", header);
+            for (int first : {0, 1234})
+            {
+                int count = first == 0 ? 1234 : n - 1234;
+                std::vector<PLYWriter::ColumnData> columns = {{points[first].data(), sizeof(vec3)},
+                                                              {points[first].data() + 1, sizeof(vec3)},
+                                                              {points[first].data() + 2, sizeof(vec3)},
+                                                              {confidence.data() + first, sizeof(double)}};
+                writer.WriteRows(count, columns);
+            }
+        }
+
+        PLYReader reader("ply_test_custom.ply");
+        EXPECT_TRUE(reader.HasProperty("vertex", "confidence"));
+        EXPECT_FALSE(reader.HasProperty("vertex", "nx"));
+        EXPECT_FALSE(reader.HasProperty("face", "vertex_indices"));
+
+        EXPECT_EQ(reader.Read<double>("vertex", "confidence"), confidence);
+
+        // Converted range
+        std::vector<float> y(100);
+        reader.Read<float>("vertex", "y", y, 2000);
+        for (int i = 0; i < 100; ++i) EXPECT_EQ(y[i], points[2000 + i].y());
+
+        std::vector<vec3> streamed;
+        reader.StreamPoints(999, [&](const UnifiedMesh& chunk, size_t first) {
+            EXPECT_EQ(first, streamed.size());
+            EXPECT_LE(chunk.NumVertices(), 999);
+            EXPECT_FALSE(chunk.HasColor());
+            streamed.insert(streamed.end(), chunk.position.begin(), chunk.position.end());
+        });
+        EXPECT_EQ(streamed, points);
+    }
+    std::filesystem::remove("ply_test_custom.ply");
+}
+
+TEST(PLY, AsciiPolygons)
+{
+    std::ofstream("ply_test_ascii.ply") << "ply\r\n"
+                                           "format ascii 1.0\n"
+                                           "comment made by hand\n"
+                                           "element vertex 5\n"
+                                           "property float x\n"
+                                           "property float y\n"
+                                           "property float z\n"
+                                           "property uchar red\n"
+                                           "property uchar green\n"
+                                           "property uchar blue\n"
+                                           "element face 2\n"
+                                           "property list uchar int vertex_index\n"
+                                           "property int flags\n"
+                                           "end_header\n"
+                                           "0 0 0 255 0 0\n"
+                                           "1 0 0 0 255 0\r\n"
+                                           "1 1 0 0 0 255\n"
+                                           "\n"
+                                           "0 1 0 255 255 255\n"
+                                           "0.5 1.5e0 -2 0 0 0\n"
+                                           "4 0 1 2 3 7\n"
+                                           "3 4 3 2 8\n";
+
+    PLYReader reader("ply_test_ascii.ply");
+    ASSERT_EQ(reader.Header().comments.size(), 1);
+    EXPECT_EQ(reader.Header().comments[0], "made by hand");
+
+    auto mesh = reader.Mesh();
+    ASSERT_EQ(mesh.NumVertices(), 5);
+    EXPECT_EQ(mesh.position[4], vec3(0.5, 1.5, -2));
+    EXPECT_EQ(mesh.color[1], vec4(0, 1, 0, 1));
+    EXPECT_EQ(mesh.triangles, (std::vector<ivec3>{ivec3(0, 1, 2), ivec3(0, 2, 3), ivec3(4, 3, 2)}));
+
+    // A scalar behind a list
+    EXPECT_EQ(reader.Read<int>("face", "flags"), (std::vector<int>{7, 8}));
+
+    std::vector<size_t> offsets;
+    std::vector<uint16_t> indices;
+    reader.ReadList("face", "vertex_index", offsets, indices);
+    EXPECT_EQ(offsets, (std::vector<size_t>{0, 4, 7}));
+    EXPECT_EQ(indices, (std::vector<uint16_t>{0, 1, 2, 3, 4, 3, 2}));
+
+    // The old loader interface
+    PLYLoader loader("ply_test_ascii.ply");
+    EXPECT_EQ(loader.mesh.vertices.size(), 5);
+    EXPECT_EQ(loader.mesh.faces.size(), 3);
+
+    std::filesystem::remove("ply_test_ascii.ply");
+}
+
+TEST(PLY, Invalid)
+{
+    std::string header =
+        "ply\nformat binary_little_endian 1.0\nelement vertex 1\nproperty float x\n"
+        "element face 2\nproperty list uchar int vertex_indices\nend_header\n";
+    float x        = 1;
+    char face[13]  = {3};
+    int indices[3] = {0, 0, 1};
+    std::memcpy(face + 1, indices, sizeof(indices));
+
+    // The second face is missing
+    {
+        std::ofstream strm("ply_test_invalid.ply", std::ios::binary);
+        strm << header;
+        strm.write((char*)&x, sizeof(x));
+        strm.write(face, sizeof(face));
+    }
+    EXPECT_THROW(PLYReader("ply_test_invalid.ply"), std::runtime_error);
+
+    // Index 1 is out of range
+    {
+        std::ofstream strm("ply_test_invalid.ply", std::ios::binary);
+        strm << header;
+        strm.write((char*)&x, sizeof(x));
+        strm.write(face, sizeof(face));
+        strm.write(face, sizeof(face));
+    }
+    EXPECT_THROW(PLYReader("ply_test_invalid.ply").Mesh(), std::runtime_error);
+
+    std::ofstream("ply_test_invalid.ply") << "ply\nformat ascii 1.0\nelement vertex many\nend_header\n";
+    EXPECT_THROW(PLYReader("ply_test_invalid.ply"), std::runtime_error);
+
+    std::filesystem::remove("ply_test_invalid.ply");
+}
+
+}  // namespace Saiga
@@ -0,0 +1,285 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/config.h"
+#include "saiga/core/util/Thread/ParallelFor.h"
+#include "saiga/core/util/Thread/threadPool.h"
+
+#include "gtest/gtest.h"
+
+#include <numeric>
+#include <thread>
+
+namespace Saiga
+{
+TEST(ThreadPool, SmallTaskIsInline)
+{
+    int a = 0, b = 0;
+    auto small = [&a, &b]() { a = b; };
+    EXPECT_TRUE(Task::fitsInline<decltype(small)>());
+
+    std::array<char, 256> big_capture;
+    auto big = [big_capture]() { (void)big_capture; };
+    EXPECT_FALSE(Task::fitsInline<decltype(big)>());
+
+    Task t1(small);
+    Task t2(std::move(t1));
+    b = 5;
+    t2();
+    EXPECT_EQ(a, 5);
+    EXPECT_FALSE(t1);
+}
+
+TEST(ThreadPool, Enqueue)
+{
+    ThreadPool pool(4);
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 1000; ++i)
+    {
+        results.push_back(pool.enqueue([](int x) { return x * 2; }, i));
+    }
+    for (int i = 0; i < 1000; ++i)
+    {
+        EXPECT_EQ(results[i].get(), i * 2);
+    }
+}
+
+TEST(ThreadPool, EmptyPool)
+{
+    ThreadPool pool(0);
+    auto f = pool.enqueue([]() { return 42; });
+    EXPECT_EQ(f.get(), 42);
+}
+
+TEST(ThreadPool, TaskGroup)
+{
+    ThreadPool pool(4);
+    std::vector<int> data(100000, 0);
+
+    TaskGroup group(&pool);
+    for (int i = 0; i < data.size(); ++i)
+    {
+        group.run([&data, i]() { data[i] = i; });
+    }
+    group.wait();
+
+    for (int i = 0; i < data.size(); ++i)
+    {
+        EXPECT_EQ(data[i], i);
+    }
+}
+
+// Recursive fork-join. Waiting inside a worker must not deadlock, even with a single thread.
+static long Fib(ThreadPool* pool, int n)
+{
+    if (n < 12)
+    {
+        return n < 2 ? n : Fib(nullptr, n - 1) + Fib(nullptr, n - 2);
+    }
+    long a, b;
+    TaskGroup group(pool);
+    group.run([&]() { a = Fib(pool, n - 1); });
+    group.run([&]() { b = Fib(pool, n - 2); });
+    group.wait();
+    return a + b;
+}
+
+TEST(ThreadPool, NestedTaskGroups)
+{
+    for (int threads : {1, 4})
+    {
+        ThreadPool pool(threads);
+        long result = -1;
+        auto f      = pool.enqueue([&]() { result = Fib(&pool, 25); });
+        f.wait();
+        EXPECT_EQ(result, 75025);
+    }
+}
+
+TEST(ThreadPool, ParentGroup)
+{
+    ThreadPool pool(4);
+    std::atomic<int> counter = 0;
+
+    TaskGroup parent(&pool);
+    {
+        TaskGroup child(&pool, &parent);
+        for (int i = 0; i < 100; ++i)
+        {
+            child.run([&]() { counter++; });
+        }
+        EXPECT_GE(parent.numPending(), child.numPending());
+        parent.wait();
+        EXPECT_EQ(child.numPending(), 0);
+    }
+    EXPECT_EQ(counter, 100);
+}
+
+TEST(ThreadPool, Exception)
+{
+    ThreadPool pool(2);
+    TaskGroup group(&pool);
+    group.run([]() { throw std::runtime_error("test"); });
+    EXPECT_THROW(group.wait(), std::runtime_error);
+
+    auto f = pool.enqueue([]() -> int { throw std::runtime_error("test"); });
+    EXPECT_THROW(f.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, ParallelFor)
+{
+    ThreadPool pool(4);
+    for (ThreadPool* p : {(ThreadPool*)nullptr, &pool})
+    {
+        ParallelOptions options;
+        options.pool = p;
+
+        std::vector<int> data(10007, 0);
+        ParallelFor(
+            0, data.size(), [&](int i) { data[i] += i; }, options);
+        for (int i = 0; i < data.size(); ++i)
+        {
+            EXPECT_EQ(data[i], i);
+        }
+    }
+}
+
+TEST(ThreadPool, ParallelReduceDeterministic)
+{
+    std::vector<double> data(100000);
+    for (int i = 0; i < data.size(); ++i) data[i] = 1.0 / (i + 1);
+
+    auto map = [&](int i) { return data[i]; };
+    double ref;
+    {
+        ThreadPool pool(0);
+        ParallelOptions options;
+        options.pool = &pool;
+        ref          = ParallelReduce(0, data.size(), 0.0, map, std::plus<double>(), options);
+    }
+    EXPECT_NEAR(ref, std::accumulate(data.begin(), data.end(), 0.0), 1e-10);
+
+    for (int threads : {1, 3, 4})
+    {
+        ThreadPool pool(threads);
+        ParallelOptions options;
+        options.pool = &pool;
+        for (int it = 0; it < 10; ++it)
+        {
+            double sum = ParallelReduce(0, data.size(), 0.0, map, std::plus<double>(), options);
+            // Bit-exact, because the reduction order does not depend on the thread count.
+            EXPECT_EQ(sum, ref);
+        }
+    }
+}
+
+TEST(ThreadPool, ParallelScan)
+{
+    ThreadPool pool(4);
+    ParallelOptions options;
+    options.pool       = &pool;
+    options.grain_size = 100;
+
+    std::vector<int> in(12345), exclusive(in.size()), inclusive(in.size());
+    for (int i = 0; i < in.size(); ++i) in[i] = i % 7;
+
+    auto get   = [&](int i) { return in[i]; };
+    int total1 = ParallelScan(
+        0, in.size(), 0, get, [&](int i, int v) { exclusive[i] = v; }, std::plus<int>(), false, options);
+    int total2 = ParallelScan(
+        0, in.size(), 0, get, [&](int i, int v) { inclusive[i] = v; }, std::plus<int>(), true, options);
+
+    std::vector<int> ref_in(in.size()), ref_ex(in.size());
+    std::inclusive_scan(in.begin(), in.end(), ref_in.begin());
+    std::exclusive_scan(in.begin(), in.end(), ref_ex.begin(), 0);
+
+    EXPECT_EQ(exclusive, ref_ex);
+    EXPECT_EQ(inclusive, ref_in);
+    EXPECT_EQ(total1, ref_in.back());
+    EXPECT_EQ(total2, ref_in.back());
+}
+
+TEST(ThreadPool, NestedParallelFor)
+{
+    ThreadPool pool(4);
+    ParallelOptions options;
+    options.pool = &pool;
+
+    std::vector<int> data(64 * 64, 0);
+    ParallelFor(
+        0, 64,
+        [&](int i) {
+            ParallelFor(
+                0, 64, [&](int j) { data[i * 64 + j] = 1; }, options);
+        },
+        options);
+    EXPECT_EQ(std::accumulate(data.begin(), data.end(), 0), 64 * 64);
+}
+
+TEST(ThreadPool, ExternalThreadIds)
+{
+    // Two external threads run loops at the same time and accumulate into per-thread slots.
+    // External threads share the last slot, which is only correct if their loops do not overlap.
+    ThreadPool pool(3);
+    ParallelOptions options;
+    options.pool       = &pool;
+    options.grain_size = 16;
+
+    auto run = [&](std::vector<long>& result) {
+        for (int it = 0; it < 50; ++it)
+        {
+            std::vector<long> local(pool.numThreads() + 1, 0);
+            ParallelFor(
+                0, 10000,
+                [&](int i) {
+                    int id = pool.currentWorkerId();
+                    local[id >= 0 ? id : pool.numThreads()] += i;
+                },
+                options);
+            result.push_back(std::accumulate(local.begin(), local.end(), 0L));
+        }
+    };
+
+    std::vector<long> r1, r2;
+    std::thread t1(run, std::ref(r1));
+    std::thread t2(run, std::ref(r2));
+    t1.join();
+    t2.join();
+    for (auto r : r1) EXPECT_EQ(r, 10000L * 9999 / 2);
+    for (auto r : r2) EXPECT_EQ(r, 10000L * 9999 / 2);
+}
+
+TEST(ThreadPool, ConcurrentExternalLoops)
+{
+    // The loop bodies of two external threads wait for each other, which requires that both loops run at the same
+    // time. Covers the serial single-chunk path and loops distributed to the pool.
+    ThreadPool pool(2);
+    ParallelOptions options;
+    options.pool = &pool;
+
+    for (int n : {1, 8})
+    {
+        std::atomic<int> arrived = 0;
+        auto run                 = [&]() {
+            ParallelFor(
+                0, n,
+                [&](int i) {
+                    if (i != 0) return;
+                    arrived++;
+                    while (arrived.load() < 2) std::this_thread::yield();
+                },
+                options);
+        };
+
+        std::thread t1(run);
+        std::thread t2(run);
+        t1.join();
+        t2.join();
+        EXPECT_EQ(arrived.load(), 2);
+    }
+}
+
+}  // namespace Saiga
@@ -10,6 +10,9 @@
 
 #include "gtest/gtest.h"
 
+#include <sstream>
+#include <zlib.h>
+
 namespace Saiga
 {
 TEST(zlib, SimpleCompressUncompress)
@@ -80,4 +83,96 @@ TEST(zlib, BinaryVectorCompress)
     EXPECT_EQ(data, data2);
 }
 
+static std::vector<unsigned char> RandomBytes(size_t n)
+{
+    // Only a few different values -> compressible
+    std::vector<unsigned char> data(n);
+    for (auto& d : data) d = rand() % 10;
+    return data;
+}
+
+TEST(zlib, Chunked)
+{
+    for (size_t size : {0, 1, 999, 1000, 1001, 12345})
+    {
+        auto data         = RandomBytes(size);
+        auto compressed   = compress(data.data(), data.size(), 1000);
+        auto decompressed = uncompress(compressed.data());
+        EXPECT_EQ(data, decompressed);
+    }
+}
+
+TEST(zlib, SingleStreamFormat)
+{
+    // Data written before the chunked container was introduced
+    auto data = RandomBytes(10000);
+    std::vector<unsigned char> compressed(compressBound(data.size()) + 3 * sizeof(size_t));
+    uLongf compressed_size = compressBound(data.size());
+    ::compress(compressed.data() + 3 * sizeof(size_t), &compressed_size, data.data(), data.size());
+    size_t header[3] = {0x6712956A9725DEUL, compressed_size, data.size()};
+    memcpy(compressed.data(), header, sizeof(header));
+
+    EXPECT_EQ(uncompress(compressed.data()), data);
+}
+
+TEST(zlib, ChunkedRange)
+{
+    auto data       = RandomBytes(10000);
+    auto compressed = compress(data.data(), data.size(), 1000);
+
+    // Without the index (written to a non seekable stream) the chunk headers are scanned
+    auto compressed_no_index = compressed;
+    memset(compressed_no_index.data() + 2 * sizeof(size_t), 0, sizeof(size_t));
+    EXPECT_EQ(uncompress(compressed_no_index.data()), data);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        size_t offset = rand() % data.size();
+        size_t size   = rand() % (data.size() - offset + 1);
+        std::vector<unsigned char> expected(data.begin() + offset, data.begin() + offset + size);
+        EXPECT_EQ(uncompressRange(compressed.data(), offset, size), expected);
+        EXPECT_EQ(uncompressRange(compressed_no_index.data(), offset, size), expected);
+    }
+}
+
+TEST(zlib, Stream)
+{
+    auto data = RandomBytes(123456);
+
+    std::stringstream strm;
+    {
+        CompressedOutputStream out(strm, 1000);
+        // Writes of different sizes, which are not aligned to the chunks
+        for (size_t i = 0; i < data.size();)
+        {
+            size_t n = std::min<size_t>(rand() % 3000, data.size() - i);
+            out.Write(data.data() + i, n);
+            i += n;
+        }
+        EXPECT_EQ(out.Size(), data.size());
+    }
+
+    // The stream is a valid in-memory container
+    std::string container = strm.str();
+    EXPECT_EQ(uncompress(container.data()), data);
+    EXPECT_LT(container.size(), data.size());
+
+    CompressedInputStream in(strm);
+    EXPECT_EQ(in.Size(), data.size());
+    std::vector<unsigned char> expected(data.begin() + 5500, data.begin() + 7100);
+    EXPECT_EQ(in.ReadRange(5500, 1600), expected);
+
+    std::vector<unsigned char> result(data.size());
+    size_t read = 0;
+    while (size_t n = in.Read(result.data() + read, std::min<size_t>(777, data.size() - read)))
+    {
+        read += n;
+        if (read == data.size()) break;
+    }
+    EXPECT_EQ(read, data.size());
+    EXPECT_EQ(result, data);
+    unsigned char c;
+    EXPECT_EQ(in.Read(&c, 1), 0);
+}
+
 }  // namespace Saiga
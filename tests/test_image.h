@@ -0,0 +1,35 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/core/image/imageTransformations.h"
+#include "saiga/core/math/random.h"
+
+namespace Saiga
+{
+// Blurred noise for the feature detector and descriptor tests.
+// The optional uniform rectangles add flat regions with sharp corners.
+inline TemplatedImage<unsigned char> TestImage(int h, int w, int rectangles = 0)
+{
+    TemplatedImage<unsigned char> noise(h, w), img(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x) noise(y, x) = Random::uniformInt(0, 255);
+    }
+    ImageTransformation::GaussianBlur(noise.getConstImageView(), img.getImageView(), 2, 1);
+
+    for (int i = 0; i < rectangles; ++i)
+    {
+        int s  = Random::uniformInt(5, 20);
+        int y0 = Random::uniformInt(0, h - s - 1);
+        int x0 = Random::uniformInt(0, w - s - 1);
+        img.getImageView().subImageView(y0, x0, s, s).set(Random::uniformInt(0, 255));
+    }
+    return img;
+}
+
+}  // namespace Saiga
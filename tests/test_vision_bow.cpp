@@ -15,6 +15,8 @@
 #include "gtest/gtest.h"
 
 #include "compare_numbers.h"
+
+#include <thread>
 namespace Saiga
 {
 using Descriptor    = MiniBow::FORB::TDescriptor;
@@ -291,4 +293,98 @@ TEST(BoW, Orb)
     //    auto stat = measureObject(50, [&]() { orbVoc2.transform(features.front(), bv2, fv2, 4, 4); });
     //    std::cout << stat << std::endl;
 }
+
+static MiniBow2::BowVector RandomBowVector(int num_words, int words_per_vector)
+{
+    std::vector<std::pair<MiniBow2::WordId, MiniBow2::WordValue>> words;
+    for (int i = 0; i < words_per_vector; ++i)
+    {
+        words.push_back({Random::uniformInt(0, num_words - 1), Random::sampleDouble(0.1, 1)});
+    }
+    MiniBow2::BowVector bv;
+    bv.set(words);
+    return bv;
+}
+
+TEST(BoW, Database)
+{
+    int num_words = 500;
+    MiniBow2::Database db(num_words);
+
+    std::vector<MiniBow2::BowVector> bows;
+    for (int i = 0; i < 300; ++i)
+    {
+        bows.push_back(RandomBowVector(num_words, 50));
+        MiniBow2::FeatureVector fv;
+        std::vector<std::pair<MiniBow2::NodeId, int>> features = {{i % 7, 0}, {i % 7, 1}};
+        fv.setFeatures(features);
+        db.add(i, bows.back(), fv);
+    }
+    EXPECT_EQ(db.size(), 300);
+    EXPECT_EQ(db.getFeatureVector(12).front().first, 12 % 7);
+
+    // Remove every third entry
+    for (int i = 0; i < 300; i += 3) db.remove(i);
+    EXPECT_EQ(db.size(), 200);
+    EXPECT_FALSE(db.contains(3));
+
+    for (int q = 0; q < 20; ++q)
+    {
+        auto query = RandomBowVector(num_words, 50);
+
+        // Linear reference
+        std::vector<std::pair<float, int>> ref;
+        for (int i = 0; i < bows.size(); ++i)
+        {
+            if (i % 3 == 0) continue;
+            float score = MiniBow2::FeatureVector::score(query, bows[i]);
+            if (score > 0) ref.push_back({score, i});
+        }
+        std::sort(ref.begin(), ref.end(),
+                  [](auto a, auto b) { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+
+        auto result = db.query(query, 10, 1e-10);
+        ASSERT_EQ(result.size(), std::min<size_t>(10, ref.size()));
+        for (int i = 0; i < result.size(); ++i)
+        {
+            EXPECT_EQ(result[i].id, ref[i].second);
+            EXPECT_EQ(result[i].score, ref[i].first);
+        }
+
+        auto filtered = db.query(query, -1, 1e-10, [](int id) { return id % 2 == 0; });
+        for (auto& r : filtered) EXPECT_EQ(r.id % 2, 0);
+    }
+
+    // Concurrent queries on the same database
+    std::vector<MiniBow2::BowVector> queries;
+    std::vector<std::vector<MiniBow2::Database::QueryResult>> ref;
+    for (int q = 0; q < 50; ++q)
+    {
+        queries.push_back(RandomBowVector(num_words, 50));
+        ref.push_back(db.query(queries.back(), 10));
+    }
+    std::vector<int> wrong(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (int it = 0; it < 20; ++it)
+            {
+                for (int q = 0; q < queries.size(); ++q)
+                {
+                    auto result = db.query(queries[q], 10);
+                    if (result.size() != ref[q].size())
+                    {
+                        wrong[t]++;
+                        continue;
+                    }
+                    for (int i = 0; i < result.size(); ++i)
+                        wrong[t] += result[i].id != ref[q][i].id || result[i].score != ref[q][i].score;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    for (auto w : wrong) EXPECT_EQ(w, 0);
+}
 }  // namespace Saiga
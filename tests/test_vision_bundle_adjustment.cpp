@@ -230,6 +230,115 @@ TEST(Scene, LoadStore)
     }
 }
 
+TEST(Scene, LoadStoreBinary)
+{
+    Scene scene = SynteticScene::CircleSphere(2500, 65, 250);
+    scene.images[3].constant                  = true;
+    scene.images[5].stereoPoints[7].depth     = 2.5;
+    scene.images[6].stereoPoints[1].weight    = 0.25;
+    scene.images[8].velocity.translation()(0) = 1;
+
+    std::vector<bool> compress_options = {false};
+#ifdef SAIGA_USE_ZLIB
+    compress_options.push_back(true);
+#endif
+
+    for (bool compress : compress_options)
+    {
+        scene.saveBinary("test.scene_bin", compress);
+
+        // load() detects the binary format
+        Scene scene2;
+        scene2.load("test.scene_bin");
+
+        EXPECT_EQ(scene.bf, scene2.bf);
+        EXPECT_EQ(scene.globalScale, scene2.globalScale);
+        ASSERT_EQ(scene.intrinsics.size(), scene2.intrinsics.size());
+        ASSERT_EQ(scene.images.size(), scene2.images.size());
+        ASSERT_EQ(scene.worldPoints.size(), scene2.worldPoints.size());
+
+        for (int i = 0; i < (int)scene.intrinsics.size(); ++i)
+        {
+            EXPECT_EQ(scene.intrinsics[i].coeffs(), scene2.intrinsics[i].coeffs());
+        }
+
+        for (int i = 0; i < (int)scene.worldPoints.size(); ++i)
+        {
+            EXPECT_EQ(scene.worldPoints[i].p, scene2.worldPoints[i].p);
+            EXPECT_EQ(scene.worldPoints[i].valid, scene2.worldPoints[i].valid);
+            EXPECT_EQ(scene.worldPoints[i].stereoreferences, scene2.worldPoints[i].stereoreferences);
+        }
+
+        for (int i = 0; i < (int)scene.images.size(); ++i)
+        {
+            auto& img1 = scene.images[i];
+            auto& img2 = scene2.images[i];
+            EXPECT_EQ(img1.se3.params(), img2.se3.params());
+            EXPECT_EQ(img1.velocity.params(), img2.velocity.params());
+            EXPECT_EQ(img1.constant, img2.constant);
+            EXPECT_EQ(img1.intr, img2.intr);
+            EXPECT_EQ(img1.validPoints, img2.validPoints);
+            ASSERT_EQ(img1.stereoPoints.size(), img2.stereoPoints.size());
+
+            for (int j = 0; j < (int)img1.stereoPoints.size(); ++j)
+            {
+                EXPECT_EQ(img1.stereoPoints[j].wp, img2.stereoPoints[j].wp);
+                EXPECT_EQ(img1.stereoPoints[j].depth, img2.stereoPoints[j].depth);
+                EXPECT_EQ(img1.stereoPoints[j].point, img2.stereoPoints[j].point);
+                EXPECT_EQ(img1.stereoPoints[j].weight, img2.stereoPoints[j].weight);
+            }
+        }
+        EXPECT_EQ(scene.chi2(), scene2.chi2());
+    }
+}
+
+
+TEST(Scene, ObservationTable)
+{
+    Scene scene = SynteticScene::CircleSphere(2500, 65, 250);
+    scene.images[2].stereoPoints[3].outlier = true;
+    scene.images[4].stereoPoints[0].wp      = -1;
+    scene.images[5].stereoPoints[7].depth   = 2.5;
+    scene.compress();
+
+    auto& obs = scene.observationTable();
+    ASSERT_EQ(obs.numImages(), (int)scene.images.size());
+    ASSERT_EQ(obs.numPoints(), (int)scene.worldPoints.size());
+
+    int total = 0;
+    for (int i = 0; i < (int)scene.images.size(); ++i)
+    {
+        EXPECT_EQ(obs.imageBegin(i), total);
+        for (int j = 0; j < (int)scene.images[i].stereoPoints.size(); ++j)
+        {
+            auto& ip = scene.images[i].stereoPoints[j];
+            if (!ip) continue;
+            EXPECT_EQ(obs.imageId[total], i);
+            EXPECT_EQ(obs.imagePointId[total], j);
+            EXPECT_EQ(obs.pointId[total], ip.wp);
+            EXPECT_EQ(obs.pixel[total], ip.point);
+            EXPECT_EQ(obs.depth[total], ip.depth);
+            EXPECT_EQ(obs.weight[total], ip.weight);
+            total++;
+        }
+        EXPECT_EQ(obs.imageEnd(i), total);
+    }
+    EXPECT_EQ(obs.size(), total);
+
+    // Every observation appears exactly once in the point lists
+    std::vector<int> count(obs.size(), 0);
+    for (int p = 0; p < obs.numPoints(); ++p)
+    {
+        for (int k = obs.pointBegin(p); k < obs.pointEnd(p); ++k)
+        {
+            int o = obs.pointObservations[k];
+            EXPECT_EQ(obs.pointId[o], p);
+            count[o]++;
+        }
+    }
+    for (auto c : count) EXPECT_EQ(c, 1);
+}
+
 
 TEST(BundleAdjustment, Empty)
 {
@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/vision/camera/CameraBase.h"
+
+#include "gtest/gtest.h"
+
+#include <thread>
+
+namespace Saiga
+{
+// Generates the images instead of reading them from disk.
+// Each image is filled with the frame id.
+class SyntheticDataset : public DatasetCameraBase
+{
+   public:
+    SyntheticDataset(const DatasetParameters& params, int num_frames)
+        : DatasetCameraBase(params), num_frames(num_frames)
+    {
+        camera_type = CameraInputType::Mono;
+        Load();
+    }
+    ~SyntheticDataset() { StopPrefetch(); }
+
+    int LoadMetaData() override
+    {
+        frames.resize(num_frames);
+        for (int i = 0; i < num_frames; ++i)
+        {
+            frames[i].id        = i;
+            frames[i].timeStamp = i;
+        }
+        return num_frames;
+    }
+
+    void LoadImageData(FrameData& data) override
+    {
+        SAIGA_ASSERT(data.image.rows == 0);
+        if (data.image.data()) reused_buffers++;
+
+        data.image.create(h, w);
+        data.image.getImageView().set(data.id % 256);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+        int loaded = ++loaded_frames;
+        int ahead  = loaded - consumed_frames;
+        max_ahead  = std::max<int>(max_ahead, ahead);
+    }
+
+    std::atomic_int consumed_frames = 0;
+    std::atomic_int loaded_frames   = 0;
+    std::atomic_int reused_buffers  = 0;
+    std::atomic_int max_ahead       = 0;
+
+    int num_frames;
+    int w = 640, h = 480;
+};
+
+static void CheckSequence(SyntheticDataset& dataset)
+{
+    FrameData data;
+    int count = 0;
+    while (dataset.isOpened())
+    {
+        EXPECT_TRUE(dataset.getImageSync(data));
+        dataset.consumed_frames++;
+        EXPECT_EQ(data.id, count);
+        ASSERT_EQ(data.image.rows, dataset.h);
+        EXPECT_EQ(data.image(dataset.h - 1, dataset.w - 1), count % 256);
+        count++;
+    }
+    EXPECT_EQ(count, dataset.num_frames);
+    EXPECT_FALSE(dataset.getImageSync(data));
+}
+
+TEST(DatasetPrefetch, Synchronous)
+{
+    DatasetParameters params;
+    params.playback_fps    = 100000;
+    params.preload         = false;
+    params.prefetch_frames = 0;
+
+    SyntheticDataset dataset(params, 50);
+    EXPECT_EQ(dataset.loaded_frames, 0);
+    CheckSequence(dataset);
+}
+
+TEST(DatasetPrefetch, Window)
+{
+    DatasetParameters params;
+    params.playback_fps     = 100000;
+    params.preload          = false;
+    params.prefetch_frames  = 5;
+    params.prefetch_threads = 3;
+
+    SyntheticDataset dataset(params, 200);
+    CheckSequence(dataset);
+    EXPECT_EQ(dataset.loaded_frames, 200);
+    // +1 because the counter of the consumer is incremented after getImageSync returned
+    EXPECT_LE(dataset.max_ahead, params.prefetch_frames + 1);
+    // The caller reuses 'data' -> the memory of the previous frame is recycled
+    EXPECT_GT(dataset.reused_buffers, 150);
+}
+
+TEST(DatasetPrefetch, MemoryBudget)
+{
+    DatasetParameters params;
+    params.playback_fps     = 100000;
+    params.preload          = false;
+    params.prefetch_frames  = 50;
+    params.prefetch_threads = 4;
+    // 2 images of 640x480 bytes
+    params.prefetch_memory_mb = 0.62;
+
+    SyntheticDataset dataset(params, 100);
+    CheckSequence(dataset);
+    EXPECT_EQ(dataset.loaded_frames, 100);
+    EXPECT_LE(dataset.max_ahead, 2 + 1);
+}
+
+TEST(DatasetPrefetch, Close)
+{
+    DatasetParameters params;
+    params.playback_fps    = 100000;
+    params.preload         = false;
+    params.prefetch_frames = 10;
+
+    SyntheticDataset dataset(params, 30);
+    FrameData data;
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_TRUE(dataset.getImageSync(data));
+        EXPECT_EQ(data.id, i);
+    }
+
+    // The remaining frames are loaded synchronously
+    dataset.close();
+    for (int i = 10; i < 30; ++i)
+    {
+        EXPECT_TRUE(dataset.getImageSync(data));
+        EXPECT_EQ(data.id, i);
+        EXPECT_EQ(data.image(0, 0), i);
+    }
+    EXPECT_FALSE(dataset.isOpened());
+}
+
+TEST(DatasetPrefetch, CloseFromOtherThread)
+{
+    DatasetParameters params;
+    params.playback_fps     = 100000;
+    params.preload          = false;
+    params.prefetch_frames  = 10;
+    params.prefetch_threads = 3;
+
+    // getImageSync might wait for a frame, which is skipped by close(). It must wake up and load the frame itself.
+    for (int close_after_us : {0, 500, 2000, 5000})
+    {
+        SyntheticDataset dataset(params, 100);
+        std::thread closer([&]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(close_after_us));
+            dataset.close();
+        });
+        CheckSequence(dataset);
+        closer.join();
+    }
+}
+
+}  // namespace Saiga
@@ -6,6 +6,7 @@
 
 
 #include "saiga/vision/kernels/BA.h"
+#include "saiga/vision/kernels/BABatch.h"
 #include "saiga/vision/util/Random.h"
 
 #include "gtest/gtest.h"
@@ -201,6 +202,132 @@ TEST(NumericDerivative, BundleAdjustmentStereo)
 }
 
 
+// Random observations in front of the camera. The last observations are not a multiple of the SIMD width.
+static void RandomBatch(const SE3& pose_c_w, const StereoCamera4& intr, int n, BABatch<double>& batch, bool stereo)
+{
+    batch.Clear();
+    for (int i = 0; i < n; ++i)
+    {
+        Vec3 pc = Vec3::Random();
+        pc.z()  = Random::sampleDouble(1, 5);
+        Vec3 wp = pose_c_w.inverse() * pc;
+
+        Vec2 observation = intr.project(pc) + Vec2::Random() * 0.1;
+        double weight    = Random::sampleDouble(0.5, 2);
+        if (stereo)
+        {
+            batch.Add(wp, observation, Random::sampleDouble(-1, 1), weight, weight * 0.7);
+        }
+        else
+        {
+            batch.Add(wp, observation, weight);
+        }
+    }
+}
+
+template <typename T>
+static BABatch<T> CastBatch(const BABatch<double>& batch)
+{
+    BABatch<T> result;
+    for (int i = 0; i < batch.size(); ++i)
+    {
+        result.Add(Vec3(batch.point_x[i], batch.point_y[i], batch.point_z[i]).cast<T>(),
+                   Vec2(batch.observation_u[i], batch.observation_v[i]).cast<T>(), T(batch.stereo_point[i]),
+                   T(batch.weight[i]), T(batch.weight_stereo[i]));
+    }
+    return result;
+}
+
+template <typename Derived1, typename Derived2>
+static void ExpectCloseNorm(const Eigen::MatrixBase<Derived1>& a, const Eigen::MatrixBase<Derived2>& b, double eps)
+{
+    EXPECT_LE((a.template cast<double>() - b.template cast<double>()).norm(), eps * (1 + b.norm()));
+}
+
+// Compares the batch kernels of all supported instruction sets against the scalar kernels above.
+template <typename T>
+static void TestBABatch(double eps)
+{
+    Random::setSeed(9357235);
+    SE3 pose_c_w = Random::randomSE3();
+    StereoCamera4 intr(IntrinsicsPinholed(500, 450, 320, 240, 0.5), 40);
+
+    auto previous_kernel = ActiveBABatchKernel();
+    for (auto kernel : {BABatchKernel::Scalar, BABatchKernel::AVX2, BABatchKernel::AVX512})
+    {
+        if (!BABatchKernelSupported(kernel)) continue;
+        SetBABatchKernel(kernel);
+        SCOPED_TRACE(BABatchKernelName(kernel));
+
+        for (bool stereo : {false, true})
+        {
+            for (bool jacobians : {false, true})
+            {
+                BABatch<double> reference;
+                RandomBatch(pose_c_w, intr, 37, reference, stereo);
+                auto batch = CastBatch<T>(reference);
+                if (stereo)
+                {
+                    BundleAdjustmentStereoBatch(intr.cast<T>(), pose_c_w.cast<T>(), batch, jacobians);
+                }
+                else
+                {
+                    BundleAdjustmentBatch(intr.cast<T>(), pose_c_w.cast<T>(), batch, jacobians);
+                }
+
+                for (int i = 0; i < reference.size(); ++i)
+                {
+                    Vec3 wp(reference.point_x[i], reference.point_y[i], reference.point_z[i]);
+                    Vec2 observation(reference.observation_u[i], reference.observation_v[i]);
+                    double weight = reference.weight[i];
+
+                    if (stereo)
+                    {
+                        Matrix<double, 3, 6> J_pose;
+                        Matrix<double, 3, 3> J_point;
+                        auto [res, depth] =
+                            BundleAdjustmentStereo(intr, observation, reference.stereo_point[i], pose_c_w, wp, weight,
+                                                   reference.weight_stereo[i], &J_pose, &J_point);
+                        ExpectCloseNorm(batch.template Residual<3>(i), res, eps);
+                        EXPECT_NEAR(batch.Depth(i), depth, eps * depth);
+                        if (jacobians)
+                        {
+                            ExpectCloseNorm(batch.template JacobianPose<3>(i), J_pose, eps);
+                            ExpectCloseNorm(batch.template JacobianPoint<3>(i), J_point, eps);
+                        }
+                    }
+                    else
+                    {
+                        Matrix<double, 2, 6> J_pose;
+                        Matrix<double, 2, 3> J_point;
+                        auto [res, depth] =
+                            BundleAdjustment<double>(intr, observation, pose_c_w, wp, weight, &J_pose, &J_point);
+                        ExpectCloseNorm(batch.template Residual<2>(i), res, eps);
+                        EXPECT_NEAR(batch.Depth(i), depth, eps * depth);
+                        if (jacobians)
+                        {
+                            ExpectCloseNorm(batch.template JacobianPose<2>(i), J_pose, eps);
+                            ExpectCloseNorm(batch.template JacobianPoint<2>(i), J_point, eps);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    SetBABatchKernel(previous_kernel);
+}
+
+TEST(BABatch, Double)
+{
+    TestBABatch<double>(1e-10);
+}
+
+TEST(BABatch, Float)
+{
+    TestBABatch<float>(1e-3);
+}
+
+
 
 Vec2 BundleAdjustmentDistortionVerbose(const SE3& pose, const Vec3& point, const IntrinsicsPinholed& camera,
                                        const Distortion& distortion, const Vec2& observation, double weight,
@@ -7,6 +7,7 @@
 #include "saiga/config.h"
 #include "saiga/core/image/all.h"
 #include "saiga/vision/cameraModel/Distortion.h"
+#include "saiga/vision/cameraModel/RemapTable.h"
 #include "saiga/vision/util/Random.h"
 
 #include "gtest/gtest.h"
@@ -69,4 +70,197 @@ TEST(NumericDerivative, DistortionDist)
     ExpectCloseRelative(res1, res2, 1e-5);
     ExpectCloseRelative(J1, J2, 1e-5);
 }
-#endif
\ No newline at end of file
+
+static Distortion TestDistortion()
+{
+    Distortion d;
+    d.k1 = -0.2;
+    d.k2 = 0.05;
+    d.p1 = 0.001;
+    return d;
+}
+
+static RemapTable TestTable()
+{
+    IntrinsicsPinholed K(300, 300, 160, 120, 0);
+    return RemapTable::Undistort(K, TestDistortion(), ImageDimensions(240, 320));
+}
+
+template <typename T>
+static TemplatedImage<T> RandomImage(int h, int w)
+{
+    TemplatedImage<T> img(h, w);
+    for (int i = 0; i < img.size(); ++i)
+    {
+        img.data8()[i] = Random::uniformInt(0, 255);
+    }
+    return img;
+}
+
+TEST(RemapTable, Undistort)
+{
+    IntrinsicsPinholed K(300, 300, 160, 120, 0);
+    Distortion d = TestDistortion();
+
+    auto table = TestTable();
+    int valid  = 0;
+    for (int y = 0; y < 240; ++y)
+    {
+        for (int x = 0; x < 320; ++x)
+        {
+            vec2 p;
+            if (!table.SourcePosition(y, x, p)) continue;
+            valid++;
+
+            // Undistorting the source position results in the destination pixel
+            Vec2 n   = undistortPointGN<double>(K.unproject2(p.cast<double>()), K.unproject2(p.cast<double>()), d);
+            Vec2 dst = K.normalizedToImage(n);
+            EXPECT_NEAR(dst.x(), x, 0.01);
+            EXPECT_NEAR(dst.y(), y, 0.01);
+        }
+    }
+    EXPECT_GT(valid, 240 * 320 * 0.9);
+}
+
+TEST(RemapTable, Identity)
+{
+    IntrinsicsPinholed K(300, 300, 160, 120, 0);
+    auto table = RemapTable::Undistort(K, Distortion(), ImageDimensions(240, 320));
+
+    auto gray = RandomImage<unsigned char>(240, 320);
+    auto rgba = RandomImage<ucvec4>(240, 320);
+    TemplatedImage<unsigned char> gray2(240, 320);
+    TemplatedImage<ucvec4> rgba2(240, 320);
+
+    for (auto kernel : {RemapKernel::Scalar, RemapKernel::AVX2})
+    {
+        if (!RemapKernelSupported(kernel)) continue;
+        SetRemapKernel(kernel);
+        table.Remap(gray, gray2.getImageView());
+        table.Remap(rgba, rgba2.getImageView());
+        EXPECT_EQ(gray, gray2);
+        EXPECT_EQ(rgba, rgba2);
+    }
+}
+
+TEST(RemapTable, Kernels)
+{
+    auto table = TestTable();
+    auto gray  = RandomImage<unsigned char>(240, 320);
+    auto rgba  = RandomImage<ucvec4>(240, 320);
+    TemplatedImage<float> depth(240, 320);
+    for (int i = 0; i < depth.rows * depth.cols; ++i) depth.data()[i] = Random::sampleDouble(0.5, 5);
+
+    std::vector<TemplatedImage<unsigned char>> grays;
+    std::vector<TemplatedImage<ucvec4>> rgbas;
+    std::vector<TemplatedImage<float>> depths_nearest, depths_bilinear;
+    for (auto kernel : {RemapKernel::Scalar, RemapKernel::AVX2})
+    {
+        if (!RemapKernelSupported(kernel)) continue;
+        SetRemapKernel(kernel);
+
+        TemplatedImage<unsigned char> g(240, 320);
+        TemplatedImage<ucvec4> c(240, 320);
+        TemplatedImage<float> dn(240, 320), db(240, 320);
+        table.Remap(gray, g.getImageView());
+        table.Remap(rgba, c.getImageView());
+        table.Remap(depth, dn.getImageView(), RemapInterpolation::Nearest);
+        table.Remap(depth, db.getImageView(), RemapInterpolation::Bilinear);
+        grays.push_back(g);
+        rgbas.push_back(c);
+        depths_nearest.push_back(dn);
+        depths_bilinear.push_back(db);
+    }
+
+    // Nearest neighbour only copies existing depth values
+    for (int y = 0; y < 240; ++y)
+    {
+        for (int x = 0; x < 320; ++x)
+        {
+            vec2 p;
+            float expected = 0;
+            if (table.SourcePosition(y, x, p)) expected = depth(std::round(p.y()), std::round(p.x()));
+            EXPECT_EQ(depths_nearest.front()(y, x), expected);
+        }
+    }
+
+    // All kernels compute the same result
+    for (int i = 1; i < grays.size(); ++i)
+    {
+        EXPECT_EQ(grays[0], grays[i]);
+        EXPECT_EQ(rgbas[0], rgbas[i]);
+        EXPECT_EQ(depths_nearest[0], depths_nearest[i]);
+        for (int j = 0; j < 240 * 320; ++j)
+        {
+            EXPECT_NEAR(depths_bilinear[0].data()[j], depths_bilinear[i].data()[j], 1e-5);
+        }
+    }
+    SetRemapKernel(RemapKernelSupported(RemapKernel::AVX2) ? RemapKernel::AVX2 : RemapKernel::Scalar);
+}
+
+TEST(RemapTable, Rectify)
+{
+    Rectification rect;
+    rect.K_src = IntrinsicsPinholed(300, 300, 160, 120, 0);
+    rect.D_src = TestDistortion();
+    rect.R     = Quat(Eigen::AngleAxisd(0.05, Vec3(1, 2, 0.5).normalized()));
+    rect.K_dst = IntrinsicsPinholed(280, 280, 150, 110, 0);
+
+    auto table = RemapTable::Rectify(rect, ImageDimensions(240, 320), ImageDimensions(220, 300));
+    int valid  = 0;
+    for (int y = 0; y < 220; ++y)
+    {
+        for (int x = 0; x < 300; ++x)
+        {
+            vec2 p;
+            if (!table.SourcePosition(y, x, p)) continue;
+            valid++;
+
+            // Rectifying the source position results in the destination pixel
+            Vec2 dst = rect.Forward(p.cast<double>());
+            EXPECT_NEAR(dst.x(), x, 0.01);
+            EXPECT_NEAR(dst.y(), y, 0.01);
+        }
+    }
+    EXPECT_GT(valid, 220 * 300 * 0.8);
+}
+
+TEST(RemapTable, OCamToPinhole)
+{
+    // A calibrated fisheye camera (see test_vision_derivative_ocam.cpp)
+    OCam<double> ocam;
+    ocam.w = 5472;
+    ocam.h = 3648;
+    Vector<double, 5> affine;
+    affine << 1.0001200000e+00, 3.1232900000e-03, -3.1106100000e-03, 1.8263000000e+03, 2.7250100000e+03;
+    ocam.SetAffineParams(affine);
+    ocam.poly_world2cam = {2.1853300000e+03,  1.3746500000e+03,  -1.9568400000e+02, -2.7793500000e+02,
+                           1.4024400000e+02,  4.8937200000e+02,  -1.0358400000e+02, -6.6795000000e+02,
+                           5.6145100000e+01,  7.5621400000e+02,  1.0581900000e+02,  -5.7444200000e+02,
+                           -2.1457300000e+02, 2.4003900000e+02,  1.5284200000e+02,  -2.7509800000e+01,
+                           -3.9366600000e+01, -7.9584200000e+00};
+    ocam.poly_cam2world = {-1.3760700000e+03, 0.0000000000e+00,  3.5451700000e-04, -2.6874700000e-07,
+                           2.5379600000e-10,  -1.0337200000e-13, 1.6999900000e-17};
+
+    IntrinsicsPinholed K(150, 150, 160, 120, 0);
+    auto table = RemapTable::OCamToPinhole(ocam, K, ImageDimensions(240, 320));
+    int valid  = 0;
+    for (int y = 0; y < 240; ++y)
+    {
+        for (int x = 0; x < 320; ++x)
+        {
+            vec2 p;
+            if (!table.SourcePosition(y, x, p)) continue;
+            valid++;
+
+            // Unprojecting the source position with the inverse polynomial results in the destination pixel.
+            // The two polynomials differ by up to 0.5 fisheye pixels, which is less than 0.1 pinhole pixels here.
+            Vec3 ray = UnprojectOCam<double>(p.cast<double>(), 1, ocam.AffineParams(), ocam.poly_cam2world);
+            Vec2 dst = K.project(ray);
+            EXPECT_NEAR(dst.x(), x, 0.1);
+            EXPECT_NEAR(dst.y(), y, 0.1);
+        }
+    }
+    EXPECT_EQ(valid, 240 * 320);
+}
+#endif
@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/image/imageTransformations.h"
+#include "saiga/core/math/random.h"
+#include "saiga/vision/features/FastDetector.h"
+#include "saiga/vision/features/ORBExtractor.h"
+
+#include "gtest/gtest.h"
+#include "test_image.h"
+
+#ifdef SAIGA_USE_OPENCV
+#    include "saiga/vision/opencv/opencv.h"
+
+#    include <opencv2/features2d/features2d.hpp>
+#endif
+
+namespace Saiga
+{
+// Direct implementation of the FAST-9 definition.
+static bool NaiveIsCorner(ImageView<const unsigned char> img, int y, int x, int t)
+{
+    const int cx[16] = {0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1};
+    const int cy[16] = {3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1, 0, 1, 2, 3};
+    int v            = img(y, x);
+    for (int start = 0; start < 16; ++start)
+    {
+        bool bright = true, dark = true;
+        for (int j = 0; j < 9; ++j)
+        {
+            int k = (start + j) % 16;
+            int c = img(y + cy[k], x + cx[k]);
+            bright &= c > v + t;
+            dark &= c < v - t;
+        }
+        if (bright || dark) return true;
+    }
+    return false;
+}
+
+static std::vector<KeyPoint<float>> NaiveFast(ImageView<const unsigned char> img, int t, bool nms)
+{
+    TemplatedImage<int> score(img.h, img.w);
+    score.getImageView().set(0);
+    for (int y = 3; y < img.h - 3; ++y)
+    {
+        for (int x = 3; x < img.w - 3; ++x)
+        {
+            if (!NaiveIsCorner(img, y, x, t)) continue;
+            int s = t;
+            while (NaiveIsCorner(img, y, x, s + 1)) s++;
+            score(y, x) = s;
+        }
+    }
+
+    std::vector<KeyPoint<float>> result;
+    for (int y = 3; y < img.h - 3; ++y)
+    {
+        for (int x = 3; x < img.w - 3; ++x)
+        {
+            int s = score(y, x);
+            if (!NaiveIsCorner(img, y, x, t)) continue;
+            bool keep = true;
+            for (int dy = -1; dy <= 1 && nms; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if ((dx != 0 || dy != 0) && s <= score(y + dy, x + dx)) keep = false;
+                }
+            }
+            if (keep) result.emplace_back(float(x), float(y), 7.f, -1.f, float(s));
+        }
+    }
+    return result;
+}
+
+TEST(FastDetector, Naive)
+{
+    auto img            = TestImage(120, 157, 50);
+    auto default_kernel = ActiveFastKernel();
+
+    FastDetector fast;
+    std::vector<KeyPoint<float>> keypoints;
+    for (int threshold : {5, 20, 50})
+    {
+        for (bool nms : {false, true})
+        {
+            auto ref = NaiveFast(img.getConstImageView(), threshold, nms);
+            EXPECT_GT(ref.size(), 0);
+            for (auto kernel : {FastKernel::Scalar, FastKernel::SSE2, FastKernel::AVX2})
+            {
+                if (!FastKernelSupported(kernel)) continue;
+                SetFastKernel(kernel);
+                fast.Detect(img.getConstImageView(), threshold, nms, keypoints);
+                EXPECT_EQ(keypoints, ref) << FastKernelName(kernel) << " t=" << threshold << " nms=" << nms;
+            }
+        }
+    }
+    SetFastKernel(default_kernel);
+}
+
+TEST(FastDetector, SubImage)
+{
+    // Corners are only detected inside the view, even if the surrounding pixels are valid.
+    // The widths cover rows which are smaller than one vector and rows with an overlapping last vector.
+    auto img            = TestImage(100, 100, 50);
+    auto default_kernel = ActiveFastKernel();
+
+    FastDetector fast;
+    std::vector<KeyPoint<float>> keypoints;
+    for (int w : {12, 25, 36, 50})
+    {
+        auto view = img.getConstImageView().subImageView(10, 20, 40, w);
+        auto ref  = NaiveFast(view, 10, true);
+        for (auto kernel : {FastKernel::Scalar, FastKernel::SSE2, FastKernel::AVX2})
+        {
+            if (!FastKernelSupported(kernel)) continue;
+            SetFastKernel(kernel);
+            fast.Detect(view, 10, true, keypoints);
+            EXPECT_EQ(keypoints, ref) << FastKernelName(kernel) << " w=" << w;
+        }
+    }
+    SetFastKernel(default_kernel);
+}
+
+#ifdef SAIGA_USE_OPENCV
+TEST(FastDetector, OpenCV)
+{
+    // Same corners, scores and order as cv::FAST
+    auto img            = TestImage(120, 157, 50);
+    auto default_kernel = ActiveFastKernel();
+    cv::Mat cv_img      = ImageViewToMat(img.getImageView());
+
+    FastDetector fast;
+    std::vector<KeyPoint<float>> keypoints;
+    std::vector<cv::KeyPoint> cv_keypoints;
+    for (int threshold : {5, 20, 50})
+    {
+        for (bool nms : {false, true})
+        {
+            cv::FAST(cv_img, cv_keypoints, threshold, nms);
+            for (auto kernel : {FastKernel::Scalar, FastKernel::SSE2, FastKernel::AVX2})
+            {
+                if (!FastKernelSupported(kernel)) continue;
+                SetFastKernel(kernel);
+                fast.Detect(img.getConstImageView(), threshold, nms, keypoints);
+                ASSERT_EQ(keypoints.size(), cv_keypoints.size()) << FastKernelName(kernel) << " t=" << threshold;
+                for (size_t i = 0; i < keypoints.size(); ++i)
+                {
+                    EXPECT_EQ(keypoints[i].point.x(), cv_keypoints[i].pt.x);
+                    EXPECT_EQ(keypoints[i].point.y(), cv_keypoints[i].pt.y);
+                    EXPECT_EQ(keypoints[i].response, cv_keypoints[i].response);
+                }
+            }
+        }
+    }
+    SetFastKernel(default_kernel);
+}
+#endif
+
+TEST(ImageTransformation, ResizeBlurBorder)
+{
+    // Constant images stay constant
+    TemplatedImage<unsigned char> img(50, 70), small(41, 58), blurred(50, 70);
+    img.getImageView().set(77);
+    ImageTransformation::ResizeBilinear(img.getConstImageView(), small.getImageView());
+    ImageTransformation::GaussianBlur(img.getConstImageView(), blurred.getImageView(), 3, 2);
+    for (auto i : small.getImageView().rowRange())
+        for (auto j : small.getImageView().colRange()) EXPECT_EQ(small(i, j), 77);
+    for (auto i : blurred.getImageView().rowRange())
+        for (auto j : blurred.getImageView().colRange()) EXPECT_EQ(blurred(i, j), 77);
+
+    // Resizing to the same size is a copy
+    img = TestImage(50, 70, 50);
+    ImageTransformation::ResizeBilinear(img.getConstImageView(), blurred.getImageView());
+    EXPECT_EQ(ImageTransformation::L1Difference(img.getConstImageView(), blurred.getConstImageView()), 0);
+
+    // Reflected border without repeating the edge pixel
+    const int b = 5;
+    TemplatedImage<unsigned char> bordered(50 + 2 * b, 70 + 2 * b);
+    img.getImageView().copyTo(bordered.getImageView().subImageView(b, b, 50, 70));
+    ImageTransformation::FillBorderReflect101(bordered.getImageView(), b);
+    EXPECT_EQ(bordered(0, 0), img(b, b));
+    EXPECT_EQ(bordered(b, b - 2), img(0, 2));
+    EXPECT_EQ(bordered(b - 1, b + 10), img(1, 10));
+    EXPECT_EQ(bordered(50 + 2 * b - 1, 70 + 2 * b - 1), img(50 - 1 - b, 70 - 1 - b));
+}
+
+TEST(ORBExtractor, Detect)
+{
+    auto img = TestImage(480, 752, 50);
+    ORBExtractor extractor(1000, 1.2, 8, 20, 7, 1);
+
+    std::vector<KeyPoint<float>> keypoints;
+    std::vector<DescriptorORB> descriptors;
+    extractor.Detect(img.getImageView(), keypoints, descriptors);
+
+    EXPECT_EQ(keypoints.size(), descriptors.size());
+    EXPECT_GT(keypoints.size(), 500);
+    for (auto& kp : keypoints)
+    {
+        EXPECT_TRUE(img.getImageView().inImage(kp.point.y(), kp.point.x()));
+        EXPECT_GE(kp.octave, 0);
+        EXPECT_LT(kp.octave, 8);
+    }
+}
+
+}  // namespace Saiga
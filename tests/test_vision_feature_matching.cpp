@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/vision/features/Features.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+static std::vector<DescriptorORB> RandomDescriptors(int n)
+{
+    std::vector<DescriptorORB> result(n);
+    for (auto& d : result)
+    {
+        for (auto& w : d)
+        {
+            w = (uint64_t(Random::urand64()) << 32) ^ Random::urand64();
+        }
+    }
+    return result;
+}
+
+// Reference implementation with the scalar distance function.
+static void NaiveKnn2(const std::vector<DescriptorORB>& d1, const std::vector<DescriptorORB>& d2,
+                      std::vector<std::pair<int, int>>& knn2)
+{
+    knn2.resize(d1.size() * 2);
+    for (int i = 0; i < d1.size(); ++i)
+    {
+        auto& best   = knn2[i * 2];
+        auto& second = knn2[i * 2 + 1];
+        best = second = {1000, -1};
+        for (int j = 0; j < d2.size(); ++j)
+        {
+            int dis = distance(d1[i], d2[j]);
+            if (dis < best.first)
+            {
+                second = best;
+                best   = {dis, j};
+            }
+            else if (dis < second.first)
+            {
+                second = {dis, j};
+            }
+        }
+    }
+}
+
+TEST(FeatureMatching, HammingKernels)
+{
+    auto query = RandomDescriptors(10);
+    auto train = RandomDescriptors(203);
+    OrbDescriptorBlocks blocks(train);
+
+    auto default_kernel = ActiveHammingKernel();
+    for (auto kernel : {HammingKernel::Scalar, HammingKernel::AVX2, HammingKernel::AVX512BW,
+                        HammingKernel::AVX512VPOPCNT})
+    {
+        if (!HammingKernelSupported(kernel)) continue;
+        SetHammingKernel(kernel);
+
+        std::vector<int> dist(blocks.numBlocks() * OrbDescriptorBlocks::kBlockSize);
+        for (auto& q : query)
+        {
+            HammingDistanceBlocks(q, blocks, 0, blocks.numBlocks(), dist.data());
+            for (int j = 0; j < train.size(); ++j)
+            {
+                EXPECT_EQ(dist[j], distance(q, train[j])) << HammingKernelName(kernel);
+            }
+        }
+    }
+    SetHammingKernel(default_kernel);
+}
+
+TEST(FeatureMatching, Knn2)
+{
+    auto d1 = RandomDescriptors(1000);
+    auto d2 = RandomDescriptors(1500);
+    // Duplicates to check the tie breaking
+    d2[700] = d2[20];
+    d1[5]   = d1[400];
+
+    std::vector<std::pair<int, int>> ref;
+    NaiveKnn2(d1, d2, ref);
+
+    for (int threads : {1, 4})
+    {
+        BruteForceMatcher<DescriptorORB> matcher;
+        matcher.matchKnn2_omp(d1, d2, threads);
+        for (int i = 0; i < d1.size(); ++i)
+        {
+            EXPECT_EQ(matcher.knn2(i, 0), ref[i * 2]);
+            EXPECT_EQ(matcher.knn2(i, 1), ref[i * 2 + 1]);
+        }
+    }
+}
+
+TEST(FeatureMatching, CrossCheck)
+{
+    auto d1 = RandomDescriptors(500);
+    auto d2 = RandomDescriptors(600);
+    // Some true matches with small noise
+    for (int i = 0; i < 100; ++i)
+    {
+        d2[i * 5] = d1[i * 3];
+        d2[i * 5][0] ^= 1ULL << (i % 64);
+    }
+
+    std::vector<std::pair<int, int>> knn12, knn21;
+    NaiveKnn2(d1, d2, knn12);
+    NaiveKnn2(d2, d1, knn21);
+
+    std::vector<std::pair<int, int>> ref;
+    for (int i = 0; i < d1.size(); ++i)
+    {
+        int j = knn12[i * 2].second;
+        if (knn12[i * 2].first <= 50 && knn21[j * 2].second == i) ref.push_back({i, j});
+    }
+    EXPECT_EQ(ref.size(), 100);
+
+    for (int threads : {1, 3})
+    {
+        BruteForceMatcher<DescriptorORB> matcher;
+        matcher.matchCrossCheck(d1, d2, 50, threads);
+        EXPECT_EQ(matcher.matches, ref);
+    }
+}
+
+}  // namespace Saiga
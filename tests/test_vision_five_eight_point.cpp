@@ -232,6 +232,83 @@ TEST(EpipolarGeometry, FivePointAlgorithm)
     std::cout << "failed " << failed << std::endl;
 }
 
+TEST(EpipolarGeometry, AdaptiveRansac)
+{
+    // An easy and a harder inlier ratio
+    for (double outlierRatio : {0.1, 0.3})
+    {
+        FiveEightPointTest test;
+
+        // Replace a part of the correspondences by outliers
+        std::vector<char> outlier(test.N, false);
+        std::vector<double> quality(test.N);
+        for (int i = 0; i < test.N; ++i)
+        {
+            outlier[i] = Random::sampleDouble(0, 1) < outlierRatio;
+            if (outlier[i])
+            {
+                Vec2 p                     = Vec2(Random::sampleDouble(0, 640), Random::sampleDouble(0, 480));
+                test.normalized_points2[i] = test.K2.unproject2(p);
+            }
+            // A noisy quality score, which prefers the inliers
+            quality[i] = Random::sampleDouble(0, 1) + (outlier[i] ? 0 : 0.5);
+        }
+        int num_true_inliers = std::count(outlier.begin(), outlier.end(), false);
+
+        auto run = [&](RansacParameters params, bool prosac) {
+            FivePointRansac ransac(params);
+            if (prosac) ransac.setMatchQuality(quality);
+
+            Mat3 E;
+            SE3 T;
+            std::vector<int> inliers;
+            std::vector<char> inlierMask;
+            int num;
+#pragma omp parallel num_threads(params.threads)
+            {
+                num = ransac.solve(test.normalized_points1, test.normalized_points2, E, T, inliers, inlierMask);
+            }
+
+            EXPECT_EQ(num, inliers.size());
+            EXPECT_GT(num, num_true_inliers * 0.95);
+            int wrong = 0;
+            for (int i = 0; i < test.N; ++i) wrong += inlierMask[i] && outlier[i];
+            EXPECT_LT(wrong, test.N * 0.05);
+            std::cout << "Ransac outliers " << outlierRatio << " threads " << params.threads << " adaptive "
+                      << params.adaptive << " sprt " << params.sprt << " prosac " << prosac << ": "
+                      << ransac.Iterations() << " iterations, " << num << " inliers" << std::endl;
+            return ransac.Iterations();
+        };
+
+        for (int threads : {1, 4})
+        {
+            RansacParameters params;
+            params.maxIterations     = 2000;
+            double epipolarTheshold  = 1.5 / test.K1.fx;
+            params.residualThreshold = epipolarTheshold * epipolarTheshold;
+            params.reserveN          = test.N;
+            params.threads           = threads;
+
+            EXPECT_EQ(run(params, false), params.maxIterations);
+
+            params.adaptive  = true;
+            int its_adaptive = run(params, false);
+            EXPECT_LT(its_adaptive, params.maxIterations / 2);
+            if (outlierRatio <= 0.1)
+            {
+                // With 90% inliers a few dozen samples are enough
+                EXPECT_LT(its_adaptive, params.maxIterations / 20);
+            }
+
+            params.sprt = true;
+            run(params, false);
+
+            int its_prosac = run(params, true);
+            EXPECT_LE(its_prosac, its_adaptive * 2);
+        }
+    }
+}
+
 TEST(EpipolarGeometry, Benchmark)
 {
     int its = 50;
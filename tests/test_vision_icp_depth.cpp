@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/vision/icp/ICPDepthMap.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+// Ray casting of a room with two spheres. The camera looks along +z with y pointing down.
+static TemplatedImage<float> RenderRoom(const IntrinsicsPinholed& K, int h, int w, const SE3& pose)
+{
+    // n * x = d
+    std::vector<std::pair<Vec3, double>> planes = {
+        {Vec3(0, 0, 1), 4}, {Vec3(0, 1, 0), 1.2}, {Vec3(1, 0, 0), -2}, {Vec3(1, 0, 0), 2.5}};
+    std::vector<std::pair<Vec3, double>> spheres = {{Vec3(0.3, 0.1, 2.5), 0.5}, {Vec3(-0.8, 0.6, 3.0), 0.4}};
+
+    TemplatedImage<float> depth(h, w);
+    Vec3 o = pose.translation();
+    for (int i = 0; i < h; ++i)
+    {
+        for (int j = 0; j < w; ++j)
+        {
+            // t is the depth, because the ray has z = 1 in camera space
+            Vec3 dir = pose.so3() * K.unproject(Vec2(j, i), 1);
+            double t = std::numeric_limits<double>::infinity();
+            for (auto& [n, d] : planes)
+            {
+                double ti = (d - n.dot(o)) / n.dot(dir);
+                if (ti > 0) t = std::min(t, ti);
+            }
+            for (auto& [c, r] : spheres)
+            {
+                Vec3 oc     = o - c;
+                double a    = dir.squaredNorm();
+                double b    = 2 * dir.dot(oc);
+                double disc = b * b - 4 * a * (oc.squaredNorm() - r * r);
+                if (disc < 0) continue;
+                double ti = (-b - std::sqrt(disc)) / (2 * a);
+                if (ti > 0) t = std::min(t, ti);
+            }
+            depth(i, j) = std::isfinite(t) ? t : 0;
+        }
+    }
+    return depth;
+}
+
+struct DenseICPTest
+{
+    int w = 320, h = 240;
+    IntrinsicsPinholed K = IntrinsicsPinholed(260, 260, 159.5, 119.5, 0);
+    SE3 ref_pose;
+    SE3 src_pose = SE3(Sophus::SO3d::exp(Vec3(0.3, 1, 0.2).normalized() * radians(3.0)), Vec3(0.04, -0.02, 0.05));
+
+    TemplatedImage<float> ref_depth = RenderRoom(K, h, w, ref_pose);
+    TemplatedImage<float> src_depth = RenderRoom(K, h, w, src_pose);
+
+    DenseICPTest()
+    {
+        // Some invalid pixels
+        src_depth.getImageView().subImageView(10, 10, 20, 30).set(0);
+    }
+
+    static std::pair<double, double> Error(const SE3& a, const SE3& b)
+    {
+        SE3 d = a.inverse() * b;
+        return {d.translation().norm(), d.so3().log().norm()};
+    }
+};
+
+TEST(DenseICP, Pyramid)
+{
+    DenseICPTest test;
+    ICP::DepthMapPyramid pyramid(test.ref_depth.getImageView(), test.K, 3);
+    ASSERT_EQ(pyramid.levels.size(), 3);
+    EXPECT_EQ(pyramid.levels[1].depth.h, 120);
+    EXPECT_EQ(pyramid.levels[2].depth.w, 80);
+
+    // On a smooth surface the coarse point is the average of the fine points.
+    for (int l = 1; l < 3; ++l)
+    {
+        auto& fine   = pyramid.levels[l - 1];
+        auto& coarse = pyramid.levels[l];
+        for (int i : {20, 30, 40})
+        {
+            for (int j : {5, 40, 70})
+            {
+                Vec3 mean = (fine.points(2 * i, 2 * j) + fine.points(2 * i, 2 * j + 1) +
+                             fine.points(2 * i + 1, 2 * j) + fine.points(2 * i + 1, 2 * j + 1)) /
+                            4;
+                EXPECT_LT((coarse.points(i, j) - mean).norm(), 1e-3) << l << " " << i << " " << j;
+                EXPECT_TRUE(coarse.normals(i, j).allFinite());
+            }
+        }
+    }
+}
+
+TEST(DenseICP, Align)
+{
+    DenseICPTest test;
+    ICP::DenseICPParams params;
+
+    SE3 result = ICP::alignDepthMapsDense(test.ref_depth.getImageView(), test.src_depth.getImageView(), test.ref_pose,
+                                          SE3(), test.K, params);
+    auto [et, er] = DenseICPTest::Error(result, test.src_pose);
+    EXPECT_LT(et, 1e-3);
+    EXPECT_LT(er, 1e-3);
+
+    // Same result with the robust weights
+    params.huberThres = 0.01;
+    result = ICP::alignDepthMapsDense(test.ref_depth.getImageView(), test.src_depth.getImageView(), test.ref_pose,
+                                      SE3(), test.K, params);
+    std::tie(et, er) = DenseICPTest::Error(result, test.src_pose);
+    EXPECT_LT(et, 1e-3);
+    EXPECT_LT(er, 1e-3);
+}
+
+TEST(DenseICP, Robust)
+{
+    // An object, which moved 15cm towards the camera in the source frame.
+    DenseICPTest test;
+    auto moved = test.src_depth.getImageView().subImageView(60, 60, 60, 60);
+    for (auto i : moved.rowRange())
+    {
+        for (auto j : moved.colRange()) moved(i, j) -= 0.15;
+    }
+
+    ICP::DenseICPParams params;
+    SE3 result = ICP::alignDepthMapsDense(test.ref_depth.getImageView(), test.src_depth.getImageView(), test.ref_pose,
+                                          SE3(), test.K, params);
+    double error_l2 = DenseICPTest::Error(result, test.src_pose).first;
+
+    params.huberThres = 0.01;
+    result = ICP::alignDepthMapsDense(test.ref_depth.getImageView(), test.src_depth.getImageView(), test.ref_pose,
+                                      SE3(), test.K, params);
+    double error_huber = DenseICPTest::Error(result, test.src_pose).first;
+
+    EXPECT_LT(error_huber, 0.5 * error_l2);
+    EXPECT_LT(error_huber, 0.005);
+}
+
+}  // namespace Saiga
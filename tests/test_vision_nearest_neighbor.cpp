@@ -60,5 +60,74 @@ TEST(NearestNeighbor, PointToMesh)
     EXPECT_EQ(result_bf, result_bvh);
 }
 
+TEST(NearestNeighbor, SAHBVH)
+{
+    std::vector<Triangle> mesh;
+    for (int i = 0; i < 10000; ++i)
+    {
+        // Varying triangle sizes
+        float size = Random::sampleDouble(0.001, 0.2);
+        Triangle t;
+        t.a = Random::MatrixUniform<vec3>();
+        t.b = t.a + Random::MatrixGauss<vec3>(0, size);
+        t.c = t.a + Random::MatrixGauss<vec3>(0, size);
+        mesh.push_back(t);
+    }
+
+    AccelerationStructure::BruteForce bf(mesh);
+    AccelerationStructure::SAHBVH bvh(mesh);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        vec3 p = Random::MatrixUniform<vec3>(-2, 2);
+        EXPECT_EQ(bvh.ClosestPoint(p).first, Distance(mesh, p));
+
+        Ray ray(Random::MatrixUniform<vec3>(-1, 1).normalized(), p);
+        auto closest_bf  = bf.getClosest(ray);
+        auto closest_bvh = bvh.getClosest(ray);
+        EXPECT_EQ(closest_bf.valid, closest_bvh.valid);
+        if (closest_bf.valid)
+        {
+            EXPECT_EQ(closest_bf.t, closest_bvh.t);
+        }
+        EXPECT_EQ(bvh.getAll(ray).size(), bf.getAll(ray).size());
+        EXPECT_EQ(bvh.AnyHit(ray), closest_bf.valid);
+    }
+}
+
+TEST(NearestNeighbor, SAHBVHDegenerate)
+{
+    // Exponentially growing triangles along the x-axis and many copies of the same triangle (coincident centers)
+    std::vector<Triangle> mesh;
+    for (int i = 0; i < 300; ++i)
+    {
+        float x = std::pow(1.1f, float(i % 150));
+        Triangle t;
+        t.a = vec3(x, 0, 0);
+        t.b = vec3(x, 0.1f * x, 0);
+        t.c = vec3(x, 0, 0.1f * x);
+        mesh.push_back(t);
+    }
+    for (int i = 0; i < 1000; ++i) mesh.push_back(mesh.front());
+
+    AccelerationStructure::BruteForce bf(mesh);
+    AccelerationStructure::SAHBVH bvh(mesh);
+
+    for (int i = 0; i < 150; ++i)
+    {
+        float x = std::pow(1.1f, float(i));
+        Ray ray(vec3(1, 0.01, 0.01).normalized(), vec3(x * 0.5f, 0, 0));
+        auto closest_bf  = bf.getClosest(ray);
+        auto closest_bvh = bvh.getClosest(ray);
+        EXPECT_EQ(closest_bf.valid, closest_bvh.valid);
+        if (closest_bf.valid)
+        {
+            EXPECT_EQ(closest_bf.t, closest_bvh.t);
+        }
+        EXPECT_EQ(bvh.getAll(ray).size(), bf.getAll(ray).size());
+        EXPECT_EQ(bvh.AnyHit(ray), closest_bf.valid);
+    }
+}
+
 
 }  // namespace Saiga
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/vision/features/OrbDescriptors.h"
+
+#include "gtest/gtest.h"
+#include "test_image.h"
+
+namespace Saiga
+{
+// Integer positions (as from the FAST detector) and random sub-pixel positions at least 19 pixels from the border.
+static std::vector<KeyPoint<float>> TestKeypoints(int h, int w, int n)
+{
+    std::vector<KeyPoint<float>> keypoints;
+    for (int i = 0; i < n; ++i)
+    {
+        float x = Random::sampleDouble(19, w - 20);
+        float y = Random::sampleDouble(19, h - 20);
+        if (i % 2 == 0)
+        {
+            x = std::round(x);
+            y = std::round(y);
+        }
+        keypoints.emplace_back(x, y, 31.f, Random::sampleDouble(0, 360));
+    }
+    return keypoints;
+}
+
+TEST(ORB, AngleBin)
+{
+    EXPECT_EQ(ORB::AngleBin(0), 0);
+    EXPECT_EQ(ORB::AngleBin(5.9), 0);
+    EXPECT_EQ(ORB::AngleBin(6.1), 1);
+    EXPECT_EQ(ORB::AngleBin(353), 29);
+    EXPECT_EQ(ORB::AngleBin(355), 0);
+    EXPECT_EQ(ORB::AngleBin(360), 0);
+    EXPECT_EQ(ORB::AngleBin(-12), 29);
+    EXPECT_EQ(ORB::QuantizeAngle(100), 96);
+}
+
+TEST(ORB, ComputeAngles)
+{
+    auto img            = TestImage(150, 211);
+    auto keypoints      = TestKeypoints(150, 211, 500);
+    auto default_kernel = ActiveOrbKernel();
+
+    ORB orb;
+    for (auto kernel : {OrbKernel::Scalar, OrbKernel::AVX2})
+    {
+        if (!OrbKernelSupported(kernel)) continue;
+        SetOrbKernel(kernel);
+        auto result = keypoints;
+        orb.ComputeAngles(img.getImageView(), result);
+        for (auto& kp : result)
+        {
+            EXPECT_EQ(kp.angle, orb.ComputeAngle(img.getImageView(), kp.point)) << OrbKernelName(kernel);
+        }
+    }
+    SetOrbKernel(default_kernel);
+}
+
+TEST(ORB, ComputeDescriptors)
+{
+    auto img            = TestImage(150, 211);
+    auto keypoints      = TestKeypoints(150, 211, 500);
+    auto default_kernel = ActiveOrbKernel();
+
+    // Also test the exact bin angles, because they contain the rounding ties of the pattern (for example 60 degrees).
+    for (int bin = 0; bin < ORB::angle_bins; ++bin) keypoints[bin].angle = bin * 12;
+
+    ORB orb;
+    std::vector<DescriptorORB> ref;
+    for (auto& kp : keypoints)
+    {
+        ref.push_back(orb.ComputeDescriptor(img.getImageView(), kp.point, ORB::QuantizeAngle(kp.angle)));
+    }
+
+    std::vector<DescriptorORB> descriptors(keypoints.size());
+    for (auto kernel : {OrbKernel::Scalar, OrbKernel::AVX2})
+    {
+        if (!OrbKernelSupported(kernel)) continue;
+        SetOrbKernel(kernel);
+        orb.ComputeDescriptors(img.getImageView(), keypoints, descriptors);
+        for (size_t i = 0; i < keypoints.size(); ++i)
+        {
+            EXPECT_EQ(descriptors[i], ref[i]) << OrbKernelName(kernel) << " " << keypoints[i];
+        }
+    }
+    SetOrbKernel(default_kernel);
+}
+
+}  // namespace Saiga
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/vision/pgo/PGOIncremental.h"
+#include "saiga/vision/recursive/PGORecursive.h"
+#include "saiga/vision/scene/SynteticPoseGraph.h"
+#include "saiga/vision/util/Random.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+// Adds vertex i of the reference graph and all edges (a, b) with max(a, b) == i.
+// The new vertex is initialized by chaining the odometry edge to the current estimate of vertex i-1.
+static void AddNextVertex(const PoseGraph& reference, PoseGraph& graph)
+{
+    int i = graph.vertices.size();
+    graph.vertices.push_back(reference.vertices[i]);
+    if (i > 0)
+    {
+        for (auto& e : reference.edges)
+        {
+            if (e.from == i - 1 && e.to == i)
+            {
+                graph.vertices[i].SetPose(graph.vertices[i - 1].Pose() * e.GetSE3());
+            }
+        }
+    }
+    for (auto& e : reference.edges)
+    {
+        if (std::max(e.from, e.to) == i) graph.edges.push_back(e);
+    }
+}
+
+// Circle graph with noisy edge measurements.
+static PoseGraph NoisyCircle(int n, int connections)
+{
+    PoseGraph pg = SyntheticPoseGraph::Circle(5, n, connections);
+    for (auto& e : pg.edges)
+    {
+        e.T_i_j = DSim3(Random::JitterPose(e.GetSE3(), 0.01, 0.01), 1.0);
+    }
+    return pg;
+}
+
+TEST(PGOIncremental, MatchesBatch)
+{
+    Random::setSeed(3956);
+    auto reference = NoisyCircle(150, 3);
+
+    PoseGraph graph;
+    PGOIncremental pgo;
+    pgo.create(graph);
+
+    int num_full_solves = 0;
+    for (int i = 0; i < (int)reference.vertices.size(); ++i)
+    {
+        AddNextVertex(reference, graph);
+        auto result = pgo.Update();
+        num_full_solves += result.full_solve;
+    }
+    // Only the wrap-around loop closure edges of the last vertices trigger a full solve.
+    EXPECT_GE(num_full_solves, 1);
+    EXPECT_LE(num_full_solves, 3);
+
+    auto batch = graph;
+    batch.sortEdges();
+    PGORec rec;
+    rec.create(batch);
+    rec.optimizationOptions.maxIterations = 10;
+    rec.optimizationOptions.solverType    = OptimizationOptions::SolverType::Direct;
+    rec.initAndSolve();
+
+    double chi2_incremental = graph.chi2();
+    double chi2_batch       = batch.chi2();
+    EXPECT_LE(chi2_incremental, chi2_batch * 1.01 + 1e-10);
+
+    for (int i = 0; i < (int)graph.vertices.size(); ++i)
+    {
+        Vec6 diff = Sophus::se3_logd(graph.vertices[i].Pose() * batch.vertices[i].Pose().inverse());
+        EXPECT_LT(diff.norm(), 1e-3);
+    }
+}
+
+TEST(PGOIncremental, OdometryRefactorsTail)
+{
+    Random::setSeed(3957);
+    int connections = 3;
+    auto reference  = SyntheticPoseGraph::Linear(150, connections);
+
+    PoseGraph graph;
+    PGOIncremental pgo;
+    pgo.create(graph);
+    for (int i = 0; i < (int)reference.vertices.size(); ++i)
+    {
+        AddNextVertex(reference, graph);
+        auto result = pgo.Update();
+        EXPECT_FALSE(result.full_solve);
+        EXPECT_LE(result.refactored_vertices, connections + 1);
+        EXPECT_EQ(result.relinearized_vertices, 0);
+    }
+    EXPECT_NEAR(graph.chi2(), 0, 1e-10);
+
+    // Large loop closure with an inconsistent measurement
+    PoseEdge e = graph.edges.front();
+    e.from     = 0;
+    e.to       = graph.vertices.size() - 1;
+    e.setRel(graph.vertices[e.from].Pose(), graph.vertices[e.to].Pose() * Sophus::se3_expd(Vec6::Constant(0.05)));
+    graph.edges.push_back(e);
+
+    auto result = pgo.Update();
+    EXPECT_TRUE(result.full_solve);
+    EXPECT_GT(graph.chi2(), 0);
+
+    auto batch = graph;
+    batch.sortEdges();
+    PGORec rec;
+    rec.create(batch);
+    rec.optimizationOptions.maxIterations = 10;
+    rec.optimizationOptions.solverType    = OptimizationOptions::SolverType::Direct;
+    rec.initAndSolve();
+    EXPECT_LE(graph.chi2(), batch.chi2() * 1.01 + 1e-10);
+}
+
+}  // namespace Saiga
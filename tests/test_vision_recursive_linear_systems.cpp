@@ -123,6 +123,90 @@ TEST(RecursiveLinearSolver, SparseBlock)
     }
 }
 
+TEST(RecursiveLinearSolver, SupernodalLLT)
+{
+    Random::setSeed(3469346);
+    srand(4586);
+
+    using T              = double;
+    const int block_size = 6;
+    int n                = 300;
+
+    using Block  = Eigen::Matrix<T, block_size, block_size>;
+    using Vector = Eigen::Matrix<T, block_size, 1>;
+    using AType  = Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<Block>, Eigen::RowMajor>;
+    using BType  = Eigen::Matrix<Eigen::Recursive::MatrixScalar<Vector>, -1, 1>;
+
+    // Upper triangle of a diagonal dominant matrix with a 2D grid pattern and a few random long range edges.
+    // This produces a lot of fill in and therefore large supernodes.
+    int side = 15;
+    std::vector<Eigen::Triplet<Block>> trips;
+    for (int i = 0; i < n; ++i)
+    {
+        Block diag = Block::Random();
+        diag       = diag * diag.transpose();
+        diag.diagonal().array() += 50;
+        trips.emplace_back(i, i, diag);
+
+        std::vector<int> neighbors = {i + 1, i + side};
+        for (auto j : Random::uniqueIndices(1, n)) neighbors.push_back(j);
+        for (auto j : neighbors)
+        {
+            if (j > i && j < n) trips.emplace_back(i, j, Block::Random());
+        }
+    }
+    AType A(n, n);
+    A.setFromTriplets(trips.begin(), trips.end());
+
+    BType b(n);
+    for (int i = 0; i < n; ++i) b(i) = Vector::Random();
+
+    Eigen::Matrix<double, -1, -1> A_ex = expand(A);
+    A_ex                               = A_ex.selfadjointView<Eigen::Upper>();
+    Eigen::Matrix<double, -1, 1> b_ex  = expand(b);
+    Eigen::Matrix<double, -1, 1> ref_x = A_ex.llt().solve(b_ex);
+
+    Eigen::RecursiveSupernodalLLT<AType, Eigen::Upper> llt;
+    llt.compute(A);
+    EXPECT_EQ(llt.info(), Eigen::Success);
+    EXPECT_LT(llt.numSupernodes(), n);
+    BType x = llt.solve(b);
+    ExpectCloseRelative(ref_x, expand(x), 1e-10, false);
+
+    // Refactorize with new values
+    for (int k = 0; k < A.outerSize(); ++k)
+    {
+        for (AType::InnerIterator it(A, k); it; ++it)
+        {
+            if (it.row() == it.col()) it.valueRef().get().diagonal().array() += 10;
+        }
+    }
+    A_ex  = expand(A);
+    A_ex  = A_ex.selfadjointView<Eigen::Upper>();
+    ref_x = A_ex.llt().solve(b_ex);
+    llt.factorize(A);
+    EXPECT_EQ(llt.info(), Eigen::Success);
+    x = llt.solve(b);
+    ExpectCloseRelative(ref_x, expand(x), 1e-10, false);
+
+    // Same result as the simplicial ldlt
+    Eigen::RecursiveSimplicialLDLT<AType, Eigen::Upper> ldlt;
+    ldlt.compute(A);
+    BType x_ldlt = ldlt.solve(b);
+    ExpectCloseRelative(expand(x_ldlt), expand(x), 1e-10, false);
+
+    // Not positive definite
+    for (int k = 0; k < A.outerSize(); ++k)
+    {
+        for (AType::InnerIterator it(A, k); it; ++it)
+        {
+            if (it.row() == 7 && it.col() == 7) it.valueRef().get() = -Block::Identity();
+        }
+    }
+    llt.factorize(A);
+    EXPECT_EQ(llt.info(), Eigen::NumericalIssue);
+}
+
 TEST(RecursiveLinearSolver, BA)
 {
     // Symmetric positive BA like matrix.
@@ -276,6 +360,24 @@ TEST(RecursiveLinearSolver, BA)
         ExpectCloseRelative(ref_x1, expand(x.u), 1e-10, false);
         ExpectCloseRelative(ref_x2, expand(x.v), 1e-10, false);
     }
+
+    // Float PCG with iterative refinement reaches double accuracy
+    for (bool explizit : {false, true})
+    {
+        setZero(x);
+        Eigen::Recursive::LinearSolverOptions lops;
+        lops.solverType             = Eigen::Recursive::LinearSolverOptions::SolverType::Iterative;
+        lops.maxIterativeIterations = 200;
+        lops.iterativeTolerance     = 1e-14;
+        lops.buildExplizitSchur     = explizit;
+        lops.mixedPrecision         = true;
+        lops.maxRefinementSteps     = 10;
+        BASolver mixed_solver;
+        mixed_solver.analyzePattern(A, lops);
+        mixed_solver.solve(A, x, b, lops);
+        ExpectCloseRelative(ref_x1, expand(x.u), 1e-10, false);
+        ExpectCloseRelative(ref_x2, expand(x.v), 1e-10, false);
+    }
 }
 
 
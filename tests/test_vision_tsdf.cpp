@@ -6,6 +6,7 @@
 #include "saiga/core/Core.h"
 #include "saiga/core/model/model_loader_ply.h"
 #include "saiga/vision/reconstruction/MarchingCubes.h"
+#include "saiga/vision/reconstruction/MeshToTSDF.h"
 #include "saiga/vision/reconstruction/SparseTSDF.h"
 #include "saiga/vision/reconstruction/VoxelFusion.h"
 
@@ -107,6 +108,140 @@ TEST(TSDF, Create)
 //    }
 }
 
+TEST(TSDF, ExtractSurfaceIndexed)
+{
+    auto& tsdf = *test->tsdf;
+    auto tris  = tsdf.ExtractSurface(0, 4, 0, 1, false);
+    auto mesh  = tsdf.ExtractSurfaceIndexed(0, 4, 0, 1, false);
+
+    // Same triangles in the same order as the triangle soup
+    std::vector<SparseTSDF::Triangle> soup;
+    for (auto& t : tris) soup.insert(soup.end(), t.begin(), t.end());
+    ASSERT_EQ(mesh.NumFaces(), soup.size());
+    EXPECT_EQ(mesh.NumVertices(), mesh.normal.size());
+    EXPECT_LT(mesh.NumVertices(), soup.size());
+
+    for (int t = 0; t < (int)soup.size(); ++t)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            ExpectCloseRelative(mesh.position[mesh.triangles[t](i)], soup[t][i], 1e-5, false);
+        }
+    }
+
+    // The sphere is closed -> every edge is shared by exactly two triangles
+    std::map<std::pair<int, int>, int> edge_count;
+    for (auto& t : mesh.triangles)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            int a = t(i), b = t((i + 1) % 3);
+            edge_count[{std::min(a, b), std::max(a, b)}]++;
+        }
+    }
+    for (auto& e : edge_count)
+    {
+        EXPECT_EQ(e.second, 2);
+    }
+
+    // Gradient normals point outwards
+    for (int v = 0; v < mesh.NumVertices(); ++v)
+    {
+        vec3 radial = (mesh.position[v] - test->sphere.pos).normalized();
+        EXPECT_GT(mesh.normal[v].dot(radial), 0.99);
+    }
+}
+
+TEST(TSDF, WindingNumber)
+{
+    auto tris = test->mesh.TriangleSoup();
+    AccelerationStructure::SAHBVH bvh(tris);
+    bvh.ComputeWindingNumberData();
+
+    // The extracted sphere is closed -> |w| = 1 inside and 0 outside.
+    // The dipole approximation has an error of a few percent. With a large beta the sum is exact.
+    for (int i = 0; i < 1000; ++i)
+    {
+        vec3 dir     = Random::MatrixUniform<vec3>(-1, 1).normalized();
+        vec3 inside  = dir * Random::sampleDouble(0, 0.4);
+        vec3 outside = dir * Random::sampleDouble(0.6, 3);
+        EXPECT_NEAR(std::abs(bvh.WindingNumber(inside)), 1, 0.05);
+        EXPECT_NEAR(bvh.WindingNumber(outside), 0, 0.05);
+        EXPECT_NEAR(std::abs(bvh.WindingNumber(inside, 1e10)), 1, 1e-4);
+        EXPECT_NEAR(bvh.WindingNumber(outside, 1e10), 0, 1e-4);
+    }
+}
+
+TEST(TSDF, MeshToTSDF)
+{
+    auto tris = test->mesh.TriangleSoup();
+    for (auto mode : {MeshToTSDFSign::WindingNumber, MeshToTSDFSign::RayCasting})
+    {
+        auto tsdf = MeshToTSDF(tris, 0.05, 1, mode);
+        EXPECT_GT(tsdf->current_blocks, 0);
+
+        int wrong_sign = 0;
+        for (int b = 0; b < tsdf->current_blocks; ++b)
+        {
+            auto& block = tsdf->blocks[b];
+            for (int i = 0; i < tsdf->VOXEL_BLOCK_SIZE; ++i)
+            {
+                for (int j = 0; j < tsdf->VOXEL_BLOCK_SIZE; ++j)
+                {
+                    for (int k = 0; k < tsdf->VOXEL_BLOCK_SIZE; ++k)
+                    {
+                        float expected = test->sphere.sdf(tsdf->GlobalPosition(block.index, i, j, k));
+                        float d        = block.data[i][j][k].distance;
+                        if (std::abs(expected) > 0.05 && (d < 0) != (expected < 0)) wrong_sign++;
+                    }
+                }
+            }
+        }
+        EXPECT_EQ(wrong_sign, 0);
+    }
+}
+
+TEST(TSDF, SaveLoadCompressed)
+{
+    test->tsdf->SaveCompressed("tsdf_compressed.dat");
+    SparseTSDF tsdf;
+    tsdf.LoadCompressed("tsdf_compressed.dat");
+    EXPECT_TRUE(tsdf == *test->tsdf);
+}
+
+TEST(TSDF, SaveLoadLegacy)
+{
+    auto& ref = *test->tsdf;
+    test->tsdf->Save("tsdf.dat");
+    SparseTSDF tsdf;
+    tsdf.Load("tsdf.dat");
+    EXPECT_TRUE(tsdf == ref);
+
+    // Files without the version header stored the block array with the hash chains and the hash bucket heads
+    struct LegacyVoxelBlock
+    {
+        decltype(SparseTSDF::VoxelBlock::data) data;
+        SparseTSDF::VoxelBlockIndex index;
+        int next_index;
+    };
+    std::vector<LegacyVoxelBlock> legacy_blocks(ref.current_blocks + 10);
+    for (int i = 0; i < ref.current_blocks; ++i)
+    {
+        legacy_blocks[i].data       = ref.blocks[i].data;
+        legacy_blocks[i].index      = ref.blocks[i].index;
+        legacy_blocks[i].next_index = -1;
+    }
+    {
+        BinaryFile strm("tsdf_legacy.dat", std::ios_base::out);
+        strm << ref.voxel_size << ref.voxel_size_inv << ref.block_size_inv << ref.hash_size << ref.current_blocks;
+        strm << legacy_blocks << std::vector<int>(ref.hash_size, -1);
+    }
+    SparseTSDF legacy;
+    legacy.Load("tsdf_legacy.dat");
+    EXPECT_TRUE(legacy == ref);
+    EXPECT_EQ(legacy.GetBlockId(ref.blocks[0].index), 0);
+}
+
 TEST(TSDF, InsertRemoveBlock)
 {
     {
@@ -145,6 +280,44 @@ TEST(TSDF, InsertRemoveBlock)
     }
 }
 
+TEST(TSDF, InsertBlockConcurrent)
+{
+    Random::setSeed(9346723);
+    std::vector<ivec3> indices;
+    for (int i = 0; i < 200000; ++i)
+    {
+        indices.push_back(ivec3(Random::uniformInt(-30, 30), Random::uniformInt(-30, 30), Random::uniformInt(-3, 3)));
+    }
+
+    // Small hash and block pool -> long bucket lists and growing of the pool during insertion
+    SparseTSDF serial(1, 10, 97);
+    SparseTSDF concurrent(1, 10, 97);
+
+    for (auto& i : indices) serial.InsertBlock(i);
+
+#pragma omp parallel for num_threads(8)
+    for (int k = 0; k < (int)indices.size(); ++k)
+    {
+        auto* b = concurrent.InsertBlockConcurrent(indices[k]);
+        EXPECT_EQ(b->index, indices[k]);
+    }
+
+    EXPECT_EQ(serial.Size(), concurrent.Size());
+    for (int b = 0; b < concurrent.Size(); ++b)
+    {
+        auto index = concurrent.blocks[b].index;
+        EXPECT_EQ(concurrent.GetBlockId(index), b);
+        EXPECT_TRUE(serial.GetBlock(index));
+    }
+
+    // The serial functions still work on the concurrently built hash map
+    auto copy = concurrent;
+    EXPECT_TRUE(copy.EraseBlock(indices.front()));
+    EXPECT_FALSE(copy.GetBlock(indices.front()));
+    EXPECT_EQ(copy.Size(), serial.Size() - 1);
+    EXPECT_EQ(copy.NumBlocksInRect(copy.Bounds()), copy.Size());
+}
+
 TEST(TSDF, Crop)
 {
     Random::setSeed(394765346);
@@ -177,6 +350,81 @@ TEST(TSDF, Crop)
 }
 
 
+TEST(TSDF, Streaming)
+{
+    auto& src = *test->tsdf;
+
+    SparseTSDF tsdf(src.voxel_size, 100, 1000);
+    tsdf.EnableStreaming("tsdf_streaming.swap");
+    for (int i = 0; i < src.current_blocks; ++i)
+    {
+        tsdf.InsertBlock(src.blocks[i].index)->data = src.blocks[i].data;
+    }
+    int n = tsdf.current_blocks;
+
+    // Keep only the positive octant in memory
+    iRect<3> region(ivec3(0, 0, 0), ivec3(100, 100, 100));
+    int in_region = tsdf.NumBlocksInRect(region);
+    int evicted   = tsdf.EvictOutside(region);
+    EXPECT_EQ(evicted, n - in_region);
+    EXPECT_EQ(tsdf.current_blocks, in_region);
+    EXPECT_EQ(tsdf.storage->Size(), evicted);
+    EXPECT_EQ(tsdf.AllBlockIndices().size(), n);
+
+    // Insert pages in the evicted block
+    ivec3 index(-1, -2, -1);
+    EXPECT_FALSE(tsdf.GetBlock(index));
+    auto* block = tsdf.InsertBlock(index);
+    EXPECT_EQ(memcmp(&block->data, &src.GetBlock(index)->data, sizeof(block->data)), 0);
+    EXPECT_EQ(tsdf.storage->Size(), evicted - 1);
+
+    // Evict and page in again, this time the slot in the file is reused
+    block->data[1][2][3].distance = 7;
+    auto file_size                = tsdf.storage->FileSize();
+    tsdf.EvictBlock(index);
+    EXPECT_EQ(tsdf.PageIn(index)->data[1][2][3].distance, 7);
+    EXPECT_LE(tsdf.storage->FileSize(), file_size + sizeof(block->data) + 64);
+    tsdf.GetBlock(index)->data[1][2][3].distance = src.GetBlock(index)->data[1][2][3].distance;
+
+    // The chunked extraction produces the same surface and only keeps one chunk in memory
+    auto triangles        = src.ExtractSurface(0, 4, 0, 1, false);
+    auto triangles_stream = tsdf.ExtractSurfaceStreaming(0, 4, 0, 1, false, 3);
+    EXPECT_LE(tsdf.current_blocks, 4 * 4 * 4);
+
+    size_t count = 0, count_stream = 0;
+    for (auto& t : triangles) count += t.size();
+    for (auto& t : triangles_stream) count_stream += t.size();
+    EXPECT_GT(count, 0);
+    EXPECT_EQ(count, count_stream);
+
+    // The saved files also contain the evicted blocks
+    auto expect_equal_blocks = [&](SparseTSDF& loaded) {
+        ASSERT_EQ(loaded.current_blocks, src.current_blocks);
+        for (int i = 0; i < src.current_blocks; ++i)
+        {
+            auto* block = loaded.GetBlock(src.blocks[i].index);
+            ASSERT_TRUE(block);
+            EXPECT_EQ(memcmp(&block->data, &src.blocks[i].data, sizeof(block->data)), 0);
+        }
+    };
+    int resident = tsdf.current_blocks;
+    tsdf.Save("tsdf_streaming.dat");
+    EXPECT_EQ(tsdf.current_blocks, resident);
+    SparseTSDF loaded;
+    loaded.Load("tsdf_streaming.dat");
+    expect_equal_blocks(loaded);
+#ifdef SAIGA_USE_ZLIB
+    tsdf.SaveCompressed("tsdf_streaming_compressed.dat");
+    SparseTSDF loaded_compressed;
+    loaded_compressed.LoadCompressed("tsdf_streaming_compressed.dat");
+    expect_equal_blocks(loaded_compressed);
+#endif
+
+    tsdf.PageInAll();
+    EXPECT_EQ(tsdf.current_blocks, n);
+    EXPECT_EQ(tsdf.storage->Size(), 0);
+}
+
 TEST(TSDF, VirtualVoxelIndex)
 {
     {
@@ -116,6 +116,49 @@ TEST(TSDF, IncrementalFuse)
     EXPECT_EQ(test->scene.tsdf->current_blocks, scene2.tsdf->current_blocks);
 }
 
+TEST(TSDF, StreamingFuse)
+{
+    // The second view looks into the opposite direction and evicts the blocks of the first view. The third view
+    // sees the surface further away, so the paged in blocks of the first surface are in free space.
+    TemplatedImage<float> far_depth = test->depth_image;
+    for (auto i : far_depth.rowRange())
+    {
+        for (auto j : far_depth.colRange()) far_depth(i, j) *= 1.5f;
+    }
+
+    std::vector<FusionImage> images(3, test->scene.images.front());
+    images[1].V.so3() = Sophus::SO3d::exp(Vec3(0, pi<double>(), 0));
+    images[2].depthMap = far_depth.getConstImageView();
+
+    auto fuse = [&](bool streaming) {
+        FusionScene scene;
+        scene = test->scene;
+        scene.images.clear();
+        scene.params.streaming      = streaming;
+        scene.params.streaming_file = "tsdf_fuse_streaming.swap";
+        for (int i = 0; i < (int)images.size(); ++i)
+        {
+            scene.FuseIncrement(images[i], i == 0);
+        }
+        if (streaming) EXPECT_GT(scene.tsdf->storage->Size(), 0);
+        scene.tsdf->PageInAll();
+        return scene.tsdf;
+    };
+
+    auto tsdf        = fuse(false);
+    auto tsdf_stream = fuse(true);
+
+    ASSERT_EQ(tsdf->current_blocks, tsdf_stream->current_blocks);
+    int different = 0;
+    for (int i = 0; i < tsdf->current_blocks; ++i)
+    {
+        auto* block = tsdf_stream->GetBlock(tsdf->blocks[i].index);
+        ASSERT_TRUE(block);
+        different += memcmp(&block->data, &tsdf->blocks[i].data, sizeof(block->data)) != 0;
+    }
+    EXPECT_EQ(different, 0);
+}
+
 
 
 TEST(TSDF, LoadStore)
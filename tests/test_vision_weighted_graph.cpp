@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/vision/slam/WeightedUndirectedGraph.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+// Random graph with num_clusters disconnected clusters.
+static WeightedUndirectedGraph<int> RandomGraph(int n, int edges_per_node, int num_clusters)
+{
+    WeightedUndirectedGraph<int> graph(n);
+    for (int i = 0; i < n; ++i)
+    {
+        for (int e = 0; e < edges_per_node; ++e)
+        {
+            int j = Random::uniformInt(0, n / num_clusters - 1) * num_clusters + i % num_clusters;
+            if (j == i) continue;
+            graph.AddEdge(i, j, Random::uniformInt(1, 1000));
+        }
+    }
+    return graph;
+}
+
+// Reference: O(V^2) Prim on the dense adjacency matrix. Returns the weight of the maximum spanning forest.
+static long DenseMSTWeight(const WeightedUndirectedGraph<int>& graph)
+{
+    int n = graph.NumNodes();
+    Eigen::MatrixXi A(n, n);
+    A.setConstant(-1);
+    for (int i = 0; i < n; ++i) graph.ForEachNeighbor(i, [&](int j, int w) { A(i, j) = w; });
+
+    std::vector<bool> visited(n, false);
+    std::vector<int> best(n, -1);
+    long total = 0;
+    for (int it = 0; it < n; ++it)
+    {
+        int next = -1;
+        for (int j = 0; j < n; ++j)
+        {
+            if (!visited[j] && (next == -1 || best[j] > best[next])) next = j;
+        }
+        visited[next] = true;
+        if (best[next] > 0) total += best[next];
+        for (int j = 0; j < n; ++j)
+        {
+            if (!visited[j]) best[j] = std::max(best[j], A(next, j));
+        }
+    }
+    return total;
+}
+
+TEST(WeightedUndirectedGraph, IncrementalUpdate)
+{
+    WeightedUndirectedGraph<int> graph(4);
+    graph.AddWeight(0, 1, 5);
+    graph.AddWeight(1, 0, 3);
+    graph.AddWeight(2, 3, 1);
+    EXPECT_EQ(graph.NumEdges(), 2);
+    EXPECT_EQ(graph.Weight(0, 1), 8);
+    EXPECT_EQ(graph.Weight(1, 0), 8);
+
+    // The edge is removed when the weight reaches 0
+    graph.AddWeight(3, 2, -1);
+    EXPECT_EQ(graph.NumEdges(), 1);
+    EXPECT_EQ(graph.Weight(2, 3), graph.invalid_weight);
+
+    int node = graph.AddNode();
+    graph.AddEdge(node, 0, 2);
+    graph.AddEdge(node, 1, 7);
+    EXPECT_EQ(graph.NumEdges(), 3);
+    graph.RemoveEdges(node);
+    EXPECT_EQ(graph.NumEdges(), 1);
+    EXPECT_EQ(graph.Degree(0), 1);
+}
+
+TEST(WeightedUndirectedGraph, MST)
+{
+    for (int clusters : {1, 3})
+    {
+        auto graph = RandomGraph(300, 4, clusters);
+        graph.BuildMST();
+        auto mst = graph.GetMSTAsGraph();
+
+        std::vector<int> components;
+        int num_components = graph.ConnectedComponents(components);
+
+        // A spanning forest has V - C edges
+        EXPECT_EQ(mst.NumEdges(), graph.NumNodes() - num_components);
+        EXPECT_GE(num_components, clusters);
+
+        std::vector<int> mst_components;
+        EXPECT_EQ(mst.ConnectedComponents(mst_components), num_components);
+        EXPECT_EQ(mst_components, components);
+
+        long total = 0;
+        for (int i = 0; i < mst.NumNodes(); ++i) mst.ForEachNeighbor(i, [&](int, int w) { total += w; });
+        EXPECT_EQ(total / 2, DenseMSTWeight(graph));
+
+        for (int i = 0; i < graph.NumNodes(); ++i)
+        {
+            EXPECT_EQ(graph.GetMSTEdgesForNode(i).size(), mst.Degree(i));
+        }
+    }
+}
+
+TEST(WeightedUndirectedGraph, StrongestNeighbors)
+{
+    auto graph = RandomGraph(100, 10, 1);
+    for (int i = 0; i < graph.NumNodes(); ++i)
+    {
+        auto all = graph.GetEdgesForNode(i);
+        std::sort(all.begin(), all.end(), [](auto& a, auto& b) { return a.weight > b.weight; });
+
+        auto top = graph.StrongestNeighbors(i, 3);
+        ASSERT_EQ(top.size(), std::min<size_t>(3, all.size()));
+        for (int k = 0; k < top.size(); ++k)
+        {
+            EXPECT_EQ(top[k].second, all[k].weight);
+        }
+    }
+}
+
+TEST(WeightedUndirectedGraph, CSR)
+{
+    auto graph = RandomGraph(200, 5, 2);
+    CSRGraph<int> csr(graph);
+    EXPECT_EQ(csr.NumNodes(), graph.NumNodes());
+    EXPECT_EQ(csr.NumEdges(), graph.NumEdges());
+
+    for (int i = 0; i < graph.NumNodes(); ++i)
+    {
+        EXPECT_EQ(csr.Degree(i), graph.Degree(i));
+        auto neighbors = csr.Neighbors(i);
+        EXPECT_TRUE(std::is_sorted(neighbors.begin(), neighbors.end()));
+        graph.ForEachNeighbor(i, [&](int j, int w) { EXPECT_EQ(csr.Weight(i, j), w); });
+        EXPECT_EQ(StrongestNeighbors(csr, i, 4), graph.StrongestNeighbors(i, 4));
+    }
+
+    EXPECT_EQ(MaximumSpanningForest(csr), MaximumSpanningForest(graph));
+
+    std::vector<int> c1, c2;
+    EXPECT_EQ(ConnectedComponents(csr, c1), ConnectedComponents(graph, c2));
+    EXPECT_EQ(c1, c2);
+}
+
+}  // namespace Saiga